@@ -0,0 +1,815 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg/rate-limiting.h>
+#include <locale.h>
+#include <math.h>
+#include <string.h>
+
+
+/*
+ * Analyse the code space of libeos-payg-codes for a set of keys, to check the
+ * assumptions behind the rate limiting in libeos-payg/manager.c: that the
+ * truncated signatures are uniformly distributed, so that each guess at a code
+ * has a 1 in 2^SIGN_WIDTH_BITS chance of being valid, and that codes for one
+ * key say nothing about codes for another.
+ *
+ * The signature of a code depends only on its period and counter, so every
+ * code value for a key can be classified from one HMAC per (period, counter)
+ * pair: 27 × 256 HMACs per key, rather than 2^26. --exhaustive additionally
+ * verifies every code value with epc_signing_key_verify_code(), as a device
+ * would, and checks the results agree.
+ */
+
+/* Exit statuses. */
+typedef enum
+{
+  /* Success. */
+  EXIT_OK = 0,
+  /* Error parsing command line options. */
+  EXIT_INVALID_OPTIONS = 1,
+  /* Analysis failed, or --exhaustive found an inconsistency. */
+  EXIT_FAILED = 2,
+} ExitStatus;
+
+#define COUNTER_WIDTH_BITS EPC_CODE_COUNTER_WIDTH_BITS
+#define PERIOD_WIDTH_BITS EPC_CODE_PERIOD_WIDTH_BITS
+#define SIGN_WIDTH_BITS EPC_CODE_SIGNATURE_WIDTH_BITS
+#define CODE_VALUE_WIDTH_BITS EPC_CODE_WIDTH_BITS
+
+#define N_CODE_VALUES (1 << CODE_VALUE_WIDTH_BITS)
+#define N_PERIOD_VALUES (1 << PERIOD_WIDTH_BITS)
+#define N_COUNTERS (1 << COUNTER_WIDTH_BITS)
+#define N_SIGNATURES (1 << SIGN_WIDTH_BITS)
+#define N_CODE_VALUES_PER_PERIOD (N_COUNTERS * N_SIGNATURES)
+#define SIGNATURE_MASK (N_SIGNATURES - 1)
+
+/* Number of signatures calculated for each key. */
+#define N_SIGNATURES_PER_KEY (EPC_N_PERIODS * N_COUNTERS)
+
+/* Simulated attacks which haven’t succeeded after this many attempts are
+ * counted as failures. The expected number of attempts is N_SIGNATURES. */
+#define MAXIMUM_SIMULATED_ATTEMPTS (1 << 24)
+
+/* A |z| score for the chi-squared test above this is reported as
+ * non-uniform. */
+#define UNIFORMITY_Z_THRESHOLD 4.0
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+/* How much credit each period gives, as in extend_expiry_time() in
+ * libeos-payg/manager.c. */
+static const struct
+  {
+    EpcPeriod period;
+    guint64 duration_secs;
+  }
+period_durations[] =
+  {
+    { EPC_PERIOD_5_SECONDS, 5 },
+    { EPC_PERIOD_1_MINUTE, 60 },
+    { EPC_PERIOD_5_MINUTES, 5 * 60 },
+    { EPC_PERIOD_30_MINUTES, 30 * 60 },
+    { EPC_PERIOD_1_HOUR, 60 * 60 },
+    { EPC_PERIOD_8_HOURS, 8 * 60 * 60 },
+    { EPC_PERIOD_1_DAY, 1 * SECONDS_PER_DAY },
+    { EPC_PERIOD_2_DAYS, 2 * SECONDS_PER_DAY },
+    { EPC_PERIOD_3_DAYS, 3 * SECONDS_PER_DAY },
+    { EPC_PERIOD_4_DAYS, 4 * SECONDS_PER_DAY },
+    { EPC_PERIOD_5_DAYS, 5 * SECONDS_PER_DAY },
+    { EPC_PERIOD_6_DAYS, 6 * SECONDS_PER_DAY },
+    { EPC_PERIOD_7_DAYS, 7 * SECONDS_PER_DAY },
+    { EPC_PERIOD_8_DAYS, 8 * SECONDS_PER_DAY },
+    { EPC_PERIOD_9_DAYS, 9 * SECONDS_PER_DAY },
+    { EPC_PERIOD_10_DAYS, 10 * SECONDS_PER_DAY },
+    { EPC_PERIOD_11_DAYS, 11 * SECONDS_PER_DAY },
+    { EPC_PERIOD_12_DAYS, 12 * SECONDS_PER_DAY },
+    { EPC_PERIOD_13_DAYS, 13 * SECONDS_PER_DAY },
+    { EPC_PERIOD_14_DAYS, 14 * SECONDS_PER_DAY },
+    { EPC_PERIOD_30_DAYS, 30 * SECONDS_PER_DAY },
+    { EPC_PERIOD_31_DAYS, 31 * SECONDS_PER_DAY },
+    { EPC_PERIOD_60_DAYS, 60 * SECONDS_PER_DAY },
+    { EPC_PERIOD_90_DAYS, 90 * SECONDS_PER_DAY },
+    { EPC_PERIOD_120_DAYS, 120 * SECONDS_PER_DAY },
+    { EPC_PERIOD_365_DAYS, 365 * SECONDS_PER_DAY },
+    { EPC_PERIOD_INFINITE, G_MAXUINT64 },
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (period_durations) == EPC_N_PERIODS);
+
+/* Durations to report the probability of a brute force attack succeeding
+ * within. */
+static const guint report_days[] = { 1, 7, 30, 365 };
+
+typedef struct
+{
+  /* Inputs. */
+  GPtrArray *keys;  /* (owned) (element-type EpcSigningKey) */
+  guint32 seed;
+  guint n_trials;
+  guint n_attempts;
+  guint window_secs;
+
+  /* Valid periods, in the order used to index @signatures, and the reverse
+   * mapping from period value to index (or -1 if the period is invalid). */
+  EpcPeriod periods[EPC_N_PERIODS];
+  gint period_indices[N_PERIOD_VALUES];
+
+  /* Signature of each (key, period index, counter). */
+  guint16 *signatures;  /* (owned) (array length=keys->len × N_SIGNATURES_PER_KEY) */
+
+  /* Results from --exhaustive, indexed by (key, period value). */
+  guint *n_verified;  /* (owned) (nullable) */
+  guint *n_mismatches;  /* (owned) (nullable) */
+
+  /* Results from comparing each key with all the later keys. */
+  guint64 *n_collisions;  /* (owned) (array length=keys->len) */
+  guint64 *n_near_collisions;  /* (owned) (array length=keys->len) */
+  guint64 *max_pair_collisions;  /* (owned) (array length=keys->len) */
+
+  /* Results from the brute force simulation: the number of attempts each
+   * trial took (or 0 if it failed), and the period of the code it found. */
+  guint64 *trial_attempts;  /* (owned) (array length=n_trials) */
+  EpcPeriod *trial_periods;  /* (owned) (array length=n_trials) */
+} Analysis;
+
+static void
+analysis_clear (Analysis *analysis)
+{
+  g_clear_pointer (&analysis->keys, g_ptr_array_unref);
+  g_clear_pointer (&analysis->signatures, g_free);
+  g_clear_pointer (&analysis->n_verified, g_free);
+  g_clear_pointer (&analysis->n_mismatches, g_free);
+  g_clear_pointer (&analysis->n_collisions, g_free);
+  g_clear_pointer (&analysis->n_near_collisions, g_free);
+  g_clear_pointer (&analysis->max_pair_collisions, g_free);
+  g_clear_pointer (&analysis->trial_attempts, g_free);
+  g_clear_pointer (&analysis->trial_periods, g_free);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (Analysis, analysis_clear)
+
+static const guint16 *
+get_key_signatures (const Analysis *analysis,
+                    guint           key_index)
+{
+  return analysis->signatures + (gsize) key_index * N_SIGNATURES_PER_KEY;
+}
+
+/* Running work items in parallel. Each thread takes the next unclaimed item
+ * until there are none left, so uneven items still balance across threads. */
+typedef void (*WorkFunc) (Analysis *analysis,
+                          guint     item);
+
+typedef struct
+{
+  Analysis *analysis;  /* (unowned) */
+  WorkFunc func;
+  guint n_items;
+  gint next_item;  /* (atomic) */
+} ParallelWork;
+
+static gpointer
+parallel_work_thread_cb (gpointer user_data)
+{
+  ParallelWork *work = user_data;
+
+  while (TRUE)
+    {
+      guint item = (guint) g_atomic_int_add (&work->next_item, 1);
+      if (item >= work->n_items)
+        break;
+
+      work->func (work->analysis, item);
+    }
+
+  return NULL;
+}
+
+static void
+run_parallel (Analysis *analysis,
+              guint     n_threads,
+              guint     n_items,
+              WorkFunc  func)
+{
+  ParallelWork work = { analysis, func, n_items, 0 };
+  g_autoptr(GPtrArray) threads = g_ptr_array_new ();
+
+  g_assert (n_items <= G_MAXINT);
+
+  n_threads = CLAMP (n_threads, 1, MAX (n_items, 1));
+
+  for (guint i = 0; i < n_threads; i++)
+    g_ptr_array_add (threads, g_thread_new ("analyse", parallel_work_thread_cb, &work));
+
+  for (guint i = 0; i < threads->len; i++)
+    g_thread_join (threads->pdata[i]);
+}
+
+/* Work item: calculate all the signatures for one key. */
+static void
+calculate_signatures_cb (Analysis *analysis,
+                         guint     key_index)
+{
+  EpcSigningKey *key = analysis->keys->pdata[key_index];
+  guint16 *signatures = analysis->signatures + (gsize) key_index * N_SIGNATURES_PER_KEY;
+
+  for (gsize i = 0; i < EPC_N_PERIODS; i++)
+    {
+      for (guint counter = 0; counter < N_COUNTERS; counter++)
+        {
+          g_autoptr(GError) local_error = NULL;
+          EpcCode code = epc_signing_key_calculate_code (key, analysis->periods[i],
+                                                         counter, &local_error);
+          g_assert_no_error (local_error);
+
+          signatures[i * N_COUNTERS + counter] = code & SIGNATURE_MASK;
+        }
+    }
+}
+
+/* Work item: verify every code value in one period for one key, and check the
+ * valid ones against the calculated signatures. */
+static void
+verify_period_cb (Analysis *analysis,
+                  guint     item)
+{
+  guint key_index = item / N_PERIOD_VALUES;
+  guint period_value = item % N_PERIOD_VALUES;
+  EpcSigningKey *key = analysis->keys->pdata[key_index];
+  const guint16 *signatures = get_key_signatures (analysis, key_index);
+  gint period_index = analysis->period_indices[period_value];
+  guint n_verified = 0, n_mismatches = 0;
+
+  for (EpcCode offset = 0; offset < N_CODE_VALUES_PER_PERIOD; offset++)
+    {
+      EpcCode code = (period_value << (COUNTER_WIDTH_BITS + SIGN_WIDTH_BITS)) | offset;
+      EpcPeriod period;
+      guint counter;
+
+      if (!epc_signing_key_verify_code (key, code, &period, &counter, NULL))
+        continue;
+
+      n_verified++;
+
+      if (period_index < 0 || (guint) period != period_value ||
+          signatures[period_index * N_COUNTERS + counter] != (code & SIGNATURE_MASK))
+        n_mismatches++;
+    }
+
+  analysis->n_verified[item] = n_verified;
+  analysis->n_mismatches[item] = n_mismatches;
+}
+
+/* Work item: compare the signatures of one key with those of all later keys.
+ * Two keys collide on a (period, counter) if they give it the same signature,
+ * so the same code is valid for both; they nearly collide if the signatures
+ * differ in one bit. */
+static void
+compare_keys_cb (Analysis *analysis,
+                 guint     key_index)
+{
+  const guint16 *signatures = get_key_signatures (analysis, key_index);
+  guint64 n_collisions = 0, n_near_collisions = 0, max_pair_collisions = 0;
+
+  for (guint other_index = key_index + 1; other_index < analysis->keys->len; other_index++)
+    {
+      const guint16 *other_signatures = get_key_signatures (analysis, other_index);
+      guint64 n_pair_collisions = 0;
+
+      for (gsize i = 0; i < N_SIGNATURES_PER_KEY; i++)
+        {
+          guint distance = __builtin_popcount (signatures[i] ^ other_signatures[i]);
+
+          if (distance == 0)
+            n_pair_collisions++;
+          else if (distance == 1)
+            n_near_collisions++;
+        }
+
+      n_collisions += n_pair_collisions;
+      max_pair_collisions = MAX (max_pair_collisions, n_pair_collisions);
+    }
+
+  analysis->n_collisions[key_index] = n_collisions;
+  analysis->n_near_collisions[key_index] = n_near_collisions;
+  analysis->max_pair_collisions[key_index] = max_pair_collisions;
+}
+
+/* Work item: simulate one brute force attack on a fresh device. The attacker
+ * knows the code format, so only guesses codes with valid periods, and stops
+ * at the first valid code. Checking a guess against the calculated signatures
+ * is equivalent to verifying it. */
+static void
+simulate_attack_cb (Analysis *analysis,
+                    guint     trial)
+{
+  guint key_index = trial % analysis->keys->len;
+  const guint16 *signatures = get_key_signatures (analysis, key_index);
+  g_autoptr(GRand) rng = g_rand_new_with_seed (analysis->seed + trial);
+
+  analysis->trial_attempts[trial] = 0;
+
+  for (guint64 attempt = 1; attempt <= MAXIMUM_SIMULATED_ATTEMPTS; attempt++)
+    {
+      guint period_index = g_rand_int_range (rng, 0, EPC_N_PERIODS);
+      guint counter = g_rand_int_range (rng, 0, N_COUNTERS);
+      guint signature = g_rand_int_range (rng, 0, N_SIGNATURES);
+
+      if (signatures[period_index * N_COUNTERS + counter] == signature)
+        {
+          analysis->trial_attempts[trial] = attempt;
+          analysis->trial_periods[trial] = analysis->periods[period_index];
+          return;
+        }
+    }
+}
+
+/* How long the rate limiting makes @n_attempts attempts take: each window
+ * allows @analysis->n_attempts, the first starting immediately. */
+static guint64
+attempts_to_secs (const Analysis *analysis,
+                  guint64         n_attempts)
+{
+  if (n_attempts == 0)
+    return 0;
+
+  return ((n_attempts - 1) / analysis->n_attempts) * analysis->window_secs;
+}
+
+static guint64
+secs_to_attempts (const Analysis *analysis,
+                  guint64         secs)
+{
+  return (secs / analysis->window_secs + 1) * analysis->n_attempts;
+}
+
+static guint64
+get_period_duration_secs (EpcPeriod period)
+{
+  for (gsize i = 0; i < G_N_ELEMENTS (period_durations); i++)
+    {
+      if (period_durations[i].period == period)
+        return period_durations[i].duration_secs;
+    }
+
+  g_return_val_if_reached (0);
+}
+
+static gint
+compare_guint64 (gconstpointer a,
+                 gconstpointer b)
+{
+  guint64 value_a = *((const guint64 *) a);
+  guint64 value_b = *((const guint64 *) b);
+
+  return (value_a > value_b) - (value_a < value_b);
+}
+
+static void
+report_code_space (const Analysis *analysis,
+                   gboolean        exhaustive)
+{
+  guint n_keys = analysis->keys->len;
+
+  g_print ("Code space\n");
+  g_print ("  Code values:          %u (2^%u)\n",
+           (guint) N_CODE_VALUES, (guint) CODE_VALUE_WIDTH_BITS);
+  g_print ("  Valid periods:        %u of %u\n",
+           (guint) EPC_N_PERIODS, (guint) N_PERIOD_VALUES);
+  g_print ("  Valid codes per key:  %u (1 in %.1f code values)\n",
+           (guint) N_SIGNATURES_PER_KEY,
+           (gdouble) N_CODE_VALUES / N_SIGNATURES_PER_KEY);
+  g_print ("\n");
+
+  g_print ("Valid codes per period (of %u code values each; %s)\n",
+           (guint) N_CODE_VALUES_PER_PERIOD,
+           exhaustive ? "counted by verifying every code value" :
+                        "one per counter, by construction");
+
+  for (guint period_value = 0; period_value < N_PERIOD_VALUES; period_value++)
+    {
+      gint period_index = analysis->period_indices[period_value];
+      guint min_valid = G_MAXUINT, max_valid = 0;
+
+      for (guint key_index = 0; key_index < n_keys; key_index++)
+        {
+          guint n_valid;
+
+          if (exhaustive)
+            n_valid = analysis->n_verified[key_index * N_PERIOD_VALUES + period_value];
+          else
+            n_valid = (period_index >= 0) ? N_COUNTERS : 0;
+
+          min_valid = MIN (min_valid, n_valid);
+          max_valid = MAX (max_valid, n_valid);
+        }
+
+      /* Invalid periods are only worth listing if something verified. */
+      if (period_index < 0 && max_valid == 0)
+        continue;
+
+      const gchar *period_str = (period_index >= 0) ?
+                                epc_period_to_string (period_value) : "invalid";
+
+      if (min_valid == max_valid)
+        g_print ("  %-8s  %u (density 1 in %.0f)\n", period_str, min_valid,
+                 (min_valid > 0) ? (gdouble) N_CODE_VALUES_PER_PERIOD / min_valid : 0.0);
+      else
+        g_print ("  %-8s  %u–%u across keys\n", period_str, min_valid, max_valid);
+    }
+
+  g_print ("\n");
+}
+
+/* Check the signatures are uniformly distributed over their N_SIGNATURES
+ * possible values, using a chi-squared test, and look for biased bits. */
+static void
+report_signature_distribution (const Analysis *analysis)
+{
+  g_autofree guint64 *histogram = g_new0 (guint64, N_SIGNATURES);
+  guint64 bit_counts[SIGN_WIDTH_BITS] = { 0, };
+  guint64 n_samples = (guint64) analysis->keys->len * N_SIGNATURES_PER_KEY;
+
+  for (guint64 i = 0; i < n_samples; i++)
+    {
+      guint16 signature = analysis->signatures[i];
+
+      histogram[signature]++;
+      for (guint bit = 0; bit < SIGN_WIDTH_BITS; bit++)
+        bit_counts[bit] += (signature >> bit) & 1;
+    }
+
+  gdouble expected = (gdouble) n_samples / N_SIGNATURES;
+  gdouble chi_squared = 0.0;
+  guint64 min_count = G_MAXUINT64, max_count = 0;
+
+  for (guint i = 0; i < N_SIGNATURES; i++)
+    {
+      gdouble difference = (gdouble) histogram[i] - expected;
+
+      chi_squared += difference * difference / expected;
+      min_count = MIN (min_count, histogram[i]);
+      max_count = MAX (max_count, histogram[i]);
+    }
+
+  /* For this many degrees of freedom, chi-squared is close to normal. */
+  guint degrees_of_freedom = N_SIGNATURES - 1;
+  gdouble z = (chi_squared - degrees_of_freedom) / sqrt (2.0 * degrees_of_freedom);
+  gboolean is_uniform = (fabs (z) <= UNIFORMITY_Z_THRESHOLD);
+
+  guint biased_bit = 0;
+  gdouble max_bias = 0.0;
+
+  for (guint bit = 0; bit < SIGN_WIDTH_BITS; bit++)
+    {
+      gdouble bias = fabs ((gdouble) bit_counts[bit] / n_samples - 0.5);
+
+      if (bias > max_bias)
+        {
+          max_bias = bias;
+          biased_bit = bit;
+        }
+    }
+
+  g_print ("Signature distribution (%" G_GUINT64_FORMAT " signatures over %u values)\n",
+           n_samples, (guint) N_SIGNATURES);
+  g_print ("  Expected per value:   %.1f\n", expected);
+  g_print ("  Minimum / maximum:    %" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT "\n",
+           min_count, max_count);
+  g_print ("  Chi-squared:          %.1f with %u degrees of freedom (z = %.2f): %s\n",
+           chi_squared, degrees_of_freedom, z,
+           is_uniform ? "consistent with uniform" : "NOT UNIFORM");
+  g_print ("  Most biased bit:      bit %u set in %.3f%% of signatures\n",
+           biased_bit, 100.0 * bit_counts[biased_bit] / n_samples);
+  g_print ("\n");
+}
+
+static void
+report_collisions (const Analysis *analysis)
+{
+  guint n_keys = analysis->keys->len;
+
+  if (n_keys < 2)
+    {
+      g_print ("Collisions between keys: skipped, as only one key was analysed\n\n");
+      return;
+    }
+
+  guint64 n_pairs = (guint64) n_keys * (n_keys - 1) / 2;
+  guint64 n_comparisons = n_pairs * N_SIGNATURES_PER_KEY;
+  guint64 n_collisions = 0, n_near_collisions = 0, max_pair_collisions = 0;
+
+  for (guint i = 0; i < n_keys; i++)
+    {
+      n_collisions += analysis->n_collisions[i];
+      n_near_collisions += analysis->n_near_collisions[i];
+      max_pair_collisions = MAX (max_pair_collisions, analysis->max_pair_collisions[i]);
+    }
+
+  g_print ("Collisions between keys (%" G_GUINT64_FORMAT " pairs × %u codes)\n",
+           n_pairs, (guint) N_SIGNATURES_PER_KEY);
+  g_print ("  Same code valid:      %" G_GUINT64_FORMAT " (rate %.3g; expected %.3g)\n",
+           n_collisions, (gdouble) n_collisions / n_comparisons,
+           1.0 / N_SIGNATURES);
+  g_print ("  Signatures 1 bit apart: %" G_GUINT64_FORMAT " (rate %.3g; expected %.3g)\n",
+           n_near_collisions, (gdouble) n_near_collisions / n_comparisons,
+           (gdouble) SIGN_WIDTH_BITS / N_SIGNATURES);
+  g_print ("  Most for one pair:    %" G_GUINT64_FORMAT " (expected %.2f)\n",
+           max_pair_collisions, (gdouble) N_SIGNATURES_PER_KEY / N_SIGNATURES);
+  g_print ("\n");
+}
+
+static void
+report_brute_force (const Analysis *analysis)
+{
+  /* Probability of a single guess succeeding, for an attacker who only
+   * guesses codes with valid periods. */
+  gdouble p_guess = (gdouble) N_SIGNATURES_PER_KEY /
+                    ((gdouble) EPC_N_PERIODS * N_CODE_VALUES_PER_PERIOD);
+  gdouble expected_attempts = 1.0 / p_guess;
+
+  g_print ("Brute force (%u attempts per %u s, so %" G_GUINT64_FORMAT " per day)\n",
+           analysis->n_attempts, analysis->window_secs,
+           secs_to_attempts (analysis, SECONDS_PER_DAY - 1));
+  g_print ("  Chance per guess:     1 in %.0f\n", expected_attempts);
+  g_print ("  Expected time:        %.1f days\n",
+           (gdouble) attempts_to_secs (analysis, (guint64) expected_attempts) / SECONDS_PER_DAY);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (report_days); i++)
+    {
+      guint64 n_attempts = secs_to_attempts (analysis, report_days[i] * SECONDS_PER_DAY - 1);
+      gdouble p_success = -expm1 (n_attempts * log1p (-p_guess));
+
+      g_print ("  Success within %3u days: %6.2f%%\n",
+               report_days[i], 100.0 * p_success);
+    }
+
+  /* Simulation results. */
+  g_autoptr(GArray) attempts = g_array_sized_new (FALSE, FALSE, sizeof (guint64),
+                                                  analysis->n_trials);
+  guint n_failed = 0, n_outlasting = 0;
+  gdouble total_attempts = 0.0;
+
+  for (guint trial = 0; trial < analysis->n_trials; trial++)
+    {
+      guint64 n_attempts = analysis->trial_attempts[trial];
+
+      if (n_attempts == 0)
+        {
+          n_failed++;
+          continue;
+        }
+
+      g_array_append_val (attempts, n_attempts);
+      total_attempts += n_attempts;
+
+      /* Did the attacker gain more credit than the attack took? */
+      if (get_period_duration_secs (analysis->trial_periods[trial]) >
+          attempts_to_secs (analysis, n_attempts))
+        n_outlasting++;
+    }
+
+  g_print ("\n");
+  g_print ("Simulated brute force attacks (%u trials)\n", analysis->n_trials);
+
+  if (attempts->len > 0)
+    {
+      g_array_sort (attempts, compare_guint64);
+      guint64 median_attempts = g_array_index (attempts, guint64, attempts->len / 2);
+
+      g_print ("  Mean attempts:        %.0f\n", total_attempts / attempts->len);
+      g_print ("  Median time:          %.1f days\n",
+               (gdouble) attempts_to_secs (analysis, median_attempts) / SECONDS_PER_DAY);
+      g_print ("  Credit outlasts attack: %u (%.1f%%)\n",
+               n_outlasting, 100.0 * n_outlasting / attempts->len);
+    }
+
+  g_print ("  Failed:               %u (gave up after %u attempts)\n",
+           n_failed, (guint) MAXIMUM_SIMULATED_ATTEMPTS);
+}
+
+/* Add a random key from @rng to @keys. The key bytes don’t need to be
+ * unpredictable for this analysis, just reproducible from the seed. */
+static void
+add_random_key (GPtrArray *keys,
+                GRand     *rng)
+{
+  guint8 key_data[EPC_KEY_MINIMUM_LENGTH_BYTES];
+
+  for (gsize i = 0; i < G_N_ELEMENTS (key_data); i++)
+    key_data[i] = g_rand_int_range (rng, 0, G_MAXUINT8 + 1);
+
+  g_autoptr(GBytes) key = g_bytes_new (key_data, sizeof (key_data));
+  EpcSigningKey *signing_key = epc_signing_key_new (key, NULL);
+  g_assert (signing_key != NULL);
+
+  g_ptr_array_add (keys, signing_key);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) local_error = NULL;
+
+  /* Localisation */
+  setlocale (LC_ALL, "");
+  bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+  bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+  textdomain (GETTEXT_PACKAGE);
+
+  /* Handle command line parameters. */
+  gint n_random_keys = -1;
+  gint64 seed = -1;
+  gint n_trials = 1000;
+  gint n_attempts = EPG_RATE_LIMITING_N_ATTEMPTS;
+  gint window_secs = EPG_RATE_LIMITING_TIME_PERIOD_SECS;
+  gint n_jobs = 0;
+  gboolean exhaustive = FALSE;
+  g_auto(GStrv) args = NULL;
+
+  const GOptionEntry entries[] =
+    {
+      { "random-keys", 'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_random_keys,
+        N_("Number of random keys to analyse (default: 32 if no key files are given)"), N_("N") },
+      { "seed", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_INT64, &seed,
+        N_("Seed for the random keys and simulation (default: random)"), N_("SEED") },
+      { "trials", 't', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_trials,
+        N_("Number of brute force attacks to simulate (default: 1000)"), N_("N") },
+      { "attempts", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_attempts,
+        N_("Attempts allowed per rate limiting window (default: 10)"), N_("N") },
+      { "window", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &window_secs,
+        N_("Length of the rate limiting window (default: 1800)"), N_("SECONDS") },
+      { "exhaustive", 'e', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &exhaustive,
+        N_("Also verify every code value for each key"), NULL },
+      { "jobs", 'j', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_jobs,
+        N_("Number of threads to use (default: one per processor)"), N_("N") },
+      { G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY,
+        &args, NULL, NULL },
+      { NULL, },
+    };
+
+  g_autoptr(GOptionContext) context = NULL;
+  context = g_option_context_new (_("[KEY-FILENAME…]"));
+  g_option_context_set_summary (context,
+                                _("Analyse the pay as you go code space for "
+                                  "the given keys, or for random keys"));
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 local_error->message);
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  guint n_key_files = (args != NULL) ? g_strv_length (args) : 0;
+
+  if (n_random_keys < 0)
+    n_random_keys = (n_key_files == 0) ? 32 : 0;
+
+  if ((n_key_files == 0 && n_random_keys == 0) ||
+      n_trials < 0 || n_attempts < 1 || window_secs < 1 || n_jobs < 0 ||
+      seed > G_MAXUINT32)
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 _("At least one key is required, and counts "
+                                   "must be positive"));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (seed < 0)
+    seed = g_random_int ();
+  if (n_jobs == 0)
+    n_jobs = g_get_num_processors ();
+
+  /* Load the keys. */
+  g_auto(Analysis) analysis = { 0, };
+  analysis.keys = g_ptr_array_new_with_free_func ((GDestroyNotify) epc_signing_key_unref);
+  analysis.seed = seed;
+  analysis.n_trials = n_trials;
+  analysis.n_attempts = n_attempts;
+  analysis.window_secs = window_secs;
+
+  for (guint i = 0; i < n_key_files; i++)
+    {
+      g_autoptr(GFile) key_file = g_file_new_for_commandline_arg (args[i]);
+      g_autoptr(GBytes) key = g_file_load_bytes (key_file, NULL, NULL, &local_error);
+      EpcSigningKey *signing_key = NULL;
+
+      if (key != NULL)
+        signing_key = epc_signing_key_new (key, &local_error);
+
+      if (signing_key == NULL)
+        {
+          g_printerr ("%s: %s: %s\n", argv[0], args[i], local_error->message);
+
+          return EXIT_FAILED;
+        }
+
+      g_ptr_array_add (analysis.keys, signing_key);
+    }
+
+  g_autoptr(GRand) rng = g_rand_new_with_seed (seed);
+  for (gint i = 0; i < n_random_keys; i++)
+    add_random_key (analysis.keys, rng);
+
+  guint n_keys = analysis.keys->len;
+  gsize n_periods = 0;
+
+  for (guint period_value = 0; period_value < N_PERIOD_VALUES; period_value++)
+    {
+      if (epc_period_validate (period_value, NULL))
+        {
+          analysis.period_indices[period_value] = n_periods;
+          analysis.periods[n_periods++] = period_value;
+        }
+      else
+        {
+          analysis.period_indices[period_value] = -1;
+        }
+    }
+
+  g_assert (n_periods == EPC_N_PERIODS);
+
+  /* Do the analysis. */
+  gint64 start_time = g_get_monotonic_time ();
+
+  analysis.signatures = g_new (guint16, (gsize) n_keys * N_SIGNATURES_PER_KEY);
+  run_parallel (&analysis, n_jobs, n_keys, calculate_signatures_cb);
+
+  if (exhaustive)
+    {
+      analysis.n_verified = g_new0 (guint, n_keys * N_PERIOD_VALUES);
+      analysis.n_mismatches = g_new0 (guint, n_keys * N_PERIOD_VALUES);
+      run_parallel (&analysis, n_jobs, n_keys * N_PERIOD_VALUES, verify_period_cb);
+    }
+
+  analysis.n_collisions = g_new0 (guint64, n_keys);
+  analysis.n_near_collisions = g_new0 (guint64, n_keys);
+  analysis.max_pair_collisions = g_new0 (guint64, n_keys);
+  run_parallel (&analysis, n_jobs, n_keys, compare_keys_cb);
+
+  analysis.trial_attempts = g_new0 (guint64, n_trials);
+  analysis.trial_periods = g_new0 (EpcPeriod, n_trials);
+  run_parallel (&analysis, n_jobs, n_trials, simulate_attack_cb);
+
+  gint64 duration = g_get_monotonic_time () - start_time;
+
+  /* Report. */
+  g_print ("Analysed %u keys (%u from files, %d random with seed %" G_GINT64_FORMAT ") "
+           "using %d threads in %.2f s\n\n",
+           n_keys, n_key_files, n_random_keys, seed, n_jobs,
+           (gdouble) duration / G_USEC_PER_SEC);
+
+  report_code_space (&analysis, exhaustive);
+  report_signature_distribution (&analysis);
+  report_collisions (&analysis);
+  report_brute_force (&analysis);
+
+  if (exhaustive)
+    {
+      guint64 n_mismatches = 0;
+
+      for (guint i = 0; i < n_keys * N_PERIOD_VALUES; i++)
+        n_mismatches += analysis.n_mismatches[i];
+
+      if (n_mismatches > 0)
+        {
+          g_printerr ("%s: %" G_GUINT64_FORMAT " verified codes disagree with "
+                      "the calculated signatures\n", argv[0], n_mismatches);
+
+          return EXIT_FAILED;
+        }
+    }
+
+  return EXIT_OK;
+}
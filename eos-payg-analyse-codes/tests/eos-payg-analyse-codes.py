@@ -0,0 +1,177 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+#
+# Copyright © 2026 Endless OS Foundation LLC
+#
+# This Source Code Form is subject to the terms of the Mozilla Public License,
+# v. 2.0. If a copy of the MPL was not distributed with this file, You can
+# obtain one at https://mozilla.org/MPL/2.0/.
+#
+# Alternatively, the contents of this file may be used under the terms of the
+# GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+# which case the provisions of the LGPL are applicable instead of those above.
+# If you wish to allow use of your version of this file only under the terms
+# of the LGPL, and not to allow others to use your version of this file under
+# the terms of the MPL, indicate your decision by deleting the provisions
+# above and replace them with the notice and other provisions required by the
+# LGPL. If you do not delete the provisions above, a recipient may use your
+# version of this file under the terms of either the MPL or the LGPL.
+
+
+"""Integration tests for the eos-payg-analyse-codes utility."""
+
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+import taptestrunner
+
+
+class TestEosPaygAnalyseCodes(unittest.TestCase):
+    """Integration test for running eos-payg-analyse-codes.
+
+    This can be run when installed or uninstalled. When uninstalled, it
+    requires G_TEST_BUILDDIR and G_TEST_SRCDIR to be set.
+
+    --exhaustive is not tested, as it takes too long on slow machines.
+    """
+
+    def setUp(self):
+        self.timeout_seconds = 30  # seconds per test
+        self.tmpdir = tempfile.mkdtemp()
+        os.chdir(self.tmpdir)
+        print('tmpdir:', self.tmpdir)
+        if 'G_TEST_BUILDDIR' in os.environ:
+            self.__eos_payg_analyse_codes = \
+                os.path.join(os.environ['G_TEST_BUILDDIR'], '..',
+                             'eos-payg-analyse-codes-1')
+        else:
+            self.__eos_payg_analyse_codes = \
+                os.path.join('/', 'usr', 'bin', 'eos-payg-analyse-codes-1')
+        print('eos_payg_analyse_codes:', self.__eos_payg_analyse_codes)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def createKey(self, name, contents):
+        with open(name, 'w') as key_file:
+            key_file.write(contents)
+        return name
+
+    def runAnalyse(self, *args):
+        argv = [self.__eos_payg_analyse_codes]
+        argv.extend(args)
+        print('Running:', argv)
+
+        env = os.environ.copy()
+        env['LC_ALL'] = 'C.UTF-8'
+        print('Environment:', env)
+
+        info = subprocess.run(argv, timeout=self.timeout_seconds,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=env)
+        print('Output:', info.stdout.decode('utf-8'))
+        return info
+
+    def test_random_keys(self):
+        """Test analysing random keys gives the expected report."""
+        info = self.runAnalyse('--random-keys', '8', '--seed', '1',
+                               '--trials', '200', '--jobs', '2')
+        info.check_returncode()
+        out = info.stdout.decode('utf-8')
+
+        self.assertIn('Analysed 8 keys (0 from files, 8 random with seed 1) '
+                      'using 2 threads', out)
+        self.assertIn('Code values:          67108864 (2^26)\n', out)
+        self.assertIn('Valid periods:        27 of 32\n', out)
+        self.assertIn('Valid codes per key:  6912 ', out)
+        self.assertIn('  5s        256 (density 1 in 8192)\n', out)
+        self.assertIn('  infinite  256 (density 1 in 8192)\n', out)
+        self.assertNotIn('invalid', out)
+
+        # 8 keys of random data should have uniform signatures.
+        self.assertIn('Signature distribution (55296 signatures over 8192 '
+                      'values)\n', out)
+        self.assertIn(': consistent with uniform\n', out)
+
+        self.assertIn('Collisions between keys (28 pairs × 6912 codes)\n', out)
+
+        # These follow from the default rate limiting, not from the keys.
+        self.assertIn('Brute force (10 attempts per 1800 s, so 480 per day)\n',
+                      out)
+        self.assertIn('Chance per guess:     1 in 8192\n', out)
+        self.assertIn('Expected time:        17.1 days\n', out)
+        self.assertIn('Success within   7 days:  33.65%\n', out)
+        self.assertIn('Simulated brute force attacks (200 trials)\n', out)
+
+    def test_reproducible(self):
+        """Test that the same seed gives the same report, apart from the
+        time taken."""
+        def analyse():
+            info = self.runAnalyse('--random-keys', '4', '--seed', '1234',
+                                   '--trials', '100', '--jobs', '3')
+            info.check_returncode()
+            return re.sub(r'in [0-9.]+ s\n', '', info.stdout.decode('utf-8'))
+
+        self.assertEqual(analyse(), analyse())
+
+    def test_rate_limiting(self):
+        """Test changing the simulated rate limiting."""
+        info = self.runAnalyse('--random-keys', '2', '--seed', '1',
+                               '--trials', '10',
+                               '--attempts', '5', '--window', '3600')
+        info.check_returncode()
+        out = info.stdout.decode('utf-8')
+        self.assertIn('Brute force (5 attempts per 3600 s, so 120 per day)\n',
+                      out)
+
+    def test_key_files(self):
+        """Test analysing keys from files, without random keys."""
+        key1 = self.createKey('key1', 'this is a key with at least 64 ' +
+                              'bytes of content otherwise we get an error')
+        key2 = self.createKey('key2', 'this is another key with at least ' +
+                              '64 bytes of content otherwise we get an error')
+        info = self.runAnalyse('--trials', '10', key1, key2)
+        info.check_returncode()
+        out = info.stdout.decode('utf-8')
+        self.assertIn('Analysed 2 keys (2 from files, 0 random', out)
+        self.assertIn('Collisions between keys (1 pairs × 6912 codes)\n', out)
+
+    def test_single_key(self):
+        """Test that collisions are skipped with only one key."""
+        info = self.runAnalyse('--random-keys', '1', '--trials', '10')
+        info.check_returncode()
+        out = info.stdout.decode('utf-8')
+        self.assertIn('Collisions between keys: skipped', out)
+
+    def test_short_key(self):
+        """Test that a short key file is rejected."""
+        key = self.createKey('key', 'too short')
+        info = self.runAnalyse(key)
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+
+    def test_missing_key(self):
+        """Test that a missing key file is rejected."""
+        info = self.runAnalyse('does-not-exist')
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+
+    def test_no_keys(self):
+        """Test that there must be at least one key."""
+        info = self.runAnalyse('--random-keys', '0')
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+    def test_invalid_option(self):
+        """Test that invalid options are rejected."""
+        info = self.runAnalyse('--trials', '-1')
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+        info = self.runAnalyse('--not-an-option')
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=taptestrunner.TAPTestRunner())
@@ -25,6 +25,7 @@ import shutil
 import subprocess
 import tempfile
 import unittest
+import zipfile
 
 import taptestrunner
 
@@ -160,19 +161,107 @@ class TestEosPaygCsv(unittest.TestCase):
                 self.assertTrue(cells[i][j].startswith("'"))
                 self.assertFalse(cells[i][j].endswith("'"))
 
-    def test_csv_valid(self):
-        """Test proper operation of the script for a valid input file with two
-        unique device_ids and multiple keys for a single device_id."""
+    def runCsvWithGenerate(self, *args):
         builddir = os.environ['G_TEST_BUILDDIR']
-        info = self.runCsv('--eos-payg-generate',
+        return self.runCsv('--eos-payg-generate',
                            os.path.join(builddir, '..', '..', 'eos-payg-generate',
                                         'eos-payg-generate-1'),
-                           os.path.join(self.__datadir,
-                                        'valid-2-keys-dupes.csv'))
+                           *args)
+
+    def assert_files_equal(self, dir1, dir2):
+        self.assertEqual(sorted(os.listdir(dir1)), sorted(os.listdir(dir2)))
+        for filename in os.listdir(dir1):
+            with open(os.path.join(dir1, filename), 'r') as f1, \
+                 open(os.path.join(dir2, filename), 'r') as f2:
+                self.assertEqual(f1.read(), f2.read())
+
+    def test_csv_valid(self):
+        """Test proper operation of the script for a valid input file with two
+        unique device_ids and multiple keys for a single device_id."""
+        info = self.runCsvWithGenerate(os.path.join(self.__datadir,
+                                                    'valid-2-keys-dupes.csv'))
         info.check_returncode()
 
         self.assert_csv_valid('3F0A1564.csv')
         self.assert_csv_valid('8AF5DA70.csv')
 
+        # no key files should be left lying around
+        self.assertEqual(sorted(os.listdir('.')),
+                         ['3F0A1564.csv', '8AF5DA70.csv'])
+
+    def test_csv_jobs(self):
+        """Test that the output doesn’t depend on the number of jobs."""
+        input_file = os.path.join(self.__datadir, 'valid-2-keys-dupes.csv')
+        os.mkdir('serial')
+        os.mkdir('parallel')
+        self.runCsvWithGenerate('--jobs', '1', '--output-dir', 'serial',
+                                input_file).check_returncode()
+        self.runCsvWithGenerate('--jobs', '3', '--output-dir', 'parallel',
+                                input_file).check_returncode()
+
+        self.assert_csv_valid(os.path.join('serial', '3F0A1564.csv'))
+        self.assert_files_equal('serial', 'parallel')
+
+    def test_csv_archive(self):
+        """Test writing all the devices’ CSV files into one archive."""
+        info = self.runCsvWithGenerate('--archive', 'codes.zip',
+                                       os.path.join(self.__datadir,
+                                                    'valid-2-keys-dupes.csv'))
+        info.check_returncode()
+        self.assertEqual(os.listdir('.'), ['codes.zip'])
+
+        with zipfile.ZipFile('codes.zip') as archive:
+            self.assertEqual(sorted(archive.namelist()),
+                             ['3F0A1564.csv', '8AF5DA70.csv'])
+            archive.extractall('extracted')
+
+        self.assert_csv_valid(os.path.join('extracted', '3F0A1564.csv'))
+        self.assert_csv_valid(os.path.join('extracted', '8AF5DA70.csv'))
+
+    def skipUnlessLibraryAvailable(self):
+        try:
+            import gi
+            gi.require_version('EosPaygCodes', '1.0')
+            from gi.repository import EosPaygCodes  # noqa: F401
+        except (ImportError, ValueError) as e:
+            self.skipTest('EosPaygCodes bindings not available: {}'.format(e))
+
+    def test_csv_library(self):
+        """Test that generating codes in-process with libeos-payg-codes gives
+        the same output as using eos-payg-generate."""
+        self.skipUnlessLibraryAvailable()
+
+        input_file = os.path.join(self.__datadir, 'valid-2-keys-dupes.csv')
+        os.mkdir('library')
+        os.mkdir('program')
+        self.runCsv('--output-dir', 'library', input_file).check_returncode()
+        self.runCsvWithGenerate('--output-dir', 'program',
+                                input_file).check_returncode()
+
+        self.assert_files_equal('library', 'program')
+    def test_key_store(self):
+        """Test converting the account CSV to a key store, and generating codes
+        for a device from it."""
+        self.skipUnlessLibraryAvailable()
+
+        input_file = os.path.join(self.__datadir, 'valid-2-keys-dupes.csv')
+        os.mkdir('from-csv')
+        os.mkdir('from-key-store')
+        self.runCsv('--write-key-store', 'keys', input_file).check_returncode()
+        self.runCsvWithGenerate('--output-dir', 'from-csv',
+                                input_file).check_returncode()
+        self.runCsvWithGenerate('--output-dir', 'from-key-store',
+                                '--key-store', 'keys',
+                                '--device', '3F0A1564',
+                                '--device', '8AF5DA70').check_returncode()
+
+        self.assert_files_equal('from-csv', 'from-key-store')
+
+        info = self.runCsv('--key-store', 'keys', '--device', '00000000')
+        out = info.stdout.decode('utf-8').strip()
+        self.assertIn('No key for device ‘00000000’ in key store.', out)
+        self.assertEqual(info.returncode, 1)
+
+
 if __name__ == '__main__':
     unittest.main(testRunner=taptestrunner.TAPTestRunner())
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
 #include <locale.h>
 
 
@@ -37,67 +38,45 @@ typedef enum
   EXIT_FAILED = 2,
 } ExitStatus;
 
-/* Main function stuff. */
+/* Main function stuff. The string forms of the periods come from
+ * epc_period_to_string(); this table only adds the descriptions. */
 static const struct
   {
     EpcPeriod period;
-    const gchar *period_str;
     const gchar *description;
   }
 periods[] =
   {
-    { EPC_PERIOD_5_SECONDS, "5s", N_("5 seconds") },
-    { EPC_PERIOD_1_MINUTE, "1m", N_("1 minute") },
-    { EPC_PERIOD_5_MINUTES, "5m", N_("5 minutes") },
-    { EPC_PERIOD_30_MINUTES, "30m", N_("30 minutes") },
-    { EPC_PERIOD_1_HOUR, "1h", N_("1 hour") },
-    { EPC_PERIOD_8_HOURS, "8h", N_("8 hours") },
-    { EPC_PERIOD_1_DAY, "1d", N_("1 day") },
-    { EPC_PERIOD_2_DAYS, "2d", N_("2 days") },
-    { EPC_PERIOD_3_DAYS, "3d", N_("3 days") },
-    { EPC_PERIOD_4_DAYS, "4d", N_("4 days") },
-    { EPC_PERIOD_5_DAYS, "5d", N_("5 days") },
-    { EPC_PERIOD_6_DAYS, "6d", N_("6 days") },
-    { EPC_PERIOD_7_DAYS, "7d", N_("7 days") },
-    { EPC_PERIOD_8_DAYS, "8d", N_("8 days") },
-    { EPC_PERIOD_9_DAYS, "9d", N_("9 days") },
-    { EPC_PERIOD_10_DAYS, "10d", N_("10 days") },
-    { EPC_PERIOD_11_DAYS, "11d", N_("11 days") },
-    { EPC_PERIOD_12_DAYS, "12d", N_("12 days") },
-    { EPC_PERIOD_13_DAYS, "13d", N_("13 days") },
-    { EPC_PERIOD_14_DAYS, "14d", N_("14 days") },
-    { EPC_PERIOD_30_DAYS, "30d", N_("30 days") },
-    { EPC_PERIOD_31_DAYS, "31d", N_("31 days") },
-    { EPC_PERIOD_60_DAYS, "60d", N_("60 days") },
-    { EPC_PERIOD_90_DAYS, "90d", N_("90 days") },
-    { EPC_PERIOD_120_DAYS, "120d", N_("120 days") },
-    { EPC_PERIOD_365_DAYS, "365d", N_("365 days") },
-    { EPC_PERIOD_INFINITE, "infinite", N_("Infinite") },
+    { EPC_PERIOD_5_SECONDS, N_("5 seconds") },
+    { EPC_PERIOD_1_MINUTE, N_("1 minute") },
+    { EPC_PERIOD_5_MINUTES, N_("5 minutes") },
+    { EPC_PERIOD_30_MINUTES, N_("30 minutes") },
+    { EPC_PERIOD_1_HOUR, N_("1 hour") },
+    { EPC_PERIOD_8_HOURS, N_("8 hours") },
+    { EPC_PERIOD_1_DAY, N_("1 day") },
+    { EPC_PERIOD_2_DAYS, N_("2 days") },
+    { EPC_PERIOD_3_DAYS, N_("3 days") },
+    { EPC_PERIOD_4_DAYS, N_("4 days") },
+    { EPC_PERIOD_5_DAYS, N_("5 days") },
+    { EPC_PERIOD_6_DAYS, N_("6 days") },
+    { EPC_PERIOD_7_DAYS, N_("7 days") },
+    { EPC_PERIOD_8_DAYS, N_("8 days") },
+    { EPC_PERIOD_9_DAYS, N_("9 days") },
+    { EPC_PERIOD_10_DAYS, N_("10 days") },
+    { EPC_PERIOD_11_DAYS, N_("11 days") },
+    { EPC_PERIOD_12_DAYS, N_("12 days") },
+    { EPC_PERIOD_13_DAYS, N_("13 days") },
+    { EPC_PERIOD_14_DAYS, N_("14 days") },
+    { EPC_PERIOD_30_DAYS, N_("30 days") },
+    { EPC_PERIOD_31_DAYS, N_("31 days") },
+    { EPC_PERIOD_60_DAYS, N_("60 days") },
+    { EPC_PERIOD_90_DAYS, N_("90 days") },
+    { EPC_PERIOD_120_DAYS, N_("120 days") },
+    { EPC_PERIOD_365_DAYS, N_("365 days") },
+    { EPC_PERIOD_INFINITE, N_("Infinite") },
   };
 G_STATIC_ASSERT (G_N_ELEMENTS (periods) == EPC_N_PERIODS);
 
-/* Convert a string-form period into an #EpcPeriod. */
-static gboolean
-parse_period (const gchar  *period_str,
-              EpcPeriod    *out_period,
-              GError      **error)
-{
-  g_return_val_if_fail (out_period != NULL, FALSE);
-
-  for (gsize i = 0; i < G_N_ELEMENTS (periods); i++)
-    {
-      if (g_str_equal (period_str, periods[i].period_str))
-        {
-          *out_period = periods[i].period;
-          return TRUE;
-        }
-    }
-
-  g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD,
-               _("Invalid period ‘%s’."), period_str);
-  return FALSE;
-}
-
 int
 main (int   argc,
       char *argv[])
@@ -113,6 +92,8 @@ main (int   argc,
   /* Handle command line parameters. */
   gboolean quiet = FALSE;
   gboolean list_periods = FALSE;
+  g_autofree gchar *key_store_path = NULL;
+  g_autofree gchar *device_id = NULL;
   g_auto(GStrv) args = NULL;
 
   const GOptionEntry entries[] =
@@ -121,6 +102,10 @@ main (int   argc,
         N_("Only print error messages"), NULL },
       { "list-periods", 'l', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &list_periods,
         N_("List the available periods"), NULL },
+      { "key-store", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &key_store_path,
+        N_("Look up the key in a key store rather than a key file"), N_("PATH") },
+      { "device", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &device_id,
+        N_("Device ID to look up in the key store"), N_("ID") },
       { G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY,
         &args, NULL, NULL },
       { NULL, },
@@ -129,6 +114,9 @@ main (int   argc,
   g_autoptr(GOptionContext) context = NULL;
   context = g_option_context_new (_("KEY-FILENAME PERIOD [COUNTER]"));
   g_option_context_set_summary (context, _("Generate one or more pay as you go codes"));
+  g_option_context_set_description (context,
+                                    _("KEY-FILENAME is omitted when using "
+                                      "--key-store and --device."));
   g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
 
   if (!g_option_context_parse (context, &argc, &argv, &local_error))
@@ -151,24 +139,40 @@ main (int   argc,
         {
           if (!quiet)
             g_print (" • %s — %s\n",
-                     periods[i].period_str, _(periods[i].description));
+                     epc_period_to_string (periods[i].period), _(periods[i].description));
           else
-            g_print ("%s\n", periods[i].period_str);
+            g_print ("%s\n", epc_period_to_string (periods[i].period));
         }
 
       return EXIT_OK;
     }
 
-  if (args == NULL || args[0] == NULL || args[1] == NULL)
+  if ((key_store_path == NULL) != (device_id == NULL))
     {
       g_autofree gchar *message = NULL;
       message = g_strdup_printf (_("Option parsing failed: %s"),
-                                 _("A KEY-FILENAME and PERIOD are required"));
+                                 _("--key-store and --device must be used together"));
       g_printerr ("%s: %s\n", argv[0], message);
 
       return EXIT_INVALID_OPTIONS;
     }
-  if (args[2] != NULL && args[3] != NULL)
+
+  /* The key is either loaded from KEY-FILENAME, or from a key store. */
+  const guint n_key_args = (key_store_path == NULL) ? 1 : 0;
+  const guint n_args = (args != NULL) ? g_strv_length (args) : 0;
+
+  if (n_args < n_key_args + 1)
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 (n_key_args > 0) ?
+                                 _("A KEY-FILENAME and PERIOD are required") :
+                                 _("A PERIOD is required"));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+  if (n_args > n_key_args + 2)
     {
       g_autofree gchar *message = NULL;
       message = g_strdup_printf (_("Option parsing failed: %s"),
@@ -178,15 +182,14 @@ main (int   argc,
       return EXIT_INVALID_OPTIONS;
     }
 
-  const gchar *key_filename = args[0];
-  const gchar *period_str = args[1];
-  const gchar *counter_str = args[2];
-  g_autoptr(GFile) key_file = g_file_new_for_commandline_arg (key_filename);
+  const gchar *key_filename = (n_key_args > 0) ? args[0] : NULL;
+  const gchar *period_str = args[n_key_args];
+  const gchar *counter_str = args[n_key_args + 1];
 
   /* Parse the period. */
   EpcPeriod period;
 
-  if (!parse_period (period_str, &period, &local_error))
+  if (!epc_period_from_string (period_str, &period, &local_error))
     {
       g_printerr ("%s: %s\n", argv[0], local_error->message);
 
@@ -194,20 +197,34 @@ main (int   argc,
     }
 
   /* Load the key. It should be local, so doing it synchronously is OK. */
-  g_autofree gchar *key_data = NULL;  /* should be guint8 were it not for strict aliasing */
-  gsize key_len = 0;
+  g_autoptr(GBytes) key_bytes = NULL;
+
+  if (key_store_path != NULL)
+    {
+      g_autoptr(EpcKeyStore) key_store = NULL;
+
+      key_store = epc_key_store_new_for_path (key_store_path, &local_error);
+      if (key_store != NULL)
+        key_bytes = epc_key_store_lookup (key_store, device_id, &local_error);
+    }
+  else
+    {
+      g_autoptr(GFile) key_file = g_file_new_for_commandline_arg (key_filename);
+      g_autofree gchar *key_data = NULL;  /* should be guint8 were it not for strict aliasing */
+      gsize key_len = 0;
+
+      if (g_file_load_contents (key_file, NULL, &key_data, &key_len,
+                                NULL, &local_error))
+        key_bytes = g_bytes_new_take (g_steal_pointer (&key_data), key_len);
+    }
 
-  if (!g_file_load_contents (key_file, NULL, &key_data, &key_len,
-                             NULL, &local_error))
+  if (key_bytes == NULL)
     {
       g_printerr ("%s: %s\n", argv[0], local_error->message);
 
       return EXIT_INVALID_OPTIONS;
     }
 
-  g_autoptr(GBytes) key_bytes = g_bytes_new_take (g_steal_pointer (&key_data),
-                                                  key_len);
-
   /* Work out how many codes we’re generating. */
   EpcCounter min_counter, max_counter;
   guint64 parsed_counter;
@@ -231,22 +248,23 @@ main (int   argc,
     }
 
   /* Generate codes [min_counter, max_counter]. */
-  for (guint64 counter = min_counter; counter <= max_counter; counter++)
+  g_autoptr(GArray) codes = epc_calculate_codes (period, min_counter,
+                                                 max_counter, key_bytes,
+                                                 &local_error);
+
+  if (local_error != NULL)
     {
-      /* Generate the code. */
-      EpcCode code = epc_calculate_code (period, counter, key_bytes, &local_error);
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
 
-      if (local_error != NULL)
-        {
-          g_printerr ("%s: %s\n", argv[0], local_error->message);
+      return EXIT_FAILED;
+    }
 
-          return EXIT_FAILED;
-        }
+  /* Format and output. */
+  g_auto(GStrv) code_strs = epc_format_codes ((const EpcCode *) codes->data,
+                                              codes->len);
 
-      /* Format and output. */
-      g_autofree gchar *code_str = epc_format_code (code);
-      g_print ("%s\n", code_str);
-    }
+  for (gsize i = 0; code_strs[i] != NULL; i++)
+    g_print ("%s\n", code_strs[i]);
 
   return EXIT_OK;
 }
@@ -21,6 +21,7 @@
 
 import os
 import shutil
+import struct
 import subprocess
 import tempfile
 import unittest
@@ -65,6 +66,23 @@ class TestEosPaygGenerate(unittest.TestCase):
             key_file.write(contents)
         return 'key'
 
+    def createKeyStore(self, keys):
+        """Write a key store containing @keys, a dict mapping device IDs to
+        keys. See libeos-payg-codes/key-store.c for the format."""
+        device_ids = sorted(keys.keys())
+        header = struct.pack('<8sIII12x', b'EPCKEYS', 1, len(device_ids), 0)
+        index = b''
+        data = b''
+        data_offset = len(header) + 32 * len(device_ids)
+        for device_id in device_ids:
+            key = keys[device_id].encode('utf-8')
+            index += struct.pack('<16sQI4x', device_id.encode('utf-8'),
+                                 data_offset + len(data), len(key))
+            data += key
+        with open('keys', 'wb') as key_store_file:
+            key_store_file.write(header + index + data)
+        return 'keys'
+
     def runGenerate(self, *args):
         argv = [self.__eos_payg_generate]
         argv.extend(args)
@@ -179,6 +197,47 @@ class TestEosPaygGenerate(unittest.TestCase):
         self.assertIn('Key is too short (5 bytes); minimum length 64 bytes.', out)
         self.assertEqual(info.returncode, 2)  # EXIT_FAILED
 
+    def test_generate_key_store(self):
+        """Test generating codes using a key from a key store."""
+        key_store = self.createKeyStore({
+            '3F0A1564': 'a different key with at least 64 bytes of content '
+                        'for a different device',
+            '8AF5DA70': 'this is a key with at least 64 bytes of content '
+                        'otherwise we get an error',
+        })
+        info = self.runGenerate('--key-store', key_store, '--device',
+                                '8AF5DA70', '1d', '5')
+        info.check_returncode()
+        out = info.stdout.decode('utf-8').strip()
+        self.assertEqual('08433942', out)
+
+    def test_generate_key_store_missing_device(self):
+        """Test error handling when passing --key-store without --device."""
+        info = self.runGenerate('--key-store', self.createKeyStore({}), '1d')
+        out = info.stdout.decode('utf-8').strip()
+        self.assertIn('--key-store and --device must be used together', out)
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+    def test_generate_key_store_unknown_device(self):
+        """Test error handling when the device isn’t in the key store."""
+        key_store = self.createKeyStore({
+            '8AF5DA70': 'this is a key with at least 64 bytes of content '
+                        'otherwise we get an error',
+        })
+        info = self.runGenerate('--key-store', key_store, '--device',
+                                '3F0A1564', '1d')
+        out = info.stdout.decode('utf-8').strip()
+        self.assertIn('No key for device ‘3F0A1564’ in key store.', out)
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+    def test_generate_key_store_invalid(self):
+        """Test error handling when the key store is not valid."""
+        info = self.runGenerate('--key-store', self.createKey(), '--device',
+                                '8AF5DA70', '1d')
+        out = info.stdout.decode('utf-8').strip()
+        self.assertIn('is not a key store', out)
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
 
 if __name__ == '__main__':
     unittest.main(testRunner=taptestrunner.TAPTestRunner())
@@ -0,0 +1,547 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ledger.h"
+
+
+/*
+ * The ledger records the next unused counter for each (device, period) pair
+ * which codes have been issued for. It is memory-mapped shared and updated in
+ * place, so allocating a counter is a couple of memory writes; durability
+ * comes from epi_ledger_sync(), which must be called before any code
+ * allocated since the previous sync is handed out.
+ *
+ * All integers are little-endian. The file is laid out as:
+ *
+ *  - Header (HEADER_SIZE bytes):
+ *     - 0: magic, LEDGER_MAGIC
+ *     - 8: guint32 format version, LEDGER_VERSION
+ *     - 12: guint32 record size, RECORD_SIZE
+ *     - 16: reserved, zero
+ *  - Records (RECORD_SIZE bytes each), in the order devices were first seen:
+ *     - 0: device ID, NUL-padded to DEVICE_ID_FIELD_SIZE bytes
+ *     - 16: N_PERIOD_SLOTS × guint16 next unused counter, indexed by
+ *       #EpcPeriod; COUNTER_EXHAUSTED once all counters have been issued
+ *
+ * The file is grown in chunks, and unused records are all zero. A record is
+ * in use if its device ID is non-empty, so there is no record count in the
+ * header which could get out of step with the records after a crash. Device
+ * IDs are 16-byte aligned and counters 2-byte aligned, so neither can be torn
+ * across pages when the kernel writes the mapping back.
+ *
+ * If the process crashes before a sync completes, some of the allocations
+ * since the last sync may be lost; none of those will have been handed out,
+ * so reusing their counters is safe. Allocations which were synced but not
+ * handed out are never reused, which wastes counters but is also safe.
+ */
+#define LEDGER_MAGIC "EPILEDG"  /* plus the implicit nul */
+#define LEDGER_VERSION 1
+#define HEADER_SIZE 32
+#define DEVICE_ID_FIELD_SIZE (EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH + 1)
+#define N_PERIOD_SLOTS (EPC_PERIOD_INFINITE + 1)
+#define RECORD_SIZE (DEVICE_ID_FIELD_SIZE + N_PERIOD_SLOTS * sizeof (guint16))
+/* Counters are only allocated up to %EPC_MAXCOUNTER for every device, whatever
+ * the scheme of its key, so they fit in every #EpcScheme. */
+#define COUNTER_EXHAUSTED (EPC_MAXCOUNTER + 1)
+
+/* Number of records to allocate when creating a new ledger. The file is
+ * doubled in size each time it fills up. */
+#define INITIAL_N_RECORDS 256
+
+G_STATIC_ASSERT (sizeof (LEDGER_MAGIC) == 8);
+G_STATIC_ASSERT (DEVICE_ID_FIELD_SIZE == 16);
+G_STATIC_ASSERT (RECORD_SIZE == 80);
+G_STATIC_ASSERT (RECORD_SIZE % DEVICE_ID_FIELD_SIZE == 0);
+
+G_DEFINE_QUARK (EpiLedgerError, epi_ledger_error)
+
+/**
+ * EpiLedger:
+ *
+ * An open ledger file. It is locked for exclusive use by this process until
+ * it is freed with epi_ledger_free().
+ *
+ * All counter allocation happens on the thread which owns the ledger, so
+ * allocations are atomic with respect to each other without further locking.
+ */
+struct _EpiLedger
+{
+  gchar *path;  /* (owned) */
+  int fd;  /* (owned) */
+  guint8 *data;  /* (owned) (nullable); mmap()ed from @fd */
+  gsize n_records;  /* number of records @data has room for */
+  gsize n_used_records;
+
+  /* Maps device ID to record index plus one. */
+  GHashTable *records;  /* (owned) (element-type utf8 guint) */
+
+  /* Byte range of @data written to since the last sync, or 0–0. */
+  gsize dirty_start;
+  gsize dirty_end;
+};
+
+static guint16
+read_uint16 (const guint8 *data)
+{
+  guint16 value;
+  memcpy (&value, data, sizeof (value));
+  return GUINT16_FROM_LE (value);
+}
+
+static guint32
+read_uint32 (const guint8 *data)
+{
+  guint32 value;
+  memcpy (&value, data, sizeof (value));
+  return GUINT32_FROM_LE (value);
+}
+
+static void
+write_uint16 (guint8  *data,
+              guint16  value)
+{
+  value = GUINT16_TO_LE (value);
+  memcpy (data, &value, sizeof (value));
+}
+
+static void
+write_uint32 (guint8  *data,
+              guint32  value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (data, &value, sizeof (value));
+}
+
+static gsize
+file_size_for_n_records (gsize n_records)
+{
+  return HEADER_SIZE + n_records * RECORD_SIZE;
+}
+
+static guint8 *
+get_record (EpiLedger *self,
+            gsize      index)
+{
+  g_assert (index < self->n_records);
+  return self->data + HEADER_SIZE + index * RECORD_SIZE;
+}
+
+static void
+mark_dirty (EpiLedger    *self,
+            const guint8 *start,
+            gsize         len)
+{
+  gsize offset = start - self->data;
+
+  if (self->dirty_start == self->dirty_end)
+    {
+      self->dirty_start = offset;
+      self->dirty_end = offset + len;
+    }
+  else
+    {
+      self->dirty_start = MIN (self->dirty_start, offset);
+      self->dirty_end = MAX (self->dirty_end, offset + len);
+    }
+}
+
+static void
+set_io_error (GError      **error,
+              int           errsv,
+              const gchar  *path,
+              const gchar  *message)
+{
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               _("Error accessing ledger ‘%s’: %s: %s"),
+               path, message, g_strerror (errsv));
+}
+
+/* Resize the file to hold @n_records, and (re-)map all of it. Newly added
+ * records are zero-filled by ftruncate(), which marks them as unused. */
+static gboolean
+resize_and_map (EpiLedger  *self,
+                gsize       n_records,
+                GError    **error)
+{
+  gsize old_size = file_size_for_n_records (self->n_records);
+  gsize new_size = file_size_for_n_records (n_records);
+  guint8 *new_data;
+
+  if (new_size != old_size &&
+      ftruncate (self->fd, new_size) < 0)
+    {
+      set_io_error (error, errno, self->path, _("Error resizing file"));
+      return FALSE;
+    }
+
+  /* Map the new size before unmapping the old one, so that if this fails the
+   * old mapping (and @n_records) are kept and the ledger stays usable. The
+   * file may be left larger, but the extra records are zero-filled, so are
+   * unused. */
+  new_data = mmap (NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   self->fd, 0);
+  if (new_data == MAP_FAILED)
+    {
+      set_io_error (error, errno, self->path, _("Error mapping file"));
+      return FALSE;
+    }
+
+  /* Unmapping doesn’t lose any writes: they are already in the page cache,
+   * and will be written back by the next msync() over the new mapping. */
+  if (self->data != NULL)
+    munmap (self->data, old_size);
+
+  self->data = new_data;
+  self->n_records = n_records;
+
+  return TRUE;
+}
+
+/* Sync the directory containing the ledger, so that a newly created ledger
+ * can’t disappear after a crash, taking the record of issued counters with
+ * it. */
+static gboolean
+sync_parent_directory (EpiLedger  *self,
+                       GError    **error)
+{
+  g_autofree gchar *dirname = g_path_get_dirname (self->path);
+  g_autofd int dir_fd = open (dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  if (dir_fd < 0 || fsync (dir_fd) < 0)
+    {
+      set_io_error (error, errno, self->path, _("Error syncing directory"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+load_records (EpiLedger  *self,
+              GError    **error)
+{
+  if (memcmp (self->data, LEDGER_MAGIC, sizeof (LEDGER_MAGIC)) != 0 ||
+      read_uint32 (self->data + 8) != LEDGER_VERSION ||
+      read_uint32 (self->data + 12) != RECORD_SIZE)
+    {
+      g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_INVALID,
+                   _("Ledger ‘%s’ is not a supported ledger file."),
+                   self->path);
+      return FALSE;
+    }
+
+  for (gsize i = 0; i < self->n_records; i++)
+    {
+      const guint8 *record = get_record (self, i);
+      const gchar *device_id = (const gchar *) record;
+
+      /* Unused record. */
+      if (device_id[0] == '\0')
+        continue;
+
+      if (record[DEVICE_ID_FIELD_SIZE - 1] != '\0' ||
+          g_hash_table_contains (self->records, device_id))
+        {
+          g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_INVALID,
+                       _("Ledger ‘%s’ has an invalid record at index %u."),
+                       self->path, (guint) i);
+          return FALSE;
+        }
+
+      for (gsize j = 0; j < N_PERIOD_SLOTS; j++)
+        {
+          if (read_uint16 (record + DEVICE_ID_FIELD_SIZE +
+                           j * sizeof (guint16)) > COUNTER_EXHAUSTED)
+            {
+              g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_INVALID,
+                           _("Ledger ‘%s’ has an invalid record at index %u."),
+                           self->path, (guint) i);
+              return FALSE;
+            }
+        }
+
+      g_hash_table_insert (self->records, g_strdup (device_id),
+                           GSIZE_TO_POINTER (i + 1));
+      self->n_used_records = i + 1;
+    }
+
+  return TRUE;
+}
+
+/**
+ * epi_ledger_open:
+ * @path: (type filename): path to the ledger file
+ * @error: return location for a #GError
+ *
+ * Open the ledger at @path, creating it if it does not exist. The file is
+ * locked, and %EPI_LEDGER_ERROR_BUSY is returned if another process has it
+ * open.
+ *
+ * Returns: (transfer full): the open ledger, or %NULL on error
+ */
+EpiLedger *
+epi_ledger_open (const gchar  *path,
+                 GError      **error)
+{
+  g_autoptr(EpiLedger) self = NULL;
+  struct stat stat_buf;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  self = g_new0 (EpiLedger, 1);
+  self->path = g_strdup (path);
+  self->records = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOCTTY, 0600);
+
+  if (self->fd < 0)
+    {
+      set_io_error (error, errno, path, _("Error opening file"));
+      return NULL;
+    }
+
+  if (flock (self->fd, LOCK_EX | LOCK_NB) < 0)
+    {
+      int errsv = errno;
+
+      if (errsv == EWOULDBLOCK)
+        g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_BUSY,
+                     _("Ledger ‘%s’ is in use by another process."), path);
+      else
+        set_io_error (error, errsv, path, _("Error locking file"));
+
+      return NULL;
+    }
+
+  if (fstat (self->fd, &stat_buf) < 0)
+    {
+      set_io_error (error, errno, path, _("Error querying file"));
+      return NULL;
+    }
+
+  if (stat_buf.st_size == 0)
+    {
+      /* New ledger. */
+      if (!resize_and_map (self, INITIAL_N_RECORDS, error))
+        return NULL;
+
+      memcpy (self->data, LEDGER_MAGIC, sizeof (LEDGER_MAGIC));
+      write_uint32 (self->data + 8, LEDGER_VERSION);
+      write_uint32 (self->data + 12, RECORD_SIZE);
+      mark_dirty (self, self->data, HEADER_SIZE);
+
+      if (!epi_ledger_sync (self, error) ||
+          !sync_parent_directory (self, error))
+        return NULL;
+    }
+  else if ((gsize) stat_buf.st_size < HEADER_SIZE ||
+           ((gsize) stat_buf.st_size - HEADER_SIZE) % RECORD_SIZE != 0)
+    {
+      g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_INVALID,
+                   _("Ledger ‘%s’ is not a supported ledger file."), path);
+      return NULL;
+    }
+  else
+    {
+      /* Map the file as it is, without resizing it. */
+      self->n_records = ((gsize) stat_buf.st_size - HEADER_SIZE) / RECORD_SIZE;
+      self->data = mmap (NULL, stat_buf.st_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, self->fd, 0);
+      if (self->data == MAP_FAILED)
+        {
+          self->data = NULL;
+          set_io_error (error, errno, path, _("Error mapping file"));
+          return NULL;
+        }
+
+      if (!load_records (self, error))
+        return NULL;
+    }
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * epi_ledger_free:
+ * @self: (transfer full): an open ledger
+ *
+ * Close and unlock the ledger. Allocations made since the last call to
+ * epi_ledger_sync() are not synced.
+ */
+void
+epi_ledger_free (EpiLedger *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->data != NULL)
+    munmap (self->data, file_size_for_n_records (self->n_records));
+  if (self->fd >= 0)
+    g_close (self->fd, NULL);
+  g_clear_pointer (&self->records, g_hash_table_unref);
+  g_free (self->path);
+  g_free (self);
+}
+
+/**
+ * epi_ledger_get_n_devices:
+ * @self: an open ledger
+ *
+ * Get the number of devices which have had counters allocated.
+ *
+ * Returns: number of devices in the ledger
+ */
+gsize
+epi_ledger_get_n_devices (EpiLedger *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return g_hash_table_size (self->records);
+}
+
+/**
+ * epi_ledger_allocate:
+ * @self: an open ledger
+ * @device_id: ID of the device to allocate a counter for; at most
+ *    %EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH bytes long
+ * @period: period to allocate a counter for
+ * @counter_out: (out): return location for the allocated counter
+ * @error: return location for a #GError
+ *
+ * Allocate the next unused counter for @device_id and @period, and mark it as
+ * used. Counters are allocated in increasing order from zero; once they have
+ * all been allocated, %EPI_LEDGER_ERROR_EXHAUSTED is returned.
+ *
+ * The allocation is only durable once epi_ledger_sync() has been called; codes
+ * using the counter must not be handed out before then.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+epi_ledger_allocate (EpiLedger    *self,
+                     const gchar  *device_id,
+                     EpcPeriod     period,
+                     EpcCounter   *counter_out,
+                     GError      **error)
+{
+  gsize index_plus_one;
+  guint8 *record;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (device_id != NULL, FALSE);
+  g_return_val_if_fail (*device_id != '\0', FALSE);
+  g_return_val_if_fail (strlen (device_id) <= EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH, FALSE);
+  g_return_val_if_fail ((guint) period < N_PERIOD_SLOTS, FALSE);
+  g_return_val_if_fail (counter_out != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  index_plus_one = GPOINTER_TO_SIZE (g_hash_table_lookup (self->records,
+                                                          device_id));
+
+  if (index_plus_one == 0)
+    {
+      if (self->n_used_records == self->n_records &&
+          !resize_and_map (self, self->n_records * 2, error))
+        return FALSE;
+
+      index_plus_one = ++self->n_used_records;
+      record = get_record (self, index_plus_one - 1);
+      memcpy (record, device_id, strlen (device_id));
+      mark_dirty (self, record, DEVICE_ID_FIELD_SIZE);
+
+      g_hash_table_insert (self->records, g_strdup (device_id),
+                           GSIZE_TO_POINTER (index_plus_one));
+    }
+  else
+    {
+      record = get_record (self, index_plus_one - 1);
+    }
+
+  guint8 *next_counter_field = record + DEVICE_ID_FIELD_SIZE +
+                               period * sizeof (guint16);
+  guint16 next_counter = read_uint16 (next_counter_field);
+
+  if (next_counter >= COUNTER_EXHAUSTED)
+    {
+      g_set_error (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_EXHAUSTED,
+                   _("All counters for device ‘%s’ and period ‘%s’ have been issued."),
+                   device_id, epc_period_to_string (period));
+      return FALSE;
+    }
+
+  write_uint16 (next_counter_field, next_counter + 1);
+  mark_dirty (self, next_counter_field, sizeof (guint16));
+
+  *counter_out = next_counter;
+
+  return TRUE;
+}
+
+/**
+ * epi_ledger_sync:
+ * @self: an open ledger
+ * @error: return location for a #GError
+ *
+ * Write all allocations made since the last sync to disk, and wait for them to
+ * be written. This is cheap if nothing has been allocated, so callers should
+ * batch allocations and sync once per batch.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+epi_ledger_sync (EpiLedger  *self,
+                 GError    **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (self->dirty_start == self->dirty_end)
+    return TRUE;
+
+  /* msync() needs a page-aligned start address. This also writes back any
+   * change to the file size from resize_and_map(). */
+  gsize page_size = sysconf (_SC_PAGESIZE);
+  gsize start = self->dirty_start - (self->dirty_start % page_size);
+
+  if (msync (self->data + start, self->dirty_end - start, MS_SYNC) < 0)
+    {
+      set_io_error (error, errno, self->path, _("Error syncing file"));
+      return FALSE;
+    }
+
+  self->dirty_start = 0;
+  self->dirty_end = 0;
+
+  return TRUE;
+}
@@ -0,0 +1,65 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <libeos-payg-codes/codes.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EpiLedgerError:
+ * @EPI_LEDGER_ERROR_INVALID: The ledger file was corrupt, or in an unsupported
+ *    format.
+ * @EPI_LEDGER_ERROR_BUSY: The ledger file is in use by another process.
+ * @EPI_LEDGER_ERROR_EXHAUSTED: All the counters for a device and period have
+ *    been issued.
+ *
+ * Errors which can be returned by #EpiLedger.
+ */
+typedef enum
+{
+  EPI_LEDGER_ERROR_INVALID = 0,
+  EPI_LEDGER_ERROR_BUSY,
+  EPI_LEDGER_ERROR_EXHAUSTED,
+} EpiLedgerError;
+
+GQuark epi_ledger_error_quark (void);
+#define EPI_LEDGER_ERROR epi_ledger_error_quark ()
+
+typedef struct _EpiLedger EpiLedger;
+
+EpiLedger *epi_ledger_open  (const gchar  *path,
+                             GError      **error);
+void       epi_ledger_free  (EpiLedger    *self);
+
+gsize      epi_ledger_get_n_devices (EpiLedger *self);
+
+gboolean   epi_ledger_allocate (EpiLedger    *self,
+                                const gchar  *device_id,
+                                EpcPeriod     period,
+                                EpcCounter   *counter_out,
+                                GError      **error);
+gboolean   epi_ledger_sync     (EpiLedger    *self,
+                                GError      **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EpiLedger, epi_ledger_free)
+
+G_END_DECLS
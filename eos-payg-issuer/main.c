@@ -0,0 +1,616 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
+#include <locale.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "ledger.h"
+
+
+/* Exit statuses. */
+typedef enum
+{
+  /* Success. */
+  EXIT_OK = 0,
+  /* Error parsing command line options. */
+  EXIT_INVALID_OPTIONS = 1,
+  /* Startup failed, or the ledger could not be written. */
+  EXIT_FAILED = 2,
+} ExitStatus;
+
+/* Longest request line accepted. Requests are a few tens of bytes, so anything
+ * longer than this is from a confused client. */
+#define MAXIMUM_REQUEST_LENGTH 256
+
+/* State for the whole daemon. Everything runs in the main thread, so counter
+ * allocation from the ledger needs no locking.
+ *
+ * Replies which issue a code are not written until the ledger has been synced.
+ * Rather than syncing once per request, the clients waiting on a sync are
+ * queued in @pending_clients and flushed together from an idle callback, which
+ * runs once all the requests which arrived in the current main loop iteration
+ * have been handled. Under load, that turns one msync() per request into one
+ * per batch. */
+typedef struct
+{
+  gchar *key_store_path;  /* (owned) */
+  EpcKeyStore *key_store;  /* (owned) */
+  /* Signing keys prepared so far, so each key’s HMAC state is only set up
+   * once. Cleared when the key store is reloaded. */
+  GHashTable *signing_keys;  /* (owned) (element-type utf8 EpcSigningKey) */
+
+  EpiLedger *ledger;  /* (owned) */
+
+  GSocketService *service;  /* (owned) */
+  GCancellable *cancellable;  /* (owned) */
+  GPtrArray *pending_clients;  /* (owned) (element-type Client) */
+  guint flush_id;
+
+  GMainLoop *loop;  /* (owned) */
+  ExitStatus exit_status;
+} Issuer;
+
+/* State for one client connection. A client has at most one request in flight:
+ * the next line is only read once the reply to the previous one has been
+ * written. Clients can still pipeline requests, as they are buffered, up to
+ * the size of @input’s buffer. */
+typedef struct
+{
+  Issuer *issuer;  /* (unowned) */
+  GSocketConnection *connection;  /* (owned) */
+  GBufferedInputStream *input;  /* (owned) */
+  gchar *reply;  /* (owned) (nullable) */
+} Client;
+
+static void client_read_request (Client *client);
+
+static void
+client_free (Client *client)
+{
+  g_clear_object (&client->input);
+  g_clear_object (&client->connection);
+  g_free (client->reply);
+  g_free (client);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Client, client_free)
+
+static void
+write_reply_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  g_autoptr(Client) client = g_steal_pointer (&user_data);
+  g_autoptr(GError) local_error = NULL;
+
+  if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source_object),
+                                         result, NULL, &local_error))
+    {
+      g_debug ("Error writing reply: %s", local_error->message);
+      return;
+    }
+
+  g_clear_pointer (&client->reply, g_free);
+  client_read_request (g_steal_pointer (&client));
+}
+
+/* Write @client->reply to the client, then read its next request. */
+static void
+client_send_reply (Client *client)
+{
+  GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (client->connection));
+
+  g_output_stream_write_all_async (output, client->reply, strlen (client->reply),
+                                   G_PRIORITY_DEFAULT,
+                                   client->issuer->cancellable,
+                                   write_reply_cb, client);
+}
+
+/* Get the prepared signing key for @device_id, preparing it if needed. */
+static EpcSigningKey *
+get_signing_key (Issuer       *issuer,
+                 const gchar  *device_id,
+                 GError      **error)
+{
+  EpcSigningKey *signing_key = g_hash_table_lookup (issuer->signing_keys, device_id);
+
+  if (signing_key != NULL)
+    return signing_key;
+
+  g_autoptr(GBytes) key = epc_key_store_lookup (issuer->key_store, device_id, error);
+  if (key == NULL)
+    return NULL;
+
+  signing_key = epc_signing_key_new (key, error);
+  if (signing_key == NULL)
+    return NULL;
+
+  g_hash_table_insert (issuer->signing_keys, g_strdup (device_id), signing_key);
+
+  return signing_key;
+}
+
+/* Map @error to the short reason string used in `ERROR` replies. */
+static const gchar *
+error_to_reason (const GError *error)
+{
+  if (g_error_matches (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD))
+    return "invalid-period";
+  else if (g_error_matches (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID))
+    return "invalid-device";
+  else if (g_error_matches (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_NOT_FOUND))
+    return "unknown-device";
+  else if (g_error_matches (error, EPI_LEDGER_ERROR, EPI_LEDGER_ERROR_EXHAUSTED))
+    return "exhausted";
+  else
+    return "failed";
+}
+
+static gchar *
+format_error_reply (const GError *error)
+{
+  g_autofree gchar *message = g_strdelimit (g_strdup (error->message), "\r\n", ' ');
+
+  return g_strdup_printf ("ERROR %s %s\n", error_to_reason (error), message);
+}
+
+/* Handle one request line, and return the reply to it in @reply_out. The
+ * protocol is:
+ *
+ *    ISSUE <device-id> <period>
+ *
+ * which is answered with one of:
+ *
+ *    OK <code> <counter>
+ *    ERROR <reason> <message>
+ *
+ * Returns %TRUE if the reply issues a code, in which case it must not be sent
+ * until the ledger has been synced. */
+static gboolean
+handle_request (Issuer       *issuer,
+                const gchar  *line,
+                gchar       **reply_out)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_auto(GStrv) tokens = g_strsplit (line, " ", -1);
+
+  if (g_strv_length (tokens) != 3 || !g_str_equal (tokens[0], "ISSUE"))
+    {
+      *reply_out = g_strdup_printf ("ERROR invalid-request %s\n",
+                                    _("Invalid request."));
+      return FALSE;
+    }
+
+  const gchar *device_id = tokens[1];
+  const gchar *period_str = tokens[2];
+  EpcPeriod period;
+  EpcSigningKey *signing_key = NULL;
+  EpcCounter counter = 0;
+
+  if (!epc_period_from_string (period_str, &period, &local_error) ||
+      (signing_key = get_signing_key (issuer, device_id, &local_error)) == NULL ||
+      !epi_ledger_allocate (issuer->ledger, device_id, period, &counter, &local_error))
+    {
+      *reply_out = format_error_reply (local_error);
+      return FALSE;
+    }
+
+  /* This can’t fail, since the period has been validated and the ledger only
+   * allocates counters up to %EPC_MAXCOUNTER, which fit in every scheme. That
+   * limits the issuer to the counter range of %EPC_SCHEME_1, even for keys
+   * using a scheme with wider counters, until the ledger learns the range of
+   * each key’s scheme. */
+  guint64 code = epc_signing_key_calculate_code (signing_key, period, counter,
+                                                 &local_error);
+  g_assert_no_error (local_error);
+
+  EpcScheme scheme = epc_signing_key_get_scheme (signing_key);
+  g_autofree gchar *code_str = epc_scheme_format_code (scheme, code);
+  *reply_out = g_strdup_printf ("OK %s %u\n", code_str, (guint) counter);
+
+  return TRUE;
+}
+
+static void
+issuer_fail (Issuer *issuer)
+{
+  issuer->exit_status = EXIT_FAILED;
+  g_main_loop_quit (issuer->loop);
+}
+
+static gboolean
+flush_pending_clients_cb (gpointer user_data)
+{
+  Issuer *issuer = user_data;
+  g_autoptr(GError) local_error = NULL;
+
+  issuer->flush_id = 0;
+
+  /* If the ledger can’t be synced, it’s not safe to issue any more codes, so
+   * shut down without sending the pending replies. */
+  if (!epi_ledger_sync (issuer->ledger, &local_error))
+    {
+      g_warning ("%s", local_error->message);
+      issuer_fail (issuer);
+      return G_SOURCE_REMOVE;
+    }
+
+  gsize n_clients;
+  g_autofree Client **clients = (Client **) g_ptr_array_steal (issuer->pending_clients,
+                                                               &n_clients);
+
+  for (gsize i = 0; i < n_clients; i++)
+    client_send_reply (clients[i]);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fill_request_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  g_autoptr(Client) client = g_steal_pointer (&user_data);
+  g_autoptr(GError) local_error = NULL;
+  gssize n_read;
+
+  n_read = g_buffered_input_stream_fill_finish (G_BUFFERED_INPUT_STREAM (source_object),
+                                                result, &local_error);
+
+  if (n_read < 0)
+    {
+      g_debug ("Error reading request: %s", local_error->message);
+      return;
+    }
+  else if (n_read == 0)
+    {
+      /* End of stream: the client has disconnected. */
+      return;
+    }
+
+  client_read_request (g_steal_pointer (&client));
+}
+
+/* Read the next request line from @client and handle it. A line is only taken
+ * once it is complete in the input buffer, which holds at most
+ * %MAXIMUM_REQUEST_LENGTH bytes plus the newline; if the buffer fills up
+ * without a newline, the client is disconnected. That way a client can’t make
+ * us buffer an arbitrarily long line. */
+static void
+client_read_request (Client *client)
+{
+  g_autoptr(Client) owned_client = client;
+  Issuer *issuer = client->issuer;
+  const gchar *buffer;
+  const gchar *newline = NULL;
+  gsize n_buffered;
+  g_autofree gchar *line = NULL;
+
+  buffer = g_buffered_input_stream_peek_buffer (client->input, &n_buffered);
+  if (n_buffered > 0)
+    newline = memchr (buffer, '\n', n_buffered);
+
+  if (newline == NULL)
+    {
+      if (n_buffered >= g_buffered_input_stream_get_buffer_size (client->input))
+        {
+          g_debug ("Request too long (over %u bytes); disconnecting",
+                   (guint) MAXIMUM_REQUEST_LENGTH);
+          return;
+        }
+
+      g_buffered_input_stream_fill_async (client->input, -1, G_PRIORITY_DEFAULT,
+                                          issuer->cancellable,
+                                          fill_request_cb,
+                                          g_steal_pointer (&owned_client));
+      return;
+    }
+
+  line = g_strndup (buffer, newline - buffer);
+
+  /* The line is already buffered, so this can’t block or fail. */
+  g_input_stream_skip (G_INPUT_STREAM (client->input), newline - buffer + 1,
+                       NULL, NULL);
+
+  if (handle_request (issuer, line, &client->reply))
+    {
+      g_ptr_array_add (issuer->pending_clients, g_steal_pointer (&owned_client));
+
+      if (issuer->flush_id == 0)
+        issuer->flush_id = g_idle_add (flush_pending_clients_cb, issuer);
+    }
+  else
+    {
+      client_send_reply (g_steal_pointer (&owned_client));
+    }
+}
+
+static gboolean
+incoming_cb (GSocketService    *service,
+             GSocketConnection *connection,
+             GObject           *source_object,
+             gpointer           user_data)
+{
+  Issuer *issuer = user_data;
+  Client *client = g_new0 (Client, 1);
+  GInputStream *input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+
+  client->issuer = issuer;
+  client->connection = g_object_ref (connection);
+  client->input = G_BUFFERED_INPUT_STREAM (g_buffered_input_stream_new_sized (input,
+                                                                             MAXIMUM_REQUEST_LENGTH + 1));
+
+  client_read_request (client);
+
+  return TRUE;
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+  Issuer *issuer = user_data;
+
+  g_main_loop_quit (issuer->loop);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Reload the key store, so that keys for newly provisioned devices can be
+ * picked up without restarting. If loading fails, the old key store is kept. */
+static gboolean
+reload_cb (gpointer user_data)
+{
+  Issuer *issuer = user_data;
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(EpcKeyStore) key_store = NULL;
+
+  key_store = epc_key_store_new_for_path (issuer->key_store_path, &local_error);
+  if (key_store == NULL)
+    {
+      g_warning ("Error reloading key store; keeping the old one: %s",
+                 local_error->message);
+      return G_SOURCE_CONTINUE;
+    }
+
+  g_clear_pointer (&issuer->key_store, epc_key_store_unref);
+  issuer->key_store = g_steal_pointer (&key_store);
+  g_hash_table_remove_all (issuer->signing_keys);
+
+  g_message ("Reloaded key store with %" G_GSIZE_FORMAT " keys",
+             epc_key_store_get_n_keys (issuer->key_store));
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Listen on a Unix socket at @socket_path, replacing any stale socket left
+ * behind by a previous instance. The ledger lock guarantees that no other
+ * instance using the same ledger is running. */
+static gboolean
+listen_on_socket (Issuer       *issuer,
+                  const gchar  *socket_path,
+                  GError      **error)
+{
+  GStatBuf stat_buf;
+
+  if (g_lstat (socket_path, &stat_buf) == 0 &&
+      S_ISSOCK (stat_buf.st_mode) &&
+      g_unlink (socket_path) < 0)
+    {
+      int errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Error removing stale socket ‘%s’: %s"),
+                   socket_path, g_strerror (errsv));
+      return FALSE;
+    }
+
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new (socket_path);
+
+  issuer->service = g_socket_service_new ();
+  g_socket_listener_set_backlog (G_SOCKET_LISTENER (issuer->service), 128);
+
+  /* Anyone who can connect can issue codes, so restrict the socket to the
+   * daemon’s user and group. bind() creates it with permissions from the
+   * umask, so set that rather than chmod()ing afterwards, which would leave
+   * the socket open to everyone in between. Nothing else creates files at
+   * this point, so briefly changing the process-wide umask is safe. */
+  mode_t old_umask = umask (0117);
+  gboolean added = g_socket_listener_add_address (G_SOCKET_LISTENER (issuer->service),
+                                                  address, G_SOCKET_TYPE_STREAM,
+                                                  G_SOCKET_PROTOCOL_DEFAULT,
+                                                  NULL, NULL, error);
+  umask (old_umask);
+
+  if (!added)
+    return FALSE;
+
+  g_signal_connect (issuer->service, "incoming", G_CALLBACK (incoming_cb), issuer);
+  g_socket_service_start (issuer->service);
+
+  return TRUE;
+}
+
+static gboolean
+ensure_parent_directory (const gchar  *path,
+                         GError      **error)
+{
+  g_autofree gchar *dirname = g_path_get_dirname (path);
+
+  if (g_mkdir_with_parents (dirname, 0700) < 0)
+    {
+      int errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Error creating directory ‘%s’: %s"),
+                   dirname, g_strerror (errsv));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) local_error = NULL;
+
+  /* Localisation */
+  setlocale (LC_ALL, "");
+  bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+  bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+  textdomain (GETTEXT_PACKAGE);
+
+  /* Handle command line parameters. */
+  g_autofree gchar *key_store_path = NULL;
+  g_autofree gchar *ledger_path = NULL;
+  g_autofree gchar *socket_path = NULL;
+
+  const GOptionEntry entries[] =
+    {
+      { "key-store", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &key_store_path,
+        N_("Key store to look up device keys in"), N_("PATH") },
+      { "ledger", 'l', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &ledger_path,
+        N_("Ledger of issued counters"), N_("PATH") },
+      { "socket", 'S', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &socket_path,
+        N_("Unix socket to listen on"), N_("PATH") },
+      { NULL, },
+    };
+
+  g_autoptr(GOptionContext) context = NULL;
+  context = g_option_context_new (NULL);
+  g_option_context_set_summary (context,
+                                _("Issue pay as you go codes to local clients, "
+                                  "recording which counters have been used"));
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 local_error->message);
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (argc > 1)
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 _("Too many arguments provided"));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (key_store_path == NULL)
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 _("--key-store is required"));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (ledger_path == NULL)
+    ledger_path = g_build_filename (LOCALSTATEDIR, "lib", "eos-payg-issuer", "ledger", NULL);
+  if (socket_path == NULL)
+    socket_path = g_build_filename (LOCALSTATEDIR, "lib", "eos-payg-issuer", "socket", NULL);
+
+  /* Set up the issuer. The ledger is opened first, as it takes the lock which
+   * makes it safe to replace the socket. */
+  Issuer issuer = { 0, };
+  issuer.key_store_path = g_steal_pointer (&key_store_path);
+  issuer.signing_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify) epc_signing_key_unref);
+  issuer.cancellable = g_cancellable_new ();
+  issuer.pending_clients = g_ptr_array_new_with_free_func ((GDestroyNotify) client_free);
+  issuer.loop = g_main_loop_new (NULL, FALSE);
+  issuer.exit_status = EXIT_OK;
+
+  issuer.key_store = epc_key_store_new_for_path (issuer.key_store_path, &local_error);
+
+  if (issuer.key_store != NULL &&
+      ensure_parent_directory (ledger_path, &local_error))
+    issuer.ledger = epi_ledger_open (ledger_path, &local_error);
+
+  if (issuer.ledger != NULL &&
+      ensure_parent_directory (socket_path, &local_error))
+    listen_on_socket (&issuer, socket_path, &local_error);
+
+  if (local_error != NULL)
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+      issuer.exit_status = EXIT_FAILED;
+    }
+  else
+    {
+      guint sigint_id = g_unix_signal_add (SIGINT, quit_cb, &issuer);
+      guint sigterm_id = g_unix_signal_add (SIGTERM, quit_cb, &issuer);
+      guint sighup_id = g_unix_signal_add (SIGHUP, reload_cb, &issuer);
+
+      g_message ("Listening on ‘%s’ with %" G_GSIZE_FORMAT " keys and %"
+                 G_GSIZE_FORMAT " devices in the ledger",
+                 socket_path, epc_key_store_get_n_keys (issuer.key_store),
+                 epi_ledger_get_n_devices (issuer.ledger));
+
+      g_main_loop_run (issuer.loop);
+
+      g_source_remove (sighup_id);
+      g_source_remove (sigterm_id);
+      g_source_remove (sigint_id);
+
+      g_socket_service_stop (issuer.service);
+      g_socket_listener_close (G_SOCKET_LISTENER (issuer.service));
+      g_unlink (socket_path);
+    }
+
+  /* Replies which are still waiting for a sync are dropped: their counters
+   * were never handed out. */
+  g_cancellable_cancel (issuer.cancellable);
+  g_clear_handle_id (&issuer.flush_id, g_source_remove);
+  g_clear_pointer (&issuer.pending_clients, g_ptr_array_unref);
+
+  /* Let cancelled operations on the remaining clients finish, so they are
+   * freed. */
+  while (g_main_context_iteration (NULL, FALSE));
+
+  g_clear_object (&issuer.service);
+  g_clear_pointer (&issuer.ledger, epi_ledger_free);
+  g_clear_pointer (&issuer.key_store, epc_key_store_unref);
+  g_clear_pointer (&issuer.signing_keys, g_hash_table_unref);
+  g_clear_object (&issuer.cancellable);
+  g_clear_pointer (&issuer.loop, g_main_loop_unref);
+  g_free (issuer.key_store_path);
+
+  return issuer.exit_status;
+}
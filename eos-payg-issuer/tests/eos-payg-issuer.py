@@ -0,0 +1,408 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+#
+# Copyright © 2026 Endless OS Foundation LLC
+#
+# This Source Code Form is subject to the terms of the Mozilla Public License,
+# v. 2.0. If a copy of the MPL was not distributed with this file, You can
+# obtain one at https://mozilla.org/MPL/2.0/.
+#
+# Alternatively, the contents of this file may be used under the terms of the
+# GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+# which case the provisions of the LGPL are applicable instead of those above.
+# If you wish to allow use of your version of this file only under the terms
+# of the LGPL, and not to allow others to use your version of this file under
+# the terms of the MPL, indicate your decision by deleting the provisions
+# above and replace them with the notice and other provisions required by the
+# LGPL. If you do not delete the provisions above, a recipient may use your
+# version of this file under the terms of either the MPL or the LGPL.
+
+
+"""Integration tests for the eos-payg-issuer daemon."""
+
+import hashlib
+import hmac
+import os
+import shutil
+import signal
+import socket
+import struct
+import subprocess
+import tempfile
+import time
+import unittest
+
+import taptestrunner
+
+
+# Period values, as in libeos-payg-codes/codes.h.
+PERIOD_5_SECONDS = 0
+PERIOD_1_HOUR = 3
+PERIOD_14_DAYS = 17
+
+
+def calculate_code(key, period, counter):
+    """Calculate a code in the same way as libeos-payg-codes."""
+    digest = hmac.new(key.encode('utf-8'), struct.pack('BB', period, counter),
+                      hashlib.sha1).digest()
+    sign = ((digest[18] << 8) | digest[19]) & ((1 << 13) - 1)
+    return '{:08d}'.format((period << 21) | (counter << 13) | sign)
+
+
+class IssuerConnection:
+    """A client connection to the issuer socket."""
+
+    def __init__(self, socket_path, timeout):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.settimeout(timeout)
+        self.sock.connect(socket_path)
+        self.file = self.sock.makefile('rw', encoding='utf-8', newline='\n')
+
+    def close(self):
+        self.file.close()
+        self.sock.close()
+
+    def request(self, line):
+        self.file.write(line + '\n')
+        self.file.flush()
+        return self.file.readline().rstrip('\n')
+
+    def requestMany(self, lines):
+        """Send all of @lines before reading any replies."""
+        self.file.write(''.join(line + '\n' for line in lines))
+        self.file.flush()
+        return [self.file.readline().rstrip('\n') for _ in lines]
+
+
+class TestEosPaygIssuer(unittest.TestCase):
+    """Integration test for running eos-payg-issuer.
+
+    This can be run when installed or uninstalled. When uninstalled, it
+    requires G_TEST_BUILDDIR and G_TEST_SRCDIR to be set.
+
+    Each test runs the daemon with a key store, ledger and socket in a
+    temporary directory.
+    """
+
+    keys = {
+        'DEVICE01': 'this is a key with at least 64 bytes of content ' +
+                    'otherwise we get an error; device 1',
+        'DEVICE02': 'this is a key with at least 64 bytes of content ' +
+                    'otherwise we get an error; device 2',
+        'DEVICE03': 'this is a key with at least 64 bytes of content ' +
+                    'otherwise we get an error; device 3',
+    }
+
+    def setUp(self):
+        self.timeout_seconds = 10  # seconds per test
+        self.tmpdir = tempfile.mkdtemp()
+        os.chdir(self.tmpdir)
+        print('tmpdir:', self.tmpdir)
+        if 'G_TEST_BUILDDIR' in os.environ:
+            self.__eos_payg_issuer = \
+                os.path.join(os.environ['G_TEST_BUILDDIR'], '..',
+                             'eos-payg-issuer-1')
+            self.__eos_payg_issuer_load = \
+                os.path.join(os.environ['G_TEST_BUILDDIR'],
+                             'eos-payg-issuer-load')
+        else:
+            self.__eos_payg_issuer = os.path.join('/', 'usr', 'bin',
+                                                  'eos-payg-issuer-1')
+            self.__eos_payg_issuer_load = \
+                os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             'eos-payg-issuer-load')
+        print('eos_payg_issuer:', self.__eos_payg_issuer)
+        print('eos_payg_issuer_load:', self.__eos_payg_issuer_load)
+
+        self.key_store = os.path.join(self.tmpdir, 'keys')
+        self.ledger = os.path.join(self.tmpdir, 'state', 'ledger')
+        self.socket = os.path.join(self.tmpdir, 'state', 'socket')
+        self.createKeyStore(self.keys)
+        self.issuer = None
+        self.connections = []
+
+    def tearDown(self):
+        for connection in self.connections:
+            connection.close()
+        if self.issuer is not None:
+            self.stopIssuer()
+        shutil.rmtree(self.tmpdir)
+
+    def createKeyStore(self, keys):
+        """Write a key store containing @keys, a dict mapping device IDs to
+        keys. See libeos-payg-codes/key-store.c for the format."""
+        device_ids = sorted(keys.keys())
+        header = struct.pack('<8sIII12x', b'EPCKEYS', 1, len(device_ids), 0)
+        index = b''
+        data = b''
+        data_offset = len(header) + 32 * len(device_ids)
+        for device_id in device_ids:
+            key = keys[device_id].encode('utf-8')
+            index += struct.pack('<16sQI4x', device_id.encode('utf-8'),
+                                 data_offset + len(data), len(key))
+            data += key
+        # Replace the file, rather than overwriting it, as the issuer has it
+        # mapped.
+        with open(self.key_store + '.tmp', 'wb') as key_store_file:
+            key_store_file.write(header + index + data)
+        os.rename(self.key_store + '.tmp', self.key_store)
+
+    def issuerArgs(self):
+        return [self.__eos_payg_issuer,
+                '--key-store', self.key_store,
+                '--ledger', self.ledger,
+                '--socket', self.socket]
+
+    def issuerEnv(self):
+        env = os.environ.copy()
+        env['LC_ALL'] = 'C.UTF-8'
+        return env
+
+    def startIssuer(self):
+        """Start the issuer and wait until it is accepting connections."""
+        argv = self.issuerArgs()
+        print('Running:', argv)
+        self.issuer = subprocess.Popen(argv, env=self.issuerEnv())
+
+        deadline = time.monotonic() + self.timeout_seconds
+        while True:
+            self.assertIsNone(self.issuer.poll(),
+                              'eos-payg-issuer exited on startup')
+            try:
+                with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+                    s.connect(self.socket)
+                return
+            except (FileNotFoundError, ConnectionRefusedError):
+                self.assertLess(time.monotonic(), deadline,
+                                'Timed out waiting for eos-payg-issuer')
+                time.sleep(0.05)
+
+    def stopIssuer(self, sig=signal.SIGTERM):
+        for connection in self.connections:
+            connection.close()
+        self.connections = []
+        self.issuer.send_signal(sig)
+        returncode = self.issuer.wait(timeout=self.timeout_seconds)
+        self.issuer = None
+        return returncode
+
+    def connect(self):
+        connection = IssuerConnection(self.socket, self.timeout_seconds)
+        self.connections.append(connection)
+        return connection
+
+    def assertIssued(self, reply, device_id, period, counter):
+        self.assertEqual(reply, 'OK {} {}'.format(
+            calculate_code(self.keys[device_id], period, counter),
+            counter))
+
+    def assertErrorReason(self, reply, reason):
+        self.assertTrue(reply.startswith('ERROR {} '.format(reason)), reply)
+
+    def test_issue(self):
+        """Test issuing codes allocates counters in order, independently for
+        each device and period."""
+        self.startIssuer()
+        connection = self.connect()
+
+        for counter in range(3):
+            reply = connection.request('ISSUE DEVICE01 1h')
+            self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, counter)
+
+        reply = connection.request('ISSUE DEVICE01 14d')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_14_DAYS, 0)
+
+        # A second connection shares the same ledger.
+        other_connection = self.connect()
+        reply = other_connection.request('ISSUE DEVICE02 1h')
+        self.assertIssued(reply, 'DEVICE02', PERIOD_1_HOUR, 0)
+        reply = other_connection.request('ISSUE DEVICE01 1h')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, 3)
+
+        self.assertEqual(self.stopIssuer(), 0)
+
+    def test_socket_permissions(self):
+        """Test that the socket is only accessible to the issuer’s user and
+        group, even with a permissive umask."""
+        old_umask = os.umask(0)
+        try:
+            self.startIssuer()
+        finally:
+            os.umask(old_umask)
+
+        self.assertEqual(os.stat(self.socket).st_mode & 0o777, 0o660)
+        self.assertEqual(self.stopIssuer(), 0)
+
+    def test_errors(self):
+        """Test that invalid requests are rejected without closing the
+        connection or allocating counters."""
+        self.startIssuer()
+        connection = self.connect()
+
+        self.assertErrorReason(connection.request(''), 'invalid-request')
+        self.assertErrorReason(connection.request('ISSUE DEVICE01'),
+                               'invalid-request')
+        self.assertErrorReason(connection.request('GENERATE DEVICE01 1h'),
+                               'invalid-request')
+        self.assertErrorReason(connection.request('ISSUE DEVICE01 2h'),
+                               'invalid-period')
+        self.assertErrorReason(connection.request('ISSUE NOTADEVICE 1h'),
+                               'unknown-device')
+        self.assertErrorReason(connection.request('ISSUE ' + 'X' * 16 + ' 1h'),
+                               'invalid-device')
+
+        reply = connection.request('ISSUE DEVICE01 1h')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, 0)
+
+    def test_too_long(self):
+        """Test that a client sending an over-long request line is
+        disconnected, without affecting other clients."""
+        self.startIssuer()
+        connection = self.connect()
+
+        # The issuer closes the connection with the rest of the line unread,
+        # which may surface as a reset rather than end of stream.
+        try:
+            reply = connection.request('ISSUE ' + 'X' * 1000 + ' 1h')
+        except ConnectionResetError:
+            reply = ''
+        self.assertEqual(reply, '')
+
+        # A line of exactly the maximum length is still read.
+        reply = self.connect().request('ISSUE DEVICE01 1h'.ljust(256))
+        self.assertErrorReason(reply, 'invalid-request')
+
+        reply = self.connect().request('ISSUE DEVICE01 1h')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, 0)
+
+    def test_pipelined(self):
+        """Test that pipelined requests are answered in order, and that a
+        device’s counters are exhausted after 256 codes."""
+        self.startIssuer()
+        connection = self.connect()
+
+        replies = connection.requestMany(['ISSUE DEVICE03 1h'] * 257)
+        for counter in range(256):
+            self.assertIssued(replies[counter], 'DEVICE03', PERIOD_1_HOUR,
+                              counter)
+        self.assertErrorReason(replies[256], 'exhausted')
+
+        # Other periods are unaffected.
+        reply = connection.request('ISSUE DEVICE03 14d')
+        self.assertIssued(reply, 'DEVICE03', PERIOD_14_DAYS, 0)
+
+    def test_ledger_persists(self):
+        """Test that issued counters are remembered across restarts, whether
+        the issuer is stopped cleanly or killed."""
+        self.startIssuer()
+        connection = self.connect()
+        for counter in range(3):
+            reply = connection.request('ISSUE DEVICE01 1h')
+            self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, counter)
+        self.assertEqual(self.stopIssuer(), 0)
+
+        self.startIssuer()
+        connection = self.connect()
+        reply = connection.request('ISSUE DEVICE01 1h')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, 3)
+        reply = connection.request('ISSUE DEVICE02 1h')
+        self.assertIssued(reply, 'DEVICE02', PERIOD_1_HOUR, 0)
+        self.assertEqual(self.stopIssuer(signal.SIGKILL), -signal.SIGKILL)
+
+        self.startIssuer()
+        connection = self.connect()
+        reply = connection.request('ISSUE DEVICE01 1h')
+        self.assertIssued(reply, 'DEVICE01', PERIOD_1_HOUR, 4)
+        reply = connection.request('ISSUE DEVICE02 1h')
+        self.assertIssued(reply, 'DEVICE02', PERIOD_1_HOUR, 1)
+
+    def test_ledger_busy(self):
+        """Test that a second issuer can’t use the same ledger."""
+        self.startIssuer()
+
+        argv = self.issuerArgs()
+        argv[-1] = os.path.join(self.tmpdir, 'other-socket')
+        info = subprocess.run(argv, timeout=self.timeout_seconds,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=self.issuerEnv())
+        print('Output:', info.stdout.decode('utf-8'))
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+        self.assertIn('in use by another process', info.stdout.decode('utf-8'))
+
+    def test_ledger_invalid(self):
+        """Test that the issuer refuses to start with a corrupt ledger."""
+        os.makedirs(os.path.dirname(self.ledger))
+        with open(self.ledger, 'wb') as f:
+            f.write(b'not a ledger' * 10)
+
+        info = subprocess.run(self.issuerArgs(), timeout=self.timeout_seconds,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=self.issuerEnv())
+        print('Output:', info.stdout.decode('utf-8'))
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+
+    def test_missing_key_store(self):
+        """Test that --key-store is required."""
+        argv = self.issuerArgs()[:1]
+        info = subprocess.run(argv, timeout=self.timeout_seconds,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=self.issuerEnv())
+        print('Output:', info.stdout.decode('utf-8'))
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+    def test_reload(self):
+        """Test that SIGHUP reloads the key store."""
+        self.startIssuer()
+        connection = self.connect()
+        self.assertErrorReason(connection.request('ISSUE DEVICE04 1h'),
+                               'unknown-device')
+
+        self.keys = dict(self.keys)
+        self.keys['DEVICE04'] = self.keys['DEVICE01'] + '; device 4'
+        self.createKeyStore(self.keys)
+        self.issuer.send_signal(signal.SIGHUP)
+
+        deadline = time.monotonic() + self.timeout_seconds
+        while True:
+            reply = connection.request('ISSUE DEVICE04 1h')
+            if not reply.startswith('ERROR unknown-device '):
+                break
+            self.assertLess(time.monotonic(), deadline,
+                            'Timed out waiting for the key store to reload')
+            time.sleep(0.05)
+        self.assertIssued(reply, 'DEVICE04', PERIOD_1_HOUR, 0)
+
+    def test_load(self):
+        """Test issuing codes over many connections at once with the load
+        test client, which checks no counter is issued twice."""
+        self.startIssuer()
+
+        argv = [self.__eos_payg_issuer_load,
+                '--socket', self.socket,
+                '--key-store', self.key_store,
+                '--period', '5s',
+                '--connections', '8',
+                '--requests', '600']
+        for device_id in self.keys:
+            argv.extend(['--device', device_id])
+        print('Running:', argv)
+        info = subprocess.run(argv, timeout=self.timeout_seconds * 3,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=self.issuerEnv())
+        print('Output:', info.stdout.decode('utf-8'))
+        info.check_returncode()
+        self.assertIn('600 codes issued and 0 errors',
+                      info.stdout.decode('utf-8'))
+
+        # The load test used counters 0–199 for each device.
+        connection = self.connect()
+        reply = connection.request('ISSUE DEVICE02 5s')
+        self.assertIssued(reply, 'DEVICE02', PERIOD_5_SECONDS, 200)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=taptestrunner.TAPTestRunner())
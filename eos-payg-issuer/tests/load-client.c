@@ -0,0 +1,351 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
+#include <locale.h>
+#include <string.h>
+
+
+/*
+ * Load test client for eos-payg-issuer. It opens several connections to the
+ * issuer and issues codes over all of them at once, cycling through the given
+ * devices. Once all the requests are done, it checks that no counter was
+ * issued twice for the same device (and, with --key-store, that every code
+ * verifies), and prints the request rate.
+ *
+ * It is not installed; it is used by the integration tests, and can be run
+ * from the build directory to benchmark an issuer.
+ */
+
+/* Exit statuses. */
+typedef enum
+{
+  /* Success. */
+  EXIT_OK = 0,
+  /* Error parsing command line options. */
+  EXIT_INVALID_OPTIONS = 1,
+  /* Load test failed, or the issuer misbehaved. */
+  EXIT_FAILED = 2,
+} ExitStatus;
+
+typedef struct
+{
+  guint device_index;
+  EpcCounter counter;
+  EpcCode code;
+} Result;
+
+typedef struct
+{
+  GSocketAddress *address;  /* (unowned) */
+  const gchar * const *device_ids;  /* (unowned) */
+  guint n_devices;
+  EpcPeriod period;
+  const gchar *period_str;  /* (unowned) */
+  guint n_requests;
+  gint next_request;  /* (atomic) */
+} LoadTest;
+
+typedef struct
+{
+  LoadTest *load_test;  /* (unowned) */
+  GArray *results;  /* (owned) (element-type Result) */
+  guint n_error_replies;
+  GError *error;  /* (owned) (nullable) */
+} Worker;
+
+/* Issue requests over one connection until the load test has made enough. */
+static gpointer
+worker_thread_cb (gpointer user_data)
+{
+  Worker *worker = user_data;
+  LoadTest *load_test = worker->load_test;
+  g_autoptr(GSocketClient) socket_client = g_socket_client_new ();
+  g_autoptr(GSocketConnection) connection = NULL;
+
+  connection = g_socket_client_connect (socket_client,
+                                        G_SOCKET_CONNECTABLE (load_test->address),
+                                        NULL, &worker->error);
+  if (connection == NULL)
+    return NULL;
+
+  GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+  g_autoptr(GDataInputStream) input =
+      g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+  g_data_input_stream_set_newline_type (input, G_DATA_STREAM_NEWLINE_TYPE_LF);
+
+  while (TRUE)
+    {
+      guint request_index = (guint) g_atomic_int_add (&load_test->next_request, 1);
+      if (request_index >= load_test->n_requests)
+        break;
+
+      guint device_index = request_index % load_test->n_devices;
+      g_autofree gchar *request = g_strdup_printf ("ISSUE %s %s\n",
+                                                   load_test->device_ids[device_index],
+                                                   load_test->period_str);
+
+      if (!g_output_stream_write_all (output, request, strlen (request),
+                                      NULL, NULL, &worker->error))
+        return NULL;
+
+      g_autofree gchar *reply = g_data_input_stream_read_line (input, NULL, NULL,
+                                                               &worker->error);
+      if (reply == NULL)
+        {
+          if (worker->error == NULL)
+            g_set_error_literal (&worker->error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+                                 "Issuer closed the connection");
+          return NULL;
+        }
+
+      g_auto(GStrv) tokens = g_strsplit (reply, " ", 3);
+      guint64 code, counter;
+
+      if (tokens[0] != NULL && g_str_equal (tokens[0], "ERROR"))
+        {
+          g_debug ("Error reply: %s", reply);
+          worker->n_error_replies++;
+        }
+      else if (g_strv_length (tokens) != 3 ||
+               !g_str_equal (tokens[0], "OK") ||
+               !g_ascii_string_to_unsigned (tokens[1], 10, 0, G_MAXUINT32, &code, NULL) ||
+               !g_ascii_string_to_unsigned (tokens[2], 10, 0, G_MAXUINT8, &counter, NULL))
+        {
+          g_set_error (&worker->error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "Invalid reply ‘%s’", reply);
+          return NULL;
+        }
+      else
+        {
+          Result result = { device_index, (EpcCounter) counter, (EpcCode) code };
+          g_array_append_val (worker->results, result);
+        }
+    }
+
+  return NULL;
+}
+
+/* Check that no (device, counter) pair was issued twice, and that the codes
+ * verify if @key_store is provided. */
+static gboolean
+check_results (LoadTest     *load_test,
+               GArray       *results,
+               EpcKeyStore  *key_store,
+               GError      **error)
+{
+  g_autofree guint8 *seen = g_new0 (guint8, load_test->n_devices * (G_MAXUINT8 + 1));
+  g_autoptr(GPtrArray) keys = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+
+  for (guint i = 0; key_store != NULL && i < load_test->n_devices; i++)
+    {
+      GBytes *key = epc_key_store_lookup (key_store, load_test->device_ids[i], error);
+      if (key == NULL)
+        return FALSE;
+      g_ptr_array_add (keys, key);
+    }
+
+  for (gsize i = 0; i < results->len; i++)
+    {
+      const Result *result = &g_array_index (results, Result, i);
+      const gchar *device_id = load_test->device_ids[result->device_index];
+      guint8 *seen_counter = &seen[result->device_index * (G_MAXUINT8 + 1) + result->counter];
+
+      if (*seen_counter)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Counter %u was issued twice for device ‘%s’",
+                       (guint) result->counter, device_id);
+          return FALSE;
+        }
+      *seen_counter = TRUE;
+
+      if (key_store != NULL)
+        {
+          EpcPeriod period;
+          EpcCounter counter;
+
+          if (!epc_verify_code (result->code, keys->pdata[result->device_index],
+                                &period, &counter, error))
+            return FALSE;
+
+          if (period != load_test->period || counter != result->counter)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "Code %u for device ‘%s’ has the wrong period or counter",
+                           result->code, device_id);
+              return FALSE;
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) local_error = NULL;
+
+  setlocale (LC_ALL, "");
+
+  /* Handle command line parameters. */
+  g_autofree gchar *socket_path = NULL;
+  g_auto(GStrv) device_ids = NULL;
+  g_autofree gchar *period_str = NULL;
+  g_autofree gchar *key_store_path = NULL;
+  gint n_connections = 16;
+  gint n_requests = 1000;
+  gboolean allow_errors = FALSE;
+
+  const GOptionEntry entries[] =
+    {
+      { "socket", 'S', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &socket_path,
+        "Issuer socket to connect to", "PATH" },
+      { "device", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY, &device_ids,
+        "Device ID to request codes for (may be repeated)", "ID" },
+      { "period", 'p', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &period_str,
+        "Period to request codes for (default: 5s)", "PERIOD" },
+      { "connections", 'c', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_connections,
+        "Number of concurrent connections (default: 16)", "N" },
+      { "requests", 'n', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &n_requests,
+        "Total number of requests (default: 1000)", "N" },
+      { "key-store", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &key_store_path,
+        "Key store to verify the issued codes with", "PATH" },
+      { "allow-errors", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &allow_errors,
+        "Don’t fail if the issuer returns errors, such as for exhausted counters", NULL },
+      { NULL, },
+    };
+
+  g_autoptr(GOptionContext) context = NULL;
+  context = g_option_context_new (NULL);
+  g_option_context_set_summary (context, "Load test an eos-payg-issuer daemon");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    {
+      g_printerr ("%s: Option parsing failed: %s\n", argv[0], local_error->message);
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (socket_path == NULL || device_ids == NULL ||
+      n_connections < 1 || n_requests < 1)
+    {
+      g_printerr ("%s: Option parsing failed: %s\n", argv[0],
+                  "--socket and --device are required, and counts must be positive");
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  EpcPeriod period;
+
+  if (period_str == NULL)
+    period_str = g_strdup ("5s");
+  if (!epc_period_from_string (period_str, &period, &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  g_autoptr(EpcKeyStore) key_store = NULL;
+
+  if (key_store_path != NULL)
+    {
+      key_store = epc_key_store_new_for_path (key_store_path, &local_error);
+      if (key_store == NULL)
+        {
+          g_printerr ("%s: %s\n", argv[0], local_error->message);
+          return EXIT_FAILED;
+        }
+    }
+
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new (socket_path);
+  LoadTest load_test =
+    {
+      .address = address,
+      .device_ids = (const gchar * const *) device_ids,
+      .n_devices = g_strv_length (device_ids),
+      .period = period,
+      .period_str = period_str,
+      .n_requests = (guint) n_requests,
+      .next_request = 0,
+    };
+
+  /* Run the workers. */
+  g_autofree Worker *workers = g_new0 (Worker, n_connections);
+  g_autofree GThread **threads = g_new0 (GThread *, n_connections);
+  gint64 start_time = g_get_monotonic_time ();
+
+  for (gint i = 0; i < n_connections; i++)
+    {
+      workers[i].load_test = &load_test;
+      workers[i].results = g_array_new (FALSE, FALSE, sizeof (Result));
+      threads[i] = g_thread_new ("load-worker", worker_thread_cb, &workers[i]);
+    }
+
+  for (gint i = 0; i < n_connections; i++)
+    g_thread_join (threads[i]);
+
+  gint64 duration = MAX (g_get_monotonic_time () - start_time, 1);
+
+  /* Collect the results. */
+  g_autoptr(GArray) results = g_array_new (FALSE, FALSE, sizeof (Result));
+  guint n_error_replies = 0;
+  ExitStatus exit_status = EXIT_OK;
+
+  for (gint i = 0; i < n_connections; i++)
+    {
+      if (workers[i].error != NULL)
+        {
+          g_printerr ("%s: Connection %d: %s\n", argv[0], i, workers[i].error->message);
+          exit_status = EXIT_FAILED;
+        }
+
+      g_array_append_vals (results, workers[i].results->data, workers[i].results->len);
+      n_error_replies += workers[i].n_error_replies;
+
+      g_array_unref (workers[i].results);
+      g_clear_error (&workers[i].error);
+    }
+
+  g_print ("%u codes issued and %u errors in %.3f s over %d connections: %.0f requests/s\n",
+           results->len, n_error_replies, (gdouble) duration / G_USEC_PER_SEC,
+           n_connections,
+           (gdouble) (results->len + n_error_replies) * G_USEC_PER_SEC / duration);
+
+  if (!check_results (&load_test, results, key_store, &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+      exit_status = EXIT_FAILED;
+    }
+
+  if (n_error_replies > 0 && !allow_errors)
+    {
+      g_printerr ("%s: The issuer returned %u errors\n", argv[0], n_error_replies);
+      exit_status = EXIT_FAILED;
+    }
+
+  return exit_status;
+}
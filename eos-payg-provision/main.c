@@ -0,0 +1,817 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg/efi.h>
+#include <linux/fs.h>
+#include <locale.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Exit statuses. */
+typedef enum
+{
+  /* Success. */
+  EXIT_OK = 0,
+  /* Error parsing command line options. */
+  EXIT_INVALID_OPTIONS = 1,
+  /* Provisioning failed. */
+  EXIT_FAILED = 2,
+} ExitStatus;
+
+/* The generated key is printable, so it can be stored in the CSV and JSON
+ * records and pasted into eos-payg-generate key files. Its size and layout
+ * match what the factory tooling has always produced: 768 alphanumeric
+ * characters, wrapped at 70 columns with no trailing newline. */
+#define KEY_LENGTH_CHARS 768
+#define KEY_LINE_WIDTH 70
+static const gchar key_alphabet[] =
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+G_STATIC_ASSERT (KEY_LENGTH_CHARS >= EPC_KEY_MINIMUM_LENGTH_BYTES);
+
+/* The test codes which are recorded for each provisioned machine. */
+#define TEST_CODE_PERIOD EPC_PERIOD_1_HOUR
+static const EpcCounter test_code_counters[] = { 250, 249, 248 };
+#define N_TEST_CODES G_N_ELEMENTS (test_code_counters)
+
+/* Length of the device ID taken from the start of the machine ID. */
+#define DEVICE_ID_LENGTH 8
+
+#define RECORDS_BASENAME "payg-test-codes"
+#define CSV_HEADER "device_id,code1,code2,code3,key\r\n"
+
+/* The EFI variables which may hold the PAYG state instead of the used codes
+ * file; see EFI_STATE_VARIABLE. The GUID and attributes must match
+ * libeos-payg/efi.c, and a variable holding only EFI_STATE_VERSION is the
+ * empty state described in libeos-payg/manager.c. */
+#define DEFAULT_EFIVARS_DIR "/sys/firmware/efi/efivars"
+#define EOSPAYG_EFI_GUID "d89c3871-ae0c-4fc5-a409-dc717aee61e7"
+#define EFI_STATE_VERSION 1
+static const guint8 efi_state_empty[] =
+  {
+    /* Attributes: non-volatile, boot services and runtime access. */
+    0x07, 0x00, 0x00, 0x00,
+    EFI_STATE_VERSION,
+  };
+
+/* Generate a new key using getrandom(). Bytes which would bias the choice of
+ * character are rejected. */
+static gchar *
+generate_key (GError **error)
+{
+  const gsize alphabet_len = strlen (key_alphabet);
+  const gsize reject_from = 256 - (256 % alphabet_len);
+  g_autoptr(GString) key = g_string_sized_new (KEY_LENGTH_CHARS +
+                                               KEY_LENGTH_CHARS / KEY_LINE_WIDTH);
+  gsize n_chars = 0;
+
+  while (n_chars < KEY_LENGTH_CHARS)
+    {
+      guint8 buf[256];
+      ssize_t n_read = getrandom (buf, sizeof (buf), 0);
+
+      if (n_read < 0)
+        {
+          int saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                       _("Error generating key: %s"), g_strerror (saved_errno));
+          return NULL;
+        }
+
+      for (gsize i = 0; i < (gsize) n_read && n_chars < KEY_LENGTH_CHARS; i++)
+        {
+          if (buf[i] >= reject_from)
+            continue;
+
+          if (n_chars > 0 && n_chars % KEY_LINE_WIDTH == 0)
+            g_string_append_c (key, '\n');
+          g_string_append_c (key, key_alphabet[buf[i] % alphabet_len]);
+          n_chars++;
+        }
+
+      explicit_bzero (buf, sizeof (buf));
+    }
+
+  return g_string_free (g_steal_pointer (&key), FALSE);
+}
+
+/* The device ID is the upper-cased first few characters of the machine ID. */
+static gchar *
+read_device_id (const gchar  *machine_id_path,
+                GError      **error)
+{
+  g_autofree gchar *machine_id = NULL;
+
+  if (!g_file_get_contents (machine_id_path, &machine_id, NULL, error))
+    return NULL;
+
+  g_strstrip (machine_id);
+
+  for (gsize i = 0; i < DEVICE_ID_LENGTH; i++)
+    {
+      if (!g_ascii_isxdigit (machine_id[i]))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       _("Invalid machine ID in ‘%s’."), machine_id_path);
+          return NULL;
+        }
+    }
+
+  return g_ascii_strup (machine_id, DEVICE_ID_LENGTH);
+}
+
+static gboolean
+write_all (int           fd,
+           const gchar  *data,
+           gsize         len,
+           const gchar  *path,
+           GError      **error)
+{
+  while (len > 0)
+    {
+      ssize_t n_written = write (fd, data, len);
+
+      if (n_written < 0)
+        {
+          int saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                       _("Error writing to ‘%s’: %s"), path,
+                       g_strerror (saved_errno));
+          return FALSE;
+        }
+
+      data += n_written;
+      len -= (gsize) n_written;
+    }
+
+  return TRUE;
+}
+
+/* Open @path for writing and take an exclusive lock on it, so that several
+ * machines provisioning onto the same USB stick can’t interleave records.
+ * Returns -1 on error. */
+static int
+open_locked (const gchar  *path,
+             int           flags,
+             GError      **error)
+{
+  g_autofd int fd = g_open (path, flags | O_CREAT | O_CLOEXEC, 0644);
+
+  if (fd < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error opening ‘%s’: %s"), path, g_strerror (saved_errno));
+      return -1;
+    }
+
+  while (flock (fd, LOCK_EX) < 0)
+    {
+      int saved_errno = errno;
+
+      if (saved_errno == EINTR)
+        continue;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error locking ‘%s’: %s"), path, g_strerror (saved_errno));
+      return -1;
+    }
+
+  return g_steal_fd (&fd);
+}
+
+/* Flush @fd to disk; the USB stick may be pulled as soon as we exit. The lock
+ * is released when @fd is closed. */
+static gboolean
+sync_and_close (int          *fd,
+                const gchar  *path,
+                GError      **error)
+{
+  g_autofd int owned_fd = g_steal_fd (fd);
+
+  if (fsync (owned_fd) < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error writing to ‘%s’: %s"), path,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return g_close (g_steal_fd (&owned_fd), error);
+}
+
+/* Quote a CSV field the same way as Python’s csv module (QUOTE_MINIMAL), which
+ * eos-payg-csv uses to read the records back. */
+static void
+append_csv_field (GString     *row,
+                  const gchar *field)
+{
+  if (strpbrk (field, ",\"\r\n") == NULL)
+    {
+      g_string_append (row, field);
+      return;
+    }
+
+  g_string_append_c (row, '"');
+  for (const gchar *c = field; *c != '\0'; c++)
+    {
+      if (*c == '"')
+        g_string_append_c (row, '"');
+      g_string_append_c (row, *c);
+    }
+  g_string_append_c (row, '"');
+}
+
+/* Append a record to the CSV file at @path, writing the header first if the
+ * file is new. The file is never read. */
+static gboolean
+append_csv_record (const gchar  *path,
+                   const gchar  *device_id,
+                   gchar       **codes,
+                   const gchar  *key,
+                   GError      **error)
+{
+  g_autofd int fd = open_locked (path, O_WRONLY | O_APPEND, error);
+  struct stat stat_buf;
+
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &stat_buf) < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error opening ‘%s’: %s"), path, g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  g_autoptr(GString) row = g_string_new (stat_buf.st_size == 0 ? CSV_HEADER : "");
+
+  append_csv_field (row, device_id);
+  for (gsize i = 0; i < N_TEST_CODES; i++)
+    {
+      g_string_append_c (row, ',');
+      append_csv_field (row, codes[i]);
+    }
+  g_string_append_c (row, ',');
+  append_csv_field (row, key);
+  g_string_append (row, "\r\n");
+
+  return (write_all (fd, row->str, row->len, path, error) &&
+          sync_and_close (&fd, path, error));
+}
+
+static void
+append_json_string (GString     *json,
+                    const gchar *str)
+{
+  g_string_append_c (json, '"');
+  for (const gchar *c = str; *c != '\0'; c++)
+    {
+      switch (*c)
+        {
+        case '"':
+          g_string_append (json, "\\\"");
+          break;
+        case '\\':
+          g_string_append (json, "\\\\");
+          break;
+        case '\n':
+          g_string_append (json, "\\n");
+          break;
+        default:
+          if ((guchar) *c < 0x20)
+            g_string_append_printf (json, "\\u%04x", (guint) (guchar) *c);
+          else
+            g_string_append_c (json, *c);
+        }
+    }
+  g_string_append_c (json, '"');
+}
+
+/* Append a record to the JSON array in the file at @path, creating it if
+ * needed. Only the end of the file is read: the closing bracket of the array
+ * is overwritten by the new element and a new closing bracket. */
+static gboolean
+append_json_record (const gchar  *path,
+                    const gchar  *device_id,
+                    gchar       **codes,
+                    const gchar  *key,
+                    GError      **error)
+{
+  g_autofd int fd = open_locked (path, O_RDWR, error);
+  struct stat stat_buf;
+  gchar tail[256];
+  off_t write_offset = 0;
+  const gchar *separator = "[";
+
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &stat_buf) < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error opening ‘%s’: %s"), path, g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  if (stat_buf.st_size > 0)
+    {
+      off_t tail_offset = MAX (stat_buf.st_size - (off_t) sizeof (tail), 0);
+      ssize_t tail_len;
+      ssize_t i;
+
+      do
+        tail_len = pread (fd, tail, sizeof (tail), tail_offset);
+      while (tail_len < 0 && errno == EINTR);
+
+      if (tail_len < 0)
+        {
+          int saved_errno = errno;
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                       _("Error reading ‘%s’: %s"), path,
+                       g_strerror (saved_errno));
+          return FALSE;
+        }
+
+      i = tail_len - 1;
+      while (i >= 0 && g_ascii_isspace (tail[i]))
+        i--;
+
+      if (i < 0 || tail[i] != ']')
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       _("‘%s’ does not contain a JSON array."), path);
+          return FALSE;
+        }
+
+      write_offset = tail_offset + i;
+
+      i--;
+      while (i >= 0 && g_ascii_isspace (tail[i]))
+        i--;
+
+      separator = (i >= 0 && tail[i] == '[') ? "" : ", ";
+    }
+
+  /* Use the same separators as Python’s json module. */
+  g_autoptr(GString) json = g_string_new (separator);
+
+  g_string_append (json, "{\"device_id\": ");
+  append_json_string (json, device_id);
+  for (gsize i = 0; i < N_TEST_CODES; i++)
+    {
+      g_string_append_printf (json, ", \"code%" G_GSIZE_FORMAT "\": ", i + 1);
+      append_json_string (json, codes[i]);
+    }
+  g_string_append (json, ", \"key\": ");
+  append_json_string (json, key);
+  g_string_append (json, "}]");
+
+  if (lseek (fd, write_offset, SEEK_SET) < 0 ||
+      ftruncate (fd, write_offset) < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error writing to ‘%s’: %s"), path,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return (write_all (fd, json->str, json->len, path, error) &&
+          sync_and_close (&fd, path, error));
+}
+
+/* Atomically replace the file at @path, creating its parent directories. */
+static gboolean
+install_file (const gchar  *path,
+              const gchar  *contents,
+              int           mode,
+              GError      **error)
+{
+  g_autofree gchar *dir = g_path_get_dirname (path);
+
+  if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error creating directory ‘%s’: %s"), dir,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return g_file_set_contents_full (path, contents, -1,
+                                   G_FILE_SET_CONTENTS_CONSISTENT |
+                                   G_FILE_SET_CONTENTS_DURABLE,
+                                   mode, error);
+}
+
+/* Copy @path to @backup_path if it exists, so that an accidental
+ * re-provisioning can be undone by hand. */
+static gboolean
+backup_file (const gchar  *path,
+             const gchar  *backup_path,
+             int           mode,
+             GError      **error)
+{
+  g_autofree gchar *contents = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  if (!g_file_get_contents (path, &contents, NULL, &local_error))
+    {
+      if (g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        return TRUE;
+
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return install_file (backup_path, contents, mode, error);
+}
+
+/* Replace `$device_id` and `${device_id}` in @template, as Python’s
+ * string.Template did for the original provisioning script. */
+static gchar *
+substitute_device_id (const gchar *template,
+                      const gchar *device_id)
+{
+  g_autoptr(GString) str = g_string_new (template);
+
+  g_string_replace (str, "${device_id}", device_id, 0);
+  g_string_replace (str, "$device_id", device_id, 0);
+
+  return g_string_free (g_steal_pointer (&str), FALSE);
+}
+
+/* Install the vendor’s instructions for getting an unlock code from
+ * @config_path, if it exists. It must be a JSON object whose values are all
+ * strings; that subset of JSON is also valid #GVariant text format, so it can
+ * be parsed without a JSON library. */
+static gboolean
+install_instructions (const gchar  *config_path,
+                      const gchar  *ini_path,
+                      const gchar  *backup_path,
+                      const gchar  *device_id,
+                      GError      **error)
+{
+  g_autofree gchar *config_json = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  if (!g_file_get_contents (config_path, &config_json, NULL, &local_error))
+    {
+      if (!g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+
+      g_printerr ("%s\n",
+                  _("WARNING: config.json not found on the USB device. The "
+                    "computer has been provisioned without custom instructions "
+                    "on how to obtain an unlock code."));
+      return TRUE;
+    }
+
+  g_autoptr(GVariant) config = g_variant_parse (G_VARIANT_TYPE ("a{ss}"),
+                                                config_json, NULL, NULL,
+                                                &local_error);
+  const gchar *line1 = NULL, *line2 = NULL;
+
+  if (config == NULL ||
+      !g_variant_lookup (config, "InstructionsLine1", "&s", &line1) ||
+      !g_variant_lookup (config, "InstructionsLine2", "&s", &line2))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   _("Invalid vendor configuration in ‘%s’: %s"), config_path,
+                   (local_error != NULL) ? local_error->message :
+                                           _("Missing instructions"));
+      return FALSE;
+    }
+
+  g_autofree gchar *line1_substituted = substitute_device_id (line1, device_id);
+  g_autoptr(GKeyFile) ini = g_key_file_new ();
+  g_key_file_set_string (ini, "Pay As You Go", "InstructionsLine1", line1_substituted);
+  g_key_file_set_string (ini, "Pay As You Go", "InstructionsLine2", line2);
+  g_autofree gchar *ini_data = g_key_file_to_data (ini, NULL, NULL);
+
+  return (backup_file (ini_path, backup_path, 0644, error) &&
+          install_file (ini_path, ini_data, 0644, error));
+}
+
+static gchar *
+build_efi_state_path (const gchar *efivars_dir,
+                      const gchar *name)
+{
+  g_autofree gchar *basename = g_strdup_printf ("EOSPAYG_%s-%s", name,
+                                                EOSPAYG_EFI_GUID);
+
+  return g_build_filename (efivars_dir, basename, NULL);
+}
+
+/* efivarfs marks some variables immutable; clear the flag so that @path can
+ * be deleted. This fails harmlessly if @path does not exist, or is not on
+ * efivarfs. */
+static void
+clear_immutable (const gchar *path)
+{
+  g_autofd int fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+  unsigned int flags;
+
+  if (fd < 0 || ioctl (fd, FS_IOC_GETFLAGS, &flags) < 0)
+    return;
+
+  flags &= ~FS_IMMUTABLE_FL;
+  ioctl (fd, FS_IOC_SETFLAGS, &flags);
+}
+
+/* Delete the EFI variable at @path, setting @out_existed to whether it
+ * existed. */
+static gboolean
+delete_efi_variable (const gchar  *path,
+                     gboolean     *out_existed,
+                     GError      **error)
+{
+  clear_immutable (path);
+
+  if (g_unlink (path) < 0)
+    {
+      int saved_errno = errno;
+
+      if (saved_errno == ENOENT)
+        {
+          *out_existed = FALSE;
+          return TRUE;
+        }
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error removing ‘%s’: %s"), path,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  *out_existed = TRUE;
+  return TRUE;
+}
+
+/* Forget any codes used with the previous key if the PAYG state is stored in
+ * EFI variables under @efivars_dir, by deleting both state variables and
+ * creating the first again with an empty state. If @opt_in is %TRUE, the
+ * empty state is created even if there was none, which makes eos-paygd store
+ * its state in EFI from then on.
+ *
+ * Unlike the other files, these are not under the sysroot: EFI variables
+ * belong to the firmware of the computer being provisioned. The whole empty
+ * state must be written in a single write(), as efivarfs requires. */
+static gboolean
+reset_efi_state (const gchar  *efivars_dir,
+                 gboolean      opt_in,
+                 GError      **error)
+{
+  g_autofree gchar *state_path = build_efi_state_path (efivars_dir, EFI_STATE_VARIABLE);
+  g_autofree gchar *state_b_path = build_efi_state_path (efivars_dir, EFI_STATE_VARIABLE_B);
+  gboolean state_existed, state_b_existed;
+
+  if (!g_file_test (efivars_dir, G_FILE_TEST_IS_DIR))
+    {
+      if (!opt_in)
+        return TRUE;
+
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   _("EFI variables are not available in ‘%s’."), efivars_dir);
+      return FALSE;
+    }
+
+  if (!delete_efi_variable (state_b_path, &state_b_existed, error) ||
+      !delete_efi_variable (state_path, &state_existed, error))
+    return FALSE;
+
+  if (!opt_in && !state_existed && !state_b_existed)
+    return TRUE;
+
+  g_autofd int fd = g_open (state_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+  if (fd < 0)
+    {
+      int saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   _("Error opening ‘%s’: %s"), state_path,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return (write_all (fd, (const gchar *) efi_state_empty,
+                     sizeof (efi_state_empty), state_path, error) &&
+          g_close (g_steal_fd (&fd), error));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) local_error = NULL;
+
+  /* Localisation */
+  setlocale (LC_ALL, "");
+  bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+  bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+  textdomain (GETTEXT_PACKAGE);
+
+  /* Handle command line parameters. */
+  g_autofree gchar *sysroot = NULL;
+  g_autofree gchar *backup_dir = NULL;
+  g_autofree gchar *efivars_dir = NULL;
+  gboolean efi_state = FALSE;
+  g_auto(GStrv) args = NULL;
+
+  const GOptionEntry entries[] =
+    {
+      { "sysroot", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &sysroot,
+        N_("Provision the system installed under DIR"), N_("DIR") },
+      { "backup-dir", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &backup_dir,
+        N_("Back up the previous key and instructions to DIR"), N_("DIR") },
+      { "efi-state", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &efi_state,
+        N_("Store the pay as you go state in EFI variables"), NULL },
+      { "efivars-dir", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &efivars_dir,
+        N_("Access EFI variables in DIR"), N_("DIR") },
+      { G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY,
+        &args, NULL, NULL },
+      { NULL, },
+    };
+
+  g_autoptr(GOptionContext) context = NULL;
+  context = g_option_context_new (_("OUTPUT-DIR"));
+  g_option_context_set_summary (context,
+                                _("Provision this computer for pay as you go, "
+                                  "recording its key and test codes in "
+                                  "OUTPUT-DIR"));
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 local_error->message);
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (args == NULL || args[0] == NULL || args[1] != NULL)
+    {
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Option parsing failed: %s"),
+                                 _("Exactly one OUTPUT-DIR is required"));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_INVALID_OPTIONS;
+    }
+
+  if (sysroot == NULL)
+    sysroot = g_strdup ("/");
+  if (backup_dir == NULL)
+    backup_dir = g_strdup (g_get_home_dir ());
+  if (efivars_dir == NULL)
+    efivars_dir = g_strdup (DEFAULT_EFIVARS_DIR);
+
+  g_autofree gchar *machine_id_path = g_build_filename (sysroot, "etc", "machine-id", NULL);
+  g_autofree gchar *key_path = g_build_filename (sysroot, PREFIX, "local", "share", "eos-payg", "key", NULL);
+  g_autofree gchar *account_id_path = g_build_filename (sysroot, PREFIX, "local", "share", "eos-payg", "account-id", NULL);
+  g_autofree gchar *used_codes_path = g_build_filename (sysroot, LOCALSTATEDIR, "lib", "eos-payg", "used-codes", NULL);
+  g_autofree gchar *ini_path = g_build_filename (sysroot, LOCALSTATEDIR, "lib", "eos-image-defaults",
+                                                 "vendor-customer-support.ini", NULL);
+  g_autofree gchar *key_backup_path = g_build_filename (backup_dir, "payg_backup_key", NULL);
+  g_autofree gchar *ini_backup_path = g_build_filename (backup_dir, "payg_backup_instructions", NULL);
+
+  /* Work everything out in memory before touching any files. */
+  g_autofree gchar *device_id = read_device_id (machine_id_path, &local_error);
+  g_autofree gchar *key = NULL;
+
+  if (device_id != NULL)
+    key = generate_key (&local_error);
+
+  if (key == NULL)
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+      return EXIT_FAILED;
+    }
+
+  g_autoptr(GBytes) key_bytes = g_bytes_new_static (key, strlen (key));
+  g_auto(GStrv) codes = g_new0 (gchar *, N_TEST_CODES + 1);
+
+  for (gsize i = 0; i < N_TEST_CODES; i++)
+    {
+      EpcCode code = epc_calculate_code (TEST_CODE_PERIOD, test_code_counters[i],
+                                         key_bytes, &local_error);
+
+      if (local_error != NULL)
+        {
+          g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+          return EXIT_FAILED;
+        }
+
+      codes[i] = epc_format_code (code);
+    }
+
+  /* Record the key on the USB stick before installing it, so that a failure
+   * can never leave a machine with a key which nobody knows. If installing
+   * fails afterwards, provisioning can be re-run: eos-payg-csv uses the last
+   * record for each device ID. */
+  g_autofree gchar *output_dir = g_build_filename (args[0], device_id, NULL);
+  g_autofree gchar *generated_key_path = g_build_filename (output_dir, "generated-key", NULL);
+  g_autofree gchar *csv_path = g_build_filename (output_dir, RECORDS_BASENAME ".csv", NULL);
+  g_autofree gchar *json_path = g_build_filename (output_dir, RECORDS_BASENAME ".json", NULL);
+  g_autofree gchar *config_path = g_build_filename (args[0], "config.json", NULL);
+
+  if (!install_file (generated_key_path, key, 0600, &local_error) ||
+      !append_csv_record (csv_path, device_id, codes, key, &local_error) ||
+      !append_json_record (json_path, device_id, codes, key, &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+      return EXIT_FAILED;
+    }
+
+  /* Install the key and account ID, and forget any codes used with the
+   * previous key. */
+  if (!backup_file (key_path, key_backup_path, 0600, &local_error) ||
+      !install_file (key_path, key, 0600, &local_error) ||
+      !install_file (account_id_path, device_id, 0644, &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+      return EXIT_FAILED;
+    }
+
+  if (g_unlink (used_codes_path) < 0 && errno != ENOENT)
+    {
+      int saved_errno = errno;
+      g_autofree gchar *message = NULL;
+      message = g_strdup_printf (_("Error removing ‘%s’: %s"), used_codes_path,
+                                 g_strerror (saved_errno));
+      g_printerr ("%s: %s\n", argv[0], message);
+
+      return EXIT_FAILED;
+    }
+
+  if (!reset_efi_state (efivars_dir, efi_state, &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+      return EXIT_FAILED;
+    }
+
+  if (!install_instructions (config_path, ini_path, ini_backup_path, device_id,
+                             &local_error))
+    {
+      g_printerr ("%s: %s\n", argv[0], local_error->message);
+
+      return EXIT_FAILED;
+    }
+
+  explicit_bzero (key, strlen (key));
+
+  g_print ("%s\n", device_id);
+
+  return EXIT_OK;
+}
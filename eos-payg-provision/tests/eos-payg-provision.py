@@ -0,0 +1,292 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+#
+# Copyright © 2026 Endless OS Foundation LLC
+#
+# This Source Code Form is subject to the terms of the Mozilla Public License,
+# v. 2.0. If a copy of the MPL was not distributed with this file, You can
+# obtain one at https://mozilla.org/MPL/2.0/.
+#
+# Alternatively, the contents of this file may be used under the terms of the
+# GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+# which case the provisions of the LGPL are applicable instead of those above.
+# If you wish to allow use of your version of this file only under the terms
+# of the LGPL, and not to allow others to use your version of this file under
+# the terms of the MPL, indicate your decision by deleting the provisions
+# above and replace them with the notice and other provisions required by the
+# LGPL. If you do not delete the provisions above, a recipient may use your
+# version of this file under the terms of either the MPL or the LGPL.
+
+"""Integration tests for the eos-payg-provision utility."""
+
+import csv
+import hashlib
+import hmac
+import json
+import os
+import shutil
+import struct
+import subprocess
+import tempfile
+import unittest
+
+import taptestrunner
+
+
+def calculate_code(key, period, counter):
+    """Calculate a code in the same way as libeos-payg-codes."""
+    digest = hmac.new(key.encode('utf-8'), struct.pack('BB', period, counter),
+                      hashlib.sha1).digest()
+    sign = ((digest[18] << 8) | digest[19]) & ((1 << 13) - 1)
+    return '{:08d}'.format((period << 21) | (counter << 13) | sign)
+
+
+class TestEosPaygProvision(unittest.TestCase):
+    """Integration test for running eos-payg-provision.
+
+    This can be run when installed or uninstalled. When uninstalled, it
+    requires G_TEST_BUILDDIR and G_TEST_SRCDIR to be set.
+
+    Each test provisions a fake system root in a temporary directory, with a
+    second temporary directory standing in for the USB stick.
+    """
+
+    machine_id = '0ce890737896474589e7f3dece38cd7b'
+    device_id = '0CE89073'
+
+    efi_guid = 'd89c3871-ae0c-4fc5-a409-dc717aee61e7'
+    efi_state_empty = b'\x07\x00\x00\x00\x01'
+
+    def setUp(self):
+        self.timeout_seconds = 10  # seconds per test
+        self.tmpdir = tempfile.mkdtemp()
+        os.chdir(self.tmpdir)
+        print('tmpdir:', self.tmpdir)
+        if 'G_TEST_BUILDDIR' in os.environ:
+            self.__eos_payg_provision = \
+                os.path.join(os.environ['G_TEST_BUILDDIR'], '..',
+                             'eos-payg-provision-1')
+        else:
+            self.__eos_payg_provision = os.path.join('/', 'usr', 'bin',
+                                                     'eos-payg-provision-1')
+        print('eos_payg_provision:', self.__eos_payg_provision)
+
+        self.sysroot = os.path.join(self.tmpdir, 'sysroot')
+        self.usb = os.path.join(self.tmpdir, 'usb')
+        self.backup = os.path.join(self.tmpdir, 'backup')
+        # Never touch the EFI variables of the computer running the tests.
+        self.efivars = os.path.join(self.tmpdir, 'efivars')
+        os.makedirs(os.path.join(self.sysroot, 'etc'))
+        os.makedirs(self.usb)
+        self.writeFile(os.path.join(self.sysroot, 'etc', 'machine-id'),
+                       self.machine_id + '\n')
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def writeFile(self, path, contents):
+        with open(path, 'w') as f:
+            f.write(contents)
+
+    def readFile(self, path):
+        with open(path, 'r') as f:
+            return f.read()
+
+    def findSysrootFile(self, name):
+        """Find @name in the sysroot; the exact path depends on the prefix
+        the utility was built with."""
+        for dirpath, _, filenames in os.walk(self.sysroot):
+            if name in filenames:
+                return os.path.join(dirpath, name)
+        return None
+
+    def runProvision(self, *args):
+        argv = [self.__eos_payg_provision,
+                '--sysroot', self.sysroot,
+                '--backup-dir', self.backup,
+                '--efivars-dir', self.efivars]
+        argv.extend(args)
+        print('Running:', argv)
+
+        env = os.environ.copy()
+        env['LC_ALL'] = 'C.UTF-8'
+        print('Environment:', env)
+
+        info = subprocess.run(argv, timeout=self.timeout_seconds,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.PIPE,
+                              env=env)
+        print('Output:', info.stdout.decode('utf-8'))
+        print('Errors:', info.stderr.decode('utf-8'))
+        return info
+
+    def efiStatePath(self, name):
+        return os.path.join(self.efivars,
+                            'EOSPAYG_{}-{}'.format(name, self.efi_guid))
+
+    def readRecords(self):
+        output_dir = os.path.join(self.usb, self.device_id)
+        with open(os.path.join(output_dir, 'payg-test-codes.csv'),
+                  newline='') as f:
+            csv_rows = list(csv.reader(f))
+        with open(os.path.join(output_dir, 'payg-test-codes.json')) as f:
+            json_records = json.load(f)
+        return (csv_rows, json_records)
+
+    def test_provision(self):
+        """Test provisioning a fresh system."""
+        info = self.runProvision(self.usb)
+        info.check_returncode()
+        self.assertEqual(info.stdout.decode('utf-8'), self.device_id + '\n')
+
+        key_path = self.findSysrootFile('key')
+        self.assertIsNotNone(key_path)
+        key = self.readFile(key_path)
+        self.assertEqual(len(key.replace('\n', '')), 768)
+        self.assertTrue(key.replace('\n', '').isalnum())
+        self.assertTrue(all(len(line) <= 70 for line in key.split('\n')))
+        self.assertEqual(self.readFile(os.path.join(self.usb, self.device_id,
+                                                    'generated-key')), key)
+
+        self.assertEqual(self.readFile(self.findSysrootFile('account-id')),
+                         self.device_id)
+
+        codes = [calculate_code(key, 3, counter)
+                 for counter in [250, 249, 248]]
+        csv_rows, json_records = self.readRecords()
+        self.assertEqual(csv_rows, [
+            ['device_id', 'code1', 'code2', 'code3', 'key'],
+            [self.device_id] + codes + [key],
+        ])
+        self.assertEqual(json_records, [{
+            'device_id': self.device_id,
+            'code1': codes[0],
+            'code2': codes[1],
+            'code3': codes[2],
+            'key': key,
+        }])
+
+    def test_reprovision(self):
+        """Test provisioning the same system twice: the records should be
+        appended to, the old key backed up and the used codes cleared."""
+        self.runProvision(self.usb).check_returncode()
+        key_path = self.findSysrootFile('key')
+        old_key = self.readFile(key_path)
+
+        # LOCALSTATEDIR is set when running uninstalled; installed builds use
+        # the standard /var.
+        localstatedir = os.environ.get('LOCALSTATEDIR', '/var')
+        used_codes_dir = os.path.join(self.sysroot,
+                                      localstatedir.lstrip('/'),
+                                      'lib', 'eos-payg')
+        os.makedirs(used_codes_dir, exist_ok=True)
+        used_codes_path = os.path.join(used_codes_dir, 'used-codes')
+        self.writeFile(used_codes_path, 'used')
+
+        self.runProvision(self.usb).check_returncode()
+        new_key = self.readFile(key_path)
+        self.assertNotEqual(old_key, new_key)
+        self.assertEqual(
+            self.readFile(os.path.join(self.backup, 'payg_backup_key')),
+            old_key)
+        self.assertIsNone(self.findSysrootFile('used-codes'))
+
+        csv_rows, json_records = self.readRecords()
+        self.assertEqual(len(csv_rows), 3)
+        self.assertEqual(csv_rows[0][0], 'device_id')
+        self.assertEqual([row[-1] for row in csv_rows[1:]], [old_key, new_key])
+        self.assertEqual([record['key'] for record in json_records],
+                         [old_key, new_key])
+
+    def test_efi_state_opt_in(self):
+        """Test opting in to storing the state in EFI variables."""
+        os.makedirs(self.efivars)
+        self.runProvision('--efi-state', self.usb).check_returncode()
+
+        with open(self.efiStatePath('state'), 'rb') as f:
+            self.assertEqual(f.read(), self.efi_state_empty)
+        self.assertFalse(os.path.exists(self.efiStatePath('state-b')))
+
+    def test_efi_state_reprovision(self):
+        """Test that reprovisioning a system storing its state in EFI
+        variables clears the used codes from both of them, without needing
+        --efi-state."""
+        os.makedirs(self.efivars)
+        self.writeFile(self.efiStatePath('state'), 'old state')
+        self.writeFile(self.efiStatePath('state-b'), 'older state')
+
+        self.runProvision(self.usb).check_returncode()
+
+        with open(self.efiStatePath('state'), 'rb') as f:
+            self.assertEqual(f.read(), self.efi_state_empty)
+        self.assertFalse(os.path.exists(self.efiStatePath('state-b')))
+
+    def test_efi_state_not_used(self):
+        """Test that no EFI variables are created without --efi-state, or
+        without EFI."""
+        os.makedirs(self.efivars)
+        self.runProvision(self.usb).check_returncode()
+        self.assertEqual(os.listdir(self.efivars), [])
+
+        shutil.rmtree(self.efivars)
+        self.runProvision(self.usb).check_returncode()
+        self.assertFalse(os.path.exists(self.efivars))
+
+    def test_efi_state_unavailable(self):
+        """Test error handling when opting in to storing the state in EFI
+        variables on a computer without them."""
+        info = self.runProvision('--efi-state', self.usb)
+        err = info.stderr.decode('utf-8').strip()
+        self.assertIn('EFI variables are not available', err)
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+
+    def test_instructions(self):
+        """Test installing vendor instructions from config.json."""
+        self.writeFile(os.path.join(self.usb, 'config.json'), '''{
+"InstructionsLine1": "Contact your vendor with the account number $device_id.",
+"InstructionsLine2": "You will then receive a keycode by SMS."
+}''')
+        info = self.runProvision(self.usb)
+        info.check_returncode()
+
+        ini = self.readFile(
+            self.findSysrootFile('vendor-customer-support.ini'))
+        self.assertIn('[Pay As You Go]\n', ini)
+        self.assertIn('InstructionsLine1=Contact your vendor with the '
+                      'account number 0CE89073.\n', ini)
+        self.assertIn('InstructionsLine2=You will then receive a keycode by '
+                      'SMS.\n', ini)
+
+    def test_missing_output_dir(self):
+        """Test error handling when passing no output directory."""
+        info = self.runProvision()
+        err = info.stderr.decode('utf-8').strip()
+        self.assertIn('Option parsing failed: Exactly one OUTPUT-DIR is '
+                      'required', err)
+        self.assertEqual(info.returncode, 1)  # EXIT_INVALID_OPTIONS
+
+    def test_invalid_machine_id(self):
+        """Test error handling when the machine ID is invalid. Nothing should
+        be written."""
+        self.writeFile(os.path.join(self.sysroot, 'etc', 'machine-id'),
+                       'short\n')
+        info = self.runProvision(self.usb)
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+        self.assertEqual(os.listdir(self.usb), [])
+        self.assertIsNone(self.findSysrootFile('key'))
+
+    def test_invalid_json_records(self):
+        """Test that a corrupt JSON file is not appended to, and the key is
+        not installed."""
+        os.makedirs(os.path.join(self.usb, self.device_id))
+        self.writeFile(os.path.join(self.usb, self.device_id,
+                                    'payg-test-codes.json'), 'not JSON')
+        info = self.runProvision(self.usb)
+        err = info.stderr.decode('utf-8').strip()
+        self.assertIn('does not contain a JSON array', err)
+        self.assertEqual(info.returncode, 2)  # EXIT_FAILED
+        self.assertIsNone(self.findSysrootFile('key'))
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=taptestrunner.TAPTestRunner())
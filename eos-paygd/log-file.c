@@ -0,0 +1,408 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log-file.h"
+
+#define LOGFILE_BASENAME "eos-paygd"
+#define LOGFILE_EXT "log"
+
+/* The log file is kept open, and written to from a background thread which
+ * flushes the buffered messages every %LOG_FLUSH_INTERVAL_SECONDS, or as soon
+ * as %LOG_BUFFER_FLUSH_SIZE bytes are pending. Warnings and errors wake the
+ * thread so they are written out straight away. If more than
+ * %LOG_BUFFER_MAX_SIZE bytes are pending, further messages are dropped until
+ * the next flush. The thread swaps the buffer out under the lock and writes it
+ * after releasing the lock, so logging never waits for the disk.
+ *
+ * Runs of identical messages are collapsed into one line, and non-warning
+ * messages are limited to a burst of %LOG_RATE_LIMIT_BURST followed by one per
+ * %LOG_RATE_LIMIT_INTERVAL_SECONDS, so that a client which repeatedly calls
+ * AddCode() (logging “Trying to enter code”) can’t fill the disk. This only
+ * applies to the log file; the journal does its own rate limiting. */
+#define LOG_FLUSH_INTERVAL_SECONDS 5
+#define LOG_BUFFER_FLUSH_SIZE (16 * 1024)
+#define LOG_BUFFER_MAX_SIZE (64 * 1024)
+#define LOG_RATE_LIMIT_BURST 20
+#define LOG_RATE_LIMIT_INTERVAL_SECONDS 10
+
+static struct
+{
+  GMutex lock;
+  GCond cond;
+  GThread *thread;  /* (owned) (nullable) */
+
+  /* Only used by the writer thread once it has started, so not protected by
+   * the lock. */
+  gchar *directory;  /* (owned) (nullable) */
+  int fd;  /* -1 if the log file could not be opened */
+  time_t rotate_time;  /* open a new log file at or after this time */
+
+  GString *buffer;  /* (owned) (nullable); NULL when not running */
+  gsize n_dropped;
+  gboolean flush_requested;
+  gboolean stopping;
+
+  /* The last message written, for detecting repeats. This is compared by
+   * message, domain and level rather than by formatted line, as the formatted
+   * line contains a timestamp. */
+  gchar *last_message;  /* (owned) (nullable) */
+  gchar *last_domain;  /* (owned) (nullable) */
+  GLogLevelFlags last_log_level;
+  gsize n_repeats;
+
+  gint64 rate_limit_tokens;
+  gint64 rate_limit_update_time_secs;
+  gsize n_rate_limited;
+} log_file = { .fd = -1, };
+
+/* Close the current log file, if any, and open the one for today. Log files
+ * are named with a date stamp so we get one file per day, e.g.
+ * eos-paygd-20220418.log, which makes it easy to rotate them with tmpfiles.
+ * Must only be called from the writer thread, or before it is started. */
+static void
+log_file_open (time_t now)
+{
+  g_autofree gchar *log_file_name = NULL;
+  g_autofree gchar *log_file_path = NULL;
+  g_autoptr(GDateTime) now_local = NULL;
+  g_autoptr(GDateTime) midnight = NULL;
+  g_autoptr(GDateTime) next_midnight = NULL;
+  g_autofree gchar *tstamp = NULL;
+
+  if (log_file.fd >= 0)
+    close (log_file.fd);
+
+  now_local = g_date_time_new_from_unix_local (now);
+  tstamp = g_date_time_format (now_local, "%Y%m%d");
+  log_file_name = g_strconcat (LOGFILE_BASENAME, "-", tstamp, ".", LOGFILE_EXT, NULL);
+  log_file_path = g_build_filename (log_file.directory, log_file_name, NULL);
+
+  /* We can't log an error here if this fails, as it would cause infinite
+   * recursion */
+  log_file.fd = open (log_file_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+  /* If the time can’t be worked out, try again in an hour. */
+  midnight = g_date_time_new_local (g_date_time_get_year (now_local),
+                                    g_date_time_get_month (now_local),
+                                    g_date_time_get_day_of_month (now_local),
+                                    0, 0, 0);
+  if (midnight != NULL)
+    next_midnight = g_date_time_add_days (midnight, 1);
+
+  if (next_midnight != NULL)
+    log_file.rotate_time = g_date_time_to_unix (next_midnight);
+  else
+    log_file.rotate_time = now + 60 * 60;
+}
+
+/* Write out @buffer, which has been swapped out of the shared state. Must only
+ * be called from the writer thread, without the lock held. */
+static void
+log_file_write (const GString *buffer)
+{
+  time_t now = time (NULL);
+  gsize offset = 0;
+
+  if (buffer->len == 0)
+    return;
+
+  /* Rotate if the date has changed (or the clock has gone backwards past the
+   * start of the current file’s day, which is close enough). */
+  if (log_file.fd < 0 || now >= log_file.rotate_time ||
+      now < log_file.rotate_time - 24 * 60 * 60 - 60 * 60)
+    log_file_open (now);
+
+  while (log_file.fd >= 0 && offset < buffer->len)
+    {
+      ssize_t bytes_written = write (log_file.fd, buffer->str + offset,
+                                     buffer->len - offset);
+      if (bytes_written < 0 && errno == EINTR)
+        continue;
+      else if (bytes_written <= 0)
+        break;
+
+      offset += bytes_written;
+    }
+}
+
+/* Append @line and a newline to the buffer, or drop it if the buffer is full.
+ * Must be called with the lock held. */
+static void
+log_file_append_locked (const gchar *line)
+{
+  if (log_file.buffer->len >= LOG_BUFFER_MAX_SIZE)
+    {
+      log_file.n_dropped++;
+      return;
+    }
+
+  if (log_file.n_dropped > 0)
+    {
+      g_string_append_printf (log_file.buffer,
+                              "eos-paygd: %" G_GSIZE_FORMAT " messages dropped "
+                              "while the log buffer was full\n",
+                              log_file.n_dropped);
+      log_file.n_dropped = 0;
+    }
+
+  g_string_append (log_file.buffer, line);
+  g_string_append_c (log_file.buffer, '\n');
+
+  if (log_file.buffer->len >= LOG_BUFFER_FLUSH_SIZE)
+    g_cond_signal (&log_file.cond);
+}
+
+/* Note any messages skipped as repeats or due to rate limiting, before the
+ * next message is logged. Must be called with the lock held. */
+static void
+log_file_append_skipped_locked (void)
+{
+  g_autofree gchar *line = NULL;
+
+  if (log_file.n_repeats > 0)
+    {
+      line = g_strdup_printf ("eos-paygd: Previous message repeated %" G_GSIZE_FORMAT " times",
+                              log_file.n_repeats);
+      log_file.n_repeats = 0;
+      log_file_append_locked (line);
+      g_clear_pointer (&line, g_free);
+    }
+
+  if (log_file.n_rate_limited > 0)
+    {
+      line = g_strdup_printf ("eos-paygd: %" G_GSIZE_FORMAT " messages suppressed "
+                              "by rate limiting",
+                              log_file.n_rate_limited);
+      log_file.n_rate_limited = 0;
+      log_file_append_locked (line);
+    }
+}
+
+/* Take a rate limiting token for a message, returning %FALSE if there are
+ * none left. Must be called with the lock held. */
+static gboolean
+log_file_take_token_locked (void)
+{
+  gint64 now_secs = g_get_monotonic_time () / G_USEC_PER_SEC;
+  gint64 elapsed_secs = now_secs - log_file.rate_limit_update_time_secs;
+
+  if (elapsed_secs >= LOG_RATE_LIMIT_INTERVAL_SECONDS)
+    {
+      gint64 new_tokens = elapsed_secs / LOG_RATE_LIMIT_INTERVAL_SECONDS;
+
+      log_file.rate_limit_tokens = MIN (log_file.rate_limit_tokens + new_tokens,
+                                        LOG_RATE_LIMIT_BURST);
+      log_file.rate_limit_update_time_secs += new_tokens * LOG_RATE_LIMIT_INTERVAL_SECONDS;
+    }
+
+  if (log_file.rate_limit_tokens == 0)
+    return FALSE;
+
+  log_file.rate_limit_tokens--;
+  return TRUE;
+}
+
+static gpointer
+log_file_thread (gpointer user_data)
+{
+  g_autoptr(GString) pending = g_string_sized_new (LOG_BUFFER_FLUSH_SIZE);
+  gboolean stopping = FALSE;
+
+  g_mutex_lock (&log_file.lock);
+
+  while (!stopping)
+    {
+      gint64 end_time = g_get_monotonic_time () + LOG_FLUSH_INTERVAL_SECONDS * G_TIME_SPAN_SECOND;
+      GString *full;
+
+      /* Wake up early if the buffer is getting full, a warning has been
+       * logged, or we’ve been asked to stop. */
+      while (!log_file.stopping && !log_file.flush_requested &&
+             log_file.buffer->len < LOG_BUFFER_FLUSH_SIZE)
+        {
+          if (!g_cond_wait_until (&log_file.cond, &log_file.lock, end_time))
+            break;
+        }
+
+      stopping = log_file.stopping;
+      if (stopping)
+        log_file_append_skipped_locked ();
+      log_file.flush_requested = FALSE;
+
+      /* Swap in the empty buffer so messages can carry on being logged while
+       * the full one is written out. Once stopping, later messages only go to
+       * the journal. */
+      full = log_file.buffer;
+      log_file.buffer = stopping ? NULL : g_steal_pointer (&pending);
+      pending = full;
+
+      g_mutex_unlock (&log_file.lock);
+      log_file_write (pending);
+      g_string_truncate (pending, 0);
+      g_mutex_lock (&log_file.lock);
+    }
+
+  g_mutex_unlock (&log_file.lock);
+
+  if (log_file.fd >= 0)
+    {
+      close (log_file.fd);
+      log_file.fd = -1;
+    }
+
+  return NULL;
+}
+
+/* Start the background thread which writes to a log file in @directory.
+ * Install epg_log_file_writer() as the log writer function afterwards. */
+void
+epg_log_file_start (const gchar *directory)
+{
+  g_return_if_fail (directory != NULL);
+  g_return_if_fail (log_file.thread == NULL);
+
+  g_mutex_lock (&log_file.lock);
+  log_file.directory = g_strdup (directory);
+  log_file.buffer = g_string_sized_new (LOG_BUFFER_FLUSH_SIZE);
+  log_file.rate_limit_tokens = LOG_RATE_LIMIT_BURST;
+  log_file.rate_limit_update_time_secs = g_get_monotonic_time () / G_USEC_PER_SEC;
+  log_file_open (time (NULL));
+  g_mutex_unlock (&log_file.lock);
+
+  log_file.thread = g_thread_new ("log-writer", log_file_thread, NULL);
+}
+
+/* Write out any buffered messages, then stop and join the background thread,
+ * for example before exiting. Later messages only go to the default writer. */
+void
+epg_log_file_stop (void)
+{
+  GThread *thread;
+
+  g_mutex_lock (&log_file.lock);
+  log_file.stopping = TRUE;
+  g_cond_signal (&log_file.cond);
+  thread = g_steal_pointer (&log_file.thread);
+  g_mutex_unlock (&log_file.lock);
+
+  if (thread != NULL)
+    g_thread_join (thread);
+
+  g_mutex_lock (&log_file.lock);
+  log_file.stopping = FALSE;
+  log_file.n_dropped = 0;
+  log_file.n_repeats = 0;
+  log_file.n_rate_limited = 0;
+  g_clear_pointer (&log_file.last_message, g_free);
+  g_clear_pointer (&log_file.last_domain, g_free);
+  g_clear_pointer (&log_file.directory, g_free);
+  g_mutex_unlock (&log_file.lock);
+}
+
+/* Return a copy of the string value of @field. */
+static gchar *
+log_field_dup_string (const GLogField *field)
+{
+  if (field->length < 0)
+    return g_strdup (field->value);
+  else
+    return g_strndup (field->value, field->length);
+}
+
+/* Custom log writer function that saves messages to a separate file before
+ * forwarding them to the default writer function.
+ */
+GLogWriterOutput
+epg_log_file_writer (GLogLevelFlags   log_level,
+                     const GLogField *fields,
+                     gsize            n_fields,
+                     gpointer         user_data)
+{
+  g_autofree gchar *out = NULL;
+  g_autofree gchar *message = NULL;
+  g_autofree gchar *domain = NULL;
+  GLogLevelFlags level = log_level & G_LOG_LEVEL_MASK;
+  gboolean is_warning;
+
+  g_return_val_if_fail (fields != NULL, G_LOG_WRITER_UNHANDLED);
+  g_return_val_if_fail (n_fields > 0, G_LOG_WRITER_UNHANDLED);
+
+  if (g_log_writer_default_would_drop (log_level, NULL))
+    return G_LOG_WRITER_HANDLED;
+
+  for (gsize i = 0; i < n_fields; i++)
+    {
+      if (message == NULL && g_str_equal (fields[i].key, "MESSAGE"))
+        message = log_field_dup_string (&fields[i]);
+      else if (domain == NULL && g_str_equal (fields[i].key, "GLIB_DOMAIN"))
+        domain = log_field_dup_string (&fields[i]);
+    }
+
+  out = g_log_writer_format_fields (log_level, fields, n_fields, FALSE);
+  is_warning = (log_level & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING)) != 0;
+
+  g_mutex_lock (&log_file.lock);
+
+  if (log_file.buffer == NULL)
+    {
+      /* Not started, or already stopped. */
+    }
+  else if (message != NULL && level == log_file.last_log_level &&
+           g_strcmp0 (message, log_file.last_message) == 0 &&
+           g_strcmp0 (domain, log_file.last_domain) == 0)
+    {
+      log_file.n_repeats++;
+    }
+  else if (is_warning || log_file_take_token_locked ())
+    {
+      log_file_append_skipped_locked ();
+      log_file_append_locked (out);
+
+      g_free (log_file.last_message);
+      log_file.last_message = g_steal_pointer (&message);
+      g_free (log_file.last_domain);
+      log_file.last_domain = g_steal_pointer (&domain);
+      log_file.last_log_level = level;
+    }
+  else
+    {
+      log_file.n_rate_limited++;
+    }
+
+  /* Don’t risk losing warnings if we crash or are about to power off: wake
+   * the writer thread rather than writing to the disk from this thread. */
+  if (is_warning && log_file.buffer != NULL)
+    {
+      log_file.flush_requested = TRUE;
+      g_cond_signal (&log_file.cond);
+    }
+
+  g_mutex_unlock (&log_file.lock);
+
+  /* now pass the message to the the default writer function as well */
+  return g_log_writer_default (log_level, fields, n_fields, user_data);
+}
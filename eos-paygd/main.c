@@ -33,79 +33,196 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <time.h>
 #include <libeos-payg/efi.h>
+#include <libeos-payg/loop-monitor.h>
+#include <libeos-payg/stats.h>
+
+#include "log-file.h"
+#include "static-providers.h"
 
 #define LOGFILE_DIRNAME "/var/log/eos-payg"
-#define LOGFILE_BASENAME "eos-paygd"
-#define LOGFILE_EXT "log"
 
 #define TIMEOUT_POWEROFF_ON_ERROR_MINUTES 20
 
-static GIOChannel *
-open_log_file (void)
+/* Phases of startup before the root pivot, which directly delay booting.
+ * Each is timed with the monotonic clock and reported when signalling
+ * READY=1. The securitylevel and hwclock_init phases run in threads alongside
+ * secure_init_sync, so durations may overlap. */
+typedef enum
 {
-  g_autofree gchar *log_file_name = NULL;
-  g_autofree gchar *log_file_path = NULL;
-  g_autoptr(GDateTime) now = NULL;
-  g_autofree gchar *tstamp = NULL;
+  STARTUP_PHASE_EFI_INIT = 0,
+  STARTUP_PHASE_BOOT_CHECKS,
+  STARTUP_PHASE_SECURITYLEVEL,
+  STARTUP_PHASE_HWCLOCK_INIT,
+  STARTUP_PHASE_SECURE_INIT,
+  STARTUP_PHASE_WATCHDOG_LSM,
+} StartupPhase;
 
-  /* Build log file name with a date stamp so we get one file per day,
-   * ex., eos-paygd-20220418.log
-   */
-  now = g_date_time_new_now_local ();
-  tstamp = g_date_time_format (now, "%Y%m%d");
-  log_file_name = g_strconcat (LOGFILE_BASENAME, "-", tstamp, ".", LOGFILE_EXT, NULL);
-  log_file_path = g_build_filename (LOGFILE_DIRNAME, log_file_name, NULL);
-
-  /* We can't log an error here if this fails, as it would cause infinite
-   * recursion */
-  return g_io_channel_new_file (log_file_path, "a", NULL);
+#define N_STARTUP_PHASES (STARTUP_PHASE_WATCHDOG_LSM + 1)
+
+static const struct
+{
+  const gchar *name;
+  const gchar *field;  /* structured logging field for the duration */
+} startup_phase_info[N_STARTUP_PHASES] =
+{
+  { "efi_init", "EOS_PAYG_EFI_INIT_USEC" },
+  { "boot_checks", "EOS_PAYG_BOOT_CHECKS_USEC" },
+  { "securitylevel", "EOS_PAYG_SECURITYLEVEL_USEC" },
+  { "hwclock_init", "EOS_PAYG_HWCLOCK_INIT_USEC" },
+  { "secure_init_sync", "EOS_PAYG_SECURE_INIT_SYNC_USEC" },
+  { "watchdog_lsm", "EOS_PAYG_WATCHDOG_LSM_USEC" },
+};
+
+static struct
+{
+  gint64 start_time;  /* monotonic time when main() was entered */
+  gint64 boottime_at_start;  /* CLOCK_BOOTTIME when main() was entered */
+  gint64 phase_start[N_STARTUP_PHASES];  /* 0 if the phase didn’t run */
+  gint64 phase_end[N_STARTUP_PHASES];
+} startup_profile;
+
+static gboolean profile_startup = FALSE;
+
+static void
+startup_phase_begin (StartupPhase phase)
+{
+  startup_profile.phase_start[phase] = g_get_monotonic_time ();
 }
 
-/* Custom log writer function that saves messages to a separate file before
- * forwarding them to the default writer function.
- */
-static GLogWriterOutput
-log_writer (GLogLevelFlags log_level,
-            const GLogField* fields,
-            gsize n_fields,
-            gpointer user_data)
+static void
+startup_phase_end (StartupPhase phase)
 {
-  GIOChannel *log_io = NULL;
+  g_assert (startup_profile.phase_start[phase] != 0);
+  startup_profile.phase_end[phase] = g_get_monotonic_time ();
+
+  if (profile_startup)
+    g_message ("Startup phase %s: started at +%" G_GINT64_FORMAT " µs, "
+               "took %" G_GINT64_FORMAT " µs",
+               startup_phase_info[phase].name,
+               startup_profile.phase_start[phase] - startup_profile.start_time,
+               startup_profile.phase_end[phase] - startup_profile.phase_start[phase]);
+}
 
-  g_return_val_if_fail (fields != NULL, G_LOG_WRITER_UNHANDLED);
-  g_return_val_if_fail (n_fields > 0, G_LOG_WRITER_UNHANDLED);
+static gint64
+startup_phase_get_duration (StartupPhase phase)
+{
+  if (startup_profile.phase_start[phase] == 0)
+    return 0;
 
-  if (g_log_writer_default_would_drop (log_level, NULL))
-    return G_LOG_WRITER_HANDLED;
+  return startup_profile.phase_end[phase] - startup_profile.phase_start[phase];
+}
 
-  /* Always re-construct the log file name and re-open the file it for every
-   * log message. Since the log file name contains a date stamp, this will
-   * split logs in per-day files, making it easy to rotate logs with tmpfiles.
-   */
-  log_io = open_log_file ();
-  if (log_io)
+/* Format a short human-readable summary of the startup phases, suitable for
+ * `STATUS=`. */
+static gchar *
+startup_profile_format (void)
+{
+  g_autoptr(GString) summary = g_string_new ("Startup took ");
+  gint64 total = g_get_monotonic_time () - startup_profile.start_time;
+
+  g_string_append_printf (summary, "%" G_GINT64_FORMAT " ms:", total / 1000);
+
+  for (gsize i = 0; i < N_STARTUP_PHASES; i++)
+    {
+      if (startup_profile.phase_start[i] == 0)
+        continue;
+
+      g_string_append_printf (summary, " %s=%" G_GINT64_FORMAT "ms",
+                              startup_phase_info[i].name,
+                              startup_phase_get_duration (i) / 1000);
+    }
+
+  return g_string_free (g_steal_pointer (&summary), FALSE);
+}
+
+/* Log a summary of the startup phases as a single structured message, with
+ * the duration of each phase in its own field so they can be aggregated
+ * across hardware models. */
+static void
+startup_profile_log (const gchar *summary)
+{
+  gchar *duration_values[N_STARTUP_PHASES] = { NULL, };
+  g_autofree gchar *total_value = NULL;
+  g_autofree gchar *boottime_value = NULL;
+  GLogField fields[N_STARTUP_PHASES + 4];
+  gsize n_fields = 0;
+
+  fields[n_fields++] = (GLogField) { "PRIORITY", "5", -1 };
+  fields[n_fields++] = (GLogField) { "MESSAGE", summary, -1 };
+
+  total_value = g_strdup_printf ("%" G_GINT64_FORMAT,
+                                 g_get_monotonic_time () - startup_profile.start_time);
+  fields[n_fields++] = (GLogField) { "EOS_PAYG_STARTUP_USEC", total_value, -1 };
+
+  /* How long after the kernel started that eos-paygd did. */
+  boottime_value = g_strdup_printf ("%" G_GINT64_FORMAT, startup_profile.boottime_at_start);
+  fields[n_fields++] = (GLogField) { "EOS_PAYG_STARTUP_BOOTTIME_USEC", boottime_value, -1 };
+
+  for (gsize i = 0; i < N_STARTUP_PHASES; i++)
     {
-      g_autofree gchar *out = NULL;
-      out = g_log_writer_format_fields (log_level, fields, n_fields, FALSE);
-      g_io_channel_write_chars (log_io, out, -1, NULL, NULL);
-      g_io_channel_write_chars (log_io, "\n", 1, NULL, NULL);
-      g_io_channel_unref (log_io); /* flush + close + free */
+      if (startup_profile.phase_start[i] == 0)
+        continue;
+
+      duration_values[i] = g_strdup_printf ("%" G_GINT64_FORMAT,
+                                            startup_phase_get_duration (i));
+      fields[n_fields++] = (GLogField) { startup_phase_info[i].field, duration_values[i], -1 };
+
+      /* Also export it on the com.endlessm.Payg1.Statistics interface. */
+      epg_stats_set_startup_phase (startup_phase_info[i].name,
+                                   startup_phase_get_duration (i));
     }
 
-  /* now pass the message to the the default writer function as well */
-  return g_log_writer_default (log_level, fields, n_fields, user_data);
+  g_log_structured_array (G_LOG_LEVEL_MESSAGE, fields, n_fields);
+
+  for (gsize i = 0; i < N_STARTUP_PHASES; i++)
+    g_free (duration_values[i]);
 }
 
 static int watchdog_fd = -1;
 
-/* Ping the watchdog periodically as long as eos-paygd is running. */
+/* The watchdog is fed from its own thread, so that a slow synchronous
+ * operation on the main loop (an EFI write, a provider plugin call, file I/O)
+ * can’t delay a ping long enough to cause a shutdown. To preserve the
+ * guarantee that PAYG is enforced only while eos-paygd is working, the thread
+ * only feeds the watchdog while the main loop has updated a heartbeat within
+ * %HEARTBEAT_MAX_AGE_SECONDS, which is a couple of ping intervals so that a
+ * slow operation is tolerated but a hang is not. The last ping therefore
+ * happens at most 2 minutes after the main loop wedges, and the 19 minute
+ * watchdog timeout then expires, so in the worst case a wedged main loop goes
+ * unnoticed for 21 minutes (compared to 20 minutes when the main loop fed the
+ * watchdog directly). */
+#define WATCHDOG_PING_INTERVAL_SECONDS 60
+#define HEARTBEAT_INTERVAL_SECONDS 30
+#define HEARTBEAT_MAX_AGE_SECONDS (2 * 60)
+
+/* Monotonic time (in seconds) of the last main loop heartbeat. Only accessed
+ * atomically. */
+static gint heartbeat_secs = 0;
+
+static gint
+get_monotonic_secs (void)
+{
+  return (gint) (g_get_monotonic_time () / G_USEC_PER_SEC);
+}
+
+/* Record that the main loop is making progress. */
 static gboolean
-ping_watchdog (gpointer user_data)
+heartbeat_cb (gpointer user_data)
+{
+  g_atomic_int_set (&heartbeat_secs, get_monotonic_secs ());
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Write a byte to the watchdog device. */
+static void
+ping_watchdog (void)
 {
   g_assert (watchdog_fd >= 0);
 
-  /* Write a byte to the watchdog device. We need the loop to deal with EINTR */
+  /* We need the loop to deal with EINTR */
   while (TRUE)
     {
       int bytes_written = write (watchdog_fd, "\0", 1);
@@ -123,8 +240,37 @@ ping_watchdog (gpointer user_data)
 
       break;
     }
+}
 
-  return G_SOURCE_CONTINUE;
+/* Ping the watchdog periodically as long as the main loop is running. */
+static gpointer
+watchdog_thread (gpointer user_data)
+{
+  gboolean stalled = FALSE;
+
+  while (watchdog_fd >= 0)
+    {
+      gint heartbeat_age_secs = get_monotonic_secs () - g_atomic_int_get (&heartbeat_secs);
+
+      if (heartbeat_age_secs <= HEARTBEAT_MAX_AGE_SECONDS)
+        {
+          if (stalled)
+            g_message ("Main loop has recovered; feeding watchdog again");
+          stalled = FALSE;
+
+          ping_watchdog ();
+        }
+      else if (!stalled)
+        {
+          g_warning ("Main loop has not made progress for %d seconds; "
+                     "no longer feeding watchdog", heartbeat_age_secs);
+          stalled = TRUE;
+        }
+
+      g_usleep (WATCHDOG_PING_INTERVAL_SECONDS * G_USEC_PER_SEC);
+    }
+
+  return NULL;
 }
 
 static void
@@ -275,13 +421,51 @@ test_and_update_securitylevel (void)
   return TRUE;
 }
 
+static gpointer
+update_securitylevel_thread (gpointer user_data)
+{
+  gboolean ret;
+
+  startup_phase_begin (STARTUP_PHASE_SECURITYLEVEL);
+  ret = test_and_update_securitylevel ();
+  startup_phase_end (STARTUP_PHASE_SECURITYLEVEL);
+
+  return GINT_TO_POINTER (ret);
+}
+
+static gpointer
+hwclock_init_thread (gpointer user_data)
+{
+  gboolean ret;
+
+  startup_phase_begin (STARTUP_PHASE_HWCLOCK_INIT);
+  ret = payg_hwclock_init ();
+  startup_phase_end (STARTUP_PHASE_HWCLOCK_INIT);
+
+  return GINT_TO_POINTER (ret);
+}
+
+/* How often to log the dispatch latency histograms if --stall-threshold is
+ * given. */
+#define LOOP_MONITOR_LOG_INTERVAL_SECONDS (60 * 60)
+
+static gboolean
+log_loop_monitor_cb (gpointer user_data)
+{
+  epg_loop_monitor_log_histograms ();
+  return G_SOURCE_CONTINUE;
+}
+
 static gboolean print_level = FALSE;
 static gboolean skip_sb_check = FALSE;
+static gint stall_threshold_ms = 0;
 
 static GOptionEntry opts[] =
 {
   { "seclevel", 's', 0, G_OPTION_ARG_NONE, &print_level, "Print security level and exit", NULL },
   { "skip-sb-check", 0, 0, G_OPTION_ARG_NONE, &skip_sb_check, "Enforce PAYG even if Secure Boot is off", NULL },
+  { "profile-startup", 0, 0, G_OPTION_ARG_NONE, &profile_startup, "Log the duration of each startup phase as it completes", NULL },
+  { "stall-threshold", 0, 0, G_OPTION_ARG_INT, &stall_threshold_ms, "Warn about main loop dispatches taking longer than MS, and log latency histograms", "MS" },
   { NULL }
 };
 
@@ -294,12 +478,21 @@ main (int   argc,
   g_autoptr(GFile) state_dir = NULL;
   int ret = EXIT_SUCCESS, sd_notify_ret, system_ret, exit_signal = 0;
   int lsm_fd;
-  guint timeout_id = 0, watchdog_id = 0;
+  guint timeout_id = 0, heartbeat_id = 0;
   const gchar *sd_socket_env = NULL;
   g_autofree char *sd_socket_dir = NULL;
   g_autofree char *sd_socket_name = NULL;
+  g_autofree char *sd_notify_state = NULL;
+  g_autofree gchar *startup_summary = NULL;
   GOptionContext *context;
   gboolean enforcing_mode = TRUE;
+  struct timespec boottime;
+  GThread *securitylevel_thread = NULL, *hwclock_thread = NULL;
+
+  startup_profile.start_time = g_get_monotonic_time ();
+  epg_stats_set_start_time (startup_profile.start_time);
+  if (clock_gettime (CLOCK_BOOTTIME, &boottime) == 0)
+    startup_profile.boottime_at_start = boottime.tv_sec * G_USEC_PER_SEC + boottime.tv_nsec / 1000;
 
   context = g_option_context_new ("- Pay As You Go enforcement daemon");
   g_option_context_add_main_entries (context, opts, GETTEXT_PACKAGE);
@@ -330,6 +523,7 @@ main (int   argc,
 
       g_debug ("eos-paygd running from initramfs");
 
+      startup_phase_begin (STARTUP_PHASE_EFI_INIT);
       if (!eospayg_efi_init (0, &error))
         {
           g_warning ("Unable to access EFI variables, shutting down in %d minutes: %s",
@@ -339,7 +533,9 @@ main (int   argc,
                                  payg_system_poweroff, NULL);
           g_clear_error (&error);
         }
+      startup_phase_end (STARTUP_PHASE_EFI_INIT);
 
+      startup_phase_begin (STARTUP_PHASE_BOOT_CHECKS);
       payg_set_debug_env_vars ();
 
       /* Don't enforce PAYG if the current boot is not secure. This likely
@@ -362,29 +558,20 @@ main (int   argc,
           g_debug ("EOSPAYG_active is not set; not enforcing PAYG");
           enforcing_mode = FALSE;
         }
+      startup_phase_end (STARTUP_PHASE_BOOT_CHECKS);
 
-      /* If we fail the securitylevel test we still want to complete
-       * booting and have a chance at doing a system update to recover
-       * from our currently broken state, but the shutdown is
-       * inevitable.
-       */
-      if (enforcing_mode && payg_should_check_securitylevel () &&
-          !test_and_update_securitylevel ())
-        {
-          g_warning ("Security level regressed, shutting down in %d minutes",
-                     TIMEOUT_POWEROFF_ON_ERROR_MINUTES);
-          g_timeout_add_seconds (TIMEOUT_POWEROFF_ON_ERROR_MINUTES * 60,
-                                 payg_system_poweroff, NULL);
-        }
+      /* The security level update and RTC validation only depend on the
+       * checks above, and are independent of each other and of loading the
+       * providers in epg_service_secure_init_sync(), so run them in threads
+       * while the providers are loaded, and only wait for them before
+       * signalling READY=1. Each one only reads and writes its own state. */
+      if (enforcing_mode && payg_should_check_securitylevel ())
+        securitylevel_thread = g_thread_new ("securitylevel",
+                                             update_securitylevel_thread, NULL);
 
       /* Setup RTC updater before the root pivot */
-      if (enforcing_mode && !payg_hwclock_init ())
-        {
-          g_warning ("RTC failure, shutting down in %d minutes",
-                     TIMEOUT_POWEROFF_ON_ERROR_MINUTES);
-          g_timeout_add_seconds (TIMEOUT_POWEROFF_ON_ERROR_MINUTES * 60,
-                                 payg_system_poweroff, NULL);
-        }
+      if (enforcing_mode)
+        hwclock_thread = g_thread_new ("hwclock", hwclock_init_thread, NULL);
     }
   else
     {
@@ -405,21 +592,55 @@ main (int   argc,
 
   /* Do some partial initialization before the root pivot. See
    * https://phabricator.endlessm.com/T27054 */
+  startup_phase_begin (STARTUP_PHASE_SECURE_INIT);
+  epg_register_static_providers ();
   service = epg_service_new ();
   epg_service_secure_init_sync (service, NULL);
+  startup_phase_end (STARTUP_PHASE_SECURE_INIT);
+
+  /* If we fail the securitylevel test we still want to complete
+   * booting and have a chance at doing a system update to recover
+   * from our currently broken state, but the shutdown is
+   * inevitable.
+   */
+  if (securitylevel_thread != NULL &&
+      !GPOINTER_TO_INT (g_thread_join (g_steal_pointer (&securitylevel_thread))))
+    {
+      g_warning ("Security level regressed, shutting down in %d minutes",
+                 TIMEOUT_POWEROFF_ON_ERROR_MINUTES);
+      g_timeout_add_seconds (TIMEOUT_POWEROFF_ON_ERROR_MINUTES * 60,
+                             payg_system_poweroff, NULL);
+    }
+
+  if (hwclock_thread != NULL &&
+      !GPOINTER_TO_INT (g_thread_join (g_steal_pointer (&hwclock_thread))))
+    {
+      g_warning ("RTC failure, shutting down in %d minutes",
+                 TIMEOUT_POWEROFF_ON_ERROR_MINUTES);
+      g_timeout_add_seconds (TIMEOUT_POWEROFF_ON_ERROR_MINUTES * 60,
+                             payg_system_poweroff, NULL);
+    }
 
   g_debug ("epg_service_secure_init_sync() completed");
 
+  if (payg_get_legacy_mode ())
+    {
+      startup_summary = startup_profile_format ();
+      startup_profile_log (startup_summary);
+    }
+
   if (!payg_get_legacy_mode ())
     {
+      startup_phase_begin (STARTUP_PHASE_WATCHDOG_LSM);
+
       if (enforcing_mode && payg_should_use_watchdog ())
         {
           /* Open and start pinging the custom watchdog timer ("endlessdog") which
            * will ask for a shut down after not being pinged for 19 minutes, and
            * force a shutdown after 20 minutes. This means that if eos-paygd is
-           * somehow killed or crashes, PAYG will not go unenforced. Ping it every
-           * 60 seconds so we have a margin of error in case another high priority
-           * task is happening on the main loop. And use O_CLOEXEC in case it's
+           * somehow killed, crashes or hangs, PAYG will not go unenforced. Ping
+           * it every 60 seconds from watchdog_thread(), as long as the main
+           * loop is alive. And use O_CLOEXEC in case it's
            * somehow possible to execve() this process after the root pivot. We
            * ping the watchdog even if PAYG is not active (e.g. it's not yet
            * provisioned or has been paid off) to prevent any other process from
@@ -432,8 +653,12 @@ main (int   argc,
               g_warning ("eos-paygd could not open /dev/watchdog: %m");
               return EXIT_FAILURE;
             }
-          watchdog_id = g_timeout_add_seconds_full (G_PRIORITY_HIGH, 60, ping_watchdog, NULL, NULL);
-          g_assert (watchdog_id > 0);
+          heartbeat_cb (NULL);
+          heartbeat_id = g_timeout_add_seconds_full (G_PRIORITY_HIGH, HEARTBEAT_INTERVAL_SECONDS,
+                                                     heartbeat_cb, NULL, NULL);
+          g_assert (heartbeat_id > 0);
+          g_source_set_name_by_id (heartbeat_id, "eos-paygd heartbeat");
+          g_thread_unref (g_thread_new ("watchdog", watchdog_thread, NULL));
         }
 
       if (enforcing_mode && payg_should_use_lsm ())
@@ -458,6 +683,8 @@ main (int   argc,
             }
         }
 
+      startup_phase_end (STARTUP_PHASE_WATCHDOG_LSM);
+
       /* Here be dragons:
        * We're currently in the initramfs root directory, and systemd is putting
        * all the useful bits of the system into /sysroot in preparation for the
@@ -496,7 +723,13 @@ main (int   argc,
       if (chroot ("/sysroot"))
         g_warning ("Unable to switch root to run-time root directory (/sysroot): %m");
 
-      sd_notify_ret = payg_relative_sd_notify (sd_socket_name, "READY=1");
+      /* Report how long each phase took along with READY=1, since the root
+       * pivot is waiting on us. */
+      startup_summary = startup_profile_format ();
+      sd_notify_state = g_strdup_printf ("READY=1\nSTATUS=%s", startup_summary);
+      startup_profile_log (startup_summary);
+
+      sd_notify_ret = payg_relative_sd_notify (sd_socket_name, sd_notify_state);
       if (sd_notify_ret < 0)
         {
           g_warning ("payg_relative_sd_notify() failed with code %d", -sd_notify_ret);
@@ -520,10 +753,10 @@ main (int   argc,
               g_debug ("Error connecting to system bus, will retry: %s", error->message);
               g_clear_error (&error);
 
-              /* Keep pinging the watchdog if we have it, but don't block in
-               * case we don't have it. We also need to iterate the main
-               * context for payg_system_poweroff() to have a chance to be
-               * triggered.
+              /* Keep the main loop heartbeat going so the watchdog is fed if
+               * we have it, but don't block in case we don't have it. We also
+               * need to iterate the main context for payg_system_poweroff()
+               * to have a chance to be triggered.
                */
               g_main_context_iteration (NULL, FALSE);
 
@@ -571,7 +804,8 @@ main (int   argc,
        * addition to the journal, so we have persistent logs even on systems
        * with fragile storage.
        */
-      g_log_set_writer_func (log_writer, NULL, NULL);
+      epg_log_file_start (LOGFILE_DIRNAME);
+      g_log_set_writer_func (epg_log_file_writer, NULL, NULL);
     }
 
   /* Technically this existence check is racy but no other process should be
@@ -603,7 +837,17 @@ main (int   argc,
     {
       /* Set up a D-Bus service and run until we are killed. */
       g_debug ("Starting EpgService to enforce PAYG");
+      if (stall_threshold_ms > 0)
+        {
+          guint log_id;
+
+          epg_loop_monitor_enable (NULL, (guint) stall_threshold_ms);
+          log_id = g_timeout_add_seconds (LOOP_MONITOR_LOG_INTERVAL_SECONDS,
+                                          log_loop_monitor_cb, NULL);
+          g_source_set_name_by_id (log_id, "eos-paygd loop monitor log");
+        }
       gss_service_run (GSS_SERVICE (service), argc, argv, &error);
+      epg_loop_monitor_log_histograms ();
     }
   else
     g_message ("Not enforcing PAYG for this boot");
@@ -642,6 +886,10 @@ main (int   argc,
   while (timeout_id)
     g_main_context_iteration (NULL, TRUE);
 
+  /* Write out any buffered messages and join the log file thread. Anything
+   * logged after this only goes to the journal. */
+  epg_log_file_stop ();
+
   if (exit_signal != 0)
     /* If the service exited due to a signal we should not exit with an error
      * status, as this is likely systemd's SIGTERM when stopping the service.
@@ -650,7 +898,7 @@ main (int   argc,
      */
     raise (exit_signal);
 
-  if (ret == EXIT_SUCCESS && watchdog_id > 0)
+  if (ret == EXIT_SUCCESS && heartbeat_id > 0)
     {
       g_message ("Entering watchdog-ping-only mode");
       while (TRUE)
@@ -0,0 +1,200 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+#include "log-file.h"
+
+typedef struct
+{
+  gchar *directory;  /* (owned) */
+} Fixture;
+
+static void
+setup (Fixture       *fixture,
+       gconstpointer  data)
+{
+  g_autoptr(GError) error = NULL;
+
+  fixture->directory = g_dir_make_tmp ("eos-paygd-log-file-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  epg_log_file_start (fixture->directory);
+}
+
+static void
+teardown (Fixture       *fixture,
+          gconstpointer  data)
+{
+  g_autoptr(GDir) dir = NULL;
+  const gchar *name;
+
+  epg_log_file_stop ();
+
+  dir = g_dir_open (fixture->directory, 0, NULL);
+  while (dir != NULL && (name = g_dir_read_name (dir)) != NULL)
+    {
+      g_autofree gchar *path = g_build_filename (fixture->directory, name, NULL);
+      g_unlink (path);
+    }
+
+  g_rmdir (fixture->directory);
+  g_free (fixture->directory);
+}
+
+/* Log @message from @domain through the log file writer. */
+static void
+log_message (const gchar *domain,
+             const gchar *message)
+{
+  const GLogField fields[] =
+    {
+      { "MESSAGE", message, -1 },
+      { "GLIB_DOMAIN", domain, -1 },
+    };
+
+  epg_log_file_writer (G_LOG_LEVEL_MESSAGE, fields, G_N_ELEMENTS (fields), NULL);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (a, b);
+}
+
+/* Stop the log file writer, and return the lines written to the log files in
+ * @fixture->directory, in order. Normally there’s only one file, unless the
+ * test ran over midnight. */
+static gchar **
+stop_and_read_lines (Fixture *fixture)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GDir) dir = NULL;
+  g_autoptr(GPtrArray) names = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GString) contents = g_string_new ("");
+  const gchar *name;
+
+  epg_log_file_stop ();
+
+  dir = g_dir_open (fixture->directory, 0, &error);
+  g_assert_no_error (error);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    g_ptr_array_add (names, g_strdup (name));
+  g_ptr_array_sort_values (names, compare_strings);
+
+  for (guint i = 0; i < names->len; i++)
+    {
+      g_autofree gchar *path = g_build_filename (fixture->directory, names->pdata[i], NULL);
+      g_autofree gchar *file_contents = NULL;
+
+      g_file_get_contents (path, &file_contents, NULL, &error);
+      g_assert_no_error (error);
+      g_string_append (contents, file_contents);
+    }
+
+  /* Every line is newline-terminated, so drop the empty last element. */
+  if (contents->len > 0 && contents->str[contents->len - 1] == '\n')
+    g_string_truncate (contents, contents->len - 1);
+
+  return g_strsplit (contents->str, "\n", -1);
+}
+
+/* Test that logging the same message twice writes it once, followed by a note
+ * of the repeat, even though the formatted lines have different timestamps. */
+static void
+test_log_file_repeats (Fixture       *fixture,
+                       gconstpointer  data)
+{
+  g_auto(GStrv) lines = NULL;
+
+  log_message ("eos-paygd", "Trying to enter code");
+  g_usleep (2 * G_TIME_SPAN_MILLISECOND);
+  log_message ("eos-paygd", "Trying to enter code");
+  log_message ("eos-paygd", "Code applied");
+
+  lines = stop_and_read_lines (fixture);
+
+  g_assert_cmpuint (g_strv_length (lines), ==, 3);
+  g_assert_true (g_str_has_suffix (lines[0], "Trying to enter code"));
+  g_assert_cmpstr (lines[1], ==, "eos-paygd: Previous message repeated 1 times");
+  g_assert_true (g_str_has_suffix (lines[2], "Code applied"));
+}
+
+/* Test that the same message from a different domain is not treated as a
+ * repeat. */
+static void
+test_log_file_repeats_domain (Fixture       *fixture,
+                              gconstpointer  data)
+{
+  g_auto(GStrv) lines = NULL;
+
+  log_message ("eos-paygd", "Saving state");
+  log_message ("libeos-payg", "Saving state");
+
+  lines = stop_and_read_lines (fixture);
+
+  g_assert_cmpuint (g_strv_length (lines), ==, 2);
+  g_assert_true (g_str_has_prefix (lines[0], "eos-paygd-"));
+  g_assert_true (g_str_has_suffix (lines[0], "Saving state"));
+  g_assert_true (g_str_has_prefix (lines[1], "libeos-payg-"));
+  g_assert_true (g_str_has_suffix (lines[1], "Saving state"));
+}
+
+/* Test that a repeat which is still pending when the writer is stopped is
+ * noted in the log file. */
+static void
+test_log_file_repeats_at_stop (Fixture       *fixture,
+                               gconstpointer  data)
+{
+  g_auto(GStrv) lines = NULL;
+
+  for (gsize i = 0; i < 5; i++)
+    log_message ("eos-paygd", "Trying to enter code");
+
+  lines = stop_and_read_lines (fixture);
+
+  g_assert_cmpuint (g_strv_length (lines), ==, 2);
+  g_assert_true (g_str_has_suffix (lines[0], "Trying to enter code"));
+  g_assert_cmpstr (lines[1], ==, "eos-paygd: Previous message repeated 4 times");
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+#define T(path, func) \
+  g_test_add (path, Fixture, NULL, setup, func, teardown)
+
+  T ("/log-file/repeats", test_log_file_repeats);
+  T ("/log-file/repeats/domain", test_log_file_repeats_domain);
+  T ("/log-file/repeats/at-stop", test_log_file_repeats_at_stop);
+
+#undef T
+
+  return g_test_run ();
+}
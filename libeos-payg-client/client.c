@@ -0,0 +1,910 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <libeos-payg/errors.h>
+#include <libeos-payg/manager-interface.h>
+#include <libeos-payg-client/client.h>
+#include <time.h>
+
+#define BUS_NAME "com.endlessm.Payg1"
+#define OBJECT_PATH "/com/endlessm/Payg1"
+#define INTERFACE_NAME "com.endlessm.Payg1"
+
+static const GDBusErrorEntry client_error_map[] =
+  {
+    { EPG_CLIENT_ERROR_INVALID_CODE,
+      "com.endlessm.Payg1.Error.InvalidCode" },
+    { EPG_CLIENT_ERROR_CODE_ALREADY_USED,
+      "com.endlessm.Payg1.Error.CodeAlreadyUsed" },
+    { EPG_CLIENT_ERROR_TOO_MANY_ATTEMPTS,
+      "com.endlessm.Payg1.Error.TooManyAttempts" },
+    { EPG_CLIENT_ERROR_DISABLED,
+      "com.endlessm.Payg1.Error.Disabled" },
+    { EPG_CLIENT_ERROR_DISPLAY_ACCOUNT_ID,
+      "com.endlessm.Payg1.Error.DisplayAccountID" },
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (client_error_map) == EPG_CLIENT_N_ERRORS);
+/* The daemon’s errors are what go over the bus, so these must be kept in
+ * sync with them. */
+G_STATIC_ASSERT (EPG_CLIENT_N_ERRORS == EPG_MANAGER_N_ERRORS);
+
+GQuark
+epg_client_error_quark (void)
+{
+  static gsize quark = 0;
+
+  g_dbus_error_register_error_domain ("epg-client-error-quark", &quark,
+                                      client_error_map,
+                                      G_N_ELEMENTS (client_error_map));
+  return (GQuark) quark;
+}
+
+/**
+ * EpgClient:
+ *
+ * A client for the `com.endlessm.Payg1` interface of eos-paygd, for use by
+ * UI components and tools.
+ *
+ * The daemon’s properties are all loaded in a single call when the client is
+ * created, and are then kept up to date from its `PropertiesChanged` signals,
+ * so reading them never blocks or makes a D-Bus call. Each D-Bus property is
+ * exposed as a #GObject property, which is notified when it changes.
+ *
+ * The times in the daemon’s properties are in the timescale of
+ * `CLOCK_BOOTTIME`. Use epg_client_dup_expiry_date_time() and
+ * epg_client_dup_rate_limit_end_date_time() to convert them to wall clock
+ * times for display.
+ *
+ * Since: 0.2.5
+ */
+struct _EpgClient
+{
+  GObject parent_instance;
+
+  GDBusProxy *proxy;  /* (owned) */
+};
+
+typedef enum
+{
+  PROP_ENABLED = 1,
+  PROP_EXPIRY_TIME,
+  PROP_RATE_LIMIT_END_TIME,
+  PROP_CODE_FORMAT,
+  PROP_CODE_FORMAT_PREFIX,
+  PROP_CODE_FORMAT_SUFFIX,
+  PROP_CODE_LENGTH,
+  PROP_ACCOUNT_ID,
+} EpgClientProperty;
+
+static GParamSpec *props[PROP_ACCOUNT_ID + 1] = { NULL, };
+
+/* D-Bus names of the properties, indexed by #EpgClientProperty. */
+static const gchar *property_dbus_names[] =
+  {
+    NULL,
+    "Enabled",
+    "ExpiryTime",
+    "RateLimitEndTime",
+    "CodeFormat",
+    "CodeFormatPrefix",
+    "CodeFormatSuffix",
+    "CodeLength",
+    "AccountID",
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (property_dbus_names) == G_N_ELEMENTS (props));
+
+typedef enum
+{
+  SIGNAL_EXPIRED,
+  SIGNAL_IMPENDING_SHUTDOWN,
+  SIGNAL_CREDIT_LOW,
+  SIGNAL_RATE_LIMIT_ENDED,
+} EpgClientSignal;
+
+static guint signals[SIGNAL_RATE_LIMIT_ENDED + 1] = { 0, };
+
+G_DEFINE_TYPE (EpgClient, epg_client, G_TYPE_OBJECT)
+
+static void
+epg_client_dispose (GObject *object)
+{
+  EpgClient *self = EPG_CLIENT (object);
+
+  if (self->proxy != NULL)
+    g_signal_handlers_disconnect_by_data (self->proxy, self);
+  g_clear_object (&self->proxy);
+
+  G_OBJECT_CLASS (epg_client_parent_class)->dispose (object);
+}
+
+static void
+epg_client_get_property (GObject    *object,
+                         guint       property_id,
+                         GValue     *value,
+                         GParamSpec *pspec)
+{
+  EpgClient *self = EPG_CLIENT (object);
+
+  switch ((EpgClientProperty) property_id)
+    {
+    case PROP_ENABLED:
+      g_value_set_boolean (value, epg_client_get_enabled (self));
+      break;
+    case PROP_EXPIRY_TIME:
+      g_value_set_uint64 (value, epg_client_get_expiry_time (self));
+      break;
+    case PROP_RATE_LIMIT_END_TIME:
+      g_value_set_uint64 (value, epg_client_get_rate_limit_end_time (self));
+      break;
+    case PROP_CODE_FORMAT:
+      g_value_set_string (value, epg_client_get_code_format (self));
+      break;
+    case PROP_CODE_FORMAT_PREFIX:
+      g_value_set_string (value, epg_client_get_code_format_prefix (self));
+      break;
+    case PROP_CODE_FORMAT_SUFFIX:
+      g_value_set_string (value, epg_client_get_code_format_suffix (self));
+      break;
+    case PROP_CODE_LENGTH:
+      g_value_set_uint (value, epg_client_get_code_length (self));
+      break;
+    case PROP_ACCOUNT_ID:
+      g_value_set_string (value, epg_client_get_account_id (self));
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+epg_client_class_init (EpgClientClass *klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+
+  object_class->dispose = epg_client_dispose;
+  object_class->get_property = epg_client_get_property;
+
+  /**
+   * EpgClient:enabled:
+   *
+   * Whether pay as you go is enabled on this computer.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_ENABLED] =
+      g_param_spec_boolean ("enabled", "Enabled",
+                            "Whether pay as you go is enabled on this computer.",
+                            FALSE,
+                            G_PARAM_READABLE |
+                            G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:expiry-time:
+   *
+   * Time when the current credit expires, in seconds in the timescale of
+   * `CLOCK_BOOTTIME`. This is %G_MAXUINT64 if the credit never expires, and 0
+   * if pay as you go is disabled. See epg_client_dup_expiry_date_time().
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_EXPIRY_TIME] =
+      g_param_spec_uint64 ("expiry-time", "Expiry Time",
+                           "Time when the current credit expires.",
+                           0, G_MAXUINT64, 0,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:rate-limit-end-time:
+   *
+   * Time when the current rate limiting period for code entry ends, in
+   * seconds in the timescale of `CLOCK_BOOTTIME`. This may be in the past.
+   * See epg_client_dup_rate_limit_end_date_time().
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_RATE_LIMIT_END_TIME] =
+      g_param_spec_uint64 ("rate-limit-end-time", "Rate Limit End Time",
+                           "Time when the current rate limiting period ends.",
+                           0, G_MAXUINT64, 0,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:code-format:
+   *
+   * Regular expression which matches valid codes, or the empty string if it is
+   * unknown.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_CODE_FORMAT] =
+      g_param_spec_string ("code-format", "Code Format",
+                           "Regular expression which matches valid codes.",
+                           NULL,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:code-format-prefix:
+   *
+   * Prefix which should be shown before the code entry field.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_CODE_FORMAT_PREFIX] =
+      g_param_spec_string ("code-format-prefix", "Code Format Prefix",
+                           "Prefix which should be shown before the code entry field.",
+                           NULL,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:code-format-suffix:
+   *
+   * Suffix which should be shown after the code entry field.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_CODE_FORMAT_SUFFIX] =
+      g_param_spec_string ("code-format-suffix", "Code Format Suffix",
+                           "Suffix which should be shown after the code entry field.",
+                           NULL,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:code-length:
+   *
+   * Length of valid codes, or 0 if it is not fixed.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_CODE_LENGTH] =
+      g_param_spec_uint ("code-length", "Code Length",
+                         "Length of valid codes, or 0 if it is not fixed.",
+                         0, G_MAXUINT32, 0,
+                         G_PARAM_READABLE |
+                         G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgClient:account-id:
+   *
+   * Account ID assigned to this computer, or the empty string if there is
+   * none.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_ACCOUNT_ID] =
+      g_param_spec_string ("account-id", "Account ID",
+                           "Account ID assigned to this computer.",
+                           NULL,
+                           G_PARAM_READABLE |
+                           G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, G_N_ELEMENTS (props), props);
+
+  /**
+   * EpgClient::expired:
+   * @self: an #EpgClient
+   *
+   * Emitted when the credit expires.
+   *
+   * Since: 0.2.5
+   */
+  signals[SIGNAL_EXPIRED] =
+      g_signal_new ("expired", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 0);
+
+  /**
+   * EpgClient::impending-shutdown:
+   * @self: an #EpgClient
+   * @seconds_remaining: seconds until the computer is shut down, or -1 if the
+   *    shutdown was cancelled
+   * @shutdown_reason: human-readable reason for the shutdown
+   *
+   * Emitted when the daemon schedules or cancels a shutdown.
+   *
+   * Since: 0.2.5
+   */
+  signals[SIGNAL_IMPENDING_SHUTDOWN] =
+      g_signal_new ("impending-shutdown", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 2, G_TYPE_INT, G_TYPE_STRING);
+
+  /**
+   * EpgClient::credit-low:
+   * @self: an #EpgClient
+   * @threshold: the threshold which the remaining credit has fallen below, in
+   *    seconds
+   *
+   * Emitted when the remaining credit falls below one of a fixed set of
+   * thresholds chosen by the daemon.
+   *
+   * Since: 0.2.5
+   */
+  signals[SIGNAL_CREDIT_LOW] =
+      g_signal_new ("credit-low", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 1, G_TYPE_UINT64);
+
+  /**
+   * EpgClient::rate-limit-ended:
+   * @self: an #EpgClient
+   *
+   * Emitted when the current rate limiting period for code entry ends, so
+   * codes can be entered again.
+   *
+   * Since: 0.2.5
+   */
+  signals[SIGNAL_RATE_LIMIT_ENDED] =
+      g_signal_new ("rate-limit-ended", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 0);
+
+  /* Make sure the D-Bus errors are mapped before any call returns one. */
+  epg_client_error_quark ();
+}
+
+static void
+epg_client_init (EpgClient *self)
+{
+}
+
+static void
+notify_property (EpgClient   *self,
+                 const gchar *dbus_name)
+{
+  for (gsize i = 1; i < G_N_ELEMENTS (property_dbus_names); i++)
+    {
+      if (g_str_equal (property_dbus_names[i], dbus_name))
+        {
+          g_object_notify_by_pspec (G_OBJECT (self), props[i]);
+          return;
+        }
+    }
+}
+
+static void
+properties_changed_cb (GDBusProxy          *proxy,
+                       GVariant            *changed_properties,
+                       const gchar * const *invalidated_properties,
+                       gpointer             user_data)
+{
+  EpgClient *self = EPG_CLIENT (user_data);
+  GVariantIter iter;
+  const gchar *name;
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  g_variant_iter_init (&iter, changed_properties);
+  while (g_variant_iter_next (&iter, "{&sv}", &name, NULL))
+    notify_property (self, name);
+
+  for (gsize i = 0; invalidated_properties[i] != NULL; i++)
+    notify_property (self, invalidated_properties[i]);
+
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
+static void
+signal_cb (GDBusProxy  *proxy,
+           const gchar *sender_name,
+           const gchar *signal_name,
+           GVariant    *parameters,
+           gpointer     user_data)
+{
+  EpgClient *self = EPG_CLIENT (user_data);
+
+  /* The types of @parameters have already been checked by #GDBusProxy
+   * against manager_interface. */
+  if (g_str_equal (signal_name, "Expired"))
+    {
+      g_signal_emit (self, signals[SIGNAL_EXPIRED], 0);
+    }
+  else if (g_str_equal (signal_name, "ImpendingShutdown"))
+    {
+      gint32 seconds_remaining;
+      const gchar *shutdown_reason;
+
+      g_variant_get (parameters, "(i&s)", &seconds_remaining, &shutdown_reason);
+      g_signal_emit (self, signals[SIGNAL_IMPENDING_SHUTDOWN], 0,
+                     (gint) seconds_remaining, shutdown_reason);
+    }
+  else if (g_str_equal (signal_name, "CreditLow"))
+    {
+      guint64 threshold;
+
+      g_variant_get (parameters, "(t)", &threshold);
+      g_signal_emit (self, signals[SIGNAL_CREDIT_LOW], 0, threshold);
+    }
+  else if (g_str_equal (signal_name, "RateLimitEnded"))
+    {
+      g_signal_emit (self, signals[SIGNAL_RATE_LIMIT_ENDED], 0);
+    }
+}
+
+static EpgClient *
+client_new_for_proxy (GDBusProxy *proxy)
+{
+  EpgClient *self = g_object_new (EPG_TYPE_CLIENT, NULL);
+
+  self->proxy = g_object_ref (proxy);
+  g_signal_connect (self->proxy, "g-properties-changed",
+                    G_CALLBACK (properties_changed_cb), self);
+  g_signal_connect (self->proxy, "g-signal",
+                    G_CALLBACK (signal_cb), self);
+
+  return self;
+}
+
+static void
+proxy_new_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  g_autoptr(GTask) task = G_TASK (user_data);
+  g_autoptr(GDBusProxy) proxy = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  proxy = g_dbus_proxy_new_finish (result, &local_error);
+
+  if (proxy == NULL)
+    g_task_return_error (task, g_steal_pointer (&local_error));
+  else
+    g_task_return_pointer (task, client_new_for_proxy (proxy), g_object_unref);
+}
+
+/**
+ * epg_client_new_async:
+ * @connection: (nullable): D-Bus connection to use, or %NULL to use the
+ *    system bus
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: function to call once the async operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Create a new #EpgClient for eos-paygd, and load all its properties. This
+ * makes one D-Bus call, regardless of how many properties there are.
+ *
+ * It is not an error for eos-paygd not to be running: the client will pick up
+ * its properties if it is started later.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_client_new_async (GDBusConnection     *connection,
+                      GCancellable        *cancellable,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+  g_return_if_fail (connection == NULL || G_IS_DBUS_CONNECTION (connection));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  g_autoptr(GTask) task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_client_new_async);
+
+  if (connection != NULL)
+    g_dbus_proxy_new (connection, G_DBUS_PROXY_FLAGS_NONE,
+                      (GDBusInterfaceInfo *) &manager_interface,
+                      BUS_NAME, OBJECT_PATH, INTERFACE_NAME,
+                      cancellable, proxy_new_cb, g_steal_pointer (&task));
+  else
+    g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE,
+                              (GDBusInterfaceInfo *) &manager_interface,
+                              BUS_NAME, OBJECT_PATH, INTERFACE_NAME,
+                              cancellable, proxy_new_cb, g_steal_pointer (&task));
+}
+
+/**
+ * epg_client_new_finish:
+ * @result: asynchronous operation result
+ * @error: return location for an error, or %NULL
+ *
+ * Finish an asynchronous operation started with epg_client_new_async().
+ *
+ * Returns: (transfer full): a new #EpgClient, or %NULL on error
+ * Since: 0.2.5
+ */
+EpgClient *
+epg_client_new_finish (GAsyncResult  *result,
+                       GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_client_new_async), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * epg_client_new_sync:
+ * @connection: (nullable): D-Bus connection to use, or %NULL to use the
+ *    system bus
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for an error, or %NULL
+ *
+ * Synchronous version of epg_client_new_async(). This blocks on a D-Bus call,
+ * so should only be used by command line tools.
+ *
+ * Returns: (transfer full): a new #EpgClient, or %NULL on error
+ * Since: 0.2.5
+ */
+EpgClient *
+epg_client_new_sync (GDBusConnection  *connection,
+                     GCancellable     *cancellable,
+                     GError          **error)
+{
+  g_autoptr(GDBusProxy) proxy = NULL;
+
+  g_return_val_if_fail (connection == NULL || G_IS_DBUS_CONNECTION (connection), NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (connection != NULL)
+    proxy = g_dbus_proxy_new_sync (connection, G_DBUS_PROXY_FLAGS_NONE,
+                                   (GDBusInterfaceInfo *) &manager_interface,
+                                   BUS_NAME, OBJECT_PATH, INTERFACE_NAME,
+                                   cancellable, error);
+  else
+    proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE,
+                                           (GDBusInterfaceInfo *) &manager_interface,
+                                           BUS_NAME, OBJECT_PATH, INTERFACE_NAME,
+                                           cancellable, error);
+
+  if (proxy == NULL)
+    return NULL;
+
+  return client_new_for_proxy (proxy);
+}
+
+/* Get the cached value of a property. Its type has already been checked by
+ * #GDBusProxy against manager_interface. Returns %NULL if the daemon isn’t
+ * running. */
+static GVariant *
+get_cached (EpgClient         *self,
+            EpgClientProperty  property)
+{
+  return g_dbus_proxy_get_cached_property (self->proxy, property_dbus_names[property]);
+}
+
+/* Strings returned from the cache stay valid until the property changes,
+ * since the proxy holds a reference to the variant until then. */
+static const gchar *
+get_cached_string (EpgClient         *self,
+                   EpgClientProperty  property)
+{
+  g_autoptr(GVariant) value = get_cached (self, property);
+  return (value != NULL) ? g_variant_get_string (value, NULL) : "";
+}
+
+/**
+ * epg_client_get_enabled:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:enabled.
+ *
+ * Returns: %TRUE if pay as you go is enabled
+ * Since: 0.2.5
+ */
+gboolean
+epg_client_get_enabled (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), FALSE);
+
+  g_autoptr(GVariant) value = get_cached (self, PROP_ENABLED);
+  return (value != NULL) ? g_variant_get_boolean (value) : FALSE;
+}
+
+/**
+ * epg_client_get_expiry_time:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:expiry-time.
+ *
+ * Returns: expiry time, in seconds in the timescale of `CLOCK_BOOTTIME`
+ * Since: 0.2.5
+ */
+guint64
+epg_client_get_expiry_time (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), 0);
+
+  g_autoptr(GVariant) value = get_cached (self, PROP_EXPIRY_TIME);
+  return (value != NULL) ? g_variant_get_uint64 (value) : 0;
+}
+
+/**
+ * epg_client_get_rate_limit_end_time:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:rate-limit-end-time.
+ *
+ * Returns: rate limit end time, in seconds in the timescale of
+ *    `CLOCK_BOOTTIME`
+ * Since: 0.2.5
+ */
+guint64
+epg_client_get_rate_limit_end_time (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), 0);
+
+  g_autoptr(GVariant) value = get_cached (self, PROP_RATE_LIMIT_END_TIME);
+  return (value != NULL) ? g_variant_get_uint64 (value) : 0;
+}
+
+/**
+ * epg_client_get_code_format:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:code-format. The returned string is only valid
+ * until the property next changes.
+ *
+ * Returns: (transfer none): regular expression matching valid codes
+ * Since: 0.2.5
+ */
+const gchar *
+epg_client_get_code_format (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  return get_cached_string (self, PROP_CODE_FORMAT);
+}
+
+/**
+ * epg_client_get_code_format_prefix:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:code-format-prefix. The returned string is only
+ * valid until the property next changes.
+ *
+ * Returns: (transfer none): prefix for the code entry field
+ * Since: 0.2.5
+ */
+const gchar *
+epg_client_get_code_format_prefix (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  return get_cached_string (self, PROP_CODE_FORMAT_PREFIX);
+}
+
+/**
+ * epg_client_get_code_format_suffix:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:code-format-suffix. The returned string is only
+ * valid until the property next changes.
+ *
+ * Returns: (transfer none): suffix for the code entry field
+ * Since: 0.2.5
+ */
+const gchar *
+epg_client_get_code_format_suffix (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  return get_cached_string (self, PROP_CODE_FORMAT_SUFFIX);
+}
+
+/**
+ * epg_client_get_code_length:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:code-length.
+ *
+ * Returns: length of valid codes, or 0 if it is not fixed
+ * Since: 0.2.5
+ */
+guint32
+epg_client_get_code_length (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), 0);
+
+  g_autoptr(GVariant) value = get_cached (self, PROP_CODE_LENGTH);
+  return (value != NULL) ? g_variant_get_uint32 (value) : 0;
+}
+
+/**
+ * epg_client_get_account_id:
+ * @self: an #EpgClient
+ *
+ * Get the value of #EpgClient:account-id. The returned string is only valid
+ * until the property next changes.
+ *
+ * Returns: (transfer none): account ID, or the empty string
+ * Since: 0.2.5
+ */
+const gchar *
+epg_client_get_account_id (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  return get_cached_string (self, PROP_ACCOUNT_ID);
+}
+
+/* Convert a time in seconds in the timescale of `CLOCK_BOOTTIME` to a local
+ * wall clock time. This has to be done afresh each time, as the offset
+ * between the two clocks changes whenever the computer is suspended or the
+ * wall clock is changed. */
+static GDateTime *
+boottime_to_date_time (guint64 boottime_secs)
+{
+  struct timespec ts;
+
+  if (boottime_secs > G_MAXINT64 ||
+      clock_gettime (CLOCK_BOOTTIME, &ts) != 0)
+    return NULL;
+
+  gint64 now_real_secs = g_get_real_time () / G_USEC_PER_SEC;
+  gint64 delta_secs = (gint64) boottime_secs - (gint64) ts.tv_sec;
+
+  /* Out of range times can’t be represented by #GDateTime anyway. */
+  if (delta_secs > G_MAXINT64 - now_real_secs)
+    return NULL;
+
+  return g_date_time_new_from_unix_local (now_real_secs + delta_secs);
+}
+
+/**
+ * epg_client_dup_expiry_date_time:
+ * @self: an #EpgClient
+ *
+ * Get the wall clock time when the credit expires, for display. This is
+ * calculated from #EpgClient:expiry-time using the current offset between
+ * `CLOCK_BOOTTIME` and the wall clock, so should not be cached by the caller
+ * across suspends or clock changes.
+ *
+ * Returns: (transfer full) (nullable): expiry time in the local timezone, or
+ *    %NULL if pay as you go is disabled or the credit never expires
+ * Since: 0.2.5
+ */
+GDateTime *
+epg_client_dup_expiry_date_time (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  guint64 expiry_time = epg_client_get_expiry_time (self);
+
+  if (expiry_time == 0 || expiry_time == G_MAXUINT64)
+    return NULL;
+
+  return boottime_to_date_time (expiry_time);
+}
+
+/**
+ * epg_client_dup_rate_limit_end_date_time:
+ * @self: an #EpgClient
+ *
+ * Get the wall clock time when the current rate limiting period ends, for
+ * display. See epg_client_dup_expiry_date_time().
+ *
+ * Returns: (transfer full) (nullable): rate limit end time in the local
+ *    timezone, or %NULL if there has never been any rate limiting
+ * Since: 0.2.5
+ */
+GDateTime *
+epg_client_dup_rate_limit_end_date_time (EpgClient *self)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), NULL);
+
+  guint64 rate_limit_end_time = epg_client_get_rate_limit_end_time (self);
+
+  if (rate_limit_end_time == 0)
+    return NULL;
+
+  return boottime_to_date_time (rate_limit_end_time);
+}
+
+static void
+add_code_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+  g_autoptr(GTask) task = G_TASK (user_data);
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GError) local_error = NULL;
+  gint64 time_added;
+
+  reply = g_dbus_proxy_call_finish (proxy, result, &local_error);
+
+  if (reply == NULL)
+    {
+      g_dbus_error_strip_remote_error (local_error);
+      g_task_return_error (task, g_steal_pointer (&local_error));
+      return;
+    }
+
+  g_variant_get (reply, "(x)", &time_added);
+  g_task_return_pointer (task, g_memdup2 (&time_added, sizeof (time_added)), g_free);
+}
+
+/**
+ * epg_client_add_code_async:
+ * @self: an #EpgClient
+ * @code_str: code to verify and add
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: function to call once the async operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Ask the daemon to verify @code_str and, if it is valid and has not been
+ * used before, add its credit. The #EpgClient:expiry-time property will be
+ * updated before @callback is called.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_client_add_code_async (EpgClient           *self,
+                           const gchar         *code_str,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  g_return_if_fail (EPG_IS_CLIENT (self));
+  g_return_if_fail (code_str != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_client_add_code_async);
+
+  g_dbus_proxy_call (self->proxy, "AddCode", g_variant_new ("(s)", code_str),
+                     G_DBUS_CALL_FLAGS_NONE, -1  /* default timeout */,
+                     cancellable, add_code_cb, g_steal_pointer (&task));
+}
+
+/**
+ * epg_client_add_code_finish:
+ * @self: an #EpgClient
+ * @result: asynchronous operation result
+ * @time_added: (out) (optional): return location for the number of seconds of
+ *    credit added by the code
+ * @error: return location for an error, or %NULL
+ *
+ * Finish an asynchronous operation started with epg_client_add_code_async().
+ * Errors from the daemon are returned in the #EPG_CLIENT_ERROR domain.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epg_client_add_code_finish (EpgClient     *self,
+                            GAsyncResult  *result,
+                            gint64        *time_added,
+                            GError       **error)
+{
+  g_return_val_if_fail (EPG_IS_CLIENT (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_client_add_code_async), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_autofree gint64 *time_added_ptr = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (time_added_ptr == NULL)
+    return FALSE;
+
+  if (time_added != NULL)
+    *time_added = *time_added_ptr;
+  return TRUE;
+}
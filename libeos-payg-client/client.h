@@ -0,0 +1,93 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EpgClientError:
+ * @EPG_CLIENT_ERROR_INVALID_CODE: The given code was invalid, such as having
+ *    an invalid signature or time period.
+ * @EPG_CLIENT_ERROR_CODE_ALREADY_USED: The given code has already been used.
+ * @EPG_CLIENT_ERROR_TOO_MANY_ATTEMPTS: Too many attempts to verify a code
+ *    in recent history.
+ * @EPG_CLIENT_ERROR_DISABLED: Pay as you go is disabled.
+ * @EPG_CLIENT_ERROR_DISPLAY_ACCOUNT_ID: The given code was valid, but instead
+ *    of adding time, the caller should show the account ID assigned to the
+ *    machine.
+ *
+ * Errors which can be returned by the daemon. These correspond to the
+ * `com.endlessm.Payg1.Error` D-Bus errors.
+ *
+ * Since: 0.2.5
+ */
+typedef enum
+{
+  EPG_CLIENT_ERROR_INVALID_CODE = 0,
+  EPG_CLIENT_ERROR_CODE_ALREADY_USED,
+  EPG_CLIENT_ERROR_TOO_MANY_ATTEMPTS,
+  EPG_CLIENT_ERROR_DISABLED,
+  EPG_CLIENT_ERROR_DISPLAY_ACCOUNT_ID,
+} EpgClientError;
+#define EPG_CLIENT_N_ERRORS (EPG_CLIENT_ERROR_DISPLAY_ACCOUNT_ID + 1)
+
+GQuark epg_client_error_quark (void);
+#define EPG_CLIENT_ERROR epg_client_error_quark ()
+
+#define EPG_TYPE_CLIENT epg_client_get_type ()
+G_DECLARE_FINAL_TYPE (EpgClient, epg_client, EPG, CLIENT, GObject)
+
+void       epg_client_new_async  (GDBusConnection      *connection,
+                                  GCancellable         *cancellable,
+                                  GAsyncReadyCallback   callback,
+                                  gpointer              user_data);
+EpgClient *epg_client_new_finish (GAsyncResult         *result,
+                                  GError              **error);
+EpgClient *epg_client_new_sync   (GDBusConnection      *connection,
+                                  GCancellable         *cancellable,
+                                  GError              **error);
+
+gboolean     epg_client_get_enabled              (EpgClient *self);
+guint64      epg_client_get_expiry_time          (EpgClient *self);
+guint64      epg_client_get_rate_limit_end_time  (EpgClient *self);
+const gchar *epg_client_get_code_format          (EpgClient *self);
+const gchar *epg_client_get_code_format_prefix   (EpgClient *self);
+const gchar *epg_client_get_code_format_suffix   (EpgClient *self);
+guint32      epg_client_get_code_length          (EpgClient *self);
+const gchar *epg_client_get_account_id           (EpgClient *self);
+
+GDateTime   *epg_client_dup_expiry_date_time         (EpgClient *self);
+GDateTime   *epg_client_dup_rate_limit_end_date_time (EpgClient *self);
+
+void     epg_client_add_code_async  (EpgClient            *self,
+                                     const gchar          *code_str,
+                                     GCancellable         *cancellable,
+                                     GAsyncReadyCallback   callback,
+                                     gpointer              user_data);
+gboolean epg_client_add_code_finish (EpgClient            *self,
+                                     GAsyncResult         *result,
+                                     gint64               *time_added,
+                                     GError              **error);
+
+G_END_DECLS
@@ -0,0 +1,336 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <libeos-payg/manager-interface.h>
+#include <libeos-payg-client/client.h>
+#include <locale.h>
+#include <time.h>
+
+/* A mock of eos-paygd, exported on a private bus. */
+typedef struct
+{
+  GTestDBus *bus;  /* (owned) */
+  GDBusConnection *connection;  /* (owned) */
+  guint object_id;
+  guint name_id;
+  gboolean name_acquired;
+
+  guint64 expiry_time;
+  gint n_get_all_calls;  /* (atomic) */
+} Fixture;
+
+static void
+mock_method_call (GDBusConnection       *connection,
+                  const gchar           *sender,
+                  const gchar           *object_path,
+                  const gchar           *interface_name,
+                  const gchar           *method_name,
+                  GVariant              *parameters,
+                  GDBusMethodInvocation *invocation,
+                  gpointer               user_data)
+{
+  const gchar *code_str;
+
+  g_assert_cmpstr (method_name, ==, "AddCode");
+  g_variant_get (parameters, "(&s)", &code_str);
+
+  if (g_str_equal (code_str, "12345678"))
+    g_dbus_method_invocation_return_value (invocation, g_variant_new ("(x)", (gint64) 5));
+  else
+    g_dbus_method_invocation_return_dbus_error (invocation,
+                                                "com.endlessm.Payg1.Error.InvalidCode",
+                                                "Invalid code");
+}
+
+static GVariant *
+mock_get_property (GDBusConnection  *connection,
+                   const gchar      *sender,
+                   const gchar      *object_path,
+                   const gchar      *interface_name,
+                   const gchar      *property_name,
+                   GError          **error,
+                   gpointer          user_data)
+{
+  Fixture *fixture = user_data;
+
+  if (g_str_equal (property_name, "ExpiryTime"))
+    return g_variant_new_uint64 (fixture->expiry_time);
+  else if (g_str_equal (property_name, "Enabled"))
+    return g_variant_new_boolean (TRUE);
+  else if (g_str_equal (property_name, "RateLimitEndTime"))
+    return g_variant_new_uint64 (0);
+  else if (g_str_equal (property_name, "CodeLength"))
+    return g_variant_new_uint32 (8);
+  else if (g_str_equal (property_name, "AccountID"))
+    return g_variant_new_string ("123");
+  else
+    return g_variant_new_string ("");
+}
+
+/* Called in the GDBus worker thread. */
+static GDBusMessage *
+count_get_all_cb (GDBusConnection *connection,
+                  GDBusMessage    *message,
+                  gboolean         incoming,
+                  gpointer         user_data)
+{
+  Fixture *fixture = user_data;
+
+  if (incoming &&
+      g_dbus_message_get_message_type (message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+      g_strcmp0 (g_dbus_message_get_member (message), "GetAll") == 0)
+    g_atomic_int_inc (&fixture->n_get_all_calls);
+
+  return message;
+}
+
+static void
+name_acquired_cb (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  Fixture *fixture = user_data;
+  fixture->name_acquired = TRUE;
+}
+
+static void
+setup (Fixture       *fixture,
+       gconstpointer  test_data)
+{
+  static const GDBusInterfaceVTable vtable =
+    {
+      mock_method_call,
+      mock_get_property,
+      NULL,
+    };
+  g_autoptr(GError) error = NULL;
+
+  fixture->expiry_time = 1000;
+
+  fixture->bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (fixture->bus);
+
+  fixture->connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (fixture->bus),
+                                                                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                                G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                                NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  g_dbus_connection_add_filter (fixture->connection, count_get_all_cb, fixture, NULL);
+
+  fixture->object_id = g_dbus_connection_register_object (fixture->connection,
+                                                          "/com/endlessm/Payg1",
+                                                          (GDBusInterfaceInfo *) &manager_interface,
+                                                          &vtable, fixture, NULL, &error);
+  g_assert_no_error (error);
+
+  fixture->name_id = g_bus_own_name_on_connection (fixture->connection,
+                                                   "com.endlessm.Payg1",
+                                                   G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                   name_acquired_cb, NULL,
+                                                   fixture, NULL);
+
+  while (!fixture->name_acquired)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+teardown (Fixture       *fixture,
+          gconstpointer  test_data)
+{
+  g_bus_unown_name (fixture->name_id);
+  g_dbus_connection_unregister_object (fixture->connection, fixture->object_id);
+  g_dbus_connection_close_sync (fixture->connection, NULL, NULL);
+  g_clear_object (&fixture->connection);
+
+  g_test_dbus_down (fixture->bus);
+  g_clear_object (&fixture->bus);
+}
+
+static void
+async_cb (GObject      *source,
+          GAsyncResult *result,
+          gpointer      data)
+{
+  GAsyncResult **result_out = data;
+
+  g_assert_null (*result_out);
+  *result_out = g_object_ref (result);
+}
+
+static EpgClient *
+client_new (Fixture *fixture)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  EpgClient *client;
+
+  epg_client_new_async (fixture->connection, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  client = epg_client_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (client);
+
+  return client;
+}
+
+static void
+count_notify_cb (GObject    *obj,
+                 GParamSpec *pspec,
+                 gpointer    user_data)
+{
+  guint *n_notifications = user_data;
+  (*n_notifications)++;
+}
+
+/* Test that all the properties are loaded with a single GetAll call, and that
+ * reading them afterwards makes no further calls. */
+static void
+test_client_properties (Fixture       *fixture,
+                        gconstpointer  test_data)
+{
+  g_autoptr(EpgClient) client = client_new (fixture);
+
+  g_assert_cmpint (g_atomic_int_get (&fixture->n_get_all_calls), ==, 1);
+
+  g_assert_true (epg_client_get_enabled (client));
+  g_assert_cmpuint (epg_client_get_expiry_time (client), ==, 1000);
+  g_assert_cmpuint (epg_client_get_rate_limit_end_time (client), ==, 0);
+  g_assert_cmpuint (epg_client_get_code_length (client), ==, 8);
+  g_assert_cmpstr (epg_client_get_account_id (client), ==, "123");
+  g_assert_cmpstr (epg_client_get_code_format (client), ==, "");
+
+  while (g_main_context_iteration (NULL, FALSE));
+
+  g_assert_cmpint (g_atomic_int_get (&fixture->n_get_all_calls), ==, 1);
+}
+
+/* Test that the cached properties are updated, and notified, when the daemon
+ * emits PropertiesChanged. */
+static void
+test_client_properties_changed (Fixture       *fixture,
+                                gconstpointer  test_data)
+{
+  g_autoptr(EpgClient) client = client_new (fixture);
+  g_autoptr(GError) error = NULL;
+  guint n_notifications = 0;
+
+  g_signal_connect (client, "notify::expiry-time",
+                    G_CALLBACK (count_notify_cb), &n_notifications);
+
+  g_dbus_connection_emit_signal (fixture->connection, NULL, "/com/endlessm/Payg1",
+                                 "org.freedesktop.DBus.Properties",
+                                 "PropertiesChanged",
+                                 g_variant_new_parsed ("('com.endlessm.Payg1', "
+                                                       "{'ExpiryTime': <uint64 2000>}, "
+                                                       "@as [])"),
+                                 &error);
+  g_assert_no_error (error);
+
+  while (n_notifications == 0)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (n_notifications, ==, 1);
+  g_assert_cmpuint (epg_client_get_expiry_time (client), ==, 2000);
+  g_assert_cmpint (g_atomic_int_get (&fixture->n_get_all_calls), ==, 1);
+}
+
+/* Test that adding a code returns the time added, or an error in the client
+ * error domain. */
+static void
+test_client_add_code (Fixture       *fixture,
+                      gconstpointer  test_data)
+{
+  g_autoptr(EpgClient) client = client_new (fixture);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  gboolean ret;
+
+  epg_client_add_code_async (client, "12345678", NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_client_add_code_finish (client, result, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_cmpint (time_added, ==, 5);
+
+  g_clear_object (&result);
+
+  epg_client_add_code_async (client, "00000000", NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_client_add_code_finish (client, result, &time_added, &error);
+  g_assert_error (error, EPG_CLIENT_ERROR, EPG_CLIENT_ERROR_INVALID_CODE);
+  g_assert_false (ret);
+  g_assert_cmpstr (error->message, ==, "Invalid code");
+}
+
+/* Test that times are converted from CLOCK_BOOTTIME to the wall clock, and
+ * that the special values give no time. */
+static void
+test_client_date_time (Fixture       *fixture,
+                       gconstpointer  test_data)
+{
+  struct timespec ts;
+
+  g_assert_cmpint (clock_gettime (CLOCK_BOOTTIME, &ts), ==, 0);
+  fixture->expiry_time = ts.tv_sec + 60 * 60;
+
+  g_autoptr(EpgClient) client = client_new (fixture);
+  g_autoptr(GDateTime) expiry = epg_client_dup_expiry_date_time (client);
+  g_autoptr(GDateTime) now = g_date_time_new_now_local ();
+
+  g_assert_nonnull (expiry);
+  GTimeSpan difference = g_date_time_difference (expiry, now);
+  g_assert_cmpint (difference, >=, (60 * 60 - 2) * G_TIME_SPAN_SECOND);
+  g_assert_cmpint (difference, <=, (60 * 60 + 2) * G_TIME_SPAN_SECOND);
+
+  /* RateLimitEndTime is 0 in the mock. */
+  g_assert_null (epg_client_dup_rate_limit_end_date_time (client));
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+#define T(path, func) \
+  g_test_add (path, Fixture, NULL, setup, func, teardown)
+  T ("/client/properties", test_client_properties);
+  T ("/client/properties-changed", test_client_properties_changed);
+  T ("/client/add-code", test_client_add_code);
+  T ("/client/date-time", test_client_date_time);
+#undef T
+
+  return g_test_run ();
+}
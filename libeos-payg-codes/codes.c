@@ -64,13 +64,42 @@
  * and the code displayed to the user (half of which is the message, half of which is the truncated signature calculated using Sign) is defined as:
  *  - Code-Value = (P ∥ C ∥ Sign(K, C, P)) mod 10^8
  * and it’s formatted base-10 using normal digits.
+ *
+ * That is scheme 1 (%EPC_SCHEME_1), which is the default. The #EpcCode
+ * functions only ever use scheme 1. Later schemes use the same construction
+ * with a different MAC and wider fields; scheme 2 (%EPC_SCHEME_2) is:
+ *  - C is a counter (16 bits), so a key can issue 65536 codes per period
+ *  - P is the time period (5 bits), as before
+ *  - V is the scheme version (the byte 2)
+ *  - Sign(K, C, P) = Truncate(HMAC-SHA-256(K, V ∥ P ∥ C)), with C big-endian
+ *    and Truncate selecting 18 bits
+ *  - Code-Value = P ∥ C ∥ Sign(K, C, P), which is 39 bits, formatted as 12
+ *    digits
+ * Prefixing the version keeps the signatures of the two schemes independent
+ * if the same key is used with both.
+ *
+ * In all schemes, Truncate takes the last 32 bits of the MAC, big-endian, and
+ * keeps the least significant bits of them. For scheme 1 that is the same as
+ * the 13 least significant bits of bytes 18 and 19 of the HMAC-SHA-1 output.
  */
-#define COUNTER_WIDTH_BITS 8
-#define PERIOD_WIDTH_BITS 5
-#define SIGN_WIDTH_BITS 13
-#define CODE_VALUE_WIDTH_BITS (COUNTER_WIDTH_BITS + PERIOD_WIDTH_BITS + SIGN_WIDTH_BITS)
+#define COUNTER_WIDTH_BITS EPC_CODE_COUNTER_WIDTH_BITS
+#define PERIOD_WIDTH_BITS EPC_CODE_PERIOD_WIDTH_BITS
+#define SIGN_WIDTH_BITS EPC_CODE_SIGNATURE_WIDTH_BITS
+#define CODE_VALUE_WIDTH_BITS EPC_CODE_WIDTH_BITS
 #define CODE_STR_WIDTH_DIGITS 8
 
+#define V2_COUNTER_WIDTH_BITS 16
+#define V2_SIGN_WIDTH_BITS 18
+#define V2_CODE_VALUE_WIDTH_BITS (V2_COUNTER_WIDTH_BITS + PERIOD_WIDTH_BITS + V2_SIGN_WIDTH_BITS)
+#define V2_CODE_STR_WIDTH_DIGITS 12
+
+G_STATIC_ASSERT ((1 << COUNTER_WIDTH_BITS) - 1 == EPC_MAXCOUNTER);
+
+/* Every code value must fit in its string form. */
+G_STATIC_ASSERT ((1 << CODE_VALUE_WIDTH_BITS) <= 100000000);
+G_STATIC_ASSERT ((G_GUINT64_CONSTANT (1) << V2_CODE_VALUE_WIDTH_BITS) <=
+                 G_GUINT64_CONSTANT (1000000000000));
+
 /* The key is used with the HMAC() function, which always adjusts it to be the
  * same as the block size of the hash function in use (in this case, SHA-1).
  * If the key is too short, it is padded; if it’s too long, it’s hashed. We want
@@ -138,6 +167,102 @@ epc_period_validate (EpcPeriod   period,
     }
 }
 
+/* String forms of the periods, as accepted by the command line tools. */
+static const struct
+  {
+    EpcPeriod period;
+    const gchar *period_str;
+  }
+period_strs[] =
+  {
+    { EPC_PERIOD_5_SECONDS, "5s" },
+    { EPC_PERIOD_1_MINUTE, "1m" },
+    { EPC_PERIOD_5_MINUTES, "5m" },
+    { EPC_PERIOD_30_MINUTES, "30m" },
+    { EPC_PERIOD_1_HOUR, "1h" },
+    { EPC_PERIOD_8_HOURS, "8h" },
+    { EPC_PERIOD_1_DAY, "1d" },
+    { EPC_PERIOD_2_DAYS, "2d" },
+    { EPC_PERIOD_3_DAYS, "3d" },
+    { EPC_PERIOD_4_DAYS, "4d" },
+    { EPC_PERIOD_5_DAYS, "5d" },
+    { EPC_PERIOD_6_DAYS, "6d" },
+    { EPC_PERIOD_7_DAYS, "7d" },
+    { EPC_PERIOD_8_DAYS, "8d" },
+    { EPC_PERIOD_9_DAYS, "9d" },
+    { EPC_PERIOD_10_DAYS, "10d" },
+    { EPC_PERIOD_11_DAYS, "11d" },
+    { EPC_PERIOD_12_DAYS, "12d" },
+    { EPC_PERIOD_13_DAYS, "13d" },
+    { EPC_PERIOD_14_DAYS, "14d" },
+    { EPC_PERIOD_30_DAYS, "30d" },
+    { EPC_PERIOD_31_DAYS, "31d" },
+    { EPC_PERIOD_60_DAYS, "60d" },
+    { EPC_PERIOD_90_DAYS, "90d" },
+    { EPC_PERIOD_120_DAYS, "120d" },
+    { EPC_PERIOD_365_DAYS, "365d" },
+    { EPC_PERIOD_INFINITE, "infinite" },
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (period_strs) == EPC_N_PERIODS);
+
+/**
+ * epc_period_from_string:
+ * @period_str: string form of a period, such as `14d`
+ * @period_out: (out caller-allocates): return location for the period
+ * @error: return location for a #GError
+ *
+ * Parse the string form of a period, as returned by epc_period_to_string().
+ * If @period_str is not a known period, %EPC_CODE_ERROR_INVALID_PERIOD will be
+ * returned.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_period_from_string (const gchar  *period_str,
+                        EpcPeriod    *period_out,
+                        GError      **error)
+{
+  g_return_val_if_fail (period_str != NULL, FALSE);
+  g_return_val_if_fail (period_out != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (period_strs); i++)
+    {
+      if (g_str_equal (period_str, period_strs[i].period_str))
+        {
+          *period_out = period_strs[i].period;
+          return TRUE;
+        }
+    }
+
+  g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD,
+               _("Invalid period ‘%s’."), period_str);
+  return FALSE;
+}
+
+/**
+ * epc_period_to_string:
+ * @period: a valid period
+ *
+ * Get the string form of @period, such as `14d` for %EPC_PERIOD_14_DAYS. This
+ * can be parsed again using epc_period_from_string().
+ *
+ * Returns: the string form of @period
+ * Since: 0.2.5
+ */
+const gchar *
+epc_period_to_string (EpcPeriod period)
+{
+  for (gsize i = 0; i < G_N_ELEMENTS (period_strs); i++)
+    {
+      if (period_strs[i].period == period)
+        return period_strs[i].period_str;
+    }
+
+  g_return_val_if_reached (NULL);
+}
+
 /* Validate @key to ensure it’s long enough to provide sufficient entropy.
  * Returns %EPC_CODE_ERROR_INVALID_KEY if not. */
 static gboolean
@@ -157,6 +282,275 @@ validate_key (GBytes  *key,
   return TRUE;
 }
 
+/* A MAC backend, used by a scheme to sign messages. new_keyed() returns a MAC
+ * state keyed with a key which has already been validated with validate_key().
+ * sign() returns the last 32 bits of the MAC of @message, big-endian, and must
+ * not modify the keyed state, so it can be reused for several messages and
+ * shared between threads. */
+typedef struct
+{
+  gpointer (*new_keyed) (GBytes *key);
+  void     (*free_keyed) (gpointer keyed_mac);
+  guint32  (*sign) (gconstpointer  keyed_mac,
+                    const guint8  *message,
+                    gsize          message_len);
+} MacBackend;
+
+/* Create a new HMAC state keyed with @key, ready to have messages appended. The
+ * key must already have been validated with validate_key(). */
+static GHmac *
+new_keyed_hmac (GBytes        *key,
+                GChecksumType  digest_type)
+{
+  gsize key_len;
+  const gchar *key_data = g_bytes_get_data (key, &key_len);
+
+  return g_hmac_new (digest_type, (guchar *) key_data, key_len);
+}
+
+static gpointer
+hmac_sha1_new_keyed (GBytes *key)
+{
+  return new_keyed_hmac (key, G_CHECKSUM_SHA1);
+}
+
+static gpointer
+hmac_sha256_new_keyed (GBytes *key)
+{
+  return new_keyed_hmac (key, G_CHECKSUM_SHA256);
+}
+
+static void
+hmac_free_keyed (gpointer keyed_mac)
+{
+  g_hmac_unref (keyed_mac);
+}
+
+/* The keyed state is copied rather than modified. */
+static guint32
+hmac_sign (gconstpointer  keyed_mac,
+           const guint8  *message,
+           gsize          message_len)
+{
+  g_autoptr(GHmac) hmac_state = g_hmac_copy (keyed_mac);
+  g_hmac_update (hmac_state, message, message_len);
+
+  /* Big enough for any digest type we use. */
+  guint8 hmac_data[32] = { 0, };
+  gsize hmac_len = G_N_ELEMENTS (hmac_data);
+  g_hmac_get_digest (hmac_state, hmac_data, &hmac_len);
+  g_assert (hmac_len >= 4);
+
+  return (((guint32) hmac_data[hmac_len - 4]) << 24) |
+         (((guint32) hmac_data[hmac_len - 3]) << 16) |
+         (((guint32) hmac_data[hmac_len - 2]) << 8) |
+         ((guint32) hmac_data[hmac_len - 1]);
+}
+
+static const MacBackend hmac_sha1_backend =
+  {
+    hmac_sha1_new_keyed,
+    hmac_free_keyed,
+    hmac_sign,
+  };
+
+static const MacBackend hmac_sha256_backend =
+  {
+    hmac_sha256_new_keyed,
+    hmac_free_keyed,
+    hmac_sign,
+  };
+
+/* The layout of codes in each #EpcScheme. All schemes use PERIOD_WIDTH_BITS
+ * for the period. */
+typedef struct
+{
+  EpcScheme scheme;
+  const MacBackend *mac;
+  guint counter_width_bits;
+  guint sign_width_bits;
+  guint code_str_width_digits;
+} SchemeInfo;
+
+static const SchemeInfo schemes[] =
+  {
+    {
+      EPC_SCHEME_1,
+      &hmac_sha1_backend,
+      COUNTER_WIDTH_BITS,
+      SIGN_WIDTH_BITS,
+      CODE_STR_WIDTH_DIGITS,
+    },
+    {
+      EPC_SCHEME_2,
+      &hmac_sha256_backend,
+      V2_COUNTER_WIDTH_BITS,
+      V2_SIGN_WIDTH_BITS,
+      V2_CODE_STR_WIDTH_DIGITS,
+    },
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (schemes) == EPC_N_SCHEMES);
+
+/* Look up the #SchemeInfo for @scheme, which must already have been validated
+ * with epc_scheme_validate(). */
+static const SchemeInfo *
+get_scheme_info (EpcScheme scheme)
+{
+  g_assert (scheme >= EPC_SCHEME_1 && scheme <= EPC_N_SCHEMES);
+  g_assert (schemes[scheme - 1].scheme == scheme);
+
+  return &schemes[scheme - 1];
+}
+
+static guint
+scheme_code_value_width_bits (const SchemeInfo *info)
+{
+  return PERIOD_WIDTH_BITS + info->counter_width_bits + info->sign_width_bits;
+}
+
+static gchar *
+format_scheme_code (const SchemeInfo *info,
+                    guint64           code)
+{
+  return g_strdup_printf ("%0*" G_GUINT64_FORMAT,
+                          (int) info->code_str_width_digits, code);
+}
+
+/* Check @code fits in the code space of @info, returning
+ * %EPC_CODE_ERROR_INVALID_CODE if not. */
+static gboolean
+validate_scheme_code (const SchemeInfo  *info,
+                      guint64            code,
+                      GError           **error)
+{
+  if ((code >> scheme_code_value_width_bits (info)) == 0)
+    return TRUE;
+
+  g_autofree gchar *code_str = format_scheme_code (info, code);
+  g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE,
+               _("Invalid code %s."), code_str);
+
+  return FALSE;
+}
+
+/* Check @counter fits in the counter space of @info, returning
+ * %EPC_CODE_ERROR_INVALID_COUNTER if not. */
+static gboolean
+validate_scheme_counter (const SchemeInfo  *info,
+                         guint              counter,
+                         GError           **error)
+{
+  if ((counter >> info->counter_width_bits) == 0)
+    return TRUE;
+
+  g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_COUNTER,
+               _("Counter %u is too big for code scheme %u."),
+               counter, (guint) info->scheme);
+
+  return FALSE;
+}
+
+/* Calculate the code for @period and @counter in the scheme described by
+ * @info, given a @keyed_mac from its MAC backend. @period and @counter must
+ * already have been validated. */
+static guint64
+calculate_scheme_code (const SchemeInfo *info,
+                       gconstpointer     keyed_mac,
+                       EpcPeriod         period,
+                       guint             counter)
+{
+  g_assert ((period >> PERIOD_WIDTH_BITS) == 0);
+  g_assert ((counter >> info->counter_width_bits) == 0);
+
+  /* Build the message: V ∥ P ∥ C, with C big-endian. Scheme 1 predates the
+   * version prefix, so omits it; its P and C are one byte each, which is what
+   * it has always hashed on the little-endian machines it is used on. */
+  guint8 message[1 + 1 + sizeof (guint32)];
+  gsize message_len = 0;
+
+  if (info->scheme != EPC_SCHEME_1)
+    message[message_len++] = (guint8) info->scheme;
+  message[message_len++] = (guint8) period;
+  for (guint shift = (info->counter_width_bits + 7) / 8 * 8; shift > 0; shift -= 8)
+    message[message_len++] = (guint8) (counter >> (shift - 8));
+
+  /* Truncate down to the scheme’s signature width. */
+  const guint32 sign_mask = (1u << info->sign_width_bits) - 1;
+  guint32 sign_result = info->mac->sign (keyed_mac, message, message_len) & sign_mask;
+
+  /* Build the full code to return. */
+  guint64 code_value = (((guint64) period) << (info->counter_width_bits + info->sign_width_bits)) |
+                       (((guint64) counter) << info->sign_width_bits) |
+                       ((guint64) sign_result);
+
+  g_assert (validate_scheme_code (info, code_value, NULL));
+
+  return code_value;
+}
+
+/* Verify @code in the scheme described by @info, using a @keyed_mac from its
+ * MAC backend. @code must already have been validated. The error message is
+ * only formatted if @error is non-%NULL, as callers checking many codes pass
+ * %NULL and expect most of them to be invalid. */
+static gboolean
+verify_scheme_code (const SchemeInfo  *info,
+                    gconstpointer      keyed_mac,
+                    guint64            code,
+                    EpcPeriod         *period_out,
+                    guint             *counter_out,
+                    GError           **error)
+{
+  /* Extract the period and counter. */
+  const guint64 period_mask = (1u << PERIOD_WIDTH_BITS) - 1;
+  EpcPeriod period = (code >> (info->counter_width_bits + info->sign_width_bits)) & period_mask;
+
+  const guint64 counter_mask = (1u << info->counter_width_bits) - 1;
+  guint counter = (code >> info->sign_width_bits) & counter_mask;
+
+  if (!epc_period_validate (period, error))
+    return FALSE;
+
+  /* Re-calculate the code for this @period and @counter and compare it to the
+   * input. */
+  guint64 check_code = calculate_scheme_code (info, keyed_mac, period, counter);
+
+  if (check_code != code)
+    {
+      if (error != NULL)
+        {
+          g_autofree gchar *code_str = format_scheme_code (info, code);
+          g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SIGNATURE,
+                       _("Invalid signature on code %s."), code_str);
+        }
+
+      return FALSE;
+    }
+
+  /* Return what we parsed. */
+  if (period_out != NULL)
+    *period_out = period;
+  if (counter_out != NULL)
+    *counter_out = counter;
+
+  return TRUE;
+}
+
+/* Calculate the scheme 1 code for @period and @counter, given a @keyed_hmac
+ * from hmac_sha1_new_keyed() which has not had any message data added to it.
+ * @period must already have been validated. */
+static EpcCode
+calculate_code_with_hmac (const GHmac *keyed_hmac,
+                          EpcPeriod    period,
+                          EpcCounter   counter)
+{
+  guint64 code_value = calculate_scheme_code (get_scheme_info (EPC_SCHEME_1),
+                                              keyed_hmac, period, counter);
+
+  g_assert (epc_code_validate (code_value, NULL));
+
+  return (EpcCode) code_value;
+}
+
 /**
  * epc_code_validate:
  * @code: possibly an #EpcCode
@@ -220,36 +614,433 @@ epc_calculate_code (EpcPeriod    period,
   if (!validate_key (key, error))
     return 0;
 
-  g_assert ((period >> PERIOD_WIDTH_BITS) == 0);
-  g_assert ((counter >> COUNTER_WIDTH_BITS) == 0);
-
   /* Calculate the HMAC. */
-  gsize key_len;
-  const gchar *key_data = g_bytes_get_data (key, &key_len);
-  g_autoptr(GHmac) hmac_state = g_hmac_new (G_CHECKSUM_SHA1,
-                                            (guchar *) key_data, key_len);
-  g_hmac_update (hmac_state, (guint8 *) &period, 1);
-  g_hmac_update (hmac_state, (guint8 *) &counter, 1);
+  g_autoptr(GHmac) hmac_state = new_keyed_hmac (key, G_CHECKSUM_SHA1);
 
-  guint8 hmac_data[20] = { 0, };
-  gsize hmac_len = G_N_ELEMENTS (hmac_data);
-  g_hmac_get_digest (hmac_state, hmac_data, &hmac_len);
-  g_assert (hmac_len == 20);
+  return calculate_code_with_hmac (hmac_state, period, counter);
+}
 
-  /* Truncate down to SIGN_WIDTH_BITS bits. */
-  const guint16 sign_mask = (1 << SIGN_WIDTH_BITS) - 1;
-  guint16 sign_result = ((((guint16) hmac_data[18]) << 8) | hmac_data[19]) & sign_mask;
+/**
+ * epc_calculate_codes:
+ * @period: period to encode in the codes
+ * @min_counter: first counter to calculate a code for (inclusive)
+ * @max_counter: last counter to calculate a code for (inclusive)
+ * @key: shared key
+ * @error: return location for a #GError
+ *
+ * Calculate the codes for @period and every counter in the range
+ * [@min_counter, @max_counter] using the given shared @key. This is equivalent
+ * to calling epc_calculate_code() for each counter in turn, but only sets up
+ * the keyed HMAC state once, so it is cheaper when generating codes in bulk.
+ *
+ * If @period is invalid, %EPC_CODE_ERROR_INVALID_PERIOD will be returned. If
+ * @key is invalid, %EPC_CODE_ERROR_INVALID_KEY will be returned.
+ *
+ * Returns: (transfer full) (element-type guint32): the calculated codes, in
+ *    counter order, or %NULL on error
+ * Since: 0.2.5
+ */
+GArray *
+epc_calculate_codes (EpcPeriod    period,
+                     EpcCounter   min_counter,
+                     EpcCounter   max_counter,
+                     GBytes      *key,
+                     GError     **error)
+{
+  g_return_val_if_fail (min_counter <= max_counter, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  g_assert ((sign_result >> SIGN_WIDTH_BITS) == 0);
+  if (!epc_period_validate (period, error))
+    return NULL;
+  if (!validate_key (key, error))
+    return NULL;
 
-  /* Build the full 26-bit code to return. */
-  guint32 code_value = (((guint32) period) << (COUNTER_WIDTH_BITS + SIGN_WIDTH_BITS)) |
-                       (((guint32) counter) << SIGN_WIDTH_BITS) |
-                       ((guint32) sign_result);
+  guint n_codes = (guint) max_counter - (guint) min_counter + 1;
+  g_autoptr(GArray) codes = g_array_sized_new (FALSE, FALSE, sizeof (EpcCode),
+                                               n_codes);
+  g_autoptr(GHmac) hmac_state = new_keyed_hmac (key, G_CHECKSUM_SHA1);
 
-  g_assert (epc_code_validate (code_value, NULL));
+  for (guint i = 0; i < n_codes; i++)
+    {
+      EpcCode code = calculate_code_with_hmac (hmac_state, period,
+                                               (EpcCounter) (min_counter + i));
+      g_array_append_val (codes, code);
+    }
 
-  return code_value;
+  return g_steal_pointer (&codes);
+}
+
+/**
+ * epc_scheme_validate:
+ * @scheme: possibly an #EpcScheme
+ * @error: return location for a #GError
+ *
+ * Validate @scheme to work out whether it’s a supported #EpcScheme. If not,
+ * %EPC_CODE_ERROR_INVALID_SCHEME will be returned.
+ *
+ * Returns: %TRUE if @scheme is valid, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_scheme_validate (EpcScheme   scheme,
+                     GError    **error)
+{
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  switch (scheme)
+    {
+    case EPC_SCHEME_1:
+    case EPC_SCHEME_2:
+      return TRUE;
+    default:
+      g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SCHEME,
+                   _("Unknown code scheme %u."), (guint) scheme);
+      return FALSE;
+    }
+}
+
+/**
+ * epc_scheme_get_max_counter:
+ * @scheme: a valid scheme
+ *
+ * Get the maximum counter value (inclusive) which can be encoded in a code
+ * in @scheme. This is %EPC_MAXCOUNTER for %EPC_SCHEME_1. The minimum is always
+ * %EPC_MINCOUNTER.
+ *
+ * Returns: maximum counter value for @scheme
+ * Since: 0.2.5
+ */
+guint
+epc_scheme_get_max_counter (EpcScheme scheme)
+{
+  g_return_val_if_fail (epc_scheme_validate (scheme, NULL), 0);
+
+  return (1u << get_scheme_info (scheme)->counter_width_bits) - 1;
+}
+
+/**
+ * epc_scheme_get_code_length:
+ * @scheme: a valid scheme
+ *
+ * Get the number of digits in the string form of codes in @scheme.
+ *
+ * Returns: length of codes in @scheme, in digits
+ * Since: 0.2.5
+ */
+guint
+epc_scheme_get_code_length (EpcScheme scheme)
+{
+  g_return_val_if_fail (epc_scheme_validate (scheme, NULL), 0);
+
+  return get_scheme_info (scheme)->code_str_width_digits;
+}
+
+/**
+ * epc_scheme_code_validate:
+ * @scheme: a valid scheme
+ * @code: possibly a code in @scheme
+ * @error: return location for a #GError
+ *
+ * Validate @code to work out whether it lies within the code space of
+ * @scheme, as with epc_code_validate(). If not, %EPC_CODE_ERROR_INVALID_CODE
+ * will be returned.
+ *
+ * Returns: %TRUE if @code is valid, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_scheme_code_validate (EpcScheme   scheme,
+                          guint64     code,
+                          GError    **error)
+{
+  g_return_val_if_fail (epc_scheme_validate (scheme, NULL), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return validate_scheme_code (get_scheme_info (scheme), code, error);
+}
+
+/**
+ * epc_scheme_format_code:
+ * @scheme: a valid scheme
+ * @code: a valid code in @scheme
+ *
+ * Format the given @code as a string of epc_scheme_get_code_length() digits,
+ * as with epc_format_code(). The return value from this function is guaranteed
+ * to be parsable by epc_scheme_parse_code().
+ *
+ * Returns: (transfer full): string form of @code
+ * Since: 0.2.5
+ */
+gchar *
+epc_scheme_format_code (EpcScheme scheme,
+                        guint64   code)
+{
+  g_return_val_if_fail (epc_scheme_validate (scheme, NULL), NULL);
+  g_return_val_if_fail (epc_scheme_code_validate (scheme, code, NULL), NULL);
+
+  const SchemeInfo *info = get_scheme_info (scheme);
+  g_autofree gchar *code_str = format_scheme_code (info, code);
+  g_assert (strlen (code_str) == info->code_str_width_digits);
+
+  return g_steal_pointer (&code_str);
+}
+
+/**
+ * epc_scheme_parse_code:
+ * @scheme: a valid scheme
+ * @code_str: a valid code to parse
+ * @code_out: (out caller-allocates) (optional): return location for the
+ *    parsed code
+ * @error: return location for a #GError
+ *
+ * Parse the given @code_str, as with epc_parse_code(), for a code in @scheme.
+ * If the string is not parsable as a code, or would result in an invalid
+ * code, %EPC_CODE_ERROR_INVALID_CODE is returned.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_scheme_parse_code (EpcScheme     scheme,
+                       const gchar  *code_str,
+                       guint64      *code_out,
+                       GError      **error)
+{
+  g_return_val_if_fail (epc_scheme_validate (scheme, NULL), FALSE);
+  g_return_val_if_fail (code_str != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  const SchemeInfo *info = get_scheme_info (scheme);
+  guint64 code_value;
+
+  if (strlen (code_str) != info->code_str_width_digits ||
+      !g_ascii_string_to_unsigned (code_str,
+                                   10,  /* base */
+                                   0,  /* minimum */
+                                   G_MAXUINT64,  /* maximum */
+                                   &code_value,
+                                   NULL))
+    {
+      g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE,
+                   _("Codes must be %u digits long."),
+                   info->code_str_width_digits);
+      return FALSE;
+    }
+
+  if (!validate_scheme_code (info, code_value, error))
+    return FALSE;
+
+  if (code_out != NULL)
+    *code_out = code_value;
+
+  return TRUE;
+}
+
+/**
+ * EpcSigningKey:
+ *
+ * A shared key, prepared for calculating and verifying codes in a particular
+ * #EpcScheme. Preparing the key once, rather than passing it to
+ * epc_calculate_code() each time, saves the cost of setting up the MAC state
+ * for every code; this makes a difference when a long-running process
+ * calculates many codes with the same keys.
+ *
+ * Codes and counters are handled as #guint64 and #guint, so that they can hold
+ * values from any scheme. For %EPC_SCHEME_1 they have the same values as the
+ * corresponding #EpcCode and #EpcCounter.
+ *
+ * An #EpcSigningKey is immutable, so can be used from several threads at once.
+ *
+ * Since: 0.2.5
+ */
+struct _EpcSigningKey
+{
+  gint ref_count;
+  const SchemeInfo *scheme_info;  /* (unowned) */
+  gpointer keyed_mac;  /* (owned) */
+};
+
+G_DEFINE_BOXED_TYPE (EpcSigningKey, epc_signing_key,
+                     epc_signing_key_ref, epc_signing_key_unref)
+
+/**
+ * epc_signing_key_new:
+ * @key: shared key
+ * @error: return location for a #GError
+ *
+ * Prepare @key for calculating codes in %EPC_SCHEME_DEFAULT, as with
+ * epc_signing_key_new_for_scheme().
+ *
+ * Returns: (transfer full): the prepared key, or %NULL on error
+ * Since: 0.2.5
+ */
+EpcSigningKey *
+epc_signing_key_new (GBytes  *key,
+                     GError **error)
+{
+  return epc_signing_key_new_for_scheme (key, EPC_SCHEME_DEFAULT, error);
+}
+
+/**
+ * epc_signing_key_new_for_scheme:
+ * @key: shared key
+ * @scheme: scheme to calculate and verify codes in
+ * @error: return location for a #GError
+ *
+ * Prepare @key for calculating codes in @scheme with
+ * epc_signing_key_calculate_code(). If @key is invalid,
+ * %EPC_CODE_ERROR_INVALID_KEY will be returned; if @scheme is invalid,
+ * %EPC_CODE_ERROR_INVALID_SCHEME will be returned.
+ *
+ * Returns: (transfer full): the prepared key, or %NULL on error
+ * Since: 0.2.5
+ */
+EpcSigningKey *
+epc_signing_key_new_for_scheme (GBytes     *key,
+                                EpcScheme   scheme,
+                                GError    **error)
+{
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (!epc_scheme_validate (scheme, error))
+    return NULL;
+  if (!validate_key (key, error))
+    return NULL;
+
+  EpcSigningKey *self = g_new0 (EpcSigningKey, 1);
+  self->ref_count = 1;
+  self->scheme_info = get_scheme_info (scheme);
+  self->keyed_mac = self->scheme_info->mac->new_keyed (key);
+
+  return self;
+}
+
+/**
+ * epc_signing_key_ref:
+ * @self: a signing key
+ *
+ * Increment the reference count of @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 0.2.5
+ */
+EpcSigningKey *
+epc_signing_key_ref (EpcSigningKey *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+/**
+ * epc_signing_key_unref:
+ * @self: (transfer full): a signing key
+ *
+ * Decrement the reference count of @self, freeing it if this was the last
+ * reference.
+ *
+ * Since: 0.2.5
+ */
+void
+epc_signing_key_unref (EpcSigningKey *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  self->scheme_info->mac->free_keyed (self->keyed_mac);
+  g_free (self);
+}
+
+/**
+ * epc_signing_key_get_scheme:
+ * @self: a signing key
+ *
+ * Get the scheme which @self calculates and verifies codes in.
+ *
+ * Returns: the scheme for @self
+ * Since: 0.2.5
+ */
+EpcScheme
+epc_signing_key_get_scheme (EpcSigningKey *self)
+{
+  g_return_val_if_fail (self != NULL, EPC_SCHEME_DEFAULT);
+
+  return self->scheme_info->scheme;
+}
+
+/**
+ * epc_signing_key_calculate_code:
+ * @self: a signing key
+ * @period: period to encode in the code
+ * @counter: counter to encode in the code
+ * @error: return location for a #GError
+ *
+ * Calculate a code for @period and @counter, as with epc_calculate_code(),
+ * using the key and scheme prepared in @self.
+ *
+ * If @period is invalid, %EPC_CODE_ERROR_INVALID_PERIOD will be returned. If
+ * @counter is bigger than epc_scheme_get_max_counter() for the scheme,
+ * %EPC_CODE_ERROR_INVALID_COUNTER will be returned.
+ *
+ * Returns: the calculated code
+ * Since: 0.2.5
+ */
+guint64
+epc_signing_key_calculate_code (EpcSigningKey  *self,
+                                EpcPeriod       period,
+                                guint           counter,
+                                GError        **error)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (error == NULL || *error == NULL, 0);
+
+  if (!epc_period_validate (period, error))
+    return 0;
+  if (!validate_scheme_counter (self->scheme_info, counter, error))
+    return 0;
+
+  return calculate_scheme_code (self->scheme_info, self->keyed_mac, period,
+                                counter);
+}
+
+/**
+ * epc_signing_key_verify_code:
+ * @self: a signing key
+ * @code: code to verify
+ * @period_out: (out caller-allocates) (optional): return location for the
+ *    period encoded in the code
+ * @counter_out: (out caller-allocates) (optional): return location for the
+ *    counter encoded in the code
+ * @error: return location for a #GError
+ *
+ * Verify @code, as with epc_verify_code(), using the key and scheme prepared
+ * in @self. This is much cheaper than epc_verify_code() when verifying many
+ * codes with the same key. The same errors are returned.
+ *
+ * Returns: %TRUE if @code is valid, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_signing_key_verify_code (EpcSigningKey  *self,
+                             guint64         code,
+                             EpcPeriod      *period_out,
+                             guint          *counter_out,
+                             GError        **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!validate_scheme_code (self->scheme_info, code, error))
+    return FALSE;
+
+  return verify_scheme_code (self->scheme_info, self->keyed_mac, code, period_out,
+                             counter_out, error);
 }
 
 /**
@@ -275,8 +1066,6 @@ epc_verify_code (EpcCode      code,
                  EpcCounter  *counter_out,
                  GError     **error)
 {
-  g_autoptr(GError) local_error = NULL;
-
   g_return_val_if_fail (key != NULL, FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
@@ -285,37 +1074,15 @@ epc_verify_code (EpcCode      code,
   if (!validate_key (key, error))
     return FALSE;
 
-  /* Extract the period and counter. */
-  const guint32 period_mask = (1 << PERIOD_WIDTH_BITS) - 1;
-  EpcPeriod period = (code >> (COUNTER_WIDTH_BITS + SIGN_WIDTH_BITS)) & period_mask;
+  g_autoptr(GHmac) keyed_hmac = new_keyed_hmac (key, G_CHECKSUM_SHA1);
+  guint counter;
 
-  const guint32 counter_mask = (1 << COUNTER_WIDTH_BITS) - 1;
-  EpcCounter counter = (code >> SIGN_WIDTH_BITS) & counter_mask;
-
-  /* Re-calculate the code for this @period, @counter and @key and compare it
-   * to the input. */
-  EpcCode check_code = epc_calculate_code (period, counter, key, &local_error);
-
-  if (local_error != NULL)
-    {
-      g_propagate_error (error, g_steal_pointer (&local_error));
-      return FALSE;
-    }
-
-  /* Compare the codes. */
-  if (check_code != code)
-    {
-      g_autofree gchar *code_str = epc_format_code (code);
-      g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SIGNATURE,
-                   _("Invalid signature on code %s."), code_str);
-      return FALSE;
-    }
+  if (!verify_scheme_code (get_scheme_info (EPC_SCHEME_1), keyed_hmac, code,
+                           period_out, &counter, error))
+    return FALSE;
 
-  /* Return what we parsed. */
-  if (period_out != NULL)
-    *period_out = period;
   if (counter_out != NULL)
-    *counter_out = counter;
+    *counter_out = (EpcCounter) counter;
 
   return TRUE;
 }
@@ -342,6 +1109,34 @@ epc_format_code (EpcCode code)
   return g_steal_pointer (&code_str);
 }
 
+/**
+ * epc_format_codes:
+ * @codes: (array length=n_codes): valid codes to format
+ * @n_codes: number of elements in @codes
+ *
+ * Format each of the given @codes as a string, as with epc_format_code().
+ *
+ * Returns: (transfer full) (array zero-terminated=1): a %NULL-terminated array
+ *    of the string forms of @codes, in the same order
+ * Since: 0.2.5
+ */
+gchar **
+epc_format_codes (const EpcCode *codes,
+                  gsize          n_codes)
+{
+  g_return_val_if_fail (codes != NULL || n_codes == 0, NULL);
+
+  g_auto(GStrv) code_strs = g_new0 (gchar *, n_codes + 1);
+
+  for (gsize i = 0; i < n_codes; i++)
+    {
+      code_strs[i] = epc_format_code (codes[i]);
+      g_return_val_if_fail (code_strs[i] != NULL, NULL);
+    }
+
+  return g_steal_pointer (&code_strs);
+}
+
 /**
  * epc_parse_code:
  * @code_str: a valid code to parse
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <glib.h>
+#include <glib-object.h>
 
 G_BEGIN_DECLS
 
@@ -32,6 +33,10 @@ G_BEGIN_DECLS
  *    by being outside the permitted code space.
  * @EPC_CODE_ERROR_INVALID_SIGNATURE: When verifying a code, the signature
  *    did not match the message.
+ * @EPC_CODE_ERROR_INVALID_SCHEME: An #EpcScheme was invalid, using a value
+ *    outside the enumerated set. (Since: 0.2.5)
+ * @EPC_CODE_ERROR_INVALID_COUNTER: A counter was too big for the code space
+ *    of the #EpcScheme in use. (Since: 0.2.5)
  *
  * Errors which can be returned by the code generation and verification
  * functions.
@@ -44,8 +49,10 @@ typedef enum
   EPC_CODE_ERROR_INVALID_KEY,
   EPC_CODE_ERROR_INVALID_CODE,
   EPC_CODE_ERROR_INVALID_SIGNATURE,
+  EPC_CODE_ERROR_INVALID_SCHEME,
+  EPC_CODE_ERROR_INVALID_COUNTER,
 } EpcCodeError;
-#define EPC_CODE_N_ERRORS (EPC_CODE_ERROR_INVALID_CODE + 1)
+#define EPC_CODE_N_ERRORS (EPC_CODE_ERROR_INVALID_COUNTER + 1)
 
 GQuark epc_code_error_quark (void);
 #define EPC_CODE_ERROR epc_code_error_quark ()
@@ -109,6 +116,11 @@ typedef enum
 gboolean epc_period_validate (EpcPeriod   period,
                               GError    **error);
 
+gboolean     epc_period_from_string (const gchar  *period_str,
+                                     EpcPeriod    *period_out,
+                                     GError      **error);
+const gchar *epc_period_to_string   (EpcPeriod     period);
+
 /**
  * EpcCounter:
  *
@@ -162,6 +174,50 @@ typedef guint8 EpcCounter;
  */
 typedef guint32 EpcCode;
 
+/**
+ * EPC_CODE_PERIOD_WIDTH_BITS:
+ *
+ * Number of bits of an #EpcCode which hold its #EpcPeriod. This is the same in
+ * every #EpcScheme.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_CODE_PERIOD_WIDTH_BITS 5
+
+/**
+ * EPC_CODE_COUNTER_WIDTH_BITS:
+ *
+ * Number of bits of an #EpcCode which hold its #EpcCounter. Use
+ * epc_scheme_get_max_counter() for other schemes.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_CODE_COUNTER_WIDTH_BITS 8
+
+/**
+ * EPC_CODE_SIGNATURE_WIDTH_BITS:
+ *
+ * Number of bits of an #EpcCode which hold its truncated signature. A guess at
+ * a code for a given period and counter has a 1 in
+ * 2^%EPC_CODE_SIGNATURE_WIDTH_BITS chance of being valid.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_CODE_SIGNATURE_WIDTH_BITS 13
+
+/**
+ * EPC_CODE_WIDTH_BITS:
+ *
+ * Number of significant bits in an #EpcCode; the sum of
+ * %EPC_CODE_PERIOD_WIDTH_BITS, %EPC_CODE_COUNTER_WIDTH_BITS and
+ * %EPC_CODE_SIGNATURE_WIDTH_BITS.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_CODE_WIDTH_BITS (EPC_CODE_PERIOD_WIDTH_BITS + \
+                             EPC_CODE_COUNTER_WIDTH_BITS + \
+                             EPC_CODE_SIGNATURE_WIDTH_BITS)
+
 gboolean epc_code_validate  (EpcCode       code,
                              GError      **error);
 
@@ -169,13 +225,102 @@ EpcCode  epc_calculate_code (EpcPeriod     period,
                              EpcCounter    counter,
                              GBytes       *key,
                              GError      **error);
+GArray  *epc_calculate_codes (EpcPeriod    period,
+                              EpcCounter   min_counter,
+                              EpcCounter   max_counter,
+                              GBytes      *key,
+                              GError     **error);
 gboolean epc_verify_code    (EpcCode       code,
                              GBytes       *key,
                              EpcPeriod    *period_out,
                              EpcCounter   *counter_out,
                              GError      **error);
 
+/**
+ * EpcScheme:
+ * @EPC_SCHEME_1: HMAC-SHA-1 signatures truncated to 13 bits, with 8-bit
+ *    counters, in 8-digit codes. This is the scheme used by the #EpcCode
+ *    functions, such as epc_calculate_code().
+ * @EPC_SCHEME_2: HMAC-SHA-256 signatures truncated to 18 bits, with 16-bit
+ *    counters, in 12-digit codes.
+ *
+ * Versions of the scheme used to sign and lay out codes. The generating and
+ * verifying sides must agree on the scheme in use, as well as on the shared
+ * key; the scheme is not encoded in the code itself.
+ *
+ * More schemes may be added to this set in future.
+ *
+ * Since: 0.2.5
+ */
+typedef enum
+{
+  EPC_SCHEME_1 = 1,
+  EPC_SCHEME_2 = 2,
+  /* add additional schemes here, and update %EPC_N_SCHEMES */
+} EpcScheme;
+
+/**
+ * EPC_N_SCHEMES:
+ *
+ * The number of schemes defined in #EpcScheme.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_N_SCHEMES 2
+
+/**
+ * EPC_SCHEME_DEFAULT:
+ *
+ * The scheme used when none is specified, which is %EPC_SCHEME_1.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_SCHEME_DEFAULT EPC_SCHEME_1
+
+gboolean  epc_scheme_validate        (EpcScheme     scheme,
+                                      GError      **error);
+guint     epc_scheme_get_max_counter (EpcScheme     scheme);
+guint     epc_scheme_get_code_length (EpcScheme     scheme);
+gboolean  epc_scheme_code_validate   (EpcScheme     scheme,
+                                      guint64       code,
+                                      GError      **error);
+gchar    *epc_scheme_format_code     (EpcScheme     scheme,
+                                      guint64       code);
+gboolean  epc_scheme_parse_code      (EpcScheme     scheme,
+                                      const gchar  *code_str,
+                                      guint64      *code_out,
+                                      GError      **error);
+
+typedef struct _EpcSigningKey EpcSigningKey;
+
+#define EPC_TYPE_SIGNING_KEY (epc_signing_key_get_type ())
+GType epc_signing_key_get_type (void);
+
+EpcSigningKey *epc_signing_key_new            (GBytes         *key,
+                                               GError        **error);
+EpcSigningKey *epc_signing_key_new_for_scheme (GBytes         *key,
+                                               EpcScheme       scheme,
+                                               GError        **error);
+EpcSigningKey *epc_signing_key_ref            (EpcSigningKey  *self);
+void           epc_signing_key_unref          (EpcSigningKey  *self);
+
+EpcScheme epc_signing_key_get_scheme     (EpcSigningKey  *self);
+
+guint64   epc_signing_key_calculate_code (EpcSigningKey  *self,
+                                          EpcPeriod       period,
+                                          guint           counter,
+                                          GError        **error);
+gboolean  epc_signing_key_verify_code    (EpcSigningKey  *self,
+                                          guint64         code,
+                                          EpcPeriod      *period_out,
+                                          guint          *counter_out,
+                                          GError        **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EpcSigningKey, epc_signing_key_unref)
+
 gchar    *epc_format_code   (EpcCode       code);
+gchar   **epc_format_codes  (const EpcCode *codes,
+                             gsize          n_codes);
 gboolean  epc_parse_code    (const gchar  *code_str,
                              EpcCode      *code_out,
                              GError      **error);
@@ -0,0 +1,543 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gi18n-lib.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * A key store holds the shared keys for a fleet of devices, indexed by device
+ * ID, so that the key for one device can be found in O(log n) time without
+ * parsing the whole file. It is designed to be memory-mapped.
+ *
+ * All integers are little-endian. The file is laid out as:
+ *
+ *  - Header (HEADER_SIZE bytes):
+ *     - 0: magic, KEY_STORE_MAGIC
+ *     - 8: guint32 format version, KEY_STORE_VERSION
+ *     - 12: guint32 number of entries, n
+ *     - 16: guint32 flags; must be zero (reserved for an encrypted variant)
+ *     - 20: reserved, zero
+ *  - Index (n × ENTRY_SIZE bytes), sorted by device ID (bytewise):
+ *     - 0: device ID, NUL-padded to DEVICE_ID_FIELD_SIZE bytes
+ *     - 16: guint64 offset of the key from the start of the file
+ *     - 24: guint32 length of the key
+ *     - 28: reserved, zero
+ *  - Key data, referenced from the index.
+ *
+ * Keys are not encrypted, so key store files must be protected in the same
+ * way as the files holding individual keys.
+ */
+#define KEY_STORE_MAGIC "EPCKEYS"  /* plus the implicit nul */
+#define KEY_STORE_VERSION 1
+#define HEADER_SIZE 32
+#define ENTRY_SIZE 32
+#define DEVICE_ID_FIELD_SIZE (EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH + 1)
+
+G_STATIC_ASSERT (sizeof (KEY_STORE_MAGIC) == 8);
+G_STATIC_ASSERT (DEVICE_ID_FIELD_SIZE == 16);
+
+G_DEFINE_QUARK (EpcKeyStoreError, epc_key_store_error)
+
+static guint32
+read_uint32 (const guint8 *data)
+{
+  guint32 value;
+  memcpy (&value, data, sizeof (value));
+  return GUINT32_FROM_LE (value);
+}
+
+static guint64
+read_uint64 (const guint8 *data)
+{
+  guint64 value;
+  memcpy (&value, data, sizeof (value));
+  return GUINT64_FROM_LE (value);
+}
+
+static void
+append_uint32 (GByteArray *array,
+               guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_uint64 (GByteArray *array,
+               guint64     value)
+{
+  value = GUINT64_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+/* Pad @device_id into the fixed-size field used in the index. */
+static gboolean
+device_id_to_field (const gchar  *device_id,
+                    guint8        field[DEVICE_ID_FIELD_SIZE],
+                    GError      **error)
+{
+  gsize len = strlen (device_id);
+
+  if (len == 0 || len > EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH)
+    {
+      g_set_error (error, EPC_KEY_STORE_ERROR,
+                   EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID,
+                   _("Invalid device ID ‘%s’: must be between 1 and %u bytes long."),
+                   device_id, (guint) EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH);
+      return FALSE;
+    }
+
+  memset (field, 0, DEVICE_ID_FIELD_SIZE);
+  memcpy (field, device_id, len);
+
+  return TRUE;
+}
+
+/**
+ * EpcKeyStore:
+ *
+ * A read-only, memory-mapped key store file. See epc_key_store_new_for_path().
+ *
+ * Since: 0.2.5
+ */
+struct _EpcKeyStore
+{
+  gint ref_count;
+  GBytes *data;  /* (owned) */
+  gsize n_entries;
+};
+
+G_DEFINE_BOXED_TYPE (EpcKeyStore, epc_key_store,
+                     epc_key_store_ref, epc_key_store_unref)
+
+/**
+ * epc_key_store_new_for_path:
+ * @path: (type filename): path to a key store file
+ * @error: return location for a #GError
+ *
+ * Open the key store at @path. The file is memory-mapped, and only its header
+ * is checked here; keys are looked up with epc_key_store_lookup().
+ *
+ * The file must not be modified while it is open. Key stores are written
+ * atomically by epc_key_store_builder_write_to_path(), so replacing one with a
+ * new version is safe.
+ *
+ * If the file is corrupt or in an unsupported format,
+ * %EPC_KEY_STORE_ERROR_INVALID will be returned. Errors from opening the file
+ * are in the #G_FILE_ERROR domain.
+ *
+ * Returns: (transfer full): the key store, or %NULL on error
+ * Since: 0.2.5
+ */
+EpcKeyStore *
+epc_key_store_new_for_path (const gchar  *path,
+                            GError      **error)
+{
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  g_autoptr(GMappedFile) mapped_file = g_mapped_file_new (path, FALSE, error);
+
+  if (mapped_file == NULL)
+    return NULL;
+
+  g_autoptr(GBytes) data = g_mapped_file_get_bytes (mapped_file);
+  gsize size;
+  const guint8 *header = g_bytes_get_data (data, &size);
+
+  if (size < HEADER_SIZE ||
+      memcmp (header, KEY_STORE_MAGIC, sizeof (KEY_STORE_MAGIC)) != 0)
+    {
+      g_set_error (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID,
+                   _("‘%s’ is not a key store."), path);
+      return NULL;
+    }
+
+  guint32 version = read_uint32 (header + 8);
+  guint32 n_entries = read_uint32 (header + 12);
+  guint32 flags = read_uint32 (header + 16);
+
+  if (version != KEY_STORE_VERSION || flags != 0)
+    {
+      g_set_error (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID,
+                   _("Key store ‘%s’ has unsupported version %u (flags %x)."),
+                   path, version, flags);
+      return NULL;
+    }
+
+  if ((size - HEADER_SIZE) / ENTRY_SIZE < n_entries)
+    {
+      g_set_error (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID,
+                   _("Key store ‘%s’ is truncated."), path);
+      return NULL;
+    }
+
+  EpcKeyStore *self = g_new0 (EpcKeyStore, 1);
+  self->ref_count = 1;
+  self->data = g_steal_pointer (&data);
+  self->n_entries = n_entries;
+
+  return self;
+}
+
+/**
+ * epc_key_store_ref:
+ * @self: a key store
+ *
+ * Increment the reference count of @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 0.2.5
+ */
+EpcKeyStore *
+epc_key_store_ref (EpcKeyStore *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+/**
+ * epc_key_store_unref:
+ * @self: (transfer full): a key store
+ *
+ * Decrement the reference count of @self, closing it if this was the last
+ * reference. #GBytes returned by epc_key_store_lookup() remain valid.
+ *
+ * Since: 0.2.5
+ */
+void
+epc_key_store_unref (EpcKeyStore *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_bytes_unref (self->data);
+  g_free (self);
+}
+
+/**
+ * epc_key_store_get_n_keys:
+ * @self: a key store
+ *
+ * Get the number of keys in @self.
+ *
+ * Returns: the number of keys
+ * Since: 0.2.5
+ */
+gsize
+epc_key_store_get_n_keys (EpcKeyStore *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_entries;
+}
+
+/**
+ * epc_key_store_lookup:
+ * @self: a key store
+ * @device_id: device ID to look up
+ * @error: return location for a #GError
+ *
+ * Look up the key for @device_id in @self, using a binary search of the
+ * index.
+ *
+ * If there is no key for @device_id, %EPC_KEY_STORE_ERROR_NOT_FOUND will be
+ * returned. If @device_id could never be in a key store,
+ * %EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID will be returned. If the index entry
+ * for the key is corrupt, %EPC_KEY_STORE_ERROR_INVALID will be returned.
+ *
+ * Returns: (transfer full): the key, which refers to the mapped file rather
+ *    than being copied, or %NULL on error
+ * Since: 0.2.5
+ */
+GBytes *
+epc_key_store_lookup (EpcKeyStore  *self,
+                      const gchar  *device_id,
+                      GError      **error)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (device_id != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  guint8 needle[DEVICE_ID_FIELD_SIZE];
+
+  if (!device_id_to_field (device_id, needle, error))
+    return NULL;
+
+  gsize size;
+  const guint8 *data = g_bytes_get_data (self->data, &size);
+  const guint8 *index = data + HEADER_SIZE;
+  gsize lower = 0, upper = self->n_entries;
+
+  while (lower < upper)
+    {
+      gsize mid = lower + (upper - lower) / 2;
+      const guint8 *entry = index + mid * ENTRY_SIZE;
+      int cmp = memcmp (needle, entry, DEVICE_ID_FIELD_SIZE);
+
+      if (cmp < 0)
+        {
+          upper = mid;
+        }
+      else if (cmp > 0)
+        {
+          lower = mid + 1;
+        }
+      else
+        {
+          guint64 offset = read_uint64 (entry + DEVICE_ID_FIELD_SIZE);
+          guint32 len = read_uint32 (entry + DEVICE_ID_FIELD_SIZE + 8);
+
+          if (offset > size || len > size - offset)
+            {
+              g_set_error (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID,
+                           _("Key store entry for ‘%s’ is corrupt."), device_id);
+              return NULL;
+            }
+
+          return g_bytes_new_from_bytes (self->data, (gsize) offset, len);
+        }
+    }
+
+  g_set_error (error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_NOT_FOUND,
+               _("No key for device ‘%s’ in key store."), device_id);
+  return NULL;
+}
+
+/**
+ * EpcKeyStoreBuilder:
+ *
+ * Collects device IDs and keys to write a new key store file. See
+ * epc_key_store_builder_new().
+ *
+ * Since: 0.2.5
+ */
+struct _EpcKeyStoreBuilder
+{
+  gint ref_count;
+  GHashTable *keys;  /* (owned) (element-type utf8 GBytes) */
+};
+
+G_DEFINE_BOXED_TYPE (EpcKeyStoreBuilder, epc_key_store_builder,
+                     epc_key_store_builder_ref, epc_key_store_builder_unref)
+
+/**
+ * epc_key_store_builder_new:
+ *
+ * Create a new, empty, key store builder. Add keys to it with
+ * epc_key_store_builder_add() and then write it out with
+ * epc_key_store_builder_write_to_path().
+ *
+ * Returns: (transfer full): a new key store builder
+ * Since: 0.2.5
+ */
+EpcKeyStoreBuilder *
+epc_key_store_builder_new (void)
+{
+  EpcKeyStoreBuilder *self = g_new0 (EpcKeyStoreBuilder, 1);
+  self->ref_count = 1;
+  self->keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      g_free, (GDestroyNotify) g_bytes_unref);
+
+  return self;
+}
+
+/**
+ * epc_key_store_builder_ref:
+ * @self: a key store builder
+ *
+ * Increment the reference count of @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 0.2.5
+ */
+EpcKeyStoreBuilder *
+epc_key_store_builder_ref (EpcKeyStoreBuilder *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+/**
+ * epc_key_store_builder_unref:
+ * @self: (transfer full): a key store builder
+ *
+ * Decrement the reference count of @self, freeing it if this was the last
+ * reference.
+ *
+ * Since: 0.2.5
+ */
+void
+epc_key_store_builder_unref (EpcKeyStoreBuilder *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_hash_table_unref (self->keys);
+  g_free (self);
+}
+
+/**
+ * epc_key_store_builder_add:
+ * @self: a key store builder
+ * @device_id: device ID to add a key for
+ * @key: shared key for the device
+ * @error: return location for a #GError
+ *
+ * Add @key as the key for @device_id. If a key has already been added for
+ * @device_id, it is replaced, so when adding keys from a provisioning record
+ * in order, the last key for each device is kept.
+ *
+ * If @device_id is empty or too long, %EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID
+ * will be returned. If @key is too short, %EPC_CODE_ERROR_INVALID_KEY will be
+ * returned.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_key_store_builder_add (EpcKeyStoreBuilder  *self,
+                           const gchar         *device_id,
+                           GBytes              *key,
+                           GError             **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (device_id != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  guint8 field[DEVICE_ID_FIELD_SIZE];
+
+  if (!device_id_to_field (device_id, field, error))
+    return FALSE;
+
+  gsize key_size = g_bytes_get_size (key);
+
+  if (key_size < EPC_KEY_MINIMUM_LENGTH_BYTES)
+    {
+      g_set_error (error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_KEY,
+                   _("Key is too short (%u bytes); minimum length %u bytes."),
+                   (guint) key_size,
+                   (guint) EPC_KEY_MINIMUM_LENGTH_BYTES);
+      return FALSE;
+    }
+
+  g_hash_table_replace (self->keys, g_strdup (device_id), g_bytes_ref (key));
+
+  return TRUE;
+}
+
+static gint
+compare_device_ids (gconstpointer a,
+                    gconstpointer b)
+{
+  return strcmp (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/**
+ * epc_key_store_builder_write_to_path:
+ * @self: a key store builder
+ * @path: (type filename): path to write the key store to
+ * @error: return location for a #GError
+ *
+ * Write a key store containing all the keys added to @self to @path. The file
+ * is replaced atomically, and is only readable by its owner.
+ *
+ * Errors from writing the file are in the #G_FILE_ERROR domain.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epc_key_store_builder_write_to_path (EpcKeyStoreBuilder  *self,
+                                     const gchar         *path,
+                                     GError             **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* Device IDs are compared bytewise when looking them up, which is the same
+   * order as strcmp() gives for their NUL-padded fields. */
+  guint n_entries;
+  g_autofree const gchar **device_ids =
+      (const gchar **) g_hash_table_get_keys_as_array (self->keys, &n_entries);
+  qsort (device_ids, n_entries, sizeof (*device_ids), compare_device_ids);
+
+  g_autoptr(GByteArray) index = g_byte_array_new ();
+  g_autoptr(GByteArray) keys = g_byte_array_new ();
+  guint64 keys_offset = HEADER_SIZE + (guint64) n_entries * ENTRY_SIZE;
+
+  for (guint i = 0; i < n_entries; i++)
+    {
+      GBytes *key = g_hash_table_lookup (self->keys, device_ids[i]);
+      gsize key_len;
+      const guint8 *key_data = g_bytes_get_data (key, &key_len);
+      guint8 field[DEVICE_ID_FIELD_SIZE];
+
+      if (!device_id_to_field (device_ids[i], field, error))
+        g_assert_not_reached ();
+
+      g_byte_array_append (index, field, sizeof (field));
+      append_uint64 (index, keys_offset + keys->len);
+      append_uint32 (index, (guint32) key_len);
+      append_uint32 (index, 0);
+
+      g_byte_array_append (keys, key_data, (guint) key_len);
+    }
+
+  g_autoptr(GByteArray) contents = g_byte_array_sized_new (HEADER_SIZE + index->len + keys->len);
+  const guint8 reserved[HEADER_SIZE - 20] = { 0, };
+
+  g_byte_array_append (contents, (const guint8 *) KEY_STORE_MAGIC, sizeof (KEY_STORE_MAGIC));
+  append_uint32 (contents, KEY_STORE_VERSION);
+  append_uint32 (contents, n_entries);
+  append_uint32 (contents, 0);
+  g_byte_array_append (contents, reserved, sizeof (reserved));
+  g_byte_array_append (contents, index->data, index->len);
+  g_byte_array_append (contents, keys->data, keys->len);
+
+  gboolean success = g_file_set_contents_full (path, (const gchar *) contents->data,
+                                               contents->len,
+                                               G_FILE_SET_CONTENTS_CONSISTENT,
+                                               0600, error);
+
+  /* Don’t leave copies of the keys lying around in freed memory. */
+  memset (keys->data, 0, keys->len);
+  memset (contents->data, 0, contents->len);
+
+  return success;
+}
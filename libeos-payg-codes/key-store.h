@@ -0,0 +1,95 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EpcKeyStoreError:
+ * @EPC_KEY_STORE_ERROR_INVALID: A key store file was corrupt, or in an
+ *    unsupported format.
+ * @EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID: A device ID was empty, or longer
+ *    than %EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH bytes.
+ * @EPC_KEY_STORE_ERROR_NOT_FOUND: A key store did not contain a key for the
+ *    requested device ID.
+ *
+ * Errors which can be returned by the key store functions.
+ *
+ * Since: 0.2.5
+ */
+typedef enum
+{
+  EPC_KEY_STORE_ERROR_INVALID = 0,
+  EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID,
+  EPC_KEY_STORE_ERROR_NOT_FOUND,
+} EpcKeyStoreError;
+
+GQuark epc_key_store_error_quark (void);
+#define EPC_KEY_STORE_ERROR epc_key_store_error_quark ()
+
+/**
+ * EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH:
+ *
+ * Maximum length of a device ID in a key store, in bytes.
+ *
+ * Since: 0.2.5
+ */
+#define EPC_KEY_STORE_DEVICE_ID_MAXIMUM_LENGTH 15
+
+typedef struct _EpcKeyStore EpcKeyStore;
+
+#define EPC_TYPE_KEY_STORE (epc_key_store_get_type ())
+GType epc_key_store_get_type (void);
+
+EpcKeyStore *epc_key_store_new_for_path (const gchar  *path,
+                                         GError      **error);
+EpcKeyStore *epc_key_store_ref          (EpcKeyStore  *self);
+void         epc_key_store_unref        (EpcKeyStore  *self);
+
+gsize        epc_key_store_get_n_keys   (EpcKeyStore  *self);
+GBytes      *epc_key_store_lookup       (EpcKeyStore  *self,
+                                         const gchar  *device_id,
+                                         GError      **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EpcKeyStore, epc_key_store_unref)
+
+typedef struct _EpcKeyStoreBuilder EpcKeyStoreBuilder;
+
+#define EPC_TYPE_KEY_STORE_BUILDER (epc_key_store_builder_get_type ())
+GType epc_key_store_builder_get_type (void);
+
+EpcKeyStoreBuilder *epc_key_store_builder_new   (void);
+EpcKeyStoreBuilder *epc_key_store_builder_ref   (EpcKeyStoreBuilder  *self);
+void                epc_key_store_builder_unref (EpcKeyStoreBuilder  *self);
+
+gboolean epc_key_store_builder_add           (EpcKeyStoreBuilder  *self,
+                                              const gchar         *device_id,
+                                              GBytes              *key,
+                                              GError             **error);
+gboolean epc_key_store_builder_write_to_path (EpcKeyStoreBuilder  *self,
+                                              const gchar         *path,
+                                              GError             **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EpcKeyStoreBuilder, epc_key_store_builder_unref)
+
+G_END_DECLS
@@ -33,6 +33,11 @@
 #define CODE_VALUE_WIDTH_BITS (COUNTER_WIDTH_BITS + PERIOD_WIDTH_BITS + SIGN_WIDTH_BITS)
 #define CODE_STR_WIDTH_DIGITS 8
 
+#define V2_COUNTER_WIDTH_BITS 16
+#define V2_SIGN_WIDTH_BITS 18
+#define V2_CODE_VALUE_WIDTH_BITS (V2_COUNTER_WIDTH_BITS + PERIOD_WIDTH_BITS + V2_SIGN_WIDTH_BITS)
+#define V2_CODE_STR_WIDTH_DIGITS 12
+
 
 /* Test epc_period_validate() works correctly for valid and invalid periods. */
 static void
@@ -77,6 +82,51 @@ test_codes_code_validation (void)
   g_clear_error (&local_error);
 }
 
+/* Test epc_period_from_string() and epc_period_to_string() round-trip for all
+ * valid periods, and that invalid strings are rejected. */
+static void
+test_codes_period_string (void)
+{
+  g_autoptr(GError) local_error = NULL;
+  gsize n_periods = 0;
+
+  for (guint i = 0; i <= EPC_PERIOD_INFINITE; i++)
+    {
+      EpcPeriod period;
+
+      if (!epc_period_validate (i, NULL))
+        continue;
+
+      const gchar *period_str = epc_period_to_string (i);
+      g_assert_nonnull (period_str);
+
+      g_test_message ("Period %u: %s", i, period_str);
+
+      g_assert_true (epc_period_from_string (period_str, &period, &local_error));
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (period, ==, i);
+
+      n_periods++;
+    }
+
+  g_assert_cmpuint (n_periods, ==, EPC_N_PERIODS);
+
+  g_assert_cmpstr (epc_period_to_string (EPC_PERIOD_14_DAYS), ==, "14d");
+
+  const gchar *invalid_strs[] = { "", "14", "14D", "0d", "forever", "1h " };
+
+  for (gsize i = 0; i < G_N_ELEMENTS (invalid_strs); i++)
+    {
+      EpcPeriod period = EPC_PERIOD_5_SECONDS;
+
+      g_test_message ("Invalid string: ‘%s’", invalid_strs[i]);
+
+      g_assert_false (epc_period_from_string (invalid_strs[i], &period, &local_error));
+      g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD);
+      g_clear_error (&local_error);
+    }
+}
+
 /* Test round-trip calls between epc_calculate_code() and epc_verify_code(),
  * using only valid sets of inputs. The generated codes are compared against
  * known-good values to make sure they don’t change in future. */
@@ -235,6 +285,158 @@ test_codes_verify_error (void)
     }
 }
 
+/* Test that epc_signing_key_calculate_code() gives the same results as
+ * epc_calculate_code(), that epc_signing_key_verify_code() accepts those codes
+ * and nothing near them, and that invalid keys, periods and codes are
+ * rejected. */
+static void
+test_codes_signing_key (void)
+{
+  const gchar *key1_data =
+      "hello this has to be at least 64 bytes long so I am going to keep on typing.";
+  g_autoptr(GBytes) key1 = g_bytes_new_static (key1_data, strlen (key1_data));
+  g_autoptr(GBytes) invalid_key = g_bytes_new_static ("", 0);
+  g_autoptr(EpcSigningKey) signing_key = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  signing_key = epc_signing_key_new (key1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (signing_key);
+
+  /* Check against a couple of the known-good values from
+   * test_codes_calculate_round_trip(), and against epc_calculate_code() for a
+   * spread of other inputs. */
+  g_assert_cmpuint (epc_signing_key_calculate_code (signing_key, EPC_PERIOD_5_SECONDS,
+                                                    0, &local_error), ==, 6996);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (epc_signing_key_calculate_code (signing_key, EPC_PERIOD_INFINITE,
+                                                    32, &local_error), ==, 65277943);
+  g_assert_no_error (local_error);
+
+  for (guint counter = 0; counter <= G_MAXUINT8; counter += 17)
+    {
+      EpcCode expected_code = epc_calculate_code (EPC_PERIOD_30_DAYS, counter,
+                                                  key1, &local_error);
+      g_assert_no_error (local_error);
+
+      EpcCode actual_code = epc_signing_key_calculate_code (signing_key,
+                                                            EPC_PERIOD_30_DAYS,
+                                                            counter,
+                                                            &local_error);
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (actual_code, ==, expected_code);
+
+      EpcPeriod actual_period;
+      guint actual_counter;
+
+      g_assert_true (epc_signing_key_verify_code (signing_key, actual_code,
+                                                  &actual_period, &actual_counter,
+                                                  &local_error));
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (actual_period, ==, EPC_PERIOD_30_DAYS);
+      g_assert_cmpuint (actual_counter, ==, counter);
+
+      /* Flipping any signature bit must make it invalid. */
+      for (guint bit = 0; bit < SIGN_WIDTH_BITS; bit++)
+        {
+          g_assert_false (epc_signing_key_verify_code (signing_key,
+                                                       actual_code ^ (1 << bit),
+                                                       NULL, NULL, &local_error));
+          g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SIGNATURE);
+          g_clear_error (&local_error);
+        }
+    }
+
+  /* Invalid codes. */
+  g_assert_false (epc_signing_key_verify_code (signing_key, 1 << CODE_VALUE_WIDTH_BITS,
+                                               NULL, NULL, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE);
+  g_clear_error (&local_error);
+
+  g_assert_false (epc_signing_key_verify_code (signing_key,
+                                               30 << (COUNTER_WIDTH_BITS + SIGN_WIDTH_BITS),
+                                               NULL, NULL, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD);
+  g_clear_error (&local_error);
+
+  /* Invalid period. */
+  g_assert_cmpuint (epc_signing_key_calculate_code (signing_key, 30,
+                                                    1, &local_error), ==, 0);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD);
+  g_clear_error (&local_error);
+
+  /* Invalid key. */
+  g_assert_null (epc_signing_key_new (invalid_key, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_KEY);
+  g_clear_error (&local_error);
+}
+
+/* Test that epc_calculate_codes() gives the same results as calling
+ * epc_calculate_code() for each counter, and that epc_format_codes() matches
+ * epc_format_code(). */
+static void
+test_codes_calculate_batch (void)
+{
+  g_autoptr(GError) local_error = NULL;
+  const gchar *key1_data =
+      "hello this has to be at least 64 bytes long so I am going to keep on typing.";
+  g_autoptr(GBytes) key1 = g_bytes_new_static (key1_data, strlen (key1_data));
+
+  g_autoptr(GArray) codes = epc_calculate_codes (EPC_PERIOD_5_SECONDS,
+                                                 EPC_MINCOUNTER, EPC_MAXCOUNTER,
+                                                 key1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (codes);
+  g_assert_cmpuint (codes->len, ==, EPC_MAXCOUNTER - EPC_MINCOUNTER + 1);
+
+  /* Known-good values from test_codes_calculate_round_trip(). */
+  g_assert_cmpuint (g_array_index (codes, EpcCode, 0), ==, 6996);
+  g_assert_cmpuint (g_array_index (codes, EpcCode, 7), ==, 63462);
+
+  g_auto(GStrv) code_strs = epc_format_codes ((const EpcCode *) codes->data,
+                                              codes->len);
+  g_assert_cmpuint (g_strv_length (code_strs), ==, codes->len);
+
+  for (guint i = 0; i < codes->len; i++)
+    {
+      EpcCode expected_code = epc_calculate_code (EPC_PERIOD_5_SECONDS,
+                                                  (EpcCounter) i, key1,
+                                                  &local_error);
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (g_array_index (codes, EpcCode, i), ==, expected_code);
+
+      g_autofree gchar *expected_code_str = epc_format_code (expected_code);
+      g_assert_cmpstr (code_strs[i], ==, expected_code_str);
+    }
+
+  /* A single-element range. */
+  g_autoptr(GArray) single_codes = epc_calculate_codes (EPC_PERIOD_1_MINUTE,
+                                                        100, 100, key1,
+                                                        &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (single_codes->len, ==, 1);
+  g_assert_cmpuint (g_array_index (single_codes, EpcCode, 0), ==, 2919004);
+
+  /* Errors are the same as for epc_calculate_code(). */
+  g_autoptr(GArray) error_codes = epc_calculate_codes (30, 0, 1, key1,
+                                                       &local_error);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD);
+  g_assert_null (error_codes);
+  g_clear_error (&local_error);
+
+  g_autoptr(GBytes) short_key = g_bytes_new_static ("too short", 9);
+  error_codes = epc_calculate_codes (EPC_PERIOD_1_DAY, 0, 1, short_key,
+                                     &local_error);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_KEY);
+  g_assert_null (error_codes);
+  g_clear_error (&local_error);
+
+  /* Formatting no codes gives an empty array. */
+  g_auto(GStrv) empty_strs = epc_format_codes (NULL, 0);
+  g_assert_nonnull (empty_strs);
+  g_assert_null (empty_strs[0]);
+}
+
 /* Test that formatting codes can be round-tripped and parsed again. */
 static void
 test_codes_format_round_trip (void)
@@ -297,6 +499,291 @@ test_codes_parse_error (void)
     }
 }
 
+/* Test epc_scheme_validate() works correctly for valid and invalid schemes,
+ * and that signing keys can only be created for valid schemes. */
+static void
+test_codes_scheme_validation (void)
+{
+  const gchar *key1_data =
+      "hello this has to be at least 64 bytes long so I am going to keep on typing.";
+  g_autoptr(GBytes) key1 = g_bytes_new_static (key1_data, strlen (key1_data));
+  g_autoptr(GError) local_error = NULL;
+
+  /* Valid values. */
+  g_assert_true (epc_scheme_validate (EPC_SCHEME_1, &local_error));
+  g_assert_no_error (local_error);
+
+  g_assert_true (epc_scheme_validate (EPC_SCHEME_2, &local_error));
+  g_assert_no_error (local_error);
+
+  g_assert_cmpuint (epc_scheme_get_max_counter (EPC_SCHEME_1), ==, EPC_MAXCOUNTER);
+  g_assert_cmpuint (epc_scheme_get_max_counter (EPC_SCHEME_2), ==, G_MAXUINT16);
+  g_assert_cmpuint (epc_scheme_get_code_length (EPC_SCHEME_1), ==, CODE_STR_WIDTH_DIGITS);
+  g_assert_cmpuint (epc_scheme_get_code_length (EPC_SCHEME_2), ==, V2_CODE_STR_WIDTH_DIGITS);
+
+  /* Invalid values. */
+  g_assert_false (epc_scheme_validate (0, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SCHEME);
+  g_clear_error (&local_error);
+
+  g_assert_false (epc_scheme_validate (EPC_N_SCHEMES + 1, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SCHEME);
+  g_clear_error (&local_error);
+
+  g_assert_null (epc_signing_key_new_for_scheme (key1, EPC_N_SCHEMES + 1, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SCHEME);
+  g_clear_error (&local_error);
+
+  /* The default scheme is scheme 1. */
+  g_autoptr(EpcSigningKey) signing_key = epc_signing_key_new (key1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpint (epc_signing_key_get_scheme (signing_key), ==, EPC_SCHEME_1);
+}
+
+/* Test that scheme 2 calculates the expected codes, that they verify and
+ * round-trip through their string form, and that the wider counters and codes
+ * are bounds checked. */
+static void
+test_codes_scheme_2 (void)
+{
+  const gchar *key1_data =
+      "hello this has to be at least 64 bytes long so I am going to keep on typing.";
+  g_autoptr(GBytes) key1 = g_bytes_new_static (key1_data, strlen (key1_data));
+  g_autoptr(EpcSigningKey) signing_key = NULL;
+  g_autoptr(EpcSigningKey) v1_signing_key = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  const struct
+    {
+      EpcPeriod period;
+      guint counter;
+      guint64 code;
+      const gchar *code_str;
+    }
+  vectors[] =
+    {
+      /* Generated using a simple Python implementation of the scheme. */
+      { EPC_PERIOD_5_SECONDS, 0, G_GUINT64_CONSTANT (52958), "000000052958" },
+      { EPC_PERIOD_INFINITE, 32, G_GUINT64_CONSTANT (532584570549), "532584570549" },
+      { EPC_PERIOD_14_DAYS, 256, G_GUINT64_CONSTANT (292125103379), "292125103379" },
+      { EPC_PERIOD_INFINITE, G_MAXUINT16, G_GUINT64_CONSTANT (549755687022), "549755687022" },
+    };
+
+  signing_key = epc_signing_key_new_for_scheme (key1, EPC_SCHEME_2, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (signing_key);
+  g_assert_cmpint (epc_signing_key_get_scheme (signing_key), ==, EPC_SCHEME_2);
+
+  v1_signing_key = epc_signing_key_new_for_scheme (key1, EPC_SCHEME_1, &local_error);
+  g_assert_no_error (local_error);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_test_message ("Vector %" G_GSIZE_FORMAT ": %u, %u, %s",
+                      i, (guint) vectors[i].period, vectors[i].counter,
+                      vectors[i].code_str);
+
+      guint64 actual_code = epc_signing_key_calculate_code (signing_key,
+                                                            vectors[i].period,
+                                                            vectors[i].counter,
+                                                            &local_error);
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (actual_code, ==, vectors[i].code);
+
+      EpcPeriod actual_period;
+      guint actual_counter;
+
+      g_assert_true (epc_signing_key_verify_code (signing_key, actual_code,
+                                                  &actual_period, &actual_counter,
+                                                  &local_error));
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (actual_period, ==, vectors[i].period);
+      g_assert_cmpuint (actual_counter, ==, vectors[i].counter);
+
+      /* Flipping any signature bit must make it invalid. */
+      for (guint bit = 0; bit < V2_SIGN_WIDTH_BITS; bit++)
+        {
+          g_assert_false (epc_signing_key_verify_code (signing_key,
+                                                       actual_code ^ (1u << bit),
+                                                       NULL, NULL, &local_error));
+          g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_SIGNATURE);
+          g_clear_error (&local_error);
+        }
+
+      /* String form. */
+      g_autofree gchar *actual_code_str = epc_scheme_format_code (EPC_SCHEME_2,
+                                                                  actual_code);
+      g_assert_cmpstr (actual_code_str, ==, vectors[i].code_str);
+
+      guint64 parsed_code;
+      g_assert_true (epc_scheme_parse_code (EPC_SCHEME_2, actual_code_str,
+                                            &parsed_code, &local_error));
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (parsed_code, ==, actual_code);
+    }
+
+  /* The same key gives independent signatures in the two schemes, so a scheme
+   * 1 code must not verify as a scheme 2 code. */
+  guint64 v1_code = epc_signing_key_calculate_code (v1_signing_key,
+                                                    EPC_PERIOD_5_SECONDS, 0,
+                                                    &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (v1_code, ==, 6996);
+  g_assert_false (epc_signing_key_verify_code (signing_key, v1_code, NULL, NULL,
+                                               NULL));
+
+  /* Counters wider than the scheme allows. */
+  g_assert_cmpuint (epc_signing_key_calculate_code (signing_key, EPC_PERIOD_1_DAY,
+                                                    G_MAXUINT16 + 1, &local_error), ==, 0);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_COUNTER);
+  g_clear_error (&local_error);
+
+  g_assert_cmpuint (epc_signing_key_calculate_code (v1_signing_key, EPC_PERIOD_1_DAY,
+                                                    EPC_MAXCOUNTER + 1, &local_error), ==, 0);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_COUNTER);
+  g_clear_error (&local_error);
+
+  /* Invalid codes. */
+  g_assert_true (epc_scheme_code_validate (EPC_SCHEME_2,
+                                           (G_GUINT64_CONSTANT (1) << V2_CODE_VALUE_WIDTH_BITS) - 1,
+                                           &local_error));
+  g_assert_no_error (local_error);
+
+  g_assert_false (epc_scheme_code_validate (EPC_SCHEME_2,
+                                            G_GUINT64_CONSTANT (1) << V2_CODE_VALUE_WIDTH_BITS,
+                                            &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE);
+  g_clear_error (&local_error);
+
+  g_assert_false (epc_signing_key_verify_code (signing_key,
+                                               G_GUINT64_CONSTANT (1) << V2_CODE_VALUE_WIDTH_BITS,
+                                               NULL, NULL, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE);
+  g_clear_error (&local_error);
+
+  guint64 invalid_period_code =
+      G_GUINT64_CONSTANT (30) << (V2_COUNTER_WIDTH_BITS + V2_SIGN_WIDTH_BITS);
+  g_assert_false (epc_signing_key_verify_code (signing_key, invalid_period_code,
+                                               NULL, NULL, &local_error));
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_PERIOD);
+  g_clear_error (&local_error);
+}
+
+/* Test that epc_scheme_format_code() and epc_scheme_parse_code() match
+ * epc_format_code() and epc_parse_code() for scheme 1, and reject strings of
+ * the wrong length or value for each scheme. */
+static void
+test_codes_scheme_format (void)
+{
+  const EpcCode v1_codes[] = { 0, 123, 12345678, (1 << CODE_VALUE_WIDTH_BITS) - 1 };
+
+  for (gsize i = 0; i < G_N_ELEMENTS (v1_codes); i++)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      g_autofree gchar *expected_code_str = epc_format_code (v1_codes[i]);
+      g_autofree gchar *actual_code_str = epc_scheme_format_code (EPC_SCHEME_1,
+                                                                  v1_codes[i]);
+      g_assert_cmpstr (actual_code_str, ==, expected_code_str);
+
+      guint64 parsed_code;
+      g_assert_true (epc_scheme_parse_code (EPC_SCHEME_1, actual_code_str,
+                                            &parsed_code, &local_error));
+      g_assert_no_error (local_error);
+      g_assert_cmpuint (parsed_code, ==, v1_codes[i]);
+    }
+
+  const struct
+    {
+      EpcScheme scheme;
+      const gchar *code_str;
+    }
+  invalid_vectors[] =
+    {
+      { EPC_SCHEME_1, "" },
+      { EPC_SCHEME_1, "000000052958" },
+      { EPC_SCHEME_1, "99999999" },
+      { EPC_SCHEME_2, "" },
+      { EPC_SCHEME_2, "00006996" },
+      { EPC_SCHEME_2, "abcdefghijkl" },
+      { EPC_SCHEME_2, "549755813888" },
+      { EPC_SCHEME_2, "999999999999" },
+    };
+
+  for (gsize i = 0; i < G_N_ELEMENTS (invalid_vectors); i++)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      g_test_message ("Scheme %u, code: %s", (guint) invalid_vectors[i].scheme,
+                      invalid_vectors[i].code_str);
+
+      guint64 code;
+      gboolean success = epc_scheme_parse_code (invalid_vectors[i].scheme,
+                                                invalid_vectors[i].code_str,
+                                                &code, &local_error);
+      g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_CODE);
+      g_assert_false (success);
+    }
+}
+
+/* Measure how many codes per second each scheme can verify, both with a
+ * prepared #EpcSigningKey and with the key set up for every code, as a device
+ * does when a code is entered. Only run with `-m perf`, so the results can be
+ * compared on the hardware codes are verified on. */
+static void
+test_codes_scheme_verify_performance (void)
+{
+  const gchar *key1_data =
+      "hello this has to be at least 64 bytes long so I am going to keep on typing.";
+  g_autoptr(GBytes) key1 = g_bytes_new_static (key1_data, strlen (key1_data));
+  const guint n_iterations = 100000;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests are only run with -m perf");
+      return;
+    }
+
+  for (EpcScheme scheme = EPC_SCHEME_1; scheme <= EPC_N_SCHEMES; scheme++)
+    {
+      g_autoptr(GError) local_error = NULL;
+      g_autoptr(EpcSigningKey) signing_key = NULL;
+
+      signing_key = epc_signing_key_new_for_scheme (key1, scheme, &local_error);
+      g_assert_no_error (local_error);
+
+      guint64 code = epc_signing_key_calculate_code (signing_key, EPC_PERIOD_1_DAY,
+                                                     1, &local_error);
+      g_assert_no_error (local_error);
+
+      g_test_timer_start ();
+
+      for (guint i = 0; i < n_iterations; i++)
+        g_assert_true (epc_signing_key_verify_code (signing_key, code, NULL, NULL, NULL));
+
+      gdouble elapsed = g_test_timer_elapsed ();
+      g_test_maximized_result (n_iterations / elapsed,
+                               "Scheme %u: %.0f verifications per second with a prepared key",
+                               (guint) scheme, n_iterations / elapsed);
+
+      g_test_timer_start ();
+
+      for (guint i = 0; i < n_iterations; i++)
+        {
+          g_autoptr(EpcSigningKey) one_shot_key = NULL;
+
+          one_shot_key = epc_signing_key_new_for_scheme (key1, scheme, NULL);
+          g_assert_true (epc_signing_key_verify_code (one_shot_key, code,
+                                                      NULL, NULL, NULL));
+        }
+
+      elapsed = g_test_timer_elapsed ();
+      g_test_maximized_result (n_iterations / elapsed,
+                               "Scheme %u: %.0f verifications per second with key set up per code",
+                               (guint) scheme, n_iterations / elapsed);
+    }
+}
+
 int
 main (int    argc,
       char **argv)
@@ -305,12 +792,19 @@ main (int    argc,
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/codes/period-validation", test_codes_period_validation);
+  g_test_add_func ("/codes/period-string", test_codes_period_string);
   g_test_add_func ("/codes/code-validation", test_codes_code_validation);
   g_test_add_func ("/codes/calculate/round-trip", test_codes_calculate_round_trip);
   g_test_add_func ("/codes/calculate/error", test_codes_calculate_error);
+  g_test_add_func ("/codes/calculate/batch", test_codes_calculate_batch);
   g_test_add_func ("/codes/verify/error", test_codes_verify_error);
+  g_test_add_func ("/codes/signing-key", test_codes_signing_key);
   g_test_add_func ("/codes/format/round-trip", test_codes_format_round_trip);
   g_test_add_func ("/codes/parse/error", test_codes_parse_error);
+  g_test_add_func ("/codes/scheme/validation", test_codes_scheme_validation);
+  g_test_add_func ("/codes/scheme/2", test_codes_scheme_2);
+  g_test_add_func ("/codes/scheme/format", test_codes_scheme_format);
+  g_test_add_func ("/codes/scheme/verify-performance", test_codes_scheme_verify_performance);
 
   return g_test_run ();
 }
@@ -0,0 +1,256 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libeos-payg-codes/codes.h>
+#include <libeos-payg-codes/key-store.h>
+#include <locale.h>
+#include <string.h>
+
+
+/* A key of the minimum length, distinguished by @n. */
+static GBytes *
+make_key (guint n)
+{
+  g_autoptr(GString) key = g_string_new (NULL);
+
+  while (key->len < EPC_KEY_MINIMUM_LENGTH_BYTES)
+    g_string_append_printf (key, "key %u; ", n);
+
+  return g_string_free_to_bytes (g_steal_pointer (&key));
+}
+
+typedef struct
+{
+  gchar *tmp_dir;
+  gchar *path;
+} Fixture;
+
+static void
+setup (Fixture       *fixture,
+       gconstpointer  test_data)
+{
+  g_autoptr(GError) local_error = NULL;
+
+  fixture->tmp_dir = g_dir_make_tmp ("libeos-payg-codes-key-store-XXXXXX",
+                                     &local_error);
+  g_assert_no_error (local_error);
+  fixture->path = g_build_filename (fixture->tmp_dir, "keys", NULL);
+}
+
+static void
+teardown (Fixture       *fixture,
+          gconstpointer  test_data)
+{
+  g_unlink (fixture->path);
+  g_rmdir (fixture->tmp_dir);
+  g_free (fixture->path);
+  g_free (fixture->tmp_dir);
+}
+
+/* Test writing a key store and looking keys up in it again, including
+ * replacing a key and looking up missing and invalid device IDs. */
+static void
+test_key_store_round_trip (Fixture       *fixture,
+                           gconstpointer  test_data)
+{
+  g_autoptr(EpcKeyStoreBuilder) builder = epc_key_store_builder_new ();
+  g_autoptr(EpcKeyStore) store = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const gchar *device_ids[] = { "8AF5DA70", "3F0A1564", "0CE89073" };
+
+  for (guint i = 0; i < G_N_ELEMENTS (device_ids); i++)
+    {
+      g_autoptr(GBytes) key = make_key (i);
+      epc_key_store_builder_add (builder, device_ids[i], key, &local_error);
+      g_assert_no_error (local_error);
+    }
+
+  /* The last key added for a device wins. */
+  g_autoptr(GBytes) replacement_key = make_key (100);
+  epc_key_store_builder_add (builder, device_ids[0], replacement_key, &local_error);
+  g_assert_no_error (local_error);
+
+  epc_key_store_builder_write_to_path (builder, fixture->path, &local_error);
+  g_assert_no_error (local_error);
+
+  store = epc_key_store_new_for_path (fixture->path, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (epc_key_store_get_n_keys (store), ==, G_N_ELEMENTS (device_ids));
+
+  for (guint i = 0; i < G_N_ELEMENTS (device_ids); i++)
+    {
+      g_autoptr(GBytes) expected_key = make_key ((i == 0) ? 100 : i);
+      g_autoptr(GBytes) key = epc_key_store_lookup (store, device_ids[i], &local_error);
+      g_assert_no_error (local_error);
+      g_assert_true (g_bytes_equal (key, expected_key));
+    }
+
+  g_autoptr(GBytes) missing_key = epc_key_store_lookup (store, "00000000", &local_error);
+  g_assert_error (local_error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_NOT_FOUND);
+  g_assert_null (missing_key);
+  g_clear_error (&local_error);
+
+  g_autoptr(GBytes) invalid_key = epc_key_store_lookup (store, "", &local_error);
+  g_assert_error (local_error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID);
+  g_assert_null (invalid_key);
+}
+
+/* Test looking up every key in a larger key store, to exercise the binary
+ * search, and that keys stay valid after the store is closed. */
+static void
+test_key_store_many (Fixture       *fixture,
+                     gconstpointer  test_data)
+{
+  g_autoptr(EpcKeyStoreBuilder) builder = epc_key_store_builder_new ();
+  g_autoptr(EpcKeyStore) store = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const guint n_keys = 1000;
+
+  for (guint i = 0; i < n_keys; i++)
+    {
+      g_autofree gchar *device_id = g_strdup_printf ("%08X", i * 7919);
+      g_autoptr(GBytes) key = make_key (i);
+      epc_key_store_builder_add (builder, device_id, key, &local_error);
+      g_assert_no_error (local_error);
+    }
+
+  epc_key_store_builder_write_to_path (builder, fixture->path, &local_error);
+  g_assert_no_error (local_error);
+
+  store = epc_key_store_new_for_path (fixture->path, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (epc_key_store_get_n_keys (store), ==, n_keys);
+
+  g_autoptr(GBytes) first_key = NULL;
+
+  for (guint i = 0; i < n_keys; i++)
+    {
+      g_autofree gchar *device_id = g_strdup_printf ("%08X", i * 7919);
+      g_autoptr(GBytes) expected_key = make_key (i);
+      g_autoptr(GBytes) key = epc_key_store_lookup (store, device_id, &local_error);
+      g_assert_no_error (local_error);
+      g_assert_true (g_bytes_equal (key, expected_key));
+
+      if (i == 0)
+        first_key = g_bytes_ref (key);
+    }
+
+  g_clear_pointer (&store, epc_key_store_unref);
+
+  g_autoptr(GBytes) expected_first_key = make_key (0);
+  g_assert_true (g_bytes_equal (first_key, expected_first_key));
+}
+
+/* Test that invalid keys and device IDs are rejected by the builder. */
+static void
+test_key_store_builder_error (void)
+{
+  g_autoptr(EpcKeyStoreBuilder) builder = epc_key_store_builder_new ();
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GBytes) key = make_key (0);
+  g_autoptr(GBytes) short_key = g_bytes_new_static ("short", 5);
+  gboolean success;
+
+  success = epc_key_store_builder_add (builder, "3F0A1564", short_key, &local_error);
+  g_assert_error (local_error, EPC_CODE_ERROR, EPC_CODE_ERROR_INVALID_KEY);
+  g_assert_false (success);
+  g_clear_error (&local_error);
+
+  success = epc_key_store_builder_add (builder, "", key, &local_error);
+  g_assert_error (local_error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID);
+  g_assert_false (success);
+  g_clear_error (&local_error);
+
+  success = epc_key_store_builder_add (builder, "0123456789ABCDEF", key, &local_error);
+  g_assert_error (local_error, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID_DEVICE_ID);
+  g_assert_false (success);
+}
+
+/* Test that corrupt and missing key store files are rejected when opened. */
+static void
+test_key_store_open_error (Fixture       *fixture,
+                           gconstpointer  test_data)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(EpcKeyStore) store = NULL;
+  const struct
+    {
+      const gchar *contents;
+      gsize len;
+      GQuark expected_domain;
+      gint expected_code;
+    }
+  vectors[] =
+    {
+      { "", 0, EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID },
+      { "device_id,code1,code2,code3,key\r\n", 33,
+        EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID },
+      /* unsupported version */
+      { "EPCKEYS\0\2\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 32,
+        EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID },
+      /* unsupported flags */
+      { "EPCKEYS\0\1\0\0\0\0\0\0\0\1\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 32,
+        EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID },
+      /* truncated index */
+      { "EPCKEYS\0\1\0\0\0\2\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 32,
+        EPC_KEY_STORE_ERROR, EPC_KEY_STORE_ERROR_INVALID },
+    };
+
+  for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++)
+    {
+      g_test_message ("Vector %" G_GSIZE_FORMAT, i);
+
+      g_file_set_contents (fixture->path, vectors[i].contents,
+                           (gssize) vectors[i].len, &local_error);
+      g_assert_no_error (local_error);
+
+      store = epc_key_store_new_for_path (fixture->path, &local_error);
+      g_assert_error (local_error, vectors[i].expected_domain,
+                      vectors[i].expected_code);
+      g_assert_null (store);
+      g_clear_error (&local_error);
+    }
+
+  g_unlink (fixture->path);
+  store = epc_key_store_new_for_path (fixture->path, &local_error);
+  g_assert_error (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+  g_assert_null (store);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/key-store/round-trip", Fixture, NULL, setup,
+              test_key_store_round_trip, teardown);
+  g_test_add ("/key-store/many", Fixture, NULL, setup,
+              test_key_store_many, teardown);
+  g_test_add_func ("/key-store/builder-error", test_key_store_builder_error);
+  g_test_add ("/key-store/open-error", Fixture, NULL, setup,
+              test_key_store_open_error, teardown);
+
+  return g_test_run ();
+}
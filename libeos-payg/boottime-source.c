@@ -27,6 +27,7 @@
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <libeos-payg/boottime-source.h>
+#include <libeos-payg/loop-monitor.h>
 
 typedef struct {
   GSource parent;
@@ -50,6 +51,8 @@ epg_boottime_source_dispatch (GSource    *source,
 {
   EpgBoottimeSource *self = (EpgBoottimeSource *) source;
   uint64_t n_expirations = 0;
+  gint64 monitor_start;
+  gboolean ret;
 
   if (callback == NULL)
     {
@@ -66,7 +69,11 @@ epg_boottime_source_dispatch (GSource    *source,
       return G_SOURCE_REMOVE;
     }
 
-  return callback (user_data);
+  monitor_start = epg_loop_monitor_dispatch_begin ();
+  ret = callback (user_data);
+  epg_loop_monitor_dispatch_end (g_source_get_name (source), monitor_start);
+
+  return ret;
 }
 
 static void
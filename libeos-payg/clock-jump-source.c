@@ -29,6 +29,7 @@
 #include <gio/gio.h>
 
 #include <libeos-payg/clock-jump-source.h>
+#include <libeos-payg/loop-monitor.h>
 
 /* This file is based on boottime-source.c */
 
@@ -54,6 +55,8 @@ epg_clock_jump_source_dispatch (GSource    *source,
 {
   EpgClockJumpSource *self = (EpgClockJumpSource *) source;
   uint64_t n_expirations = 0;
+  gint64 monitor_start;
+  gboolean ret;
 
   if (callback == NULL)
     {
@@ -70,7 +73,11 @@ epg_clock_jump_source_dispatch (GSource    *source,
       return G_SOURCE_REMOVE;
     }
 
-  return callback (user_data);
+  monitor_start = epg_loop_monitor_dispatch_begin ();
+  ret = callback (user_data);
+  epg_loop_monitor_dispatch_end (g_source_get_name (source), monitor_start);
+
+  return ret;
 }
 
 static void
@@ -5,6 +5,8 @@
  * All rights reserved.
  */
 
+#include "config.h"
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -14,6 +16,8 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <libeos-payg/efi.h>
+#include <libeos-payg/stats.h>
+#include <libeos-payg/trace.h>
 #include <libglnx.h>
 
 #define EOSPAYG_GUID            "d89c3871-ae0c-4fc5-a409-dc717aee61e7"
@@ -40,6 +44,7 @@ static int efi_fd = -1;
 DIR *efi_dir = NULL;
 static gboolean post_pivot = FALSE;
 static gboolean test_mode = FALSE;
+static gboolean test_fail_delete = FALSE;
 
 struct efi_ops {
   gboolean (*exists) (const char *name);
@@ -137,6 +142,36 @@ eospayg_efi_root_pivot (void)
   post_pivot = TRUE;
 }
 
+/* eospayg_efi_internal_set_post_pivot:
+ * @is_post_pivot: whether to behave as after the root pivot
+ *
+ * Move the fake EFI storage to either side of the root pivot, so that tests
+ * can check how variables are rewritten after it, and then restore the
+ * default for other tests. Only for use in %EOSPAYG_EFI_TEST_MODE.
+ */
+void
+eospayg_efi_internal_set_post_pivot (gboolean is_post_pivot)
+{
+  g_return_if_fail (test_mode);
+
+  post_pivot = is_post_pivot;
+}
+
+/* eospayg_efi_internal_set_fail_delete:
+ * @fail_delete: whether deletions should fail
+ *
+ * Make deleting variables from the fake EFI storage fail with
+ * %G_IO_ERROR_BUSY, as it does on efivarfs if something is bind mounted over
+ * the variable. Only for use in %EOSPAYG_EFI_TEST_MODE.
+ */
+void
+eospayg_efi_internal_set_fail_delete (gboolean fail_delete)
+{
+  g_return_if_fail (test_mode);
+
+  test_fail_delete = fail_delete;
+}
+
 static gboolean
 test_write (const char  *name,
             const void  *content,
@@ -159,6 +194,17 @@ test_write (const char  *name,
         }
     }
 
+  /* Like O_EXCL on efivarfs, which is used after the root pivot. */
+  if (target && target->name && !allow_overwrite)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_EXISTS,
+                   "Variable %s already exists",
+                   name);
+      return FALSE;
+    }
+
   if (target)
     {
       if (target->name)
@@ -233,7 +279,14 @@ efi_var_write (const char  *name,
                gboolean     allow_overwrite,
                GError     **error)
 {
-  return efi->write (name, content, size, allow_overwrite, error);
+  gboolean ret;
+
+  EPG_TRACE3 (efi_write__entry, name, size, allow_overwrite);
+  epg_stats_increment (EPG_STATS_EFI_WRITES);
+  ret = efi->write (name, content, size, allow_overwrite, error);
+  EPG_TRACE2 (efi_write__return, name, ret);
+
+  return ret;
 }
 
 /* eospayg_efi_var_write:
@@ -320,6 +373,13 @@ test_delete (const char  *name,
 {
   int i;
 
+  if (test_fail_delete)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                   "Variable %s is busy", name);
+      return FALSE;
+    }
+
   for (i = 0; i < FAKE_VAR_COUNT; i++)
     if (fake_vars[i].name && !strcmp (fake_vars[i].name, name))
       {
@@ -379,7 +439,11 @@ eospayg_efi_var_delete_fullname (const char  *name,
                        "Refusing to delete non-PAYG variable %s",
                        name);
 
-  return efi->delete (name, error);
+  EPG_TRACE1 (efi_delete__entry, name);
+  gboolean ret = efi->delete (name, error);
+  EPG_TRACE2 (efi_delete__return, name, ret);
+
+  return ret;
 }
 
 
@@ -447,7 +511,10 @@ eospayg_efi_var_exists (const char *name)
   g_return_val_if_fail (efi != NULL, FALSE);
   g_return_val_if_fail (name != NULL, FALSE);
 
-  return efi->exists (name);
+  gboolean ret = efi->exists (name);
+  EPG_TRACE2 (efi_exists, name, ret);
+
+  return ret;
 }
 
 static unsigned char *
@@ -663,7 +730,10 @@ eospayg_efi_var_read_fullname (const char  *name,
   if (post_pivot)
     return glnx_null_throw (error, "Cannot read %s after pivot", name);
 
+  EPG_TRACE1 (efi_read__entry, name);
+  epg_stats_increment (EPG_STATS_EFI_READS);
   void *ret = efi->read (name, size, error);
+  EPG_TRACE2 (efi_read__return, name, *size);
   if (ret &&
       expected_size >= 0 &&
       expected_size != *size)
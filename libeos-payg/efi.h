@@ -13,6 +13,13 @@ enum eospayg_efi_flags {
   EOSPAYG_EFI_TEST_MODE = 1,
 };
 
+/* Short names of the pair of EFI variables holding the #EpgManager state when
+ * it is stored in EFI. Saves alternate between them, so that one always holds
+ * a complete state. `eos-payg-provision --efi-state` creates
+ * EFI_STATE_VARIABLE to opt a computer in to EFI storage. */
+#define EFI_STATE_VARIABLE "state"
+#define EFI_STATE_VARIABLE_B "state-b"
+
 enum efivar_states {
   EFIVAR_NOT_EXIST = 0,
   EFIVAR_TRUE,
@@ -42,6 +49,8 @@ gboolean eospayg_efi_var_supported (void);
 void eospayg_efi_list_rewind (void);
 const char *eospayg_efi_list_next (void);
 void eospayg_efi_root_pivot (void);
+void eospayg_efi_internal_set_post_pivot (gboolean is_post_pivot);
+void eospayg_efi_internal_set_fail_delete (gboolean fail_delete);
 void *eospayg_efi_var_read (const char  *name,
                             int          expected_size,
                             int         *size,
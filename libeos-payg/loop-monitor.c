@@ -0,0 +1,281 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <libeos-payg/loop-monitor.h>
+
+/* Opt-in instrumentation of main loop dispatch latency.
+ *
+ * GLib has no hook around the dispatch of arbitrary sources, so this works at
+ * two levels:
+ *
+ *  - The #GSourceFuncs implemented in libeos-payg, and the D-Bus method
+ *    handlers, bracket the user callback with
+ *    epg_loop_monitor_dispatch_begin() and epg_loop_monitor_dispatch_end(),
+ *    passing the name set with g_source_set_name() (or the D-Bus method name).
+ *    Their durations are recorded in a histogram per name, and a warning
+ *    naming the source is emitted if one dispatch exceeds the threshold.
+ *
+ *  - The poll function of the monitored #GMainContext is wrapped to measure
+ *    the time from poll() returning to it being called again, which covers
+ *    the dispatch of every source in that iteration, including those created
+ *    by GLib (timeouts, idles, GDBus). These durations are recorded under
+ *    %ITERATION_NAME, and an iteration over the threshold which was not
+ *    already explained by a named dispatch is warned about.
+ *
+ * All of this must only be used from the thread which iterates the monitored
+ * context. */
+
+#define ITERATION_NAME "main loop iteration"
+
+typedef struct
+{
+  guint64 buckets[EPG_LOOP_MONITOR_N_BUCKETS];
+  guint64 count;
+  gint64 max_usec;
+} Histogram;
+
+static struct
+{
+  gboolean enabled;
+  gint64 threshold_usec;
+  GPollFunc real_poll;
+
+  GHashTable *histograms;  /* (element-type utf8 Histogram) (owned) */
+
+  /* When poll() last returned, or 0 if never. */
+  gint64 poll_return_time;
+
+  /* Slowest named dispatch in the current iteration. */
+  const gchar *iteration_worst_name;  /* (unowned) (nullable) */
+  gint64 iteration_worst_usec;
+} monitor;
+
+static guint
+get_bucket (gint64 duration_usec)
+{
+  guint bucket = 0;
+
+  while (duration_usec > 0 && bucket < EPG_LOOP_MONITOR_N_BUCKETS - 1)
+    {
+      duration_usec >>= 1;
+      bucket++;
+    }
+
+  return bucket;
+}
+
+static void
+record (const gchar *name,
+        gint64       duration_usec)
+{
+  Histogram *histogram = g_hash_table_lookup (monitor.histograms, name);
+
+  if (histogram == NULL)
+    {
+      histogram = g_new0 (Histogram, 1);
+      g_hash_table_insert (monitor.histograms, g_strdup (name), histogram);
+    }
+
+  histogram->buckets[get_bucket (duration_usec)]++;
+  histogram->count++;
+  histogram->max_usec = MAX (histogram->max_usec, duration_usec);
+}
+
+static gint
+monitor_poll (GPollFD *ufds,
+              guint    nfds,
+              gint     timeout)
+{
+  gint ret;
+
+  if (monitor.poll_return_time != 0)
+    {
+      gint64 duration_usec = g_get_monotonic_time () - monitor.poll_return_time;
+
+      record (ITERATION_NAME, duration_usec);
+
+      if (duration_usec > monitor.threshold_usec &&
+          monitor.iteration_worst_usec <= monitor.threshold_usec)
+        {
+          if (monitor.iteration_worst_name != NULL)
+            g_warning ("Main loop stalled for %" G_GINT64_FORMAT " ms; slowest "
+                       "named source was ‘%s’ (%" G_GINT64_FORMAT " ms)",
+                       duration_usec / 1000, monitor.iteration_worst_name,
+                       monitor.iteration_worst_usec / 1000);
+          else
+            g_warning ("Main loop stalled for %" G_GINT64_FORMAT " ms in an "
+                       "unnamed source", duration_usec / 1000);
+        }
+    }
+
+  monitor.iteration_worst_name = NULL;
+  monitor.iteration_worst_usec = 0;
+
+  ret = monitor.real_poll (ufds, nfds, timeout);
+
+  monitor.poll_return_time = g_get_monotonic_time ();
+
+  return ret;
+}
+
+/**
+ * epg_loop_monitor_enable:
+ * @context: (nullable): the #GMainContext to monitor, or %NULL for the global
+ *    default context
+ * @threshold_ms: dispatch duration above which to warn, in milliseconds
+ *
+ * Start recording the duration of dispatches on @context. This can only be
+ * called once per process.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_loop_monitor_enable (GMainContext *context,
+                         guint         threshold_ms)
+{
+  g_return_if_fail (!monitor.enabled);
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  monitor.histograms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  monitor.threshold_usec = (gint64) threshold_ms * 1000;
+  monitor.real_poll = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, monitor_poll);
+  monitor.enabled = TRUE;
+}
+
+/**
+ * epg_loop_monitor_is_enabled:
+ *
+ * Get whether epg_loop_monitor_enable() has been called.
+ *
+ * Returns: %TRUE if dispatch durations are being recorded
+ * Since: 0.2.5
+ */
+gboolean
+epg_loop_monitor_is_enabled (void)
+{
+  return monitor.enabled;
+}
+
+/**
+ * epg_loop_monitor_dispatch_begin:
+ *
+ * Mark the start of a dispatch, to be passed to
+ * epg_loop_monitor_dispatch_end() once it is finished. This is cheap if
+ * monitoring is not enabled.
+ *
+ * Returns: an opaque start time
+ * Since: 0.2.5
+ */
+gint64
+epg_loop_monitor_dispatch_begin (void)
+{
+  if (!monitor.enabled)
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+/**
+ * epg_loop_monitor_dispatch_end:
+ * @name: (nullable): name of the source or handler which was dispatched,
+ *    typically from g_source_get_name()
+ * @start_time: return value of epg_loop_monitor_dispatch_begin()
+ *
+ * Record the duration of a dispatch, and warn if it exceeded the threshold.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_loop_monitor_dispatch_end (const gchar *name,
+                               gint64       start_time)
+{
+  if (!monitor.enabled || start_time == 0)
+    return;
+
+  gint64 duration_usec = g_get_monotonic_time () - start_time;
+
+  if (name == NULL)
+    name = "(unnamed)";
+
+  record (name, duration_usec);
+
+  if (duration_usec > monitor.iteration_worst_usec)
+    {
+      /* The key in the hash table lives as long as the process. */
+      g_hash_table_lookup_extended (monitor.histograms, name,
+                                    (gpointer *) &monitor.iteration_worst_name, NULL);
+      monitor.iteration_worst_usec = duration_usec;
+    }
+
+  if (duration_usec > monitor.threshold_usec)
+    g_warning ("Dispatching ‘%s’ took %" G_GINT64_FORMAT " ms, blocking the "
+               "main loop", name, duration_usec / 1000);
+}
+
+/**
+ * epg_loop_monitor_log_histograms:
+ *
+ * Log the dispatch duration histogram for each source seen so far, one line
+ * per source. Only non-empty buckets are listed, as `≤upper bound: count`.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_loop_monitor_log_histograms (void)
+{
+  GHashTableIter iter;
+  const gchar *name;
+  const Histogram *histogram;
+
+  if (!monitor.enabled)
+    return;
+
+  g_hash_table_iter_init (&iter, monitor.histograms);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &histogram))
+    {
+      g_autoptr(GString) line = g_string_new (NULL);
+
+      g_string_append_printf (line, "Dispatch latency for ‘%s’: n=%" G_GUINT64_FORMAT
+                              ", max=%" G_GINT64_FORMAT "µs;",
+                              name, histogram->count, histogram->max_usec);
+
+      for (guint i = 0; i < EPG_LOOP_MONITOR_N_BUCKETS; i++)
+        {
+          if (histogram->buckets[i] == 0)
+            continue;
+
+          if (i == EPG_LOOP_MONITOR_N_BUCKETS - 1)
+            g_string_append_printf (line, " >%" G_GUINT64_FORMAT "µs:",
+                                    (guint64) 1 << (i - 1));
+          else
+            g_string_append_printf (line, " <%" G_GUINT64_FORMAT "µs:",
+                                    (guint64) 1 << i);
+
+          g_string_append_printf (line, "%" G_GUINT64_FORMAT, histogram->buckets[i]);
+        }
+
+      g_message ("%s", line->str);
+    }
+}
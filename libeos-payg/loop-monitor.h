@@ -0,0 +1,47 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EPG_LOOP_MONITOR_N_BUCKETS:
+ *
+ * Number of buckets in a dispatch duration histogram. Bucket 0 counts
+ * dispatches which took under 1µs; bucket `i` counts those which took at
+ * least 2^(i-1)µs and under 2^iµs; the last bucket counts everything longer.
+ *
+ * Since: 0.2.5
+ */
+#define EPG_LOOP_MONITOR_N_BUCKETS 32
+
+void     epg_loop_monitor_enable         (GMainContext *context,
+                                          guint         threshold_ms);
+gboolean epg_loop_monitor_is_enabled     (void);
+
+gint64   epg_loop_monitor_dispatch_begin (void);
+void     epg_loop_monitor_dispatch_end   (const gchar  *name,
+                                          gint64        start_time);
+
+void     epg_loop_monitor_log_histograms (void);
+
+G_END_DECLS
@@ -65,6 +65,40 @@ static const GDBusMethodInfo manager_interface_add_code =
   NULL,  /* annotations */
 };
 
+static const GDBusArgInfo manager_interface_add_codes_arg_codes =
+{
+  -1,  /* ref count */
+  (gchar *) "codes",
+  (gchar *) "as",
+  NULL
+};
+static const GDBusArgInfo manager_interface_add_codes_arg_results =
+{
+  -1,  /* ref count */
+  (gchar *) "results",
+  (gchar *) "a(xs)",  /* time added and D-Bus error name (empty on success) */
+  NULL
+};
+
+static const GDBusArgInfo *manager_interface_add_codes_in_args[] =
+{
+  &manager_interface_add_codes_arg_codes,
+  NULL,
+};
+static const GDBusArgInfo *manager_interface_add_codes_out_args[] =
+{
+  &manager_interface_add_codes_arg_results,
+  NULL,
+};
+static const GDBusMethodInfo manager_interface_add_codes =
+{
+  -1,  /* ref count */
+  (gchar *) "AddCodes",
+  (GDBusArgInfo **) manager_interface_add_codes_in_args,
+  (GDBusArgInfo **) manager_interface_add_codes_out_args,
+  NULL,  /* annotations */
+};
+
 static const GDBusMethodInfo manager_interface_clear_code =
 {
   -1,  /* ref count */
@@ -74,10 +108,34 @@ static const GDBusMethodInfo manager_interface_clear_code =
   NULL,  /* annotations */
 };
 
+static const GDBusArgInfo manager_interface_get_state_fd_arg_fd =
+{
+  -1,  /* ref count */
+  (gchar *) "fd",
+  (gchar *) "h",  /* read-only memfd; see EpgStateSnapshotData */
+  NULL
+};
+
+static const GDBusArgInfo *manager_interface_get_state_fd_out_args[] =
+{
+  &manager_interface_get_state_fd_arg_fd,
+  NULL,
+};
+static const GDBusMethodInfo manager_interface_get_state_fd =
+{
+  -1,  /* ref count */
+  (gchar *) "GetStateFd",
+  NULL,  /* in args */
+  (GDBusArgInfo **) manager_interface_get_state_fd_out_args,
+  NULL,  /* annotations */
+};
+
 static const GDBusMethodInfo *manager_interface_methods[] =
 {
   &manager_interface_add_code,
+  &manager_interface_add_codes,
   &manager_interface_clear_code,
+  &manager_interface_get_state_fd,
   NULL,
 };
 
@@ -120,10 +178,42 @@ static const GDBusSignalInfo manager_interface_impending_shutdown =
   NULL,  /* annotations */
 };
 
+static const GDBusArgInfo manager_interface_credit_low_arg_threshold =
+{
+  -1,  /* ref count */
+  (gchar *) "threshold",
+  (gchar *) "t",  /* seconds of credit remaining when the signal was scheduled */
+  NULL
+};
+
+static const GDBusArgInfo *manager_interface_credit_low_args[] =
+{
+  &manager_interface_credit_low_arg_threshold,
+  NULL,
+};
+
+static const GDBusSignalInfo manager_interface_credit_low =
+{
+  -1,  /* ref count */
+  (gchar *) "CreditLow",
+  (GDBusArgInfo **) manager_interface_credit_low_args,
+  NULL,  /* annotations */
+};
+
+static const GDBusSignalInfo manager_interface_rate_limit_ended =
+{
+  -1,  /* ref count */
+  (gchar *) "RateLimitEnded",
+  NULL,  /* args */
+  NULL,  /* annotations */
+};
+
 static const GDBusSignalInfo *manager_interface_signals[] =
 {
   &manager_interface_expired,
   &manager_interface_impending_shutdown,
+  &manager_interface_credit_low,
+  &manager_interface_rate_limit_ended,
   NULL,
 };
 
@@ -222,6 +312,181 @@ static const GDBusInterfaceInfo manager_interface =
   NULL,  /* no annotations */
 };
 
+/*
+ * Declaration of the com.endlessm.Payg1.Statistics D-Bus interface. All its
+ * properties are read-only and change constantly, so none of them are
+ * notified with PropertiesChanged.
+ */
+
+static const GDBusAnnotationInfo statistics_interface_emits_changed_signal =
+{
+  -1,  /* ref count */
+  (gchar *) "org.freedesktop.DBus.Property.EmitsChangedSignal",
+  (gchar *) "false",
+  NULL,  /* annotations */
+};
+
+static const GDBusAnnotationInfo *statistics_interface_annotations[] =
+{
+  &statistics_interface_emits_changed_signal,
+  NULL,
+};
+
+static const GDBusPropertyInfo statistics_interface_codes_attempted =
+{
+  -1,  /* ref count */
+  (gchar *) "CodesAttempted",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_codes_accepted =
+{
+  -1,  /* ref count */
+  (gchar *) "CodesAccepted",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_codes_rejected =
+{
+  -1,  /* ref count */
+  (gchar *) "CodesRejected",
+  (gchar *) "a{st}",  /* keyed by error name suffix */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_codes_rate_limited =
+{
+  -1,  /* ref count */
+  (gchar *) "CodesRateLimited",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_state_saves =
+{
+  -1,  /* ref count */
+  (gchar *) "StateSaves",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_state_saves_coalesced =
+{
+  -1,  /* ref count */
+  (gchar *) "StateSavesCoalesced",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_state_save_latency_p50 =
+{
+  -1,  /* ref count */
+  (gchar *) "StateSaveLatencyP50",
+  (gchar *) "t",  /* microseconds */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_state_save_latency_p99 =
+{
+  -1,  /* ref count */
+  (gchar *) "StateSaveLatencyP99",
+  (gchar *) "t",  /* microseconds */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_efi_reads =
+{
+  -1,  /* ref count */
+  (gchar *) "EfiReads",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_efi_writes =
+{
+  -1,  /* ref count */
+  (gchar *) "EfiWrites",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_clock_jumps =
+{
+  -1,  /* ref count */
+  (gchar *) "ClockJumps",
+  (gchar *) "t",
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_expiry_timer_max_lateness =
+{
+  -1,  /* ref count */
+  (gchar *) "ExpiryTimerMaxLateness",
+  (gchar *) "t",  /* seconds */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_uptime =
+{
+  -1,  /* ref count */
+  (gchar *) "Uptime",
+  (gchar *) "t",  /* seconds */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo statistics_interface_startup_phases =
+{
+  -1,  /* ref count */
+  (gchar *) "StartupPhases",
+  (gchar *) "a(sx)",  /* names and durations in microseconds */
+  G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+  NULL,  /* annotations */
+};
+
+static const GDBusPropertyInfo *statistics_interface_properties[] =
+{
+  &statistics_interface_codes_attempted,
+  &statistics_interface_codes_accepted,
+  &statistics_interface_codes_rejected,
+  &statistics_interface_codes_rate_limited,
+  &statistics_interface_state_saves,
+  &statistics_interface_state_saves_coalesced,
+  &statistics_interface_state_save_latency_p50,
+  &statistics_interface_state_save_latency_p99,
+  &statistics_interface_efi_reads,
+  &statistics_interface_efi_writes,
+  &statistics_interface_clock_jumps,
+  &statistics_interface_expiry_timer_max_lateness,
+  &statistics_interface_uptime,
+  &statistics_interface_startup_phases,
+  NULL,
+};
+
+static const GDBusInterfaceInfo statistics_interface =
+{
+  -1,  /* ref count */
+  (gchar *) "com.endlessm.Payg1.Statistics",
+  NULL,  /* no methods */
+  NULL,  /* no signals */
+  (GDBusPropertyInfo **) statistics_interface_properties,
+  (GDBusAnnotationInfo **) statistics_interface_annotations,
+};
+
 static const gchar *manager_errors[] =
 {
   "com.endlessm.Payg1.Error.InvalidCode",
@@ -23,13 +23,26 @@
 #include <glib-unix.h>
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <libeos-payg/errors.h>
+#include <libeos-payg/loop-monitor.h>
 #include <libeos-payg/manager-interface.h>
 #include <libeos-payg/manager-service.h>
+#include <libeos-payg/state-snapshot.h>
+#include <libeos-payg/stats.h>
 #include <libeos-payg/util.h>
 
 #define TIMEOUT_POWEROFF_NO_CREDIT_MINUTES 10
 
+/* Amounts of remaining credit, in seconds, at which the CreditLow signal is
+ * emitted. These must be in descending order. */
+static const guint64 credit_low_thresholds[] =
+  {
+    24 * 60 * 60,
+    60 * 60,
+    5 * 60,
+  };
+
 static void epg_manager_service_dispose      (GObject      *object);
 static void epg_manager_service_get_property (GObject      *object,
                                               guint         property_id,
@@ -86,11 +99,21 @@ static void epg_manager_service_manager_add_code           (EpgManagerService
                                                             const gchar           *sender,
                                                             GVariant              *parameters,
                                                             GDBusMethodInvocation *invocation);
+static void epg_manager_service_manager_add_codes          (EpgManagerService     *self,
+                                                            GDBusConnection       *connection,
+                                                            const gchar           *sender,
+                                                            GVariant              *parameters,
+                                                            GDBusMethodInvocation *invocation);
 static void epg_manager_service_manager_clear_code         (EpgManagerService     *self,
                                                             GDBusConnection       *connection,
                                                             const gchar           *sender,
                                                             GVariant              *parameters,
                                                             GDBusMethodInvocation *invocation);
+static void epg_manager_service_manager_get_state_fd       (EpgManagerService     *self,
+                                                            GDBusConnection       *connection,
+                                                            const gchar           *sender,
+                                                            GVariant              *parameters,
+                                                            GDBusMethodInvocation *invocation);
 
 static GVariant *epg_manager_service_manager_get_expiry_time (EpgManagerService     *self,
                                                               GDBusConnection       *connection,
@@ -144,14 +167,29 @@ static GVariant *epg_manager_service_manager_get_account_id (EpgManagerService
                                                              const gchar           *interface_name,
                                                              const gchar           *property_name,
                                                              GDBusMethodInvocation *invocation);
+static GVariant *epg_manager_service_statistics_get (EpgManagerService     *self,
+                                                     GDBusConnection       *connection,
+                                                     const gchar           *sender,
+                                                     const gchar           *interface_name,
+                                                     const gchar           *property_name,
+                                                     GDBusMethodInvocation *invocation);
 static void expired_cb (EpgProvider *provider,
                         gpointer     user_data);
 static void notify_cb  (GObject    *obj,
                         GParamSpec *pspec,
                         gpointer    user_data);
+static void build_property_index    (EpgManagerService *self);
+static void emit_properties_changed (EpgManagerService *self);
+static void update_state_snapshot   (EpgManagerService *self);
 static void notify_expiry_time_cb  (GObject    *obj,
                                     GParamSpec *pspec,
                                     gpointer    user_data);
+static void notify_timers_cb       (GObject    *obj,
+                                    GParamSpec *pspec,
+                                    gpointer    user_data);
+static void schedule_credit_low        (EpgManagerService *self,
+                                        guint64            below_threshold);
+static void schedule_rate_limit_ended  (EpgManagerService *self);
 
 static const GDBusErrorEntry manager_error_map[] =
   {
@@ -193,6 +231,29 @@ struct _EpgManagerService
 
   /* Actual implementation of the provider. */
   EpgProvider *provider;  /* (owned) */
+
+  /* Map from the #GParamSpec of each notifiable property of @provider to its
+   * index in manager_properties, plus one. */
+  GHashTable *property_index;  /* (owned) (element-type GParamSpec gsize) */
+
+  /* Properties which have been notified since PropertiesChanged was last
+   * emitted, as a bitmask of indices in manager_properties. They are emitted
+   * together from an idle callback, or earlier if another signal or a method
+   * reply needs to be ordered after them. */
+  guint64 pending_properties;
+  guint properties_changed_id;
+
+  /* Shared memory copy of the provider state, for clients which poll it.
+   * This is only created once a client asks for it with GetStateFd, and is
+   * then kept up to date on every notification from @provider. */
+  EpgStateSnapshot *state_snapshot;  /* (owned) (nullable) */
+
+  /* Timers on the provider’s #EpgClock for the next CreditLow signal, and for
+   * the RateLimitEnded signal, if either is due. Clients can wait for these
+   * rather than running their own countdown from ExpiryTime. */
+  GSource *credit_low_source;  /* (owned) (nullable) */
+  guint64 credit_low_threshold;  /* threshold @credit_low_source is for */
+  GSource *rate_limit_ended_source;  /* (owned) (nullable) */
 };
 
 typedef enum
@@ -289,6 +350,22 @@ epg_manager_service_dispose (GObject *object)
   if (self->shutdown_timer_id != 0)
     g_source_remove (self->shutdown_timer_id);
 
+  if (self->properties_changed_id != 0)
+    {
+      g_source_remove (self->properties_changed_id);
+      self->properties_changed_id = 0;
+    }
+  self->pending_properties = 0;
+  g_clear_pointer (&self->property_index, g_hash_table_unref);
+  g_clear_object (&self->state_snapshot);
+
+  if (self->credit_low_source != NULL)
+    g_source_destroy (self->credit_low_source);
+  g_clear_pointer (&self->credit_low_source, g_source_unref);
+  if (self->rate_limit_ended_source != NULL)
+    g_source_destroy (self->rate_limit_ended_source);
+  g_clear_pointer (&self->rate_limit_ended_source, g_source_unref);
+
   g_clear_object (&self->connection);
   g_clear_pointer (&self->object_path, g_free);
   g_clear_object (&self->cancellable);
@@ -297,6 +374,7 @@ epg_manager_service_dispose (GObject *object)
     {
       g_signal_handlers_disconnect_by_func (self->provider, notify_cb, self);
       g_signal_handlers_disconnect_by_func (self->provider, notify_expiry_time_cb, self);
+      g_signal_handlers_disconnect_by_func (self->provider, notify_timers_cb, self);
       g_signal_handlers_disconnect_by_func (self->provider, expired_cb, self);
     }
 
@@ -358,9 +436,16 @@ epg_manager_service_set_property (GObject      *object,
       /* Construct only. */
       g_assert (self->provider == NULL);
       self->provider = g_value_dup_object (value);
+      build_property_index (self);
       g_signal_connect (self->provider, "expired", (GCallback) expired_cb, self);
       g_signal_connect (self->provider, "notify", (GCallback) notify_cb, self);
       g_signal_connect (self->provider, "notify::expiry-time", (GCallback) notify_expiry_time_cb, self);
+      g_signal_connect (self->provider, "notify::expiry-time", (GCallback) notify_timers_cb, self);
+      g_signal_connect (self->provider, "notify::enabled", (GCallback) notify_timers_cb, self);
+      g_signal_connect (self->provider, "notify::rate-limit-end-time", (GCallback) notify_timers_cb, self);
+
+      schedule_credit_low (self, G_MAXUINT64);
+      schedule_rate_limit_ended (self);
 
       /* Trigger expired_cb() if it's already expired */
       clock = epg_provider_get_clock (self->provider);
@@ -384,6 +469,9 @@ expired_cb (EpgProvider *provider,
   EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
   g_autoptr(GError) local_error = NULL;
 
+  /* Make sure clients see the final property values before the signal. */
+  emit_properties_changed (self);
+
   if (!g_dbus_connection_emit_signal (self->connection,
                                       NULL,  /* broadcast */
                                       self->object_path,
@@ -520,10 +608,11 @@ epg_manager_service_entry_introspect (GDBusConnection *connection,
 
   if (node == NULL)
     {
-      /* The root node implements the manager only. */
-      interfaces = g_new0 (GDBusInterfaceInfo *, 2);
+      /* The root node implements the manager and its statistics. */
+      interfaces = g_new0 (GDBusInterfaceInfo *, 3);
       interfaces[0] = (GDBusInterfaceInfo *) &manager_interface;
-      interfaces[1] = NULL;
+      interfaces[1] = (GDBusInterfaceInfo *) &statistics_interface;
+      interfaces[2] = NULL;
     }
 
   return g_steal_pointer (&interfaces);
@@ -548,9 +637,11 @@ epg_manager_service_entry_dispatch (GDBusConnection *connection,
   /* Don’t implement any permissions checks here, as they should be specific to
    * the APIs being called and objects being accessed. */
 
-  /* Manager is implemented on the root of the tree. */
+  /* Manager is implemented on the root of the tree. Statistics only have
+   * properties, which are handled by the same vtable. */
   if (node == NULL &&
-      g_str_equal (interface_name, "com.endlessm.Payg1"))
+      (g_str_equal (interface_name, "com.endlessm.Payg1") ||
+       g_str_equal (interface_name, "com.endlessm.Payg1.Statistics")))
     {
       *out_user_data = user_data;
       return &manager_interface_vtable;
@@ -601,8 +692,12 @@ manager_methods[] =
     /* Manager methods. */
     { "com.endlessm.Payg1", "AddCode",
       epg_manager_service_manager_add_code },
+    { "com.endlessm.Payg1", "AddCodes",
+      epg_manager_service_manager_add_codes },
     { "com.endlessm.Payg1", "ClearCode",
       epg_manager_service_manager_clear_code },
+    { "com.endlessm.Payg1", "GetStateFd",
+      epg_manager_service_manager_get_state_fd },
   };
 
 G_STATIC_ASSERT (G_N_ELEMENTS (manager_methods) ==
@@ -635,8 +730,11 @@ epg_manager_service_manager_method_call (GDBusConnection       *connection,
       if (g_str_equal (manager_methods[i].interface_name, interface_name) &&
           g_str_equal (manager_methods[i].method_name, method_name))
         {
+          gint64 monitor_start = epg_loop_monitor_dispatch_begin ();
+
           manager_methods[i].func (self, connection, sender,
                                    parameters, invocation);
+          epg_loop_monitor_dispatch_end (method_name, monitor_start);
           return;
         }
     }
@@ -688,12 +786,78 @@ manager_properties[] =
       epg_manager_service_manager_get_code_length, NULL  /* read-only */ },
     { "com.endlessm.Payg1", "AccountID", "account-id",
       epg_manager_service_manager_get_account_id, NULL  /* read-only */ },
+
+    /* Statistics properties. These are not backed by object properties, and
+     * are never notified. */
+    { "com.endlessm.Payg1.Statistics", "CodesAttempted", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "CodesAccepted", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "CodesRejected", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "CodesRateLimited", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "StateSaves", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "StateSavesCoalesced", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "StateSaveLatencyP50", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "StateSaveLatencyP99", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "EfiReads", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "EfiWrites", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "ClockJumps", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "ExpiryTimerMaxLateness", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "Uptime", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
+    { "com.endlessm.Payg1.Statistics", "StartupPhases", NULL,
+      epg_manager_service_statistics_get, NULL  /* read-only */ },
   };
 
 G_STATIC_ASSERT (G_N_ELEMENTS (manager_properties) ==
                  G_N_ELEMENTS (manager_interface_properties) +
+                 -1  /* NULL terminator */ +
+                 G_N_ELEMENTS (statistics_interface_properties) +
                  -1  /* NULL terminator */);
 
+/* Pending notifications are tracked in a #guint64 bitmask. */
+G_STATIC_ASSERT (G_N_ELEMENTS (manager_properties) <= 64);
+
+static void
+build_property_index (EpgManagerService *self)
+{
+  GObjectClass *provider_class = G_OBJECT_GET_CLASS (self->provider);
+
+  self->property_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (manager_properties); i++)
+    {
+      const gchar *object_property_name = manager_properties[i].object_property_name;
+      GParamSpec *pspec;
+
+      if (object_property_name == NULL)
+        continue;
+
+      /* This returns the redirect target for overridden interface
+       * properties, which is also what #GObject::notify is emitted with. */
+      pspec = g_object_class_find_property (provider_class, object_property_name);
+      if (pspec == NULL)
+        {
+          g_debug ("%s: %s has no property ‘%s’; it will never be notified.",
+                   G_STRFUNC, G_OBJECT_CLASS_NAME (provider_class),
+                   object_property_name);
+          continue;
+        }
+
+      g_hash_table_insert (self->property_index, pspec, GSIZE_TO_POINTER (i + 1));
+    }
+}
+
 static void
 epg_manager_service_manager_properties_get (EpgManagerService     *self,
                                             GDBusConnection       *connection,
@@ -785,7 +949,8 @@ epg_manager_service_manager_properties_get_all (EpgManagerService     *self,
     return;
 
   /* Try the interface. */
-  if (!g_str_equal (interface_name, "com.endlessm.Payg1"))
+  if (!g_str_equal (interface_name, "com.endlessm.Payg1") &&
+      !g_str_equal (interface_name, "com.endlessm.Payg1.Statistics"))
     {
       g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
                                              G_DBUS_ERROR_UNKNOWN_INTERFACE,
@@ -817,45 +982,47 @@ epg_manager_service_manager_properties_get_all (EpgManagerService     *self,
                                          g_variant_new ("(@a{sv})", dict_variant));
 }
 
+/* Emit a single PropertiesChanged signal for all the pending notified
+ * properties, if there are any. */
 static void
-notify_cb (GObject    *obj,
-           GParamSpec *pspec,
-           gpointer    user_data)
+emit_properties_changed (EpgManagerService *self)
 {
-  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
   g_autoptr(GError) local_error = NULL;
 
-  /* Find the property being notified. */
-  gsize i;
-  for (i = 0; i < G_N_ELEMENTS (manager_properties); i++)
+  if (self->properties_changed_id != 0)
     {
-      const gchar *object_property_name = manager_properties[i].object_property_name;
-
-      if (g_str_equal (g_param_spec_get_name (pspec), object_property_name))
-        break;
+      g_source_remove (self->properties_changed_id);
+      self->properties_changed_id = 0;
     }
 
-  if (i == G_N_ELEMENTS (manager_properties))
-    {
-      g_debug ("%s: Couldn’t find D-Bus property matching EpgManager:%s; ignoring.",
-               G_STRFUNC, g_param_spec_get_name (pspec));
-      return;
-    }
-
-  /* Emit PropertiesChanged for it. */
-  g_autoptr(GVariant) value = NULL;
-  value = manager_properties[i].get_func (self, self->connection, NULL,
-                                          manager_properties[i].interface_name,
-                                          manager_properties[i].property_name,
-                                          NULL);
-  g_variant_ref_sink (value);
+  if (self->pending_properties == 0)
+    return;
 
   g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("(sa{sv}as)"));
-  g_variant_builder_add (&builder, "s", manager_properties[i].interface_name);
+  g_variant_builder_add (&builder, "s", "com.endlessm.Payg1");
 
   g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
-  g_variant_builder_add (&builder, "{sv}",
-                         manager_properties[i].property_name, value);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (manager_properties); i++)
+    {
+      if (!(self->pending_properties & ((guint64) 1 << i)))
+        continue;
+
+      /* Only properties of the manager interface are ever notified. */
+      g_assert (g_str_equal (manager_properties[i].interface_name, "com.endlessm.Payg1"));
+
+      g_autoptr(GVariant) value = NULL;
+      value = manager_properties[i].get_func (self, self->connection, NULL,
+                                              manager_properties[i].interface_name,
+                                              manager_properties[i].property_name,
+                                              NULL);
+      g_variant_ref_sink (value);
+      g_variant_builder_add (&builder, "{sv}",
+                             manager_properties[i].property_name, value);
+    }
+
+  self->pending_properties = 0;
+
   g_variant_builder_close (&builder);
 
   g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
@@ -875,6 +1042,49 @@ notify_cb (GObject    *obj,
                local_error->message);
 }
 
+static gboolean
+properties_changed_cb (gpointer user_data)
+{
+  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
+
+  /* emit_properties_changed() would otherwise remove this source. */
+  self->properties_changed_id = 0;
+  emit_properties_changed (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+notify_cb (GObject    *obj,
+           GParamSpec *pspec,
+           gpointer    user_data)
+{
+  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
+  gsize i_plus_one = GPOINTER_TO_SIZE (g_hash_table_lookup (self->property_index, pspec));
+
+  /* Unlike PropertiesChanged, this wakes nobody up, so don’t delay it. */
+  update_state_snapshot (self);
+
+  if (i_plus_one == 0)
+    {
+      g_debug ("%s: Couldn’t find D-Bus property matching EpgManager:%s; ignoring.",
+               G_STRFUNC, g_param_spec_get_name (pspec));
+      return;
+    }
+
+  /* Batch up notifications until the next main loop iteration, so that
+   * several properties changing together (such as when a code is added) wake
+   * up clients only once. */
+  self->pending_properties |= (guint64) 1 << (i_plus_one - 1);
+
+  if (self->properties_changed_id == 0)
+    {
+      self->properties_changed_id = g_idle_add (properties_changed_cb, self);
+      g_source_set_name_by_id (self->properties_changed_id,
+                               "EpgManagerService PropertiesChanged");
+    }
+}
+
 static void
 notify_expiry_time_cb (GObject    *obj,
                        GParamSpec *pspec,
@@ -919,6 +1129,170 @@ notify_expiry_time_cb (GObject    *obj,
     }
 }
 
+static void
+emit_signal (EpgManagerService *self,
+             const gchar       *signal_name,
+             GVariant          *parameters)
+{
+  g_autoptr(GError) local_error = NULL;
+
+  /* Make sure clients see the current property values before the signal. */
+  emit_properties_changed (self);
+
+  if (!g_dbus_connection_emit_signal (self->connection,
+                                      NULL,  /* broadcast */
+                                      self->object_path,
+                                      "com.endlessm.Payg1",
+                                      signal_name,
+                                      parameters,
+                                      &local_error))
+    g_warning ("Failed to emit com.endlessm.Payg1.%s signal: %s",
+               signal_name, local_error->message);
+}
+
+static gboolean
+credit_low_cb (gpointer user_data)
+{
+  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
+  EpgClock *clock = epg_provider_get_clock (self->provider);
+  guint64 now_secs = epg_clock_get_time (clock);
+  guint64 expiry_time_secs = epg_provider_get_expiry_time (self->provider);
+  guint64 remaining_secs = (expiry_time_secs > now_secs) ? expiry_time_secs - now_secs : 0;
+  guint64 threshold = self->credit_low_threshold;
+
+  /* If the timer fired late (for example, because the computer was suspended
+   * across several thresholds), only report the lowest threshold crossed. The
+   * Expired signal covers running out entirely. */
+  for (gsize i = 0; i < G_N_ELEMENTS (credit_low_thresholds); i++)
+    {
+      if (credit_low_thresholds[i] < threshold &&
+          credit_low_thresholds[i] >= remaining_secs)
+        threshold = credit_low_thresholds[i];
+    }
+
+  if (remaining_secs > 0)
+    {
+      g_message ("Credit low: %" G_GUINT64_FORMAT " seconds remaining", remaining_secs);
+      emit_signal (self, "CreditLow", g_variant_new ("(t)", threshold));
+    }
+
+  /* This replaces the source which is currently being dispatched. */
+  schedule_credit_low (self, threshold);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Schedule the CreditLow signal for the highest threshold which is below both
+ * the remaining credit and @below_threshold, replacing any which is already
+ * scheduled. */
+static void
+schedule_credit_low (EpgManagerService *self,
+                     guint64            below_threshold)
+{
+  g_autoptr(GError) local_error = NULL;
+  EpgClock *clock = epg_provider_get_clock (self->provider);
+  guint64 now_secs = epg_clock_get_time (clock);
+  guint64 expiry_time_secs = epg_provider_get_expiry_time (self->provider);
+
+  if (self->credit_low_source != NULL)
+    g_source_destroy (self->credit_low_source);
+  g_clear_pointer (&self->credit_low_source, g_source_unref);
+  self->credit_low_threshold = 0;
+
+  /* Note: expiry_time_secs is 0 if the provider is disabled */
+  if (!epg_provider_get_enabled (self->provider) ||
+      expiry_time_secs == G_MAXUINT64 ||
+      expiry_time_secs <= now_secs)
+    return;
+
+  guint64 remaining_secs = expiry_time_secs - now_secs;
+
+  for (gsize i = 0; i < G_N_ELEMENTS (credit_low_thresholds); i++)
+    {
+      if (credit_low_thresholds[i] < remaining_secs &&
+          credit_low_thresholds[i] < below_threshold)
+        {
+          self->credit_low_threshold = credit_low_thresholds[i];
+          break;
+        }
+    }
+
+  if (self->credit_low_threshold == 0)
+    return;
+
+  guint interval_clamped = MIN (remaining_secs - self->credit_low_threshold, G_MAXUINT);
+  self->credit_low_source = epg_clock_source_new_seconds (clock, interval_clamped, &local_error);
+
+  if (self->credit_low_source == NULL)
+    {
+      g_warning ("%s: epg_clock_source_new_seconds() failed: %s", G_STRFUNC, local_error->message);
+      self->credit_low_threshold = 0;
+      return;
+    }
+
+  g_source_set_name (self->credit_low_source, "EpgManagerService CreditLow");
+  g_source_set_callback (self->credit_low_source, credit_low_cb, self, NULL);
+  g_source_attach (self->credit_low_source, NULL);
+}
+
+static gboolean
+rate_limit_ended_cb (gpointer user_data)
+{
+  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
+
+  g_clear_pointer (&self->rate_limit_ended_source, g_source_unref);
+
+  emit_signal (self, "RateLimitEnded", NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Schedule the RateLimitEnded signal for the end of the current rate limiting
+ * period, if there is one, replacing any which is already scheduled. */
+static void
+schedule_rate_limit_ended (EpgManagerService *self)
+{
+  g_autoptr(GError) local_error = NULL;
+  EpgClock *clock = epg_provider_get_clock (self->provider);
+  guint64 now_secs = epg_clock_get_time (clock);
+  guint64 rate_limit_end_time_secs = epg_provider_get_rate_limit_end_time (self->provider);
+
+  if (self->rate_limit_ended_source != NULL)
+    g_source_destroy (self->rate_limit_ended_source);
+  g_clear_pointer (&self->rate_limit_ended_source, g_source_unref);
+
+  /* Note: rate_limit_end_time_secs is 0 if the provider is disabled, and may
+   * be in the past if the last rate limiting period has already ended */
+  if (rate_limit_end_time_secs <= now_secs)
+    return;
+
+  guint interval_clamped = MIN (rate_limit_end_time_secs - now_secs, G_MAXUINT);
+  self->rate_limit_ended_source = epg_clock_source_new_seconds (clock, interval_clamped, &local_error);
+
+  if (self->rate_limit_ended_source == NULL)
+    {
+      g_warning ("%s: epg_clock_source_new_seconds() failed: %s", G_STRFUNC, local_error->message);
+      return;
+    }
+
+  g_source_set_name (self->rate_limit_ended_source, "EpgManagerService RateLimitEnded");
+  g_source_set_callback (self->rate_limit_ended_source, rate_limit_ended_cb, self, NULL);
+  g_source_attach (self->rate_limit_ended_source, NULL);
+}
+
+static void
+notify_timers_cb (GObject    *obj,
+                  GParamSpec *pspec,
+                  gpointer    user_data)
+{
+  EpgManagerService *self = EPG_MANAGER_SERVICE (user_data);
+
+  /* Thresholds which have already been passed are not signalled again, since
+   * they are strictly above the remaining credit. */
+  schedule_credit_low (self, G_MAXUINT64);
+  schedule_rate_limit_ended (self);
+}
+
 static GVariant *
 epg_manager_service_manager_get_expiry_time (EpgManagerService     *self,
                                              GDBusConnection       *connection,
@@ -1007,6 +1381,106 @@ epg_manager_service_manager_get_account_id (EpgManagerService     *self,
   return g_variant_new_string (epg_provider_get_account_id (self->provider));
 }
 
+static GVariant *
+epg_manager_service_statistics_get (EpgManagerService     *self,
+                                    GDBusConnection       *connection,
+                                    const gchar           *sender,
+                                    const gchar           *interface_name,
+                                    const gchar           *property_name,
+                                    GDBusMethodInvocation *invocation)
+{
+  static const struct
+    {
+      const gchar *property_name;
+      EpgStatsCounter counter;
+    }
+  counters[] =
+    {
+      { "CodesAttempted", EPG_STATS_CODES_ATTEMPTED },
+      { "CodesAccepted", EPG_STATS_CODES_ACCEPTED },
+      { "StateSaves", EPG_STATS_STATE_SAVES },
+      { "StateSavesCoalesced", EPG_STATS_STATE_SAVES_COALESCED },
+      { "EfiReads", EPG_STATS_EFI_READS },
+      { "EfiWrites", EPG_STATS_EFI_WRITES },
+      { "ClockJumps", EPG_STATS_CLOCK_JUMPS },
+    };
+
+  for (gsize i = 0; i < G_N_ELEMENTS (counters); i++)
+    {
+      if (g_str_equal (property_name, counters[i].property_name))
+        return g_variant_new_uint64 (epg_stats_get (counters[i].counter));
+    }
+
+  if (g_str_equal (property_name, "CodesRejected"))
+    return epg_stats_dup_codes_rejected ();
+  else if (g_str_equal (property_name, "CodesRateLimited"))
+    return g_variant_new_uint64 (epg_stats_get_codes_rejected (EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS));
+  else if (g_str_equal (property_name, "StateSaveLatencyP50"))
+    return g_variant_new_uint64 ((guint64) epg_stats_get_save_latency_percentile (50));
+  else if (g_str_equal (property_name, "StateSaveLatencyP99"))
+    return g_variant_new_uint64 ((guint64) epg_stats_get_save_latency_percentile (99));
+  else if (g_str_equal (property_name, "ExpiryTimerMaxLateness"))
+    return g_variant_new_uint64 (epg_stats_get_expiry_lateness_max ());
+  else if (g_str_equal (property_name, "Uptime"))
+    return g_variant_new_uint64 (epg_stats_get_uptime ());
+  else if (g_str_equal (property_name, "StartupPhases"))
+    return epg_stats_dup_startup_phases ();
+
+  g_assert_not_reached ();
+}
+
+typedef struct
+{
+  EpgManagerService *self;  /* (owned) */
+  GDBusMethodInvocation *invocation;  /* (owned) */
+  gchar *code_str;  /* (owned) */
+} AddCodeData;
+
+static void
+add_code_data_free (AddCodeData *data)
+{
+  g_clear_object (&data->self);
+  g_clear_object (&data->invocation);
+  g_free (data->code_str);
+  g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AddCodeData, add_code_data_free)
+
+static void
+add_code_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  EpgProvider *provider = EPG_PROVIDER (source_object);
+  g_autoptr(AddCodeData) data = g_steal_pointer (&user_data);
+  EpgManagerService *self = data->self;
+  g_autoptr(GError) local_error = NULL;
+  gint64 time_added = 0;
+
+  epg_provider_add_code_finish (provider, result, &time_added, &local_error);
+
+  /* Emit any property changes before the reply, so clients see the new state
+   * when it arrives. */
+  emit_properties_changed (self);
+
+  if (local_error != NULL)
+    {
+      epg_stats_record_code_rejected (local_error);
+      g_message ("Failed to enter code %s: %s", data->code_str, local_error->message);
+      g_dbus_method_invocation_return_gerror (data->invocation, local_error);
+    }
+  else
+    {
+      epg_stats_increment (EPG_STATS_CODES_ACCEPTED);
+      g_message ("Added %" G_GINT64_FORMAT " units of credit", time_added);
+      g_dbus_method_invocation_return_value (data->invocation,
+                                             g_variant_new ("(x)", time_added));
+    }
+}
+
+/* The code is added asynchronously, so that providers which need to do I/O to
+ * verify it don’t block other D-Bus calls in the meantime. */
 static void
 epg_manager_service_manager_add_code (EpgManagerService     *self,
                                       GDBusConnection       *connection,
@@ -1014,25 +1488,124 @@ epg_manager_service_manager_add_code (EpgManagerService     *self,
                                       GVariant              *parameters,
                                       GDBusMethodInvocation *invocation)
 {
-  g_autoptr(GError) local_error = NULL;
-  gint64 time_added = 0;
-
   const gchar *code_str;
   g_variant_get (parameters, "(&s)", &code_str);
 
   g_message ("Trying to enter code %s", code_str);
-  epg_provider_add_code (self->provider, code_str, &time_added, &local_error);
+  epg_stats_increment (EPG_STATS_CODES_ATTEMPTED);
 
-  if (local_error != NULL)
+  g_autoptr(AddCodeData) data = g_new0 (AddCodeData, 1);
+  data->self = g_object_ref (self);
+  data->invocation = g_object_ref (invocation);
+  data->code_str = g_strdup (code_str);
+
+  epg_provider_add_code_async (self->provider, code_str, self->cancellable,
+                               add_code_cb, g_steal_pointer (&data));
+}
+
+typedef struct
+{
+  EpgManagerService *self;  /* (owned) */
+  GDBusMethodInvocation *invocation;  /* (owned) */
+  gchar **codes;  /* (owned) */
+} AddCodesData;
+
+static void
+add_codes_data_free (AddCodesData *data)
+{
+  g_clear_object (&data->self);
+  g_clear_object (&data->invocation);
+  g_strfreev (data->codes);
+  g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AddCodesData, add_codes_data_free)
+
+static void
+add_codes_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  EpgProvider *provider = EPG_PROVIDER (source_object);
+  g_autoptr(AddCodesData) data = g_steal_pointer (&user_data);
+  EpgManagerService *self = data->self;
+  gsize n_codes = g_strv_length (data->codes);
+
+  g_autofree gint64 *times_added = g_new0 (gint64, n_codes);
+  g_autofree GError **errors = g_new0 (GError *, n_codes);
+
+  epg_provider_add_codes_finish (provider, result, times_added, errors);
+
+  /* Emit any property changes before the reply, so clients see the new state
+   * when it arrives. */
+  emit_properties_changed (self);
+
+  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("(a(xs))"));
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(xs)"));
+
+  for (gsize i = 0; i < n_codes; i++)
     {
-      g_message ("Failed to enter code %s: %s", code_str, local_error->message);
-      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      g_autofree gchar *error_name = NULL;
+
+      epg_stats_increment (EPG_STATS_CODES_ATTEMPTED);
+
+      if (errors[i] != NULL)
+        {
+          epg_stats_record_code_rejected (errors[i]);
+          g_message ("Failed to enter code %s: %s", data->codes[i], errors[i]->message);
+          error_name = g_dbus_error_encode_gerror (errors[i]);
+          g_clear_error (&errors[i]);
+        }
+      else
+        {
+          epg_stats_increment (EPG_STATS_CODES_ACCEPTED);
+          g_message ("Added %" G_GINT64_FORMAT " units of credit from code %s",
+                     times_added[i], data->codes[i]);
+        }
+
+      g_variant_builder_add (&builder, "(xs)", times_added[i],
+                             (error_name != NULL) ? error_name : "");
     }
-  else
+
+  g_variant_builder_close (&builder);
+  g_dbus_method_invocation_return_value (data->invocation, g_variant_builder_end (&builder));
+}
+
+/* At most %EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES codes may be passed, and they
+ * are still subject to rate limiting individually; see
+ * epg_provider_add_codes(). As with AddCode, the codes are added
+ * asynchronously so that slow providers don’t block other D-Bus calls. */
+static void
+epg_manager_service_manager_add_codes (EpgManagerService     *self,
+                                       GDBusConnection       *connection,
+                                       const gchar           *sender,
+                                       GVariant              *parameters,
+                                       GDBusMethodInvocation *invocation)
+{
+  g_autofree const gchar **codes = NULL;
+  gsize n_codes;
+
+  g_variant_get (parameters, "(^a&s)", &codes);
+  n_codes = g_strv_length ((gchar **) codes);
+
+  if (n_codes > EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES)
     {
-      g_message ("Added %" G_GINT64_FORMAT " units of credit", time_added);
-      g_dbus_method_invocation_return_value (invocation, g_variant_new ("(x)", time_added));
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                             G_DBUS_ERROR_INVALID_ARGS,
+                                             _("Too many codes: at most %u may be added at once."),
+                                             (guint) EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES);
+      return;
     }
+
+  g_message ("Trying to enter %" G_GSIZE_FORMAT " codes", n_codes);
+
+  g_autoptr(AddCodesData) data = g_new0 (AddCodesData, 1);
+  data->self = g_object_ref (self);
+  data->invocation = g_object_ref (invocation);
+  data->codes = g_strdupv ((gchar **) codes);
+
+  epg_provider_add_codes_async (self->provider, codes, self->cancellable,
+                                add_codes_cb, g_steal_pointer (&data));
 }
 
 static void
@@ -1045,6 +1618,7 @@ epg_manager_service_manager_clear_code (EpgManagerService     *self,
   g_autoptr(GError) local_error = NULL;
 
   epg_provider_clear_code (self->provider, &local_error);
+  emit_properties_changed (self);
 
   if (local_error != NULL)
     g_dbus_method_invocation_return_gerror (invocation, local_error);
@@ -1052,6 +1626,73 @@ epg_manager_service_manager_clear_code (EpgManagerService     *self,
     g_dbus_method_invocation_return_value (invocation, NULL);
 }
 
+static void
+update_state_snapshot (EpgManagerService *self)
+{
+  if (self->state_snapshot == NULL)
+    return;
+
+  epg_state_snapshot_update (self->state_snapshot,
+                             epg_provider_get_enabled (self->provider),
+                             epg_provider_get_expiry_time (self->provider),
+                             epg_provider_get_rate_limit_end_time (self->provider));
+}
+
+/* Return a read-only file descriptor for a memfd containing the provider state
+ * (see #EpgStateSnapshotData), so that clients which poll the state can mmap()
+ * it rather than calling Get/GetAll repeatedly. */
+static void
+epg_manager_service_manager_get_state_fd (EpgManagerService     *self,
+                                          GDBusConnection       *connection,
+                                          const gchar           *sender,
+                                          GVariant              *parameters,
+                                          GDBusMethodInvocation *invocation)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  int fd;
+
+  if (!(g_dbus_connection_get_capabilities (connection) &
+        G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                             G_DBUS_ERROR_NOT_SUPPORTED,
+                                             _("File descriptors can’t be passed on this connection."));
+      return;
+    }
+
+  if (self->state_snapshot == NULL)
+    {
+      self->state_snapshot = epg_state_snapshot_new (&local_error);
+      if (self->state_snapshot == NULL)
+        {
+          g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                 G_DBUS_ERROR_FAILED,
+                                                 _("Failed to create state snapshot: %s"),
+                                                 local_error->message);
+          return;
+        }
+
+      update_state_snapshot (self);
+    }
+
+  fd = epg_state_snapshot_dup_fd (self->state_snapshot, &local_error);
+  if (fd < 0)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                             G_DBUS_ERROR_FAILED,
+                                             _("Failed to get state snapshot: %s"),
+                                             local_error->message);
+      return;
+    }
+
+  /* This takes ownership of @fd. */
+  fd_list = g_unix_fd_list_new_from_array (&fd, 1);
+  g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+                                                           g_variant_new ("(h)", 0),
+                                                           fd_list);
+}
+
 /**
  * epg_manager_service_new:
  * @connection: (transfer none): D-Bus connection to export objects on
@@ -30,6 +30,11 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (EpgManagerService, epg_manager_service, EPG,
                       MANAGER_SERVICE, GObject)
 
+/* Maximum number of codes accepted by one AddCodes call. Longer batches are
+ * rejected with %G_DBUS_ERROR_INVALID_ARGS, so one call can’t hold up the
+ * main loop for long. */
+#define EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES 32
+
 EpgManagerService *epg_manager_service_new (GDBusConnection *connection,
                                             const gchar     *object_path,
                                             EpgProvider     *manager);
@@ -23,11 +23,16 @@
 #include <glib-object.h>
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
+#include <libeos-payg/efi.h>
 #include <libeos-payg/errors.h>
 #include <libeos-payg/manager.h>
 #include <libeos-payg/real-clock.h>
 #include <libeos-payg/multi-task.h>
+#include <libeos-payg/rate-limiting.h>
+#include <libeos-payg/stats.h>
+#include <libeos-payg/trace.h>
 #include <libeos-payg-codes/codes.h>
+#include <string.h>
 
 
 static void epg_manager_async_initable_iface_init (gpointer g_iface,
@@ -61,6 +66,10 @@ static gboolean    epg_manager_add_code   (EpgProvider  *provider,
                                            const gchar  *code_str,
                                            gint64       *time_added,
                                            GError      **error);
+static guint       epg_manager_add_codes  (EpgProvider        *provider,
+                                           const gchar * const *codes,
+                                           gint64             *times_added,
+                                           GError            **errors);
 static gboolean    epg_manager_clear_code (EpgProvider  *provider,
                                            GError      **error);
 
@@ -110,14 +119,39 @@ G_STATIC_ASSERT (sizeof (UsedCode) == 2);
 G_STATIC_ASSERT (offsetof (UsedCode, counter) == 0);
 G_STATIC_ASSERT (offsetof (UsedCode, period) == 1);
 
-/* Limit calls to epg_manager_add_code() to 10 attempts every 30 minutes. These
- * values are not arbitrary, and are an inherent part of the security of the
- * codes in libeos-payg-codes against brute force attacks. By rate limiting at
- * this level, we can probabilistically say that brute force attacks will take
- * longer than the period of the code they would reveal, assuming codes have
- * an average period of 1 week. */
-#define RATE_LIMITING_N_ATTEMPTS 10
-#define RATE_LIMITING_TIME_PERIOD_SECS (30 * 60)
+/* Version of the encoding of the EFI variables holding the state when EFI
+ * storage is in use (EFI_STATE_VARIABLE and EFI_STATE_VARIABLE_B; see
+ * #EpgManager:efi-state). The encoding is:
+ *
+ *  - 1 byte: %EFI_STATE_VERSION
+ *  - varint: generation of the state, incremented on each save
+ *  - varint: wall clock time of the save, in seconds since the Unix epoch
+ *  - varint: seconds of credit remaining at the time of the save
+ *  - varint: bitmask of the #EpcPeriods which have used codes
+ *  - for each bit set in that mask, in ascending order:
+ *     - 1 byte: length of the bitmap which follows, from 1 to 32 bytes
+ *     - that many bytes: bitmap of used #EpcCounters for the period, with
+ *       counter 0 in the least significant bit of the first byte
+ *
+ * Varints are unsigned LEB128. A variable consisting of only the version byte
+ * means no state has been saved yet, which is how `eos-payg-provision
+ * --efi-state` opts a computer in to EFI storage. Since counters are normally
+ * used in order, the bitmaps are short, and a typical state is under 32 bytes;
+ * the worst case is %EFI_STATE_MAX_SIZE, well under the size limits of EFI
+ * variable storage.
+ *
+ * After the root pivot, a variable can only be rewritten by deleting it and
+ * creating it again, so saves alternate between the two variables: each save
+ * rewrites the one which does not hold the newest state. If the computer
+ * loses power between the deletion and the creation, the other variable still
+ * holds the previous state, and at most the save in progress is lost. When
+ * loading, the valid variable with the highest generation is used; a missing
+ * or malformed variable is ignored as long as the other one is valid. */
+#define EFI_STATE_VERSION 1
+#define EFI_STATE_VARINT_MAX_SIZE 10
+#define EFI_STATE_BITMAP_MAX_SIZE ((EPC_MAXCOUNTER + 1) / 8)
+#define EFI_STATE_MAX_SIZE (1 + 4 * EFI_STATE_VARINT_MAX_SIZE + \
+                            EPC_N_PERIODS * (1 + EFI_STATE_BITMAP_MAX_SIZE))
 
 /**
  * EpgManager:
@@ -135,6 +169,11 @@ G_STATIC_ASSERT (offsetof (UsedCode, period) == 1);
  * size requirements (although they are not a large concern). The file format
  * is a serialised array of `UsedCode` instances.
  *
+ * Alternatively, if #EpgManager:efi-state is set, the same state is stored
+ * compactly in a single `EOSPAYG_state` EFI variable instead of in
+ * #EpgManager:state-directory, so that it cannot be modified from the root
+ * filesystem.
+ *
  * Since: 0.1.0
  */
 struct _EpgManager
@@ -155,6 +194,25 @@ struct _EpgManager
 
   GFile *state_directory;  /* (owned) */
 
+  /* Encoded contents of the two EFI state variables (EFI_STATE_VARIABLE and
+   * EFI_STATE_VARIABLE_B), as last loaded or saved. Either may be %NULL if the
+   * variable does not exist; at least one is non-%NULL if and only if EFI
+   * storage is in use (see uses_efi_storage()). */
+  GBytes *efi_states[2];  /* (owned) (nullable) */
+
+  /* Index into @efi_states of the variable holding the newest state, and the
+   * generation of that state. Saves go to the other variable. */
+  guint efi_slot;
+  guint64 efi_generation;
+
+  /* Summary of what was last written to (or loaded from) the EFI variable,
+   * used to skip writes which would not change the state: the wall clock
+   * time at which the credit runs out, and the number of used codes (which
+   * only ever grows). Only valid if @efi_saved_set is %TRUE. */
+  guint64 efi_saved_end_secs;
+  guint efi_saved_n_used_codes;
+  gboolean efi_saved_set;
+
   GMainContext *context;  /* (owned) */
   GSource *expiry;  /* (owned) (nullable) */
 
@@ -166,7 +224,7 @@ struct _EpgManager
   /* Rate limiting history. This is a FIFO queue of CLOCK_BOOTTIME timestamps
    * (in seconds) of recent epg_manager_add_code() attempts. See
    * check_rate_limiting(). */
-  guint64 rate_limiting_history[RATE_LIMITING_N_ATTEMPTS];
+  guint64 rate_limiting_history[EPG_RATE_LIMITING_N_ATTEMPTS];
   guint64 rate_limit_end_time_secs;
 
   /* Number of internal calls to epg_manager_save_state_async() in flight */
@@ -184,6 +242,8 @@ typedef enum
   PROP_KEY_FILE = 1,
   PROP_ACCOUNT_ID_FILE,
   PROP_STATE_DIRECTORY,
+  PROP_EFI_STATE,
+  PROP_EFI_STATE_B,
 
   /* Properties inherited from EpgProvider */
   PROP_EXPIRY_TIME,
@@ -208,7 +268,7 @@ static void
 epg_manager_class_init (EpgManagerClass *klass)
 {
   GObjectClass *object_class = (GObjectClass *) klass;
-  GParamSpec *props[PROP_STATE_DIRECTORY + 1] = { NULL, };
+  GParamSpec *props[PROP_EFI_STATE_B + 1] = { NULL, };
 
   object_class->constructed = epg_manager_constructed;
   object_class->dispose = epg_manager_dispose;
@@ -285,6 +345,42 @@ epg_manager_class_init (EpgManagerClass *klass)
                            G_TYPE_FILE,
                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * EpgManager:efi-state:
+   *
+   * Contents of the `EOSPAYG_state` EFI variable, as read before the root
+   * pivot. If this or #EpgManager:efi-state-b is non-%NULL, the state is
+   * loaded from whichever of the two holds the newest valid state, rather
+   * than from #EpgManager:state-directory, and saved back to the other
+   * variable with eospayg_efi_var_write(). Saves which would not change the
+   * state are skipped.
+   *
+   * EFI variables cannot be read after the root pivot, which is why the
+   * initial contents are passed in here rather than read by the manager.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_EFI_STATE] =
+      g_param_spec_boxed ("efi-state", "EFI State",
+                          "Contents of the EOSPAYG_state EFI variable.",
+                          G_TYPE_BYTES,
+                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * EpgManager:efi-state-b:
+   *
+   * Contents of the `EOSPAYG_state-b` EFI variable, as read before the root
+   * pivot. This is the second of the pair of variables which saves alternate
+   * between; see #EpgManager:efi-state.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_EFI_STATE_B] =
+      g_param_spec_boxed ("efi-state-b", "EFI State B",
+                          "Contents of the EOSPAYG_state-b EFI variable.",
+                          G_TYPE_BYTES,
+                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, G_N_ELEMENTS (props), props);
 }
 
@@ -305,6 +401,7 @@ epg_manager_provider_iface_init (gpointer g_iface,
   EpgProviderInterface *iface = g_iface;
 
   iface->add_code = epg_manager_add_code;
+  iface->add_codes = epg_manager_add_codes;
   iface->clear_code = epg_manager_clear_code;
   iface->shutdown_async = epg_manager_shutdown_async;
   iface->shutdown_finish = epg_manager_shutdown_finish;
@@ -383,6 +480,8 @@ epg_manager_dispose (GObject *object)
 
   g_clear_pointer (&self->used_codes, g_array_unref);
   g_clear_pointer (&self->key_bytes, g_bytes_unref);
+  g_clear_pointer (&self->efi_states[0], g_bytes_unref);
+  g_clear_pointer (&self->efi_states[1], g_bytes_unref);
   g_clear_object (&self->key_file);
   g_clear_object (&self->state_directory);
   g_clear_object (&self->clock);
@@ -430,6 +529,12 @@ epg_manager_get_property (GObject    *object,
     case PROP_STATE_DIRECTORY:
       g_value_set_object (value, epg_manager_get_state_directory (self));
       break;
+    case PROP_EFI_STATE:
+      g_value_set_boxed (value, self->efi_states[0]);
+      break;
+    case PROP_EFI_STATE_B:
+      g_value_set_boxed (value, self->efi_states[1]);
+      break;
     case PROP_RATE_LIMIT_END_TIME:
       g_value_set_uint64 (value, epg_provider_get_rate_limit_end_time (provider));
       break;
@@ -495,6 +600,16 @@ epg_manager_set_property (GObject      *object,
       g_assert (self->state_directory == NULL);
       self->state_directory = g_value_dup_object (value);
       break;
+    case PROP_EFI_STATE:
+      /* Construct only. */
+      g_assert (self->efi_states[0] == NULL);
+      self->efi_states[0] = g_value_dup_boxed (value);
+      break;
+    case PROP_EFI_STATE_B:
+      /* Construct only. */
+      g_assert (self->efi_states[1] == NULL);
+      self->efi_states[1] = g_value_dup_boxed (value);
+      break;
     case PROP_CLOCK:
       /* Construct only. */
       g_assert (self->clock == NULL);
@@ -515,6 +630,11 @@ epg_manager_set_property (GObject      *object,
  *    see #EpgManager:account-id-file
  * @state_directory: (transfer none) (optional): directory to load/store state
  *    in, or %NULL to use the default directory; see #EpgManager:state-directory
+ * @efi_state: (transfer none) (optional): contents of the `EOSPAYG_state` EFI
+ *    variable to load state from, or %NULL; see #EpgManager:efi-state
+ * @efi_state_b: (transfer none) (optional): contents of the `EOSPAYG_state-b`
+ *    EFI variable to load state from, or %NULL; see #EpgManager:efi-state-b.
+ *    If both this and @efi_state are %NULL, @state_directory is used.
  * @clock: (transfer none) (optional): an #EpgClock, or %NULL to use the default
  *    clock implementation
  * @cancellable: (nullable): a #GCancellable or %NULL
@@ -535,6 +655,8 @@ epg_manager_new (gboolean             enabled,
                  GFile               *key_file,
                  GFile               *account_id_file,
                  GFile               *state_directory,
+                 GBytes              *efi_state,
+                 GBytes              *efi_state_b,
                  EpgClock            *clock,
                  GCancellable        *cancellable,
                  GAsyncReadyCallback  callback,
@@ -555,6 +677,8 @@ epg_manager_new (gboolean             enabled,
                               "key-file", key_file,
                               "account-id-file", account_id_file,
                               "state-directory", state_directory,
+                              "efi-state", efi_state,
+                              "efi-state-b", efi_state_b,
                               "clock", clock,
                               NULL);
 }
@@ -613,21 +737,22 @@ check_rate_limiting (EpgManager  *self,
                      GError     **error)
 {
   /* Count how many attempts there have been in the last
-   * %RATE_LIMITING_TIME_PERIOD_SECS. If it’s over %RATE_LIMITING_N_ATTEMPTS,
-   * reject the attempt. In any case, update the list of attempts. */
+   * %EPG_RATE_LIMITING_TIME_PERIOD_SECS. If it’s over
+   * %EPG_RATE_LIMITING_N_ATTEMPTS, reject the attempt. In any case, update
+   * the list of attempts. */
   gsize n_attempts_in_last_period = 0;
 
   for (gsize i = 0; i < G_N_ELEMENTS (self->rate_limiting_history); i++)
     {
-      if (self->rate_limiting_history[i] >= now_secs - RATE_LIMITING_TIME_PERIOD_SECS)
+      if (self->rate_limiting_history[i] >= now_secs - EPG_RATE_LIMITING_TIME_PERIOD_SECS)
         n_attempts_in_last_period++;
     }
 
   g_debug ("%s: Checking rate limiting: %" G_GSIZE_FORMAT " attempts in last "
            "%u seconds; limit is %u attempts",
            G_STRFUNC, n_attempts_in_last_period,
-           (guint) RATE_LIMITING_TIME_PERIOD_SECS,
-           (guint) RATE_LIMITING_N_ATTEMPTS);
+           (guint) EPG_RATE_LIMITING_TIME_PERIOD_SECS,
+           (guint) EPG_RATE_LIMITING_N_ATTEMPTS);
 
   /* Update the history: shift the first N-1 elements of the array to indexes
    * 1..N, and push the new entry in at index 0. */
@@ -640,10 +765,13 @@ check_rate_limiting (EpgManager  *self,
    * there have not been enough attempts (ever) to trigger rate limiting, clamp
    * to zero. */
   guint64 oldest_attempt_secs = self->rate_limiting_history[G_N_ELEMENTS (self->rate_limiting_history) - 1];
-  self->rate_limit_end_time_secs = (oldest_attempt_secs > 0) ? oldest_attempt_secs + RATE_LIMITING_TIME_PERIOD_SECS : 0;
+  self->rate_limit_end_time_secs = (oldest_attempt_secs > 0) ? oldest_attempt_secs + EPG_RATE_LIMITING_TIME_PERIOD_SECS : 0;
 
-  if (n_attempts_in_last_period >= RATE_LIMITING_N_ATTEMPTS)
+  if (n_attempts_in_last_period >= EPG_RATE_LIMITING_N_ATTEMPTS)
     {
+      EPG_TRACE2 (rate_limited, n_attempts_in_last_period,
+                  self->rate_limit_end_time_secs);
+
       if (self->enabled)
         g_object_notify (G_OBJECT (self), "rate-limit-end-time");
 
@@ -711,6 +839,7 @@ check_expired_cb (gpointer user_data)
 
   if (self->expiry_time_secs <= now_secs)
     {
+      epg_stats_record_expiry_lateness (now_secs - self->expiry_time_secs);
       g_signal_emit_by_name (self, "expired");
       return G_SOURCE_REMOVE;
     }
@@ -742,6 +871,8 @@ set_expiry_time (EpgManager *self,
   if (!g_uint64_checked_add (&self->expiry_time_secs, now_secs, span_secs))
     self->expiry_time_secs = G_MAXUINT64;
 
+  EPG_TRACE3 (set_expiry_time, now_secs, span_secs, self->expiry_time_secs);
+
   /* Set the expiry timer. epg_clock_source_new_seconds() takes a #guint, and
    * @span_secs is a #guint64 so clamp to G_MAXUINT */
   clear_expiry_timer (self);
@@ -764,6 +895,7 @@ set_expiry_time (EpgManager *self,
         }
       else
         {
+          g_source_set_name (self->expiry, "EpgManager expiry");
           g_source_set_callback (self->expiry, check_expired_cb, self, NULL);
           g_source_attach (self->expiry, self->context);
         }
@@ -916,21 +1048,16 @@ used_codes_sort_cb (gconstpointer a,
   return 0;
 }
 
+/* Verify and apply a code, without saving the state. */
 static gboolean
-epg_manager_add_code (EpgProvider   *provider,
-                      const gchar  *code_str,
-                      gint64       *time_added,
-                      GError      **error)
+add_code (EpgManager   *self,
+          const gchar  *code_str,
+          gint64       *time_added,
+          GError      **error)
 {
-  EpgManager *self = EPG_MANAGER (provider);
   g_autoptr(GError) local_error = NULL;
   guint64 now_secs;
 
-  g_return_val_if_fail (EPG_IS_MANAGER (provider), FALSE);
-  g_return_val_if_fail (code_str != NULL, FALSE);
-  g_return_val_if_fail (time_added != NULL, FALSE);
-  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
   if (!check_enabled (self, error))
     return FALSE;
 
@@ -979,6 +1106,37 @@ epg_manager_add_code (EpgProvider   *provider,
   /* Reset the rate limiting history, since the code was successful. */
   clear_rate_limiting (self);
 
+  return TRUE;
+}
+
+static gboolean
+add_code_traced (EpgManager   *self,
+                 const gchar  *code_str,
+                 gint64       *time_added,
+                 GError      **error)
+{
+  g_autoptr(GError) local_error = NULL;
+  gboolean success;
+
+  /* Only trace the length of the code: anyone who can attach to the probe
+   * must not be able to harvest valid codes from it. */
+  EPG_TRACE1 (add_code__entry, strlen (code_str));
+
+  success = add_code (self, code_str, time_added, &local_error);
+
+  /* The last argument is the #EpgManagerError code, or -1 on success. */
+  EPG_TRACE3 (add_code__return, success, success ? *time_added : 0,
+              success ? -1 : local_error->code);
+
+  if (!success)
+    g_propagate_error (error, g_steal_pointer (&local_error));
+
+  return success;
+}
+
+static void
+save_state_after_add_code (EpgManager *self)
+{
   /* Kick off an asynchronous save.
    *
    * FIXME: pass self->cancellable; see comment in
@@ -986,12 +1144,67 @@ epg_manager_add_code (EpgProvider   *provider,
    */
   g_assert (self->pending_internal_save_state_calls < G_MAXUINT64);
   self->pending_internal_save_state_calls++;
-  epg_manager_save_state_async (provider, NULL,
+  epg_manager_save_state_async (EPG_PROVIDER (self), NULL,
                                 internal_save_state_cb, NULL);
+}
+
+static gboolean
+epg_manager_add_code (EpgProvider   *provider,
+                      const gchar  *code_str,
+                      gint64       *time_added,
+                      GError      **error)
+{
+  EpgManager *self = EPG_MANAGER (provider);
+
+  g_return_val_if_fail (EPG_IS_MANAGER (provider), FALSE);
+  g_return_val_if_fail (code_str != NULL, FALSE);
+  g_return_val_if_fail (time_added != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!add_code_traced (self, code_str, time_added, error))
+    return FALSE;
+
+  save_state_after_add_code (self);
 
   return TRUE;
 }
 
+/* Each code is verified and applied in turn exactly as in
+ * epg_manager_add_code(), including rate limiting, but property notifications
+ * are held until the end of the batch, and the state is saved once. */
+static guint
+epg_manager_add_codes (EpgProvider        *provider,
+                       const gchar * const *codes,
+                       gint64             *times_added,
+                       GError            **errors)
+{
+  EpgManager *self = EPG_MANAGER (provider);
+  guint n_added = 0;
+
+  g_return_val_if_fail (EPG_IS_MANAGER (provider), 0);
+  g_return_val_if_fail (codes != NULL, 0);
+  g_return_val_if_fail (times_added != NULL, 0);
+  g_return_val_if_fail (errors != NULL, 0);
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  for (gsize i = 0; codes[i] != NULL; i++)
+    {
+      times_added[i] = 0;
+      errors[i] = NULL;
+
+      if (add_code_traced (self, codes[i], &times_added[i], &errors[i]))
+        n_added++;
+    }
+
+  if (n_added > 0)
+    save_state_after_add_code (self);
+
+  g_object_thaw_notify (G_OBJECT (self));
+
+  return n_added;
+}
+
 gboolean
 epg_manager_clear_code (EpgProvider  *provider,
                         GError     **error)
@@ -1094,12 +1307,242 @@ get_used_codes_file (EpgManager *self)
   return g_file_get_child (self->state_directory, "used-codes");
 }
 
+/* Append @value to @buf as an unsigned LEB128 varint, returning the number of
+ * bytes written (at most %EFI_STATE_VARINT_MAX_SIZE). */
+static gsize
+efi_state_put_varint (guint8  *buf,
+                      guint64  value)
+{
+  gsize len = 0;
+
+  do
+    {
+      guint8 byte = value & 0x7f;
+
+      value >>= 7;
+      if (value != 0)
+        byte |= 0x80;
+      buf[len++] = byte;
+    }
+  while (value != 0);
+
+  return len;
+}
+
+/* Read an unsigned LEB128 varint from *@data, advancing *@data past it.
+ * Returns %FALSE if the varint is truncated or overflows a #guint64. */
+static gboolean
+efi_state_get_varint (const guint8 **data,
+                      const guint8  *end,
+                      guint64       *value_out)
+{
+  guint64 value = 0;
+
+  for (guint shift = 0; shift < 64; shift += 7)
+    {
+      if (*data >= end)
+        return FALSE;
+
+      guint8 byte = *(*data)++;
+      guint64 bits = byte & 0x7f;
+
+      if (shift == 63 && bits > 1)
+        return FALSE;
+
+      value |= bits << shift;
+
+      if (!(byte & 0x80))
+        {
+          *value_out = value;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* Encode the given state in the format described above %EFI_STATE_VERSION.
+ * @used_codes must be sorted with used_codes_sort_cb(). */
+static GBytes *
+efi_state_encode (guint64  generation,
+                  guint64  wallclock_secs,
+                  guint64  credit_secs,
+                  GArray  *used_codes)
+{
+  guint8 bitmaps[32][EFI_STATE_BITMAP_MAX_SIZE] = { { 0, }, };
+  guint8 bitmap_lens[32] = { 0, };
+  guint32 period_mask = 0;
+  g_autofree guint8 *buf = g_malloc (EFI_STATE_MAX_SIZE);
+  gsize len = 0;
+
+  for (gsize i = 0; i < used_codes->len; i++)
+    {
+      const UsedCode *used_code = &g_array_index (used_codes, UsedCode, i);
+      guint byte_index = used_code->counter / 8;
+
+      g_assert (used_code->period < G_N_ELEMENTS (bitmaps));
+
+      period_mask |= 1u << used_code->period;
+      bitmaps[used_code->period][byte_index] |= 1u << (used_code->counter % 8);
+      bitmap_lens[used_code->period] = MAX (bitmap_lens[used_code->period],
+                                            byte_index + 1);
+    }
+
+  buf[len++] = EFI_STATE_VERSION;
+  len += efi_state_put_varint (buf + len, generation);
+  len += efi_state_put_varint (buf + len, wallclock_secs);
+  len += efi_state_put_varint (buf + len, credit_secs);
+  len += efi_state_put_varint (buf + len, period_mask);
+
+  for (guint period = 0; period < G_N_ELEMENTS (bitmaps); period++)
+    {
+      if (!(period_mask & (1u << period)))
+        continue;
+
+      buf[len++] = bitmap_lens[period];
+      memcpy (buf + len, bitmaps[period], bitmap_lens[period]);
+      len += bitmap_lens[period];
+    }
+
+  g_assert (len <= EFI_STATE_MAX_SIZE);
+
+  return g_bytes_new_take (g_steal_pointer (&buf), len);
+}
+
+/* Decode @state, which must be in the format described above
+ * %EFI_STATE_VERSION. If it contains only the version byte, @has_state_out is
+ * set to %FALSE and the other out arguments are not touched. Otherwise, the
+ * used codes are appended to @used_codes in sorted order. */
+static gboolean
+efi_state_decode (GBytes    *state,
+                  gboolean  *has_state_out,
+                  guint64   *generation_out,
+                  guint64   *wallclock_secs_out,
+                  guint64   *credit_secs_out,
+                  GArray    *used_codes,
+                  GError   **error)
+{
+  gsize len;
+  const guint8 *data = g_bytes_get_data (state, &len);
+  const guint8 *end = data + len;
+  guint64 generation, wallclock_secs, credit_secs, period_mask;
+  g_autoptr(GArray) decoded_codes = g_array_new (FALSE, FALSE, sizeof (UsedCode));
+
+  if (len == 0 || data[0] != EFI_STATE_VERSION)
+    goto invalid;
+
+  data++;
+
+  if (data == end)
+    {
+      *has_state_out = FALSE;
+      return TRUE;
+    }
+
+  if (!efi_state_get_varint (&data, end, &generation) ||
+      !efi_state_get_varint (&data, end, &wallclock_secs) ||
+      !efi_state_get_varint (&data, end, &credit_secs) ||
+      !efi_state_get_varint (&data, end, &period_mask) ||
+      period_mask > G_MAXUINT32)
+    goto invalid;
+
+  for (guint period = 0; period < 32; period++)
+    {
+      if (!(period_mask & (1u << period)))
+        continue;
+
+      if (!epc_period_validate (period, NULL) || data >= end)
+        goto invalid;
+
+      gsize bitmap_len = *data++;
+
+      if (bitmap_len == 0 || bitmap_len > EFI_STATE_BITMAP_MAX_SIZE ||
+          bitmap_len > (gsize) (end - data))
+        goto invalid;
+
+      for (gsize i = 0; i < bitmap_len * 8; i++)
+        {
+          if (data[i / 8] & (1u << (i % 8)))
+            {
+              UsedCode used_code = { i, period };
+              g_array_append_val (decoded_codes, used_code);
+            }
+        }
+
+      data += bitmap_len;
+    }
+
+  if (data != end)
+    goto invalid;
+
+  g_array_sort (decoded_codes, used_codes_sort_cb);
+  g_array_append_vals (used_codes, decoded_codes->data, decoded_codes->len);
+
+  *has_state_out = TRUE;
+  *generation_out = generation;
+  *wallclock_secs_out = wallclock_secs;
+  *credit_secs_out = credit_secs;
+
+  return TRUE;
+
+invalid:
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       _("EFI state variable was malformed."));
+  return FALSE;
+}
+
+/* Names of the EFI variables, indexed in the same way as
+ * #EpgManager.efi_states. */
+static const gchar * const efi_state_variables[] =
+  {
+    EFI_STATE_VARIABLE,
+    EFI_STATE_VARIABLE_B,
+  };
+
+/* Whether the state is stored in EFI variables rather than in the
+ * #EpgManager:state-directory. */
+static gboolean
+uses_efi_storage (EpgManager *self)
+{
+  return (self->efi_states[0] != NULL || self->efi_states[1] != NULL);
+}
+
+/* Write @state to the EFI variable for @slot. After the root pivot,
+ * eospayg_efi_var_write() refuses to replace an existing variable, so delete
+ * it first in that case. Callers must only write the slot which does not hold
+ * the newest state, so that state survives if the computer loses power between
+ * the two calls. */
+static gboolean
+efi_state_write (guint     slot,
+                 GBytes   *state,
+                 GError  **error)
+{
+  g_autoptr(GError) local_error = NULL;
+  const gchar *variable = efi_state_variables[slot];
+  gsize len;
+  const guint8 *data = g_bytes_get_data (state, &len);
+
+  if (eospayg_efi_var_write (variable, data, len, &local_error))
+    return TRUE;
+
+  if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return (eospayg_efi_var_delete (variable, error) &&
+          eospayg_efi_var_write (variable, data, len, error));
+}
+
 static void file_load_cb        (GObject      *source_object,
                                  GAsyncResult *result,
                                  gpointer      user_data);
 static void file_load_delete_cb (GObject      *source_object,
                                  GAsyncResult *result,
                                  gpointer      user_data);
+static void load_efi_state      (EpgManager   *self,
+                                 GTask        *task);
 
 /*
  * epg_manager_init_async:
@@ -1109,7 +1552,8 @@ static void file_load_delete_cb (GObject      *source_object,
  * @callback: function to call once the async operation is complete
  * @user_data: data to pass to @callback
  *
- * Load the state for the #EpgManager from the #EpgManager:state-directory.
+ * Load the state for the #EpgManager from the #EpgManager:state-directory, or
+ * from #EpgManager:efi-state if that is set.
  */
 static void
 epg_manager_init_async (GAsyncInitable      *initable,
@@ -1126,6 +1570,13 @@ epg_manager_init_async (GAsyncInitable      *initable,
 
   g_task_set_source_tag (task, epg_manager_init_async);
   g_task_set_priority (task, priority);
+
+  if (uses_efi_storage (self))
+    {
+      load_efi_state (self, task);
+      return;
+    }
+
   epg_multi_task_attach (task, 5);
 
   /* Load the wall clock time of the last state save. */
@@ -1170,6 +1621,167 @@ get_guint64_from_bytes (const guint8 *bytes)
   return number_union.u64;
 }
 
+/* Set the expiry time from the wall clock time and credit which were last
+ * saved (#EpgManager.last_save_time_secs and
+ * #EpgManager.last_save_expiry_secs), consuming credit for the time which has
+ * passed since the save. */
+static void
+set_expiry_time_from_saved_state (EpgManager *self,
+                                  GTask      *task,
+                                  guint64     now_secs,
+                                  guint64     wallclock_now_secs)
+{
+  if (self->last_save_time_secs > wallclock_now_secs)
+    {
+      /* Time has gone backwards!? Either the saved time is wrong (and
+       * there's no way to know by how much) or the current time is wrong
+       * (and NTP will fix it, see T24501). Let's just assume time stood
+       * still. */
+      set_expiry_time (self, task, TRUE, now_secs, self->last_save_expiry_secs);
+    }
+  else
+    {
+      /* Time has continued its inexorable march forward while the computer
+       * was off. Consume the appropriate credit */
+      guint64 unaccounted_time = wallclock_now_secs - self->last_save_time_secs;
+      if (unaccounted_time > self->last_save_expiry_secs)
+        set_expiry_time (self, task, TRUE, now_secs, 0);
+      else
+        {
+          guint64 YEAR_SECS = 365 * 24 * 60 * 60;
+          guint64 BOGUS_CREDIT_LOWER_LIMIT_SECS = 5 * YEAR_SECS;
+          guint64 BOGUS_CREDIT_UPPER_LIMIT_SECS = 100 * YEAR_SECS;
+          guint64 credit_secs = self->last_save_expiry_secs - unaccounted_time;
+
+          /* No system should have more than 5 years of credit, except if
+           * they were permanently unlocked, at which point G_MAXUINT64
+           * seconds (a bit over 584 billion years) were added to their
+           * credit.
+           * If a system in the field has over 5 years but less than 100
+           * years of credit it is certainly due to a bug (T34550). Reset
+           * the credit to 31 days, which is the typical payment period. */
+          if (BOGUS_CREDIT_LOWER_LIMIT_SECS < credit_secs &&
+              credit_secs < BOGUS_CREDIT_UPPER_LIMIT_SECS)
+            {
+              g_message ("Detected system with too much credit (%" G_GUINT64_FORMAT "), resetting to 31 days.",
+                         credit_secs);
+              credit_secs = 31 * 24 * 60 * 60;
+            }
+
+          set_expiry_time (self, task, TRUE, now_secs, credit_secs);
+        }
+    }
+}
+
+/* Load the state for the #EpgManager from the newest valid one of
+ * #EpgManager:efi-state and #EpgManager:efi-state-b, and the key and account ID
+ * from their files. This is the counterpart of epg_manager_init_async() for
+ * EFI storage. */
+static void
+load_efi_state (EpgManager *self,
+                GTask      *task)
+{
+  GCancellable *cancellable = g_task_get_cancellable (task);
+  g_autoptr(GError) local_error = NULL;
+  gboolean has_state = FALSE;
+  gboolean has_valid_variable = FALSE;
+
+  for (guint slot = 0; slot < G_N_ELEMENTS (self->efi_states); slot++)
+    {
+      g_autoptr(GError) slot_error = NULL;
+      g_autoptr(GArray) slot_used_codes = g_array_new (FALSE, FALSE, sizeof (UsedCode));
+      gboolean slot_has_state = FALSE;
+      guint64 generation = 0, wallclock_secs = 0, credit_secs = 0;
+
+      /* A variable is missing if the computer lost power while it was being
+       * rewritten (or if it has never been written); the other one then holds
+       * the newest state. */
+      if (self->efi_states[slot] == NULL)
+        continue;
+
+      if (!efi_state_decode (self->efi_states[slot], &slot_has_state,
+                             &generation, &wallclock_secs, &credit_secs,
+                             slot_used_codes, &slot_error))
+        {
+          g_debug ("%s: Ignoring EFI variable %s: %s", G_STRFUNC,
+                   efi_state_variables[slot], slot_error->message);
+          if (local_error == NULL)
+            local_error = g_steal_pointer (&slot_error);
+          continue;
+        }
+
+      if (!has_valid_variable)
+        self->efi_slot = slot;
+      has_valid_variable = TRUE;
+
+      if (!slot_has_state || (has_state && generation <= self->efi_generation))
+        continue;
+
+      has_state = TRUE;
+      self->efi_slot = slot;
+      self->efi_generation = generation;
+      self->last_save_time_secs = wallclock_secs;
+      self->last_save_expiry_secs = credit_secs;
+      g_array_set_size (self->used_codes, 0);
+      g_array_append_vals (self->used_codes, slot_used_codes->data,
+                           slot_used_codes->len);
+    }
+
+  if (!has_valid_variable)
+    {
+      g_autoptr(GError) write_error = NULL;
+      const guint8 empty_state[] = { EFI_STATE_VERSION };
+
+      g_assert (local_error != NULL);
+
+      /* Reset the first variable so that we don’t error next time we start.
+       * The computer will have no credit until a new code is entered. */
+      g_clear_pointer (&self->efi_states[0], g_bytes_unref);
+      self->efi_states[0] = g_bytes_new (empty_state, sizeof (empty_state));
+      self->efi_slot = 0;
+
+      if (!efi_state_write (0, self->efi_states[0], &write_error))
+        g_debug ("%s: Error resetting EFI state: %s", G_STRFUNC, write_error->message);
+
+      g_task_return_error (task, g_steal_pointer (&local_error));
+      return;
+    }
+
+  epg_multi_task_attach (task, 3);
+
+  guint64 now_secs = epg_clock_get_time (self->clock);
+  guint64 wallclock_now_secs = epg_clock_get_wallclock_time (self->clock);
+
+  if (has_state)
+    {
+      self->last_save_time_secs_set = TRUE;
+      self->last_save_expiry_secs_set = TRUE;
+
+      /* What’s in the variable already need not be written again. */
+      if (!g_uint64_checked_add (&self->efi_saved_end_secs,
+                                 self->last_save_time_secs,
+                                 self->last_save_expiry_secs))
+        self->efi_saved_end_secs = G_MAXUINT64;
+      self->efi_saved_n_used_codes = self->used_codes->len;
+      self->efi_saved_set = TRUE;
+
+      set_expiry_time_from_saved_state (self, task, now_secs, wallclock_now_secs);
+    }
+  else
+    {
+      /* No state has been saved yet. Expire immediately. */
+      set_expiry_time (self, task, TRUE, now_secs, 0);
+    }
+
+  g_file_load_contents_async (self->key_file, cancellable,
+                              file_load_cb, g_object_ref (task));
+  g_file_load_contents_async (self->account_id_file, cancellable,
+                              file_load_cb, g_object_ref (task));
+
+  /* Decrement the pending operation count. */
+  epg_multi_task_return_boolean (task, TRUE);
+}
+
 static void
 file_load_cb (GObject      *source_object,
               GAsyncResult *result,
@@ -1369,7 +1981,14 @@ file_load_cb (GObject      *source_object,
     }
   else if (g_file_equal (file, self->key_file))
     {
-      if (data == NULL)
+      if (data == NULL && uses_efi_storage (self))
+        {
+          /* EFI storage is only used on computers which have been
+           * provisioned, so the key must be present. */
+          epg_multi_task_return_error (task, G_STRFUNC, g_steal_pointer (&local_error));
+          return;
+        }
+      else if (data == NULL)
         {
           /* The key is missing, so (this flavour of) PAYG is not enabled. */
           self->enabled = FALSE;
@@ -1402,48 +2021,7 @@ file_load_cb (GObject      *source_object,
   if (self->last_save_time_secs_set && self->last_save_expiry_secs_set &&
       (g_file_equal (file, wallclock_time_file) ||
        g_file_equal (file, expiry_seconds_file)))
-    {
-      if (self->last_save_time_secs > wallclock_now_secs)
-        {
-          /* Time has gone backwards!? Either the saved time is wrong (and
-           * there's no way to know by how much) or the current time is wrong
-           * (and NTP will fix it, see T24501). Let's just assume time stood
-           * still. */
-          set_expiry_time (self, task, TRUE, now_secs, self->last_save_expiry_secs);
-        }
-      else
-        {
-          /* Time has continued its inexorable march forward while the computer
-           * was off. Consume the appropriate credit */
-          guint64 unaccounted_time = wallclock_now_secs - self->last_save_time_secs;
-          if (unaccounted_time > self->last_save_expiry_secs)
-            set_expiry_time (self, task, TRUE, now_secs, 0);
-          else
-            {
-              guint64 YEAR_SECS = 365 * 24 * 60 * 60;
-              guint64 BOGUS_CREDIT_LOWER_LIMIT_SECS = 5 * YEAR_SECS;
-              guint64 BOGUS_CREDIT_UPPER_LIMIT_SECS = 100 * YEAR_SECS;
-              guint64 credit_secs = self->last_save_expiry_secs - unaccounted_time;
-
-              /* No system should have more than 5 years of credit, except if
-               * they were permanently unlocked, at which point G_MAXUINT64
-               * seconds (a bit over 584 billion years) were added to their
-               * credit.
-               * If a system in the field has over 5 years but less than 100
-               * years of credit it is certainly due to a bug (T34550). Reset
-               * the credit to 31 days, which is the typical payment period. */
-              if (BOGUS_CREDIT_LOWER_LIMIT_SECS < credit_secs &&
-                  credit_secs < BOGUS_CREDIT_UPPER_LIMIT_SECS)
-                {
-                  g_message ("Detected system with too much credit (%" G_GUINT64_FORMAT "), resetting to 31 days.",
-                             credit_secs);
-                  credit_secs = 31 * 24 * 60 * 60;
-                }
-
-              set_expiry_time (self, task, TRUE, now_secs, credit_secs);
-            }
-        }
-    }
+    set_expiry_time_from_saved_state (self, task, now_secs, wallclock_now_secs);
 
   epg_multi_task_return_boolean (task, TRUE);
 }
@@ -1537,6 +2115,87 @@ write_guint64_to_file (guint64       number,
                                        g_object_ref (task));
 }
 
+/* Amount by which the wall clock time at which the credit runs out may drift
+ * (due to differences between the wall clock and CLOCK_BOOTTIME) before it is
+ * worth writing the EFI variable again. */
+#define EFI_STATE_SAVE_SLACK_SECS 60
+
+/* Save the state to the EFI variable which does not hold the newest state,
+ * unless it would not change the state stored there. EFI variable storage has
+ * limited write endurance, so most calls (such as the one at shutdown) should
+ * not result in a write. On success, @n_bytes_written_out is set to the size of
+ * the variable written, or 0 if the write was skipped. */
+static gboolean
+save_efi_state (EpgManager  *self,
+                gsize       *n_bytes_written_out,
+                GError     **error)
+{
+  guint64 now_secs = epg_clock_get_time (self->clock);
+  guint64 wallclock_secs = epg_clock_get_wallclock_time (self->clock);
+  guint64 credit_secs = (now_secs > self->expiry_time_secs) ? 0 : self->expiry_time_secs - now_secs;
+  guint64 end_secs;
+
+  *n_bytes_written_out = 0;
+
+  if (!g_uint64_checked_add (&end_secs, wallclock_secs, credit_secs))
+    end_secs = G_MAXUINT64;
+
+  if (self->efi_saved_set &&
+      self->efi_saved_n_used_codes == self->used_codes->len &&
+      ((credit_secs == 0 && self->efi_saved_end_secs <= wallclock_secs) ||
+       (MAX (end_secs, self->efi_saved_end_secs) -
+        MIN (end_secs, self->efi_saved_end_secs)) < EFI_STATE_SAVE_SLACK_SECS))
+    {
+      g_debug ("%s: State unchanged; not writing EFI variable", G_STRFUNC);
+      return TRUE;
+    }
+
+  guint slot = 1 - self->efi_slot;
+  g_autoptr(GBytes) state = efi_state_encode (self->efi_generation + 1,
+                                              wallclock_secs, credit_secs,
+                                              self->used_codes);
+
+  if (!efi_state_write (slot, state, error))
+    return FALSE;
+
+  *n_bytes_written_out = g_bytes_get_size (state);
+
+  g_clear_pointer (&self->efi_states[slot], g_bytes_unref);
+  self->efi_states[slot] = g_steal_pointer (&state);
+  self->efi_slot = slot;
+  self->efi_generation++;
+  self->efi_saved_end_secs = end_secs;
+  self->efi_saved_n_used_codes = self->used_codes->len;
+  self->efi_saved_set = TRUE;
+
+  return TRUE;
+}
+
+typedef struct
+{
+  gint64 start_time;
+  gsize n_bytes;
+} SaveStateData;
+
+static void
+save_state_data_free (gpointer  data,
+                      GClosure *closure)
+{
+  g_free (data);
+}
+
+static void
+save_state_completed_cb (GObject    *object,
+                         GParamSpec *pspec,
+                         gpointer    user_data)
+{
+  const SaveStateData *data = user_data;
+  gboolean success = !g_task_had_error (G_TASK (object));
+
+  epg_stats_record_save_latency (g_get_monotonic_time () - data->start_time);
+  EPG_TRACE2 (save_state__done, success, success ? data->n_bytes : 0);
+}
+
 static void
 epg_manager_save_state_async (EpgProvider         *provider,
                               GCancellable        *cancellable,
@@ -1550,6 +2209,39 @@ epg_manager_save_state_async (EpgProvider         *provider,
 
   g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, epg_manager_save_state_async);
+
+  EPG_TRACE1 (save_state__start, uses_efi_storage (self));
+  epg_stats_increment (EPG_STATS_STATE_SAVES);
+
+  if (uses_efi_storage (self))
+    {
+      g_autoptr(GError) local_error = NULL;
+      gsize n_bytes_written = 0;
+      gint64 start_time = g_get_monotonic_time ();
+      gboolean success = save_efi_state (self, &n_bytes_written, &local_error);
+
+      if (success && n_bytes_written == 0)
+        epg_stats_increment (EPG_STATS_STATE_SAVES_COALESCED);
+      else
+        epg_stats_record_save_latency (g_get_monotonic_time () - start_time);
+
+      EPG_TRACE2 (save_state__done, success, n_bytes_written);
+
+      if (!success)
+        g_task_return_error (task, g_steal_pointer (&local_error));
+      else
+        g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  /* Two #guint64 files, plus the used codes. */
+  SaveStateData *data = g_new0 (SaveStateData, 1);
+  data->start_time = g_get_monotonic_time ();
+  data->n_bytes = 2 * sizeof (guint64) + self->used_codes->len * sizeof (UsedCode);
+  g_signal_connect_data (task, "notify::completed",
+                         G_CALLBACK (save_state_completed_cb), data,
+                         save_state_data_free, 0);
+
   epg_multi_task_attach (task, 4);
 
   /* Save the wall clock time. */
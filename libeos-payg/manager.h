@@ -33,6 +33,8 @@ void         epg_manager_new        (gboolean             enabled,
                                      GFile               *key_file,
                                      GFile               *account_id_file,
                                      GFile               *state_directory,
+                                     GBytes              *efi_state,
+                                     GBytes              *efi_state_b,
                                      EpgClock            *clock,
                                      GCancellable        *cancellable,
                                      GAsyncReadyCallback  callback,
@@ -19,11 +19,17 @@
 
 #include "config.h"
 
+#ifdef ENABLE_PLUGINS
 #include <libpeas/peas.h>
+#endif
 #include <libeos-payg/multi-task.h>
 #include <libeos-payg/provider-loader.h>
 #include <libeos-payg/errors.h>
 
+static void epg_provider_loader_get_property (GObject    *object,
+                                              guint       property_id,
+                                              GValue     *value,
+                                              GParamSpec *pspec);
 static void epg_provider_loader_set_property (GObject      *object,
                                               guint         property_id,
                                               const GValue *value,
@@ -36,6 +42,17 @@ static void epg_provider_loader_finalize (GObject *object);
  * EpgProviderLoader:
  *
  * Loads plugins which implement the #EpgProvider interface, using libpeas.
+ * Providers which are compiled into the program and registered with
+ * epg_provider_loader_register_static() are also loaded, before any plugins.
+ * If eos-payg is built with `-Dplugins=false`, only those are loaded, and
+ * libpeas is not used at all.
+ *
+ * The same loader can be used more than once (for example, before and after
+ * the root pivot). Plugins are only scanned and loaded once per loader, and
+ * providers which were disabled on an earlier call to
+ * epg_provider_loader_get_first_enabled_async() are kept and asked to re-check
+ * their state (see epg_provider_recheck_enabled_async()) rather than being
+ * shut down and initialised again, if they support it.
  *
  * Since: 0.2.0
  */
@@ -44,12 +61,31 @@ struct _EpgProviderLoader
   GObject parent;
 
   gchar *module_dir;  /* (owned) */
+#ifdef ENABLE_PLUGINS
   PeasEngine *engine;  /* (owned) */
+#endif
+
+  /* Disabled providers kept from an earlier
+   * epg_provider_loader_get_first_enabled_async() call, to be re-checked on
+   * the next load rather than re-initialised. Keyed by the provider’s source
+   * (see source_quark). */
+  GHashTable *standby_providers;  /* (owned) (element-type gpointer EpgProvider) */
+
+  guint init_timeout_ms;  /* 0 means no timeout */
 };
 
+/* What each provider was created from, set as qdata on the provider: either
+ * its #PeasPluginInfo (which is owned by the #PeasEngine), or its #GType
+ * (as a pointer) for statically registered providers. */
+static GQuark source_quark;
+
+/* Provider types registered with epg_provider_loader_register_static(). */
+static GArray *static_provider_types = NULL;  /* (element-type GType) */
+
 typedef enum
 {
   PROP_MODULE_DIR = 1,
+  PROP_INIT_TIMEOUT_MS,
 } EpgProviderLoaderProperty;
 
 G_DEFINE_TYPE (EpgProviderLoader, epg_provider_loader, G_TYPE_OBJECT)
@@ -58,8 +94,9 @@ static void
 epg_provider_loader_class_init (EpgProviderLoaderClass *klass)
 {
   GObjectClass *object_class = (GObjectClass *) klass;
-  GParamSpec *props[PROP_MODULE_DIR + 1] = { NULL, };
+  GParamSpec *props[PROP_INIT_TIMEOUT_MS + 1] = { NULL, };
 
+  object_class->get_property = epg_provider_loader_get_property;
   object_class->set_property = epg_provider_loader_set_property;
   object_class->constructed = epg_provider_loader_constructed;
   object_class->dispose = epg_provider_loader_dispose;
@@ -81,12 +118,58 @@ epg_provider_loader_class_init (EpgProviderLoaderClass *klass)
                            G_PARAM_CONSTRUCT_ONLY |
                            G_PARAM_STATIC_STRINGS);
 
+  /**
+   * EpgProviderLoader:init-timeout-ms:
+   *
+   * Maximum time, in milliseconds, to wait for each provider to initialize
+   * (or re-check whether it is enabled). Providers which take longer are
+   * treated as having failed, and their operation is cancelled. Zero means
+   * there is no limit.
+   *
+   * Changes take effect for loads started afterwards, so the same loader can
+   * use a limit before the root pivot (where a hung plugin would stall the
+   * pivot) and none afterwards.
+   *
+   * Since: 0.2.5
+   */
+  props[PROP_INIT_TIMEOUT_MS] =
+      g_param_spec_uint ("init-timeout-ms", "Init Timeout",
+                         "Maximum time to wait for each provider to initialize, in milliseconds",
+                         0, G_MAXUINT, 0,
+                         G_PARAM_READWRITE |
+                         G_PARAM_EXPLICIT_NOTIFY |
+                         G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, G_N_ELEMENTS (props), props);
+
+  source_quark = g_quark_from_static_string ("epg-provider-loader-source");
 }
 
 static void
 epg_provider_loader_init (EpgProviderLoader *self)
 {
+  self->standby_providers = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                   NULL, g_object_unref);
+}
+
+static void
+epg_provider_loader_get_property (GObject    *object,
+                                  guint       property_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  EpgProviderLoader *self = EPG_PROVIDER_LOADER (object);
+
+  switch ((EpgProviderLoaderProperty) property_id)
+    {
+    case PROP_INIT_TIMEOUT_MS:
+      g_value_set_uint (value, self->init_timeout_ms);
+      break;
+    case PROP_MODULE_DIR:
+      /* Write only. */
+    default:
+      g_assert_not_reached ();
+    }
 }
 
 static void
@@ -104,6 +187,13 @@ epg_provider_loader_set_property (GObject      *object,
       g_assert (self->module_dir == NULL);
       self->module_dir = g_value_dup_string (value);
       break;
+    case PROP_INIT_TIMEOUT_MS:
+      if (self->init_timeout_ms != g_value_get_uint (value))
+        {
+          self->init_timeout_ms = g_value_get_uint (value);
+          g_object_notify_by_pspec (object, pspec);
+        }
+      break;
     default:
       g_assert_not_reached ();
     }
@@ -122,8 +212,10 @@ epg_provider_loader_constructed (GObject *object)
   if (self->module_dir == NULL || self->module_dir[0] == '\0')
     self->module_dir = g_strdup (PLUGINSDIR);
 
+#ifdef ENABLE_PLUGINS
   self->engine = peas_engine_new ();
   peas_engine_add_search_path (self->engine, self->module_dir, NULL);
+#endif
 }
 
 static void
@@ -131,7 +223,12 @@ epg_provider_loader_dispose (GObject *object)
 {
   EpgProviderLoader *self = EPG_PROVIDER_LOADER (object);
 
+  /* Providers in standby are disabled, so have no state which needs to be
+   * saved by shutting them down. */
+  g_clear_pointer (&self->standby_providers, g_hash_table_unref);
+#ifdef ENABLE_PLUGINS
   g_clear_object (&self->engine);
+#endif
 
   G_OBJECT_CLASS (epg_provider_loader_parent_class)->dispose (object);
 }
@@ -146,14 +243,207 @@ epg_provider_loader_finalize (GObject *object)
   G_OBJECT_CLASS (epg_provider_loader_parent_class)->finalize (object);
 }
 
+/* Key in a plugin’s .plugin file listing paths, separated by semicolons, at
+ * least one of which must exist for the provider to possibly be enabled. This
+ * allows plugins to be skipped without even loading their module. */
+#define PROBE_PATHS_KEY "Epg-Probe-Paths"
+
+/* Timing and outcome of loading one plugin, for the summary logged by
+ * epg_provider_loader_get_first_enabled_async(). Times are in microseconds. */
+typedef struct
+{
+  gchar *name;  /* (owned) */
+  gint64 load_usec;
+  gint64 create_usec;
+  gint64 init_usec;
+  const gchar *outcome;  /* (not owned) */
+} PluginTiming;
+
+static void
+plugin_timing_clear (PluginTiming *timing)
+{
+  g_clear_pointer (&timing->name, g_free);
+}
+
+typedef struct
+{
+  GPtrArray *providers;  /* (owned) (element-type EpgProvider) */
+  gboolean probe;
+  gint64 start_time;  /* monotonic time */
+  GArray *timings;  /* (owned) (element-type PluginTiming) */
+} LoadData;
+
+static void
+load_data_free (LoadData *data)
+{
+  g_clear_pointer (&data->providers, g_ptr_array_unref);
+  g_clear_pointer (&data->timings, g_array_unref);
+  g_free (data);
+}
+
+/* Add a #PluginTiming for @name to @data and return its index. Indices are
+ * used rather than pointers, since the array may be reallocated. */
+static guint
+load_data_add_timing (LoadData    *data,
+                      const gchar *name)
+{
+  PluginTiming timing = { g_strdup (name), 0, 0, 0, "pending" };
+
+  g_array_append_val (data->timings, timing);
+
+  return data->timings->len - 1;
+}
+
+static PluginTiming *
+load_data_get_timing (LoadData *data,
+                      guint     timing_index)
+{
+  return &g_array_index (data->timings, PluginTiming, timing_index);
+}
+
+/* State for one pending provider initialization (or re-check). If it takes
+ * longer than #EpgProviderLoader:init-timeout-ms, the provider is treated as
+ * having failed and its #GCancellable is cancelled, so that a single slow or
+ * hung plugin cannot stall loading. */
+typedef struct
+{
+  GTask *task;  /* (owned) */
+  guint timing_index;  /* into LoadData.timings */
+  gint64 start_time;  /* monotonic time */
+  GCancellable *cancellable;  /* (owned) */
+  gulong cancelled_id;  /* on the @task’s cancellable, or 0 */
+  GSource *timeout_source;  /* (owned) (nullable) */
+  gboolean timed_out;
+} ProviderInit;
+
+static void
+provider_init_free (ProviderInit *init)
+{
+  if (init->cancelled_id != 0)
+    g_signal_handler_disconnect (g_task_get_cancellable (init->task),
+                                 init->cancelled_id);
+
+  if (init->timeout_source != NULL)
+    {
+      g_source_destroy (init->timeout_source);
+      g_source_unref (init->timeout_source);
+    }
+
+  g_clear_object (&init->cancellable);
+  g_clear_object (&init->task);
+  g_free (init);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ProviderInit, provider_init_free)
+
+static gboolean provider_init_timeout_cb (gpointer user_data);
+
+static ProviderInit *
+provider_init_new (EpgProviderLoader *self,
+                   GTask             *task,
+                   guint              timing_index)
+{
+  g_autoptr(ProviderInit) init = g_new0 (ProviderInit, 1);
+  GCancellable *task_cancellable = g_task_get_cancellable (task);
+
+  init->task = g_object_ref (task);
+  init->timing_index = timing_index;
+  init->start_time = g_get_monotonic_time ();
+  init->cancellable = g_cancellable_new ();
+
+  /* Chain the task’s cancellable to the per-provider one. A signal handler is
+   * used rather than g_cancellable_connect(), since the handler may need to
+   * be disconnected from within the provider’s callback. */
+  if (task_cancellable != NULL)
+    {
+      init->cancelled_id = g_signal_connect_swapped (task_cancellable, "cancelled",
+                                                     G_CALLBACK (g_cancellable_cancel),
+                                                     init->cancellable);
+      if (g_cancellable_is_cancelled (task_cancellable))
+        g_cancellable_cancel (init->cancellable);
+    }
+
+  if (self->init_timeout_ms > 0)
+    {
+      init->timeout_source = g_timeout_source_new (self->init_timeout_ms);
+      g_source_set_name (init->timeout_source, "EpgProviderLoader init timeout");
+      g_source_set_callback (init->timeout_source, provider_init_timeout_cb,
+                             init, NULL);
+      g_source_attach (init->timeout_source, g_main_context_get_thread_default ());
+    }
+
+  return g_steal_pointer (&init);
+}
+
+static void maybe_return (GTask       *task,
+                          EpgProvider *provider);
+
+/* Record the outcome of @init. */
+static void
+provider_init_complete (ProviderInit *init,
+                        const gchar  *outcome)
+{
+  LoadData *data = g_task_get_task_data (init->task);
+  PluginTiming *timing = load_data_get_timing (data, init->timing_index);
+
+  timing->init_usec = g_get_monotonic_time () - init->start_time;
+  timing->outcome = outcome;
+}
+
+static gboolean
+provider_init_timeout_cb (gpointer user_data)
+{
+  ProviderInit *init = user_data;
+  EpgProviderLoader *self = g_task_get_source_object (init->task);
+  LoadData *data = g_task_get_task_data (init->task);
+
+  g_warning ("Timed out after %u ms initializing %s; treating it as failed",
+             self->init_timeout_ms,
+             load_data_get_timing (data, init->timing_index)->name);
+
+  provider_init_complete (init, "timed-out");
+  init->timed_out = TRUE;
+
+  /* The source is destroyed when this returns. */
+  g_clear_pointer (&init->timeout_source, g_source_unref);
+
+  maybe_return (init->task, NULL);
+
+  /* This may cause the provider’s callback to be called, and free @init, so
+   * must come last. */
+  g_cancellable_cancel (init->cancellable);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void load_async (EpgProviderLoader   *self,
+                        gboolean             probe,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data);
+static void try_recheck (EpgProviderLoader *self,
+                         gpointer           source,
+                         const gchar       *name,
+                         GTask             *task);
+static void try_load_static (EpgProviderLoader *self,
+                             GType              provider_type,
+                             GTask             *task);
+#ifdef ENABLE_PLUGINS
 static void try_load (EpgProviderLoader *self,
                       PeasPluginInfo    *plugin_info,
                       GTask             *task);
+#endif
+static void start_init (EpgProviderLoader *self,
+                        GTask             *task,
+                        EpgProvider       *provider,
+                        gpointer           source,
+                        guint              timing_index);
 static void provider_init_cb (GObject      *source_object,
                               GAsyncResult *result,
                               gpointer      user_data);
-static void maybe_return (GTask       *task,
-                          EpgProvider *provider);
+static void provider_recheck_enabled_cb (GObject      *source_object,
+                                         GAsyncResult *result,
+                                         gpointer      user_data);
 
 /**
  * epg_provider_loader_load_async:
@@ -164,6 +454,14 @@ static void maybe_return (GTask       *task,
  * epg_provider_loader_load_finish() to retrieve a (possibly empty) list of
  * providers that were successfully initialized.
  *
+ * Plugins which were already loaded by an earlier call on @self are not loaded
+ * again. Providers in standby from an earlier call to
+ * epg_provider_loader_get_first_enabled_async() are re-checked rather than
+ * re-initialized.
+ *
+ * Providers which take longer than #EpgProviderLoader:init-timeout-ms to
+ * initialize are treated as having failed.
+ *
  * Since: 0.2.0
  */
 void
@@ -175,66 +473,221 @@ epg_provider_loader_load_async (EpgProviderLoader   *self,
   g_return_if_fail (EPG_IS_PROVIDER_LOADER (self));
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
+  load_async (self, FALSE, cancellable, callback, user_data);
+}
+
+/* If @probe is %TRUE, plugins and providers which report that they cannot be
+ * enabled on this machine are skipped without being initialized. */
+static void
+load_async (EpgProviderLoader   *self,
+            gboolean             probe,
+            GCancellable        *cancellable,
+            GAsyncReadyCallback  callback,
+            gpointer             user_data)
+{
   g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, epg_provider_loader_load_async);
-  g_task_set_task_data (task,
-                        g_ptr_array_new_with_free_func (g_object_unref),
-                        (GDestroyNotify) g_ptr_array_unref);
+
+  LoadData *data = g_new0 (LoadData, 1);
+  data->providers = g_ptr_array_new_with_free_func (g_object_unref);
+  data->probe = probe;
+  data->start_time = g_get_monotonic_time ();
+  data->timings = g_array_new (FALSE, TRUE, sizeof (PluginTiming));
+  g_array_set_clear_func (data->timings, (GDestroyNotify) plugin_timing_clear);
+  g_task_set_task_data (task, data, (GDestroyNotify) load_data_free);
   epg_multi_task_attach (task, 1);
 
+  for (guint i = 0; static_provider_types != NULL && i < static_provider_types->len; i++)
+    {
+      GType provider_type = g_array_index (static_provider_types, GType, i);
+      gpointer source = GSIZE_TO_POINTER (provider_type);
+
+      if (g_hash_table_contains (self->standby_providers, source))
+        try_recheck (self, source, g_type_name (provider_type), task);
+      else
+        try_load_static (self, provider_type, task);
+    }
+
+#ifdef ENABLE_PLUGINS
   const GList *plugins = peas_engine_get_plugin_list (self->engine);
   for (; plugins != NULL; plugins = plugins->next)
-    try_load (self, PEAS_PLUGIN_INFO (plugins->data), task);
+    {
+      PeasPluginInfo *plugin_info = PEAS_PLUGIN_INFO (plugins->data);
+
+      if (g_hash_table_contains (self->standby_providers, plugin_info))
+        try_recheck (self, plugin_info,
+                     peas_plugin_info_get_name (plugin_info), task);
+      else
+        try_load (self, plugin_info, task);
+    }
+#endif
 
   maybe_return (task, NULL);
 }
 
+/* Re-check the provider for @source which is in standby. */
+static void
+try_recheck (EpgProviderLoader *self,
+             gpointer           source,
+             const gchar       *name,
+             GTask             *task)
+{
+  LoadData *data = g_task_get_task_data (task);
+  gpointer standby_provider = NULL;
+
+  if (!g_hash_table_steal_extended (self->standby_providers, source,
+                                    NULL, &standby_provider))
+    g_assert_not_reached ();
+
+  g_debug ("%s: Re-checking %s", G_STRFUNC,
+           G_OBJECT_TYPE_NAME (standby_provider));
+
+  guint timing_index = load_data_add_timing (data, name);
+  ProviderInit *init = provider_init_new (self, task, timing_index);
+
+  epg_multi_task_increment (task);
+  epg_provider_recheck_enabled_async (EPG_PROVIDER (standby_provider),
+                                      init->cancellable,
+                                      provider_recheck_enabled_cb,
+                                      init);
+}
+
+static void
+try_load_static (EpgProviderLoader *self,
+                 GType              provider_type,
+                 GTask             *task)
+{
+  LoadData *data = g_task_get_task_data (task);
+  const gchar *name = g_type_name (provider_type);
+  guint timing_index = load_data_add_timing (data, name);
+
+  gint64 start_time = g_get_monotonic_time ();
+  g_autoptr(EpgProvider) provider = g_object_new (provider_type, NULL);
+  load_data_get_timing (data, timing_index)->create_usec = g_get_monotonic_time () - start_time;
+
+  start_init (self, task, provider, GSIZE_TO_POINTER (provider_type), timing_index);
+}
+
+#ifdef ENABLE_PLUGINS
+/* Check the optional PROBE_PATHS_KEY of @plugin_info. Returns %TRUE if it is
+ * unset, or if any of the paths it lists exists. */
+static gboolean
+probe_paths_exist (PeasPluginInfo *plugin_info)
+{
+  const gchar *probe_paths = peas_plugin_info_get_external_data (plugin_info,
+                                                                 PROBE_PATHS_KEY);
+
+  if (probe_paths == NULL)
+    return TRUE;
+
+  g_auto(GStrv) paths = g_strsplit (probe_paths, ";", -1);
+
+  for (gsize i = 0; paths[i] != NULL; i++)
+    {
+      if (*paths[i] != '\0' && g_file_test (paths[i], G_FILE_TEST_EXISTS))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static void
 try_load (EpgProviderLoader *self,
           PeasPluginInfo    *plugin_info,
           GTask             *task)
 {
+  LoadData *data = g_task_get_task_data (task);
   const gchar *name = peas_plugin_info_get_name (plugin_info);
   g_autoptr(PeasExtension) extension = NULL;
+  guint timing_index = load_data_add_timing (data, name);
+  gint64 start_time;
 
-  if (!peas_engine_load_plugin (self->engine, plugin_info))
+  if (data->probe && !probe_paths_exist (plugin_info))
+    {
+      g_debug ("%s: Skipping plugin %s: none of its probe paths exist",
+               G_STRFUNC, name);
+      load_data_get_timing (data, timing_index)->outcome = "probe-paths-missing";
+      return;
+    }
+
+  start_time = g_get_monotonic_time ();
+  gboolean loaded = peas_engine_load_plugin (self->engine, plugin_info);
+  load_data_get_timing (data, timing_index)->load_usec = g_get_monotonic_time () - start_time;
+
+  if (!loaded)
     {
       g_autoptr(GError) local_error = NULL;
       peas_plugin_info_is_available (plugin_info, &local_error);
       g_warning ("Failed to load plugin %s: %s",
                  name,
                  local_error != NULL ? local_error->message : "(unknown reason)");
+      load_data_get_timing (data, timing_index)->outcome = "load-failed";
       return;
     }
 
   if (!peas_engine_provides_extension (self->engine,
                                        plugin_info,
                                        EPG_TYPE_PROVIDER))
-    return;
+    {
+      load_data_get_timing (data, timing_index)->outcome = "not-a-provider";
+      return;
+    }
 
+  start_time = g_get_monotonic_time ();
   extension = peas_engine_create_extension (self->engine,
                                             plugin_info,
                                             EPG_TYPE_PROVIDER,
                                             NULL);
+  load_data_get_timing (data, timing_index)->create_usec = g_get_monotonic_time () - start_time;
+
   if (extension == NULL)
     {
       /* Should not happen: we just checked that plugin_info can do this. */
       g_warning ("Failed to create EpgProvider from %s", name);
+      load_data_get_timing (data, timing_index)->outcome = "create-failed";
+      return;
+    }
+
+  start_init (self, task, EPG_PROVIDER (extension), plugin_info, timing_index);
+}
+#endif  /* ENABLE_PLUGINS */
+
+/* Probe (if requested) and start initializing @provider, which was just
+ * created from @source. */
+static void
+start_init (EpgProviderLoader *self,
+            GTask             *task,
+            EpgProvider       *provider,
+            gpointer           source,
+            guint              timing_index)
+{
+  LoadData *data = g_task_get_task_data (task);
+
+  if (!G_IS_ASYNC_INITABLE (provider))
+    {
+      g_warning ("%s is not GAsyncInitable", G_OBJECT_TYPE_NAME (provider));
+      load_data_get_timing (data, timing_index)->outcome = "create-failed";
       return;
     }
 
-  if (!G_IS_ASYNC_INITABLE (extension))
+  if (data->probe && !epg_provider_probe (provider))
     {
-      g_warning ("EpgProvider from %s is not GAsyncInitable", name);
+      g_debug ("%s: Skipping %s: it cannot be enabled on this machine",
+               G_STRFUNC, G_OBJECT_TYPE_NAME (provider));
+      load_data_get_timing (data, timing_index)->outcome = "probe-failed";
       return;
     }
 
+  g_object_set_qdata (G_OBJECT (provider), source_quark, source);
+
+  ProviderInit *init = provider_init_new (self, task, timing_index);
+
   epg_multi_task_increment (task);
-  g_async_initable_init_async (G_ASYNC_INITABLE (g_steal_pointer (&extension)),
+  g_async_initable_init_async (G_ASYNC_INITABLE (g_object_ref (provider)),
                                g_task_get_priority (task),
-                               g_task_get_cancellable (task),
+                               init->cancellable,
                                provider_init_cb,
-                               g_object_ref (task));
+                               init);
 }
 
 static void
@@ -243,21 +696,70 @@ provider_init_cb (GObject      *source_object,
                   gpointer      user_data)
 {
   g_autoptr(EpgProvider) provider = EPG_PROVIDER (source_object);
-  g_autoptr(GTask) task = G_TASK (user_data);
+  g_autoptr(ProviderInit) init = user_data;
   g_autoptr(GError) local_error = NULL;
+  gboolean success;
 
-  if (!g_async_initable_init_finish (G_ASYNC_INITABLE (provider),
-                                     result,
-                                     &local_error))
+  success = g_async_initable_init_finish (G_ASYNC_INITABLE (provider),
+                                          result,
+                                          &local_error);
+
+  /* If the provider timed out, it has already been counted as failed; drop it
+   * even if it eventually succeeded. */
+  if (init->timed_out)
+    {
+      g_debug ("%s: Ignoring late result from %s", G_STRFUNC,
+               G_OBJECT_TYPE_NAME (provider));
+      return;
+    }
+
+  if (!success)
     {
       g_warning ("Failed to initialize %s: %s",
                  G_OBJECT_TYPE_NAME (provider),
                  local_error->message);
-      maybe_return (task, NULL);
+      provider_init_complete (init, "init-failed");
+      maybe_return (init->task, NULL);
+    }
+  else
+    {
+      provider_init_complete (init, "initialized");
+      maybe_return (init->task, g_steal_pointer (&provider));
+    }
+}
+
+static void
+provider_recheck_enabled_cb (GObject      *source_object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  /* This takes the reference which was held in @standby_providers. */
+  g_autoptr(EpgProvider) provider = EPG_PROVIDER (source_object);
+  g_autoptr(ProviderInit) init = user_data;
+  g_autoptr(GError) local_error = NULL;
+  gboolean success;
+
+  success = epg_provider_recheck_enabled_finish (provider, result, &local_error);
+
+  if (init->timed_out)
+    {
+      g_debug ("%s: Ignoring late result from %s", G_STRFUNC,
+               G_OBJECT_TYPE_NAME (provider));
+      return;
+    }
+
+  if (!success)
+    {
+      g_warning ("Failed to re-check %s: %s",
+                 G_OBJECT_TYPE_NAME (provider),
+                 local_error->message);
+      provider_init_complete (init, "recheck-failed");
+      maybe_return (init->task, NULL);
     }
   else
     {
-      maybe_return (task, g_steal_pointer (&provider));
+      provider_init_complete (init, "rechecked");
+      maybe_return (init->task, g_steal_pointer (&provider));
     }
 }
 
@@ -265,7 +767,8 @@ static void
 maybe_return (GTask       *task,
               EpgProvider *provider)
 {
-  GPtrArray *providers = g_task_get_task_data (task);
+  LoadData *data = g_task_get_task_data (task);
+  GPtrArray *providers = data->providers;
 
   if (provider != NULL)
     g_ptr_array_add (providers, g_steal_pointer (&provider));
@@ -358,6 +861,50 @@ shutdown_providers_finish (EpgProviderLoader  *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* Log the timing of each plugin in the load operation @data as a single
+ * structured message, so that slow plugins can be identified from the
+ * journal. */
+static void
+log_timings (LoadData *data)
+{
+  if (data->timings->len == 0)
+    return;
+
+  g_autoptr(GString) message = g_string_new (NULL);
+  g_autofree gchar *total_value = NULL;
+  gint64 total_usec = g_get_monotonic_time () - data->start_time;
+
+  g_string_append_printf (message, "Loaded %u plugins in %" G_GINT64_FORMAT " µs:",
+                          data->timings->len, total_usec);
+
+  for (guint i = 0; i < data->timings->len; i++)
+    {
+      const PluginTiming *timing = load_data_get_timing (data, i);
+
+      g_string_append_printf (message,
+                              "%s %s (load=%" G_GINT64_FORMAT "µs "
+                              "create=%" G_GINT64_FORMAT "µs "
+                              "init=%" G_GINT64_FORMAT "µs %s)",
+                              (i > 0) ? "," : "",
+                              timing->name,
+                              timing->load_usec,
+                              timing->create_usec,
+                              timing->init_usec,
+                              timing->outcome);
+    }
+
+  total_value = g_strdup_printf ("%" G_GINT64_FORMAT, total_usec);
+
+  const GLogField fields[] =
+    {
+      { "PRIORITY", "5", -1 },
+      { "MESSAGE", message->str, -1 },
+      { "EOS_PAYG_PROVIDER_LOAD_USEC", total_value, -1 },
+    };
+
+  g_log_structured_array (G_LOG_LEVEL_MESSAGE, fields, G_N_ELEMENTS (fields));
+}
+
 static void get_first_enabled_load_cb (GObject      *source_object,
                                        GAsyncResult *result,
                                        gpointer      user_data);
@@ -374,6 +921,17 @@ static void get_first_enabled_shutdown_cb (GObject      *source_object,
  * epg_provider_loader_get_first_enabled_finish() to retrieve the first enabled
  * provider, if any.
  *
+ * Unlike epg_provider_loader_load_async(), providers are probed (see
+ * epg_provider_probe()) before being initialized, and plugins are only loaded
+ * if at least one of the paths in their `X-Epg-Probe-Paths` metadata exists
+ * (if it is set). Only providers which could be enabled pay the cost of full
+ * initialization.
+ *
+ * Other providers are shut down, except for disabled ones which support
+ * epg_provider_recheck_enabled_async(): those are kept in standby by @self, so
+ * that a later call (for example, after the root pivot, once more state is
+ * available) can re-check them cheaply.
+ *
  * Since: 0.2.0
  */
 void
@@ -388,9 +946,9 @@ epg_provider_loader_get_first_enabled_async  (EpgProviderLoader   *self,
   g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, epg_provider_loader_get_first_enabled_async);
 
-  epg_provider_loader_load_async (self, cancellable,
-                                  get_first_enabled_load_cb,
-                                  g_steal_pointer (&task));
+  load_async (self, TRUE, cancellable,
+              get_first_enabled_load_cb,
+              g_steal_pointer (&task));
 }
 
 static void
@@ -404,6 +962,8 @@ get_first_enabled_load_cb (GObject      *source_object,
   g_autoptr(GError) local_error = NULL;
 
   providers = epg_provider_loader_load_finish (self, result, &local_error);
+  log_timings (g_task_get_task_data (G_TASK (result)));
+
   if (providers == NULL)
     {
       g_task_return_error (task, g_steal_pointer (&local_error));
@@ -435,7 +995,25 @@ get_first_enabled_load_cb (GObject      *source_object,
   if (provider != NULL)
     g_task_set_task_data (task, g_steal_pointer (&provider), g_object_unref);
 
-  /* Shut down all providers except the first enabled one (if any). */
+  /* Keep disabled providers which can re-check their state in standby. */
+  for (i = providers->len; i > 0; i--)
+    {
+      EpgProvider *candidate = EPG_PROVIDER (g_ptr_array_index (providers, i - 1));
+      gpointer source = g_object_get_qdata (G_OBJECT (candidate), source_quark);
+
+      if (source == NULL ||
+          epg_provider_get_enabled (candidate) ||
+          !epg_provider_can_recheck_enabled (candidate))
+        continue;
+
+      g_debug ("%s: Keeping disabled external provider %s in standby",
+               G_STRFUNC, G_OBJECT_TYPE_NAME (candidate));
+      g_hash_table_replace (self->standby_providers, source,
+                            g_ptr_array_steal_index_fast (providers, i - 1));
+    }
+
+  /* Shut down all remaining providers except the first enabled one (if
+   * any). */
   GCancellable *cancellable = g_task_get_cancellable (task);
   shutdown_providers_async (self, providers, cancellable,
                             get_first_enabled_shutdown_cb,
@@ -500,3 +1078,35 @@ epg_provider_loader_new (const gchar *module_dir)
                        "module-dir", module_dir,
                        NULL);
 }
+
+/**
+ * epg_provider_loader_register_static:
+ * @provider_type: a #GType implementing #EpgProvider and #GAsyncInitable
+ *
+ * Register a provider which is compiled into the program, rather than loaded
+ * from a plugin. All #EpgProviderLoader instances will construct and
+ * initialize it (with no construct properties) in the same way as providers
+ * from plugins, before any plugins are loaded.
+ *
+ * This must be called from the main thread, before any #EpgProviderLoader is
+ * used. Registering the same type more than once has no effect.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_provider_loader_register_static (GType provider_type)
+{
+  g_return_if_fail (g_type_is_a (provider_type, EPG_TYPE_PROVIDER));
+  g_return_if_fail (g_type_is_a (provider_type, G_TYPE_ASYNC_INITABLE));
+
+  if (static_provider_types == NULL)
+    static_provider_types = g_array_new (FALSE, FALSE, sizeof (GType));
+
+  for (guint i = 0; i < static_provider_types->len; i++)
+    {
+      if (g_array_index (static_provider_types, GType, i) == provider_type)
+        return;
+    }
+
+  g_array_append_val (static_provider_types, provider_type);
+}
@@ -29,6 +29,8 @@ G_DECLARE_FINAL_TYPE (EpgProviderLoader, epg_provider_loader, EPG, PROVIDER_LOAD
 
 EpgProviderLoader *epg_provider_loader_new (const gchar *module_dir);
 
+void epg_provider_loader_register_static (GType provider_type);
+
 void       epg_provider_loader_load_async  (EpgProviderLoader   *self,
                                             GCancellable        *cancellable,
                                             GAsyncReadyCallback  callback,
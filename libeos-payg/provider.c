@@ -285,6 +285,329 @@ epg_provider_add_code   (EpgProvider  *self,
   return iface->add_code (self, code_str, time_added, error);
 }
 
+/**
+ * epg_provider_add_code_async:
+ * @self: an #EpgProvider
+ * @code_str: code to verify and add
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: function to call once the async operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of epg_provider_add_code(), for providers which need
+ * to do slow work (such as I/O) to verify or apply a code. Callers should
+ * prefer this, so that such providers don’t block the main loop.
+ *
+ * If the provider does not implement the asynchronous vfuncs, this calls
+ * epg_provider_add_code() and completes with its result.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_provider_add_code_async (EpgProvider         *self,
+                             const gchar         *code_str,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  g_return_if_fail (EPG_IS_PROVIDER (self));
+  g_return_if_fail (code_str != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->add_code_async != NULL)
+    {
+      g_assert (iface->add_code_finish != NULL);
+      iface->add_code_async (self, code_str, cancellable, callback, user_data);
+      return;
+    }
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_provider_add_code_async);
+
+  g_autoptr(GError) local_error = NULL;
+  gint64 time_added = 0;
+
+  if (!epg_provider_add_code (self, code_str, &time_added, &local_error))
+    g_task_return_error (task, g_steal_pointer (&local_error));
+  else
+    g_task_return_pointer (task, g_memdup2 (&time_added, sizeof (time_added)), g_free);
+}
+
+/**
+ * epg_provider_add_code_finish:
+ * @self: an #EpgProvider
+ * @result: asynchronous operation result
+ * @time_added: (out): return location for the span of seconds added by the
+ *    code
+ * @error: return location for an error, or %NULL
+ *
+ * Finish an asynchronous operation started with
+ * epg_provider_add_code_async(). The errors and @time_added are as for
+ * epg_provider_add_code().
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epg_provider_add_code_finish (EpgProvider   *self,
+                              GAsyncResult  *result,
+                              gint64        *time_added,
+                              GError       **error)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (time_added != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->add_code_finish != NULL)
+    return iface->add_code_finish (self, result, time_added, error);
+
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_provider_add_code_async), FALSE);
+
+  g_autofree gint64 *time_added_ptr = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (time_added_ptr == NULL)
+    return FALSE;
+
+  *time_added = *time_added_ptr;
+  return TRUE;
+}
+
+/**
+ * epg_provider_add_codes:
+ * @self: an #EpgProvider
+ * @codes: (array zero-terminated=1): codes to add
+ * @times_added: (out caller-allocates) (array): return location for the span
+ *    of seconds added by each code, with as many elements as @codes
+ * @errors: (out caller-allocates) (array): return location for the error from
+ *    each code, with as many elements as @codes; each is set to %NULL if the
+ *    code was added
+ *
+ * Verify and add each of @codes, as if by calling epg_provider_add_code() on
+ * each in order. An invalid code does not prevent the following ones from
+ * being added.
+ *
+ * Providers which implement the `add_codes` vfunc (such as #EpgManager) save
+ * the state only once, after all the codes have been tried. For other
+ * providers, this falls back to calling epg_provider_add_code() for each code,
+ * so the state is saved once per code; only the property change notifications
+ * are coalesced until the end of the batch.
+ *
+ * Rate limiting applies to each code in the batch individually: every invalid
+ * code counts as an attempt, exactly as for epg_provider_add_code(), and a
+ * valid code resets the history. If the limit is reached partway through the
+ * batch, the remaining codes all fail with
+ * %EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS. Batching therefore does not allow
+ * more codes to be guessed than separate calls would.
+ *
+ * The caller must free each non-%NULL element of @errors.
+ *
+ * Returns: the number of codes which were added successfully
+ * Since: 0.2.5
+ */
+guint
+epg_provider_add_codes (EpgProvider        *self,
+                        const gchar * const *codes,
+                        gint64             *times_added,
+                        GError            **errors)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), 0);
+  g_return_val_if_fail (codes != NULL, 0);
+  g_return_val_if_fail (times_added != NULL, 0);
+  g_return_val_if_fail (errors != NULL, 0);
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->add_codes != NULL)
+    return iface->add_codes (self, codes, times_added, errors);
+
+  /* Fall back to adding them one at a time. */
+  guint n_added = 0;
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  for (gsize i = 0; codes[i] != NULL; i++)
+    {
+      times_added[i] = 0;
+      errors[i] = NULL;
+
+      if (epg_provider_add_code (self, codes[i], &times_added[i], &errors[i]))
+        n_added++;
+    }
+
+  g_object_thaw_notify (G_OBJECT (self));
+
+  return n_added;
+}
+
+typedef struct
+{
+  gchar **codes;  /* (owned) */
+  gsize n_codes;
+  gsize next_code;
+  gint64 *times_added;  /* (owned) (array length=n_codes) */
+  GError **errors;  /* (owned) (array length=n_codes) */
+  guint n_added;
+} AddCodesData;
+
+static void
+add_codes_data_free (AddCodesData *data)
+{
+  for (gsize i = 0; i < data->n_codes; i++)
+    g_clear_error (&data->errors[i]);
+
+  g_free (data->errors);
+  g_free (data->times_added);
+  g_strfreev (data->codes);
+  g_free (data);
+}
+
+static void add_codes_next (GTask *task);
+
+static void
+add_codes_add_code_cb (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  EpgProvider *self = EPG_PROVIDER (source_object);
+  g_autoptr(GTask) task = G_TASK (user_data);
+  AddCodesData *data = g_task_get_task_data (task);
+  gsize i = data->next_code;
+
+  if (epg_provider_add_code_finish (self, result, &data->times_added[i], &data->errors[i]))
+    data->n_added++;
+
+  data->next_code++;
+  add_codes_next (g_steal_pointer (&task));
+}
+
+/* Start adding the next code in the batch, or complete @task if there are no
+ * more. Takes ownership of @task. */
+static void
+add_codes_next (GTask *task)
+{
+  g_autoptr(GTask) owned_task = task;
+  EpgProvider *self = g_task_get_source_object (task);
+  AddCodesData *data = g_task_get_task_data (task);
+
+  if (data->next_code < data->n_codes)
+    {
+      epg_provider_add_code_async (self, data->codes[data->next_code],
+                                   g_task_get_cancellable (task),
+                                   add_codes_add_code_cb,
+                                   g_steal_pointer (&owned_task));
+      return;
+    }
+
+  g_object_thaw_notify (G_OBJECT (self));
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * epg_provider_add_codes_async:
+ * @self: an #EpgProvider
+ * @codes: (array zero-terminated=1): codes to add
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: function to call once the async operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of epg_provider_add_codes().
+ *
+ * If the provider implements the `add_code_async` vfunc, the codes are added
+ * one at a time with epg_provider_add_code_async(), so that a provider which
+ * needs to do slow work for each code doesn’t block the main loop. Otherwise,
+ * this calls epg_provider_add_codes() and completes with its results.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_provider_add_codes_async (EpgProvider         *self,
+                              const gchar * const *codes,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_return_if_fail (EPG_IS_PROVIDER (self));
+  g_return_if_fail (codes != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_provider_add_codes_async);
+  /* Cancellation is reported per code, in the errors from the batch. */
+  g_task_set_check_cancellable (task, FALSE);
+
+  AddCodesData *data = g_new0 (AddCodesData, 1);
+  data->codes = g_strdupv ((gchar **) codes);
+  data->n_codes = g_strv_length (data->codes);
+  data->times_added = g_new0 (gint64, data->n_codes);
+  data->errors = g_new0 (GError *, data->n_codes);
+  g_task_set_task_data (task, data, (GDestroyNotify) add_codes_data_free);
+
+  if (iface->add_code_async != NULL)
+    {
+      /* Coalesce the notifications until the end of the batch, as
+       * epg_provider_add_codes() does. add_codes_next() thaws them. */
+      g_object_freeze_notify (G_OBJECT (self));
+      add_codes_next (g_steal_pointer (&task));
+      return;
+    }
+
+  data->n_added = epg_provider_add_codes (self, (const gchar * const *) data->codes,
+                                          data->times_added, data->errors);
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * epg_provider_add_codes_finish:
+ * @self: an #EpgProvider
+ * @result: asynchronous operation result
+ * @times_added: (out caller-allocates) (array): return location for the span
+ *    of seconds added by each code, with as many elements as the codes passed
+ *    to epg_provider_add_codes_async()
+ * @errors: (out caller-allocates) (array): return location for the error from
+ *    each code, with as many elements as the codes passed to
+ *    epg_provider_add_codes_async(); each is set to %NULL if the code was added
+ *
+ * Finish an asynchronous operation started with
+ * epg_provider_add_codes_async(). The results are as for
+ * epg_provider_add_codes().
+ *
+ * The caller must free each non-%NULL element of @errors.
+ *
+ * Returns: the number of codes which were added successfully
+ * Since: 0.2.5
+ */
+guint
+epg_provider_add_codes_finish (EpgProvider   *self,
+                               GAsyncResult  *result,
+                               gint64        *times_added,
+                               GError       **errors)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), 0);
+  g_return_val_if_fail (g_task_is_valid (result, self), 0);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_provider_add_codes_async), 0);
+  g_return_val_if_fail (times_added != NULL, 0);
+  g_return_val_if_fail (errors != NULL, 0);
+
+  AddCodesData *data = g_task_get_task_data (G_TASK (result));
+
+  /* The batch as a whole can’t fail; errors are reported per code. */
+  g_task_propagate_boolean (G_TASK (result), NULL);
+
+  for (gsize i = 0; i < data->n_codes; i++)
+    {
+      times_added[i] = data->times_added[i];
+      errors[i] = g_steal_pointer (&data->errors[i]);
+    }
+
+  return data->n_added;
+}
+
 /**
  * epg_provider_clear_code:
  * @self: an #EpgProvider
@@ -370,6 +693,134 @@ epg_provider_shutdown_finish (EpgProvider   *self,
   return iface->shutdown_finish (self, result, error);
 }
 
+/**
+ * epg_provider_probe:
+ * @self: an #EpgProvider which has not yet been initialized
+ *
+ * Cheaply check whether @self could be enabled on this machine, without
+ * initializing it. This is called before g_async_initable_init_async() so that
+ * providers which are installed but clearly not in use (for example, because
+ * none of their state or keys exist) don’t pay the cost of full
+ * initialization.
+ *
+ * This must not block, and must err on the side of returning %TRUE: if it
+ * returns %FALSE, the provider will not be initialized at all. Providers which
+ * do not implement it are always initialized.
+ *
+ * Returns: %FALSE if @self definitely cannot be enabled, %TRUE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epg_provider_probe (EpgProvider *self)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), FALSE);
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->probe == NULL)
+    return TRUE;
+
+  return iface->probe (self);
+}
+
+/**
+ * epg_provider_can_recheck_enabled:
+ * @self: an #EpgProvider
+ *
+ * Get whether @self implements epg_provider_recheck_enabled_async(). If it
+ * does, a provider which is disabled when first initialised (for example,
+ * because its state lives on a file system which is not mounted yet) can be
+ * kept and re-checked later, rather than being shut down and initialised
+ * again from scratch.
+ *
+ * Returns: %TRUE if @self can re-check whether it is enabled, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epg_provider_can_recheck_enabled (EpgProvider *self)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), FALSE);
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  return (iface->recheck_enabled_async != NULL);
+}
+
+/**
+ * epg_provider_recheck_enabled_async:
+ * @self: an #EpgProvider
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: function to call once the async operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Ask an already-initialised provider to check again whether it is enabled,
+ * re-reading only those inputs (such as state files) which may have changed
+ * since it was initialised. #EpgProvider:enabled is updated (and notified) as
+ * needed before the operation completes.
+ *
+ * If the provider does not implement this (see
+ * epg_provider_can_recheck_enabled()), the operation fails with
+ * %G_IO_ERROR_NOT_SUPPORTED.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_provider_recheck_enabled_async (EpgProvider         *self,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  g_return_if_fail (EPG_IS_PROVIDER (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->recheck_enabled_async != NULL)
+    {
+      g_assert (iface->recheck_enabled_finish != NULL);
+      iface->recheck_enabled_async (self, cancellable, callback, user_data);
+      return;
+    }
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_provider_recheck_enabled_async);
+  g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "%s cannot re-check whether it is enabled",
+                           G_OBJECT_TYPE_NAME (self));
+}
+
+/**
+ * epg_provider_recheck_enabled_finish:
+ * @self: an #EpgProvider
+ * @result: asynchronous operation result
+ * @error: return location for an error, or %NULL
+ *
+ * Finish an asynchronous operation started with
+ * epg_provider_recheck_enabled_async(). Use epg_provider_get_enabled()
+ * afterwards to find the result of the check.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 0.2.5
+ */
+gboolean
+epg_provider_recheck_enabled_finish (EpgProvider   *self,
+                                     GAsyncResult  *result,
+                                     GError       **error)
+{
+  g_return_val_if_fail (EPG_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  EpgProviderInterface *iface = EPG_PROVIDER_GET_IFACE (self);
+
+  if (iface->recheck_enabled_finish != NULL)
+    return iface->recheck_enabled_finish (self, result, error);
+
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_provider_recheck_enabled_async), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /**
  * epg_provider_wallclock_time_changed:
  * @self: an #EpgProvider
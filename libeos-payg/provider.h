@@ -63,12 +63,64 @@ struct _EpgProviderInterface
   const gchar *     code_format_prefix;
   const gchar *     code_format_suffix;
   guint32           code_length;
+
+  /* Since: 0.2.5. Optional; defaults to calling add_code() for each code. */
+  guint           (*add_codes)  (EpgProvider        *self,
+                                 const gchar * const *codes,
+                                 gint64             *times_added,
+                                 GError            **errors);
+
+  /* Since: 0.2.5. Optional, but both must be implemented if either is;
+   * defaults to calling add_code() and returning its result. */
+  void            (*add_code_async)  (EpgProvider         *self,
+                                      const gchar         *code_str,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+  gboolean        (*add_code_finish) (EpgProvider   *self,
+                                      GAsyncResult  *result,
+                                      gint64        *time_added,
+                                      GError       **error);
+
+  /* Since: 0.2.5. Optional, but both must be implemented if either is. */
+  void            (*recheck_enabled_async)  (EpgProvider         *self,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data);
+  gboolean        (*recheck_enabled_finish) (EpgProvider   *self,
+                                             GAsyncResult  *result,
+                                             GError       **error);
+
+  /* Since: 0.2.5. Optional; defaults to returning %TRUE. */
+  gboolean        (*probe) (EpgProvider *self);
 };
 
 gboolean        epg_provider_add_code   (EpgProvider  *self,
                                          const gchar  *code_str,
                                          gint64       *time_added,
                                          GError      **error);
+void            epg_provider_add_code_async  (EpgProvider         *self,
+                                              const gchar         *code_str,
+                                              GCancellable        *cancellable,
+                                              GAsyncReadyCallback  callback,
+                                              gpointer             user_data);
+gboolean        epg_provider_add_code_finish (EpgProvider   *self,
+                                              GAsyncResult  *result,
+                                              gint64        *time_added,
+                                              GError       **error);
+guint           epg_provider_add_codes  (EpgProvider        *self,
+                                         const gchar * const *codes,
+                                         gint64             *times_added,
+                                         GError            **errors);
+void            epg_provider_add_codes_async  (EpgProvider         *self,
+                                               const gchar * const *codes,
+                                               GCancellable        *cancellable,
+                                               GAsyncReadyCallback  callback,
+                                               gpointer             user_data);
+guint           epg_provider_add_codes_finish (EpgProvider   *self,
+                                               GAsyncResult  *result,
+                                               gint64        *times_added,
+                                               GError       **errors);
 gboolean        epg_provider_clear_code (EpgProvider  *self,
                                          GError      **error);
 
@@ -80,6 +132,16 @@ gboolean        epg_provider_shutdown_finish (EpgProvider   *self,
                                               GAsyncResult  *result,
                                               GError       **error);
 
+gboolean        epg_provider_probe                  (EpgProvider         *self);
+gboolean        epg_provider_can_recheck_enabled    (EpgProvider         *self);
+void            epg_provider_recheck_enabled_async  (EpgProvider         *self,
+                                                     GCancellable        *cancellable,
+                                                     GAsyncReadyCallback  callback,
+                                                     gpointer             user_data);
+gboolean        epg_provider_recheck_enabled_finish (EpgProvider   *self,
+                                                     GAsyncResult  *result,
+                                                     GError       **error);
+
 void            epg_provider_wallclock_time_changed  (EpgProvider *self,
                                                       gint64       delta,
                                                       gint64       now_secs);
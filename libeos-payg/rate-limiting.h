@@ -0,0 +1,38 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Limit calls to epg_manager_add_code() to 10 attempts every 30 minutes. These
+ * values are not arbitrary, and are an inherent part of the security of the
+ * codes in libeos-payg-codes against brute force attacks. By rate limiting at
+ * this level, we can probabilistically say that brute force attacks will take
+ * longer than the period of the code they would reveal, assuming codes have
+ * an average period of 1 week.
+ *
+ * eos-payg-analyse-codes checks this by simulation, using these values as its
+ * defaults. */
+#define EPG_RATE_LIMITING_N_ATTEMPTS 10
+#define EPG_RATE_LIMITING_TIME_PERIOD_SECS (30 * 60)
+
+G_END_DECLS
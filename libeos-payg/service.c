@@ -30,6 +30,8 @@
 #include <libeos-payg/resources.h>
 #include <libeos-payg/service.h>
 #include <libeos-payg/clock-jump-source.h>
+#include <libeos-payg/stats.h>
+#include <libeos-payg/trace.h>
 #include <libeos-payg/util.h>
 #include <libeos-payg-codes/codes.h>
 #include <libgsystemservice/config-file.h>
@@ -42,6 +44,12 @@
 #define USR_LOCAL_SHARE_CONFIG_FILE_PATH PREFIX "/local/share/eos-payg/eos-payg.conf"
 #define USR_SHARE_CONFIG_FILE_PATH DATADIR "/eos-payg/eos-payg.conf"
 
+/* Limit on how long each provider may take to initialize before the root
+ * pivot: long enough for a provider to read its state from slow storage, but
+ * short enough that a hung plugin can’t stall the pivot for long. After the
+ * pivot, providers may take as long as they need. */
+#define SECURE_INIT_PROVIDER_TIMEOUT_MS 10000
+
 static const GDBusErrorEntry epg_service_error_entries[] = {
   { EPG_SERVICE_ERROR_NO_PROVIDER, "com.endlessm.Payg1.Error.NoProvider" },
 };
@@ -88,6 +96,11 @@ struct _EpgService
   EpgProvider *provider;  /* (owned) */
   EpgManagerService *manager_service;  /* (owned) */
 
+  /* Loader from epg_service_secure_init_sync(), kept until
+   * epg_service_startup_async() if no enabled provider was found before the
+   * root pivot, so plugins are not loaded and initialized twice. */
+  EpgProviderLoader *loader;  /* (owned) (nullable) */
+
   /* This is normally %NULL, and is only non-%NULL when overridden from the
    * command line: */
   gchar *config_file_path;  /* (type filename) (owned) (nullable) */
@@ -115,6 +128,12 @@ struct _EpgService
 
   /* Whether the EOSPAYG_active EFI variable is set */
   gboolean eospayg_active_efivar;
+
+  /* Contents of the EOSPAYG_state and EOSPAYG_state-b EFI variables, if they
+   * exist, to be passed to #EpgManager since they cannot be read after the
+   * root pivot */
+  GBytes *efi_state;  /* (owned) (nullable) */
+  GBytes *efi_state_b;  /* (owned) (nullable) */
 };
 
 G_DEFINE_TYPE (EpgService, epg_service, GSS_TYPE_SERVICE)
@@ -160,6 +179,7 @@ epg_service_dispose (GObject *object)
 
   g_clear_object (&self->manager_service);
   g_clear_object (&self->provider);
+  g_clear_object (&self->loader);
 
   if (self->source != NULL)
     {
@@ -169,6 +189,8 @@ epg_service_dispose (GObject *object)
     }
 
   g_clear_pointer (&self->config_file_path, g_free);
+  g_clear_pointer (&self->efi_state, g_bytes_unref);
+  g_clear_pointer (&self->efi_state_b, g_bytes_unref);
 
   /* Chain up to the parent class */
   G_OBJECT_CLASS (epg_service_parent_class)->dispose (object);
@@ -238,9 +260,12 @@ clock_jump_cb (gpointer user_data)
 
   clock_jump_delta = ((clock_realtime_secs_v1 - self->clock_realtime_secs_v0) -
                       (clock_boottime_secs_v1 - self->clock_boottime_secs_v0));
+  EPG_TRACE1 (clock_jump, clock_jump_delta);
+
   if (clock_jump_delta != 0)
     {
       g_message ("Detected system clock jump of %" G_GINT64_FORMAT " seconds", clock_jump_delta);
+      epg_stats_increment (EPG_STATS_CLOCK_JUMPS);
       epg_provider_wallclock_time_changed (self->provider, clock_jump_delta, clock_realtime_secs_v1);
     }
 
@@ -269,6 +294,7 @@ _init_clock_jump_detection (EpgService *self)
     }
   else
     {
+      g_source_set_name (self->source, "EpgService clock jump");
       g_source_set_callback (self->source, clock_jump_cb, self, NULL);
       g_source_attach (self->source, NULL);
     }
@@ -285,6 +311,29 @@ epg_service_set_provider (EpgService *self,
   _init_clock_jump_detection (self);
 }
 
+/* Read the EFI variable @name, which holds #EpgManager state, returning %NULL
+ * if it does not exist or cannot be read. */
+static GBytes *
+read_efi_state_variable (const gchar *name)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autofree void *efi_state = NULL;
+  int efi_state_size = 0;
+
+  if (!eospayg_efi_var_exists (name))
+    return NULL;
+
+  efi_state = eospayg_efi_var_read (name, -1, &efi_state_size, &local_error);
+  if (efi_state == NULL)
+    {
+      g_warning ("%s: Failed to read EFI state variable %s: %s",
+                 G_STRFUNC, name, local_error->message);
+      return NULL;
+    }
+
+  return g_bytes_new_take (g_steal_pointer (&efi_state), efi_state_size);
+}
+
 /**
  * epg_service_secure_init_sync:
  * @self: an #EpgService
@@ -308,7 +357,6 @@ void
 epg_service_secure_init_sync (EpgService   *self,
                               GCancellable *cancellable)
 {
-  g_autoptr(EpgProviderLoader) loader = NULL;
   g_autoptr(GAsyncResult) load_result = NULL;
   g_autoptr(EpgProvider) provider = NULL;
   g_autoptr(GSource) clock_jump_source = NULL;
@@ -325,16 +373,29 @@ epg_service_secure_init_sync (EpgService   *self,
   else
     self->eospayg_active_efivar = payg_get_eospayg_active_set ();
 
+  /* If #EpgManager state is stored in EFI, it has to be read now. */
+  if (!payg_get_legacy_mode ())
+    {
+      self->efi_state = read_efi_state_variable (EFI_STATE_VARIABLE);
+      self->efi_state_b = read_efi_state_variable (EFI_STATE_VARIABLE_B);
+    }
+
   /* Look for enabled PAYG providers */
-  loader = epg_provider_loader_new (NULL);
-  epg_provider_loader_get_first_enabled_async (loader, cancellable,
+  g_clear_object (&self->loader);
+  self->loader = epg_provider_loader_new (NULL);
+  g_object_set (self->loader,
+                "init-timeout-ms", SECURE_INIT_PROVIDER_TIMEOUT_MS,
+                NULL);
+  epg_provider_loader_get_first_enabled_async (self->loader, cancellable,
                                                async_result_cb,
                                                &load_result);
 
+  /* The loader limits how long each provider may take to initialize, so a
+   * hung plugin can’t stall this (and hence the root pivot) indefinitely. */
   while (load_result == NULL)
     g_main_context_iteration (NULL, TRUE);
 
-  provider = epg_provider_loader_get_first_enabled_finish (loader, load_result, &local_error);
+  provider = epg_provider_loader_get_first_enabled_finish (self->loader, load_result, &local_error);
   if (local_error != NULL)
     {
       g_warning ("%s: Failed to load external providers: %s",
@@ -346,12 +407,18 @@ epg_service_secure_init_sync (EpgService   *self,
 
   /* We may not find any providers because PAYG is not enabled, or because
    * file-backed state is being used, which will only be found after the root
-   * pivot.
+   * pivot. In the latter case, keep the loader so its plugins (and any
+   * providers it has kept in standby) can be reused after the pivot.
    */
   if (provider == NULL)
-    g_debug ("%s: No enabled providers found pre-root-pivot", G_STRFUNC);
+    {
+      g_debug ("%s: No enabled providers found pre-root-pivot", G_STRFUNC);
+    }
   else
-    epg_service_set_provider (self, g_steal_pointer (&provider));
+    {
+      g_clear_object (&self->loader);
+      epg_service_set_provider (self, g_steal_pointer (&provider));
+    }
 }
 
 static void
@@ -374,8 +441,16 @@ epg_service_startup_async (GssService          *service,
   /* Some deployments are using an external provider (Angaza) with state stored
    * on the main filesystem, which would not have been found in
    * epg_service_secure_init_sync(). So we need to try
-   * epg_provider_loader_get_first_enabled_async() again here. */
-  g_autoptr(EpgProviderLoader) loader = epg_provider_loader_new (NULL);
+   * epg_provider_loader_get_first_enabled_async() again here, reusing the
+   * loader from then if there is one. */
+  if (self->loader == NULL)
+    self->loader = epg_provider_loader_new (NULL);
+
+  g_autoptr(EpgProviderLoader) loader = g_steal_pointer (&self->loader);
+
+  /* The timeout only protects the root pivot, so lift it now. */
+  g_object_set (loader, "init-timeout-ms", 0, NULL);
+
   epg_provider_loader_get_first_enabled_async (loader, cancellable,
                                                provider_get_first_enabled_cb,
                                                g_steal_pointer (&task));
@@ -408,10 +483,11 @@ provider_get_first_enabled_cb (GObject      *source_object,
 
   /* If the EFI variable EOSPAYG_active is set one of the external providers
    * should have been enabled, so error out otherwise. It would not be safe to
-   * fall back to the unsecure #EpgManager but keep it for backward
-   * compatibility with Phase 1 systems.
+   * fall back to #EpgManager with its state on the unsecure root filesystem,
+   * but keep it for backward compatibility with Phase 1 systems. #EpgManager
+   * with its state in EFI is fine.
    */
-  if (self->eospayg_active_efivar)
+  if (self->eospayg_active_efivar && self->efi_state == NULL && self->efi_state_b == NULL)
     {
       local_error = g_error_new (EPG_SERVICE_ERROR, EPG_SERVICE_ERROR_NO_PROVIDER,
                                  "No PAYG provider is enabled, despite PAYG being active");
@@ -453,8 +529,14 @@ provider_get_first_enabled_cb (GObject      *source_object,
       return;
     }
 
+  /* The EOSPAYG_state EFI variable is only created when provisioning PAYG,
+   * so it can’t be turned off by editing the configuration file. */
+  if (self->efi_state != NULL || self->efi_state_b != NULL)
+    enabled = TRUE;
+
   GCancellable *cancellable = g_task_get_cancellable (task);
-  epg_manager_new (enabled, NULL, NULL, NULL, NULL, cancellable,
+  epg_manager_new (enabled, NULL, NULL, NULL, self->efi_state, self->efi_state_b,
+                   NULL, cancellable,
                    manager_new_cb, g_steal_pointer (&task));
 }
 
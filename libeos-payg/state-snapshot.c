@@ -0,0 +1,376 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+/* For memfd_create() and F_ADD_SEALS. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <libeos-payg/state-snapshot.h>
+#include <libglnx.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Added in Linux 5.1, so define it in case the libc headers are older. */
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+/* Number of times epg_state_snapshot_read() will retry if it races with an
+ * update, before giving up. Updates only take a few stores, so this is only
+ * reached if the writer died half way through one. */
+#define READ_MAX_RETRIES 1000
+
+/* Whether to try F_SEAL_FUTURE_WRITE. Cleared once the kernel has rejected it,
+ * or by epg_state_snapshot_internal_set_use_future_write_seal() in tests. */
+static gboolean use_future_write_seal = TRUE;
+
+/**
+ * EpgStateSnapshot:
+ *
+ * A read-only view of the provider state in shared memory, so that clients
+ * which only need to display the state (such as a panel indicator) can read
+ * it without any D-Bus round trips or waking up the daemon.
+ *
+ * The memory is a sealed memfd which is mapped writable only in this process.
+ * Once that mapping exists, the memfd is sealed against any other writes or
+ * writable mappings, so even a client which reopens its file descriptor
+ * read-write can’t modify it.
+ *
+ * That needs `F_SEAL_FUTURE_WRITE`, from Linux 5.1. On older kernels, the
+ * memfd is sealed with `F_SEAL_WRITE` instead, which freezes it, and each
+ * update publishes a new memfd. A client’s existing mapping then doesn’t see
+ * later updates; clients can tell this is the case because `F_GET_SEALS`
+ * includes `F_SEAL_WRITE`, and should call `GetStateFd` again when the D-Bus
+ * properties change.
+ *
+ * Clients get a read-only file descriptor for it from
+ * epg_state_snapshot_dup_fd() (over D-Bus, from the `GetStateFd` method) and
+ * mmap() it. They can then read the current state at any time using
+ * epg_state_snapshot_read().
+ *
+ * Since: 0.2.5
+ */
+struct _EpgStateSnapshot
+{
+  GObject parent_instance;
+
+  int fd;  /* (owned) */
+  /* Mapped from @fd; or pointing to @frozen_data if @fd is sealed with
+   * F_SEAL_WRITE, in which case @fd is replaced on each update. */
+  EpgStateSnapshotData *data;  /* (owned) (nullable) */
+  EpgStateSnapshotData frozen_data;
+};
+
+G_DEFINE_TYPE (EpgStateSnapshot, epg_state_snapshot, G_TYPE_OBJECT)
+
+static void
+epg_state_snapshot_finalize (GObject *object)
+{
+  EpgStateSnapshot *self = EPG_STATE_SNAPSHOT (object);
+
+  if (self->data != NULL && self->data != &self->frozen_data)
+    munmap (self->data, sizeof (*self->data));
+  glnx_close_fd (&self->fd);
+
+  G_OBJECT_CLASS (epg_state_snapshot_parent_class)->finalize (object);
+}
+
+static void
+epg_state_snapshot_class_init (EpgStateSnapshotClass *klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+
+  object_class->finalize = epg_state_snapshot_finalize;
+}
+
+static void
+epg_state_snapshot_init (EpgStateSnapshot *self)
+{
+  self->fd = -1;
+}
+
+/* Create a new memfd containing a copy of @contents, sealed so that it can’t be
+ * modified at all. This is used when F_SEAL_FUTURE_WRITE is not supported. */
+static int
+create_frozen_memfd (const EpgStateSnapshotData  *contents,
+                     GError                     **error)
+{
+  glnx_autofd int fd = -1;
+
+  fd = memfd_create ("eos-payg-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    {
+      glnx_throw_errno_prefix (error, "memfd_create failed");
+      return -1;
+    }
+
+  if (glnx_loop_write (fd, contents, sizeof (*contents)) < 0)
+    {
+      glnx_throw_errno_prefix (error, "Failed to write memfd");
+      return -1;
+    }
+
+  if (fcntl (fd, F_ADD_SEALS,
+             F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    {
+      glnx_throw_errno_prefix (error, "Failed to seal memfd");
+      return -1;
+    }
+
+  return g_steal_fd (&fd);
+}
+
+/**
+ * epg_state_snapshot_new:
+ * @error: return location for a #GError
+ *
+ * Create a new, empty state snapshot. Its fields are all zero until
+ * epg_state_snapshot_update() is called.
+ *
+ * Returns: (transfer full): a new #EpgStateSnapshot, or %NULL on error
+ * Since: 0.2.5
+ */
+EpgStateSnapshot *
+epg_state_snapshot_new (GError **error)
+{
+  g_autoptr(EpgStateSnapshot) self = NULL;
+  glnx_autofd int fd = -1;
+  void *data;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  fd = memfd_create ("eos-payg-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    return glnx_null_throw_errno_prefix (error, "memfd_create failed");
+
+  if (ftruncate (fd, sizeof (EpgStateSnapshotData)) < 0)
+    return glnx_null_throw_errno_prefix (error, "ftruncate failed");
+
+  /* Clients must not be able to change the size of the memfd, or their
+   * mappings (and ours) could fault. */
+  if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0)
+    return glnx_null_throw_errno_prefix (error, "Failed to seal memfd");
+
+  data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    return glnx_null_throw_errno_prefix (error, "mmap failed");
+
+  self = g_object_new (EPG_TYPE_STATE_SNAPSHOT, NULL);
+  self->fd = g_steal_fd (&fd);
+  self->data = data;
+
+  self->data->magic = EPG_STATE_SNAPSHOT_MAGIC;
+  self->data->version = EPG_STATE_SNAPSHOT_VERSION;
+
+  /* Now that our writable mapping exists, stop anything else writing to the
+   * memfd. A client could otherwise reopen /proc/self/fd/N of its read-only
+   * descriptor read-write. F_SEAL_WRITE can’t be used, since it requires
+   * there to be no writable mappings, and ours is needed for updates;
+   * F_SEAL_FUTURE_WRITE allows existing mappings to carry on being used. */
+  if (use_future_write_seal)
+    {
+      if (fcntl (self->fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) == 0)
+        return g_steal_pointer (&self);
+      else if (errno != EINVAL)
+        return glnx_null_throw_errno_prefix (error, "Failed to seal memfd");
+
+      g_debug ("F_SEAL_FUTURE_WRITE not supported; falling back to F_SEAL_WRITE");
+      use_future_write_seal = FALSE;
+    }
+
+  /* The kernel is older than Linux 5.1, so fall back to F_SEAL_WRITE. That
+   * needs our writable mapping to go away, so keep a private copy of the
+   * data to update instead. */
+
+  self->frozen_data = *self->data;
+  munmap (self->data, sizeof (*self->data));
+  self->data = &self->frozen_data;
+
+  if (fcntl (self->fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    return glnx_null_throw_errno_prefix (error, "Failed to seal memfd");
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * epg_state_snapshot_update:
+ * @self: an #EpgStateSnapshot
+ * @enabled: whether the provider is enabled
+ * @expiry_time: the provider’s expiry time
+ * @rate_limit_end_time: the provider’s rate limit end time
+ *
+ * Publish new values for the provider state to all clients. This is cheap,
+ * and doesn’t wake up any clients, so it can be called whenever any of the
+ * values might have changed.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_state_snapshot_update (EpgStateSnapshot *self,
+                           gboolean          enabled,
+                           guint64           expiry_time,
+                           guint64           rate_limit_end_time)
+{
+  g_return_if_fail (EPG_IS_STATE_SNAPSHOT (self));
+
+  EpgStateSnapshotData *data = self->data;
+  guint32 sequence = data->sequence;  /* only ever written by us */
+
+  /* Mark the snapshot as being updated before touching any of the fields,
+   * then publish the new sequence number only after they’re all stored. */
+  __atomic_store_n (&data->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  __atomic_store_n (&data->enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+  __atomic_store_n (&data->expiry_time, expiry_time, __ATOMIC_RELAXED);
+  __atomic_store_n (&data->rate_limit_end_time, rate_limit_end_time, __ATOMIC_RELAXED);
+
+  __atomic_store_n (&data->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+  /* If the memfd is frozen, publish a new one with the new values. Existing
+   * clients keep the old one until they ask again. */
+  if (data == &self->frozen_data)
+    {
+      g_autoptr(GError) local_error = NULL;
+      glnx_autofd int fd = create_frozen_memfd (data, &local_error);
+
+      if (fd < 0)
+        {
+          g_warning ("Failed to update state snapshot: %s", local_error->message);
+          return;
+        }
+
+      glnx_close_fd (&self->fd);
+      self->fd = g_steal_fd (&fd);
+    }
+}
+
+/**
+ * epg_state_snapshot_dup_fd:
+ * @self: an #EpgStateSnapshot
+ * @error: return location for a #GError
+ *
+ * Get a new read-only file descriptor for the shared memory, suitable for
+ * passing to a client. It must be mapped with `PROT_READ` and `MAP_SHARED`;
+ * its size is at least `sizeof (EpgStateSnapshotData)`.
+ *
+ * Returns: (transfer full): a new file descriptor, or -1 on error
+ * Since: 0.2.5
+ */
+int
+epg_state_snapshot_dup_fd (EpgStateSnapshot  *self,
+                           GError           **error)
+{
+  g_autofree gchar *path = NULL;
+  int fd;
+
+  g_return_val_if_fail (EPG_IS_STATE_SNAPSHOT (self), -1);
+  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+
+  /* Reopening the memfd is the only way to get a read-only descriptor for it.
+   * dup() would share the access mode of our own descriptor. The seals added
+   * in epg_state_snapshot_new() stop the client getting write access by
+   * reopening it in turn. */
+  path = g_strdup_printf ("/proc/self/fd/%d", self->fd);
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    {
+      glnx_throw_errno_prefix (error, "Failed to reopen memfd read-only");
+      return -1;
+    }
+
+  return fd;
+}
+
+/**
+ * epg_state_snapshot_internal_set_use_future_write_seal:
+ * @use: %FALSE to behave as if the kernel doesn’t support
+ *    `F_SEAL_FUTURE_WRITE`
+ *
+ * Control whether snapshots created after this call try to use
+ * `F_SEAL_FUTURE_WRITE`. This is only intended for testing the fallback for
+ * older kernels; if the kernel doesn’t support the seal, snapshots fall back
+ * anyway.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_state_snapshot_internal_set_use_future_write_seal (gboolean use)
+{
+  use_future_write_seal = use;
+}
+
+/**
+ * epg_state_snapshot_read:
+ * @data: shared memory mapped from a file descriptor returned by
+ *    epg_state_snapshot_dup_fd()
+ * @out_data: (out caller-allocates): return location for a consistent copy of
+ *    @data
+ *
+ * Read a consistent copy of the state from the shared memory, retrying if it
+ * is being updated concurrently. This never blocks, and never makes any
+ * system calls.
+ *
+ * Returns: %TRUE on success; %FALSE if @data is not a state snapshot of a
+ *    version this code understands, or if it could not be read consistently
+ * Since: 0.2.5
+ */
+gboolean
+epg_state_snapshot_read (const EpgStateSnapshotData *data,
+                         EpgStateSnapshotData       *out_data)
+{
+  g_return_val_if_fail (data != NULL, FALSE);
+  g_return_val_if_fail (out_data != NULL, FALSE);
+
+  /* These never change after the snapshot is created. */
+  if (data->magic != EPG_STATE_SNAPSHOT_MAGIC ||
+      data->version < EPG_STATE_SNAPSHOT_VERSION)
+    return FALSE;
+
+  for (guint i = 0; i < READ_MAX_RETRIES; i++)
+    {
+      guint32 sequence = __atomic_load_n (&data->sequence, __ATOMIC_ACQUIRE);
+
+      if (sequence % 2 != 0)
+        continue;
+
+      out_data->enabled = __atomic_load_n (&data->enabled, __ATOMIC_RELAXED);
+      out_data->expiry_time = __atomic_load_n (&data->expiry_time, __ATOMIC_RELAXED);
+      out_data->rate_limit_end_time = __atomic_load_n (&data->rate_limit_end_time, __ATOMIC_RELAXED);
+
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n (&data->sequence, __ATOMIC_RELAXED) == sequence)
+        {
+          out_data->magic = EPG_STATE_SNAPSHOT_MAGIC;
+          out_data->version = EPG_STATE_SNAPSHOT_VERSION;
+          out_data->sequence = sequence;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
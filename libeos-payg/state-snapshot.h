@@ -0,0 +1,93 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EPG_STATE_SNAPSHOT_MAGIC:
+ *
+ * Value of #EpgStateSnapshotData.magic, which identifies a state snapshot.
+ * This is “PAYG” in ASCII, when read as little-endian.
+ *
+ * Since: 0.2.5
+ */
+#define EPG_STATE_SNAPSHOT_MAGIC 0x47594150
+
+/**
+ * EPG_STATE_SNAPSHOT_VERSION:
+ *
+ * Version of the #EpgStateSnapshotData layout. Fields are only ever appended,
+ * so readers should accept any version greater than or equal to the one they
+ * were written for.
+ *
+ * Since: 0.2.5
+ */
+#define EPG_STATE_SNAPSHOT_VERSION 1
+
+/**
+ * EpgStateSnapshotData:
+ * @magic: %EPG_STATE_SNAPSHOT_MAGIC
+ * @version: %EPG_STATE_SNAPSHOT_VERSION
+ * @sequence: sequence counter; odd while the other fields are being updated
+ * @enabled: whether the provider is enabled (1) or not (0)
+ * @expiry_time: as #EpgProvider:expiry-time
+ * @rate_limit_end_time: as #EpgProvider:rate-limit-end-time
+ *
+ * Layout of the shared memory returned by epg_state_snapshot_dup_fd(), in
+ * native byte order. The times are in the timescale of the provider’s
+ * #EpgClock, which is `CLOCK_BOOTTIME` for a real clock, exactly as for the
+ * corresponding `com.endlessm.Payg1` D-Bus properties.
+ *
+ * The fields are protected by @sequence, like a seqlock. Use
+ * epg_state_snapshot_read() to get a consistent copy of them.
+ *
+ * Since: 0.2.5
+ */
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 sequence;
+  guint32 enabled;
+  guint64 expiry_time;
+  guint64 rate_limit_end_time;
+} EpgStateSnapshotData;
+
+#define EPG_TYPE_STATE_SNAPSHOT epg_state_snapshot_get_type ()
+G_DECLARE_FINAL_TYPE (EpgStateSnapshot, epg_state_snapshot, EPG, STATE_SNAPSHOT, GObject)
+
+EpgStateSnapshot *epg_state_snapshot_new    (GError           **error);
+void              epg_state_snapshot_update (EpgStateSnapshot  *self,
+                                             gboolean           enabled,
+                                             guint64            expiry_time,
+                                             guint64            rate_limit_end_time);
+int               epg_state_snapshot_dup_fd (EpgStateSnapshot  *self,
+                                             GError           **error);
+
+gboolean epg_state_snapshot_read (const EpgStateSnapshotData *data,
+                                  EpgStateSnapshotData       *out_data);
+
+void epg_state_snapshot_internal_set_use_future_write_seal (gboolean use);
+
+G_END_DECLS
@@ -0,0 +1,427 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libeos-payg/errors.h>
+#include <libeos-payg/stats.h>
+
+/* Process-wide runtime statistics, for monitoring daemon health. These are
+ * updated from several modules (and, for EFI accesses, from several threads
+ * during startup), so everything is protected by a single lock. None of this
+ * is on a hot path. */
+
+/* Number of most recent state save durations kept for computing
+ * percentiles. */
+#define SAVE_LATENCY_WINDOW 256
+
+/* Names used for the rejection reasons in epg_stats_dup_codes_rejected(),
+ * matching the suffixes of the D-Bus error names. Errors outside the
+ * #EpgManagerError domain are counted as %REJECTED_OTHER_NAME. */
+static const gchar *rejected_names[] =
+  {
+    "InvalidCode",
+    "CodeAlreadyUsed",
+    "TooManyAttempts",
+    "Disabled",
+    "DisplayAccountID",
+  };
+G_STATIC_ASSERT (G_N_ELEMENTS (rejected_names) == EPG_MANAGER_N_ERRORS);
+
+#define REJECTED_OTHER_NAME "Other"
+
+typedef struct
+{
+  gchar *name;  /* (owned) */
+  gint64 duration_usec;
+} StartupPhase;
+
+G_LOCK_DEFINE_STATIC (stats);
+
+static struct
+{
+  guint64 counters[EPG_STATS_N_COUNTERS];
+  guint64 codes_rejected[EPG_MANAGER_N_ERRORS + 1];  /* last is ‘other’ */
+
+  gint64 save_latencies_usec[SAVE_LATENCY_WINDOW];
+  gsize n_save_latencies;  /* total recorded; index is modulo the window */
+
+  guint64 expiry_lateness_max_secs;
+
+  gint64 start_time;  /* monotonic; 0 if unset */
+  GArray *startup_phases;  /* (element-type StartupPhase) (owned) (nullable) */
+} stats;
+
+/**
+ * epg_stats_increment:
+ * @counter: counter to increment
+ *
+ * Increment @counter by one.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_increment (EpgStatsCounter counter)
+{
+  g_return_if_fail ((guint) counter < EPG_STATS_N_COUNTERS);
+
+  G_LOCK (stats);
+  stats.counters[counter]++;
+  G_UNLOCK (stats);
+}
+
+/**
+ * epg_stats_get:
+ * @counter: counter to get
+ *
+ * Get the current value of @counter.
+ *
+ * Returns: value of the counter
+ * Since: 0.2.5
+ */
+guint64
+epg_stats_get (EpgStatsCounter counter)
+{
+  guint64 value;
+
+  g_return_val_if_fail ((guint) counter < EPG_STATS_N_COUNTERS, 0);
+
+  G_LOCK (stats);
+  value = stats.counters[counter];
+  G_UNLOCK (stats);
+
+  return value;
+}
+
+/**
+ * epg_stats_record_code_rejected:
+ * @error: the error returned by epg_provider_add_code()
+ *
+ * Count a rejected code, by the reason given in @error.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_record_code_rejected (const GError *error)
+{
+  gsize index = EPG_MANAGER_N_ERRORS;
+
+  g_return_if_fail (error != NULL);
+
+  if (error->domain == EPG_MANAGER_ERROR &&
+      error->code >= 0 && error->code < EPG_MANAGER_N_ERRORS)
+    index = (gsize) error->code;
+
+  G_LOCK (stats);
+  stats.codes_rejected[index]++;
+  G_UNLOCK (stats);
+}
+
+/**
+ * epg_stats_dup_codes_rejected:
+ *
+ * Get the number of rejected codes by reason, as an `a{st}` dictionary keyed
+ * by the #EpgManagerError D-Bus error name suffix (such as `InvalidCode`), or
+ * `Other`. Reasons which have not occurred are omitted.
+ *
+ * Returns: (transfer full): a new floating `a{st}` #GVariant
+ * Since: 0.2.5
+ */
+GVariant *
+epg_stats_dup_codes_rejected (void)
+{
+  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a{st}"));
+
+  G_LOCK (stats);
+  for (gsize i = 0; i < G_N_ELEMENTS (stats.codes_rejected); i++)
+    {
+      if (stats.codes_rejected[i] == 0)
+        continue;
+
+      g_variant_builder_add (&builder, "{st}",
+                             (i < EPG_MANAGER_N_ERRORS) ? rejected_names[i] : REJECTED_OTHER_NAME,
+                             stats.codes_rejected[i]);
+    }
+  G_UNLOCK (stats);
+
+  return g_variant_builder_end (&builder);
+}
+
+/**
+ * epg_stats_get_codes_rejected:
+ * @manager_error_code: an #EpgManagerError, or -1 for errors from other
+ *    domains
+ *
+ * Get the number of codes rejected with the given reason.
+ *
+ * Returns: number of rejected codes
+ * Since: 0.2.5
+ */
+guint64
+epg_stats_get_codes_rejected (gint manager_error_code)
+{
+  gsize index = EPG_MANAGER_N_ERRORS;
+  guint64 value;
+
+  g_return_val_if_fail (manager_error_code >= -1 &&
+                        manager_error_code < EPG_MANAGER_N_ERRORS, 0);
+
+  if (manager_error_code >= 0)
+    index = (gsize) manager_error_code;
+
+  G_LOCK (stats);
+  value = stats.codes_rejected[index];
+  G_UNLOCK (stats);
+
+  return value;
+}
+
+/**
+ * epg_stats_record_save_latency:
+ * @duration_usec: time taken to save the provider state, in microseconds
+ *
+ * Record how long a state save took. Only the most recent few hundred are
+ * kept for epg_stats_get_save_latency_percentile().
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_record_save_latency (gint64 duration_usec)
+{
+  G_LOCK (stats);
+  stats.save_latencies_usec[stats.n_save_latencies % SAVE_LATENCY_WINDOW] = MAX (duration_usec, 0);
+  stats.n_save_latencies++;
+  G_UNLOCK (stats);
+}
+
+static gint
+compare_gint64 (gconstpointer a,
+                gconstpointer b)
+{
+  gint64 a_value = *((const gint64 *) a);
+  gint64 b_value = *((const gint64 *) b);
+
+  return (a_value > b_value) - (a_value < b_value);
+}
+
+/**
+ * epg_stats_get_save_latency_percentile:
+ * @percentile: percentile to return, from 0 to 100 inclusive
+ *
+ * Get the given percentile of the recent state save durations recorded with
+ * epg_stats_record_save_latency(), using the nearest-rank method.
+ *
+ * Returns: duration in microseconds, or 0 if none have been recorded
+ * Since: 0.2.5
+ */
+gint64
+epg_stats_get_save_latency_percentile (guint percentile)
+{
+  gint64 sorted[SAVE_LATENCY_WINDOW];
+  gsize n;
+
+  g_return_val_if_fail (percentile <= 100, 0);
+
+  G_LOCK (stats);
+  n = MIN (stats.n_save_latencies, SAVE_LATENCY_WINDOW);
+  memcpy (sorted, stats.save_latencies_usec, n * sizeof (*sorted));
+  G_UNLOCK (stats);
+
+  if (n == 0)
+    return 0;
+
+  qsort (sorted, n, sizeof (*sorted), compare_gint64);
+
+  /* Nearest rank: the smallest value such that at least @percentile % of the
+   * values are less than or equal to it. */
+  gsize rank = (percentile * n + 99) / 100;
+  return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+/**
+ * epg_stats_record_expiry_lateness:
+ * @lateness_secs: how long after the expiry time the expiry timer fired
+ *
+ * Record the lateness of the expiry timer, keeping the maximum.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_record_expiry_lateness (guint64 lateness_secs)
+{
+  G_LOCK (stats);
+  stats.expiry_lateness_max_secs = MAX (stats.expiry_lateness_max_secs, lateness_secs);
+  G_UNLOCK (stats);
+}
+
+/**
+ * epg_stats_get_expiry_lateness_max:
+ *
+ * Get the largest value passed to epg_stats_record_expiry_lateness().
+ *
+ * Returns: maximum lateness of the expiry timer, in seconds
+ * Since: 0.2.5
+ */
+guint64
+epg_stats_get_expiry_lateness_max (void)
+{
+  guint64 value;
+
+  G_LOCK (stats);
+  value = stats.expiry_lateness_max_secs;
+  G_UNLOCK (stats);
+
+  return value;
+}
+
+/**
+ * epg_stats_set_start_time:
+ * @monotonic_time: g_get_monotonic_time() when the process started
+ *
+ * Set the start time used to calculate epg_stats_get_uptime().
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_set_start_time (gint64 monotonic_time)
+{
+  G_LOCK (stats);
+  stats.start_time = monotonic_time;
+  G_UNLOCK (stats);
+}
+
+/**
+ * epg_stats_get_uptime:
+ *
+ * Get how long the process has been running, or 0 if
+ * epg_stats_set_start_time() has not been called.
+ *
+ * Returns: uptime in seconds
+ * Since: 0.2.5
+ */
+guint64
+epg_stats_get_uptime (void)
+{
+  gint64 start_time;
+
+  G_LOCK (stats);
+  start_time = stats.start_time;
+  G_UNLOCK (stats);
+
+  if (start_time == 0)
+    return 0;
+
+  return (guint64) MAX (g_get_monotonic_time () - start_time, 0) / G_USEC_PER_SEC;
+}
+
+static void
+startup_phase_clear (StartupPhase *phase)
+{
+  g_free (phase->name);
+}
+
+/**
+ * epg_stats_set_startup_phase:
+ * @name: name of the startup phase
+ * @duration_usec: how long the phase took, in microseconds
+ *
+ * Record the duration of a startup phase. Phases are listed in the order
+ * they were first set.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_set_startup_phase (const gchar *name,
+                             gint64       duration_usec)
+{
+  g_return_if_fail (name != NULL);
+
+  G_LOCK (stats);
+
+  if (stats.startup_phases == NULL)
+    {
+      stats.startup_phases = g_array_new (FALSE, FALSE, sizeof (StartupPhase));
+      g_array_set_clear_func (stats.startup_phases, (GDestroyNotify) startup_phase_clear);
+    }
+
+  gsize i;
+  for (i = 0; i < stats.startup_phases->len; i++)
+    {
+      StartupPhase *phase = &g_array_index (stats.startup_phases, StartupPhase, i);
+
+      if (g_str_equal (phase->name, name))
+        {
+          phase->duration_usec = duration_usec;
+          break;
+        }
+    }
+
+  if (i == stats.startup_phases->len)
+    {
+      StartupPhase phase = { g_strdup (name), duration_usec };
+      g_array_append_val (stats.startup_phases, phase);
+    }
+
+  G_UNLOCK (stats);
+}
+
+/**
+ * epg_stats_dup_startup_phases:
+ *
+ * Get the startup phase durations set with epg_stats_set_startup_phase(), as
+ * an `a(sx)` array of names and durations in microseconds.
+ *
+ * Returns: (transfer full): a new floating `a(sx)` #GVariant
+ * Since: 0.2.5
+ */
+GVariant *
+epg_stats_dup_startup_phases (void)
+{
+  g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(sx)"));
+
+  G_LOCK (stats);
+  for (gsize i = 0; stats.startup_phases != NULL && i < stats.startup_phases->len; i++)
+    {
+      const StartupPhase *phase = &g_array_index (stats.startup_phases, StartupPhase, i);
+      g_variant_builder_add (&builder, "(sx)", phase->name, phase->duration_usec);
+    }
+  G_UNLOCK (stats);
+
+  return g_variant_builder_end (&builder);
+}
+
+/**
+ * epg_stats_reset:
+ *
+ * Reset all statistics to their initial values. This is intended for use in
+ * tests.
+ *
+ * Since: 0.2.5
+ */
+void
+epg_stats_reset (void)
+{
+  G_LOCK (stats);
+  g_clear_pointer (&stats.startup_phases, g_array_unref);
+  memset (&stats, 0, sizeof (stats));
+  G_UNLOCK (stats);
+}
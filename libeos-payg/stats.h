@@ -0,0 +1,76 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EpgStatsCounter:
+ * @EPG_STATS_CODES_ATTEMPTED: Codes passed to epg_provider_add_code().
+ * @EPG_STATS_CODES_ACCEPTED: Codes which added credit.
+ * @EPG_STATS_STATE_SAVES: Calls to save the provider state.
+ * @EPG_STATS_STATE_SAVES_COALESCED: State saves which were skipped because
+ *    the stored state was already up to date.
+ * @EPG_STATS_EFI_READS: EFI variables read.
+ * @EPG_STATS_EFI_WRITES: EFI variables written.
+ * @EPG_STATS_CLOCK_JUMPS: Changes to the wall clock time which were detected.
+ *
+ * Counters which are kept for the whole process, and exported by
+ * #EpgManagerService on the `com.endlessm.Payg1.Statistics` interface.
+ *
+ * Since: 0.2.5
+ */
+typedef enum
+{
+  EPG_STATS_CODES_ATTEMPTED = 0,
+  EPG_STATS_CODES_ACCEPTED,
+  EPG_STATS_STATE_SAVES,
+  EPG_STATS_STATE_SAVES_COALESCED,
+  EPG_STATS_EFI_READS,
+  EPG_STATS_EFI_WRITES,
+  EPG_STATS_CLOCK_JUMPS,
+} EpgStatsCounter;
+#define EPG_STATS_N_COUNTERS (EPG_STATS_CLOCK_JUMPS + 1)
+
+void    epg_stats_increment (EpgStatsCounter counter);
+guint64 epg_stats_get       (EpgStatsCounter counter);
+
+void      epg_stats_record_code_rejected (const GError *error);
+GVariant *epg_stats_dup_codes_rejected   (void);
+guint64   epg_stats_get_codes_rejected   (gint          manager_error_code);
+
+void   epg_stats_record_save_latency         (gint64 duration_usec);
+gint64 epg_stats_get_save_latency_percentile (guint  percentile);
+
+void    epg_stats_record_expiry_lateness  (guint64 lateness_secs);
+guint64 epg_stats_get_expiry_lateness_max (void);
+
+void    epg_stats_set_start_time (gint64 monotonic_time);
+guint64 epg_stats_get_uptime     (void);
+
+void      epg_stats_set_startup_phase  (const gchar *name,
+                                        gint64       duration_usec);
+GVariant *epg_stats_dup_startup_phases (void);
+
+void epg_stats_reset (void);
+
+G_END_DECLS
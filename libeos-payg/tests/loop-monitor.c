@@ -0,0 +1,273 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <libeos-payg/loop-monitor.h>
+#include <locale.h>
+
+/* Dispatches longer than this are warned about. It is long enough that the
+ * quick sources in these tests never reach it, even on a loaded machine. */
+#define THRESHOLD_MS 100
+
+/* epg_loop_monitor_enable() can only be called once per process, so every
+ * test after the first shares the same monitor. */
+static void
+ensure_enabled (void)
+{
+  if (!epg_loop_monitor_is_enabled ())
+    epg_loop_monitor_enable (NULL, THRESHOLD_MS);
+}
+
+static void
+capture_message_cb (const gchar    *log_domain,
+                    GLogLevelFlags  log_level,
+                    const gchar    *message,
+                    gpointer        user_data)
+{
+  GPtrArray *messages = user_data;
+
+  g_ptr_array_add (messages, g_strdup (message));
+}
+
+/* Call epg_loop_monitor_log_histograms() and return the lines it logged, in
+ * no particular order. */
+static GPtrArray *
+log_histograms (void)
+{
+  g_autoptr(GPtrArray) messages = g_ptr_array_new_with_free_func (g_free);
+  guint handler_id = g_log_set_handler (NULL, G_LOG_LEVEL_MESSAGE,
+                                        capture_message_cb, messages);
+
+  epg_loop_monitor_log_histograms ();
+  g_log_remove_handler (NULL, handler_id);
+
+  return g_steal_pointer (&messages);
+}
+
+/* Find the histogram line for @name in @messages, or return %NULL. */
+static const gchar *
+find_histogram (GPtrArray   *messages,
+                const gchar *name)
+{
+  g_autofree gchar *prefix = g_strdup_printf ("Dispatch latency for ‘%s’: ", name);
+
+  for (guint i = 0; i < messages->len; i++)
+    {
+      const gchar *message = g_ptr_array_index (messages, i);
+
+      if (g_str_has_prefix (message, prefix))
+        return message;
+    }
+
+  return NULL;
+}
+
+/* Record a dispatch of @name which started @duration_usec ago. */
+static void
+record_dispatch (const gchar *name,
+                 gint64       duration_usec)
+{
+  epg_loop_monitor_dispatch_end (name, g_get_monotonic_time () - duration_usec);
+}
+
+typedef struct
+{
+  const gchar *name;  /* (nullable) */
+  gulong sleep_usec;
+} SleepData;
+
+/* Block the main loop for a while. If it has a name, the sleep is bracketed
+ * with epg_loop_monitor_dispatch_begin() and epg_loop_monitor_dispatch_end(),
+ * as the #GSourceFuncs in libeos-payg do; otherwise it is like a source
+ * created by GLib. */
+static gboolean
+sleep_cb (gpointer user_data)
+{
+  const SleepData *data = user_data;
+  gint64 monitor_start = 0;
+
+  if (data->name != NULL)
+    monitor_start = epg_loop_monitor_dispatch_begin ();
+
+  g_usleep (data->sleep_usec);
+
+  if (data->name != NULL)
+    epg_loop_monitor_dispatch_end (data->name, monitor_start);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Iterate until nothing is left to dispatch. The last iteration polls after
+ * the others, which is when the poll function warns about them. */
+static void
+iterate_until_idle (void)
+{
+  while (g_main_context_iteration (NULL, FALSE));
+}
+
+/* Test that nothing is recorded or logged before the monitor is enabled. */
+static void
+test_loop_monitor_disabled (void)
+{
+  g_autoptr(GPtrArray) messages = NULL;
+
+  if (epg_loop_monitor_is_enabled ())
+    {
+      g_test_skip ("Another test has already enabled the monitor");
+      return;
+    }
+
+  g_assert_cmpint (epg_loop_monitor_dispatch_begin (), ==, 0);
+
+  /* Would warn if the monitor were enabled. */
+  record_dispatch ("disabled", (THRESHOLD_MS + 1) * 1000);
+
+  messages = log_histograms ();
+  g_assert_cmpuint (messages->len, ==, 0);
+}
+
+/* Test that dispatches are counted in power-of-two buckets, with the last
+ * bucket counting everything longer, and that the histogram is logged with
+ * the upper bound of each non-empty bucket. */
+static void
+test_loop_monitor_histogram (void)
+{
+  g_autoptr(GPtrArray) messages = NULL;
+  const gchar *histogram;
+
+  ensure_enabled ();
+
+  /* These are in the middle of their buckets, so a few microseconds of
+   * overhead don’t move them: 80µs is in [64, 128) and 3000µs in
+   * [2048, 4096). */
+  record_dispatch ("histogram", 80);
+  record_dispatch ("histogram", 3000);
+
+  /* Longer than the bound of the second-last bucket, 2^30µs. */
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Dispatching ‘histogram’ took * ms, blocking the main loop");
+  record_dispatch ("histogram", (gint64) 1 << 31);
+  g_test_assert_expected_messages ();
+
+  messages = log_histograms ();
+  histogram = find_histogram (messages, "histogram");
+  g_assert_nonnull (histogram);
+  g_assert_true (g_str_has_prefix (histogram,
+                                   "Dispatch latency for ‘histogram’: n=3, max=21474836"));
+  g_assert_true (g_str_has_suffix (histogram,
+                                   "; <128µs:1 <4096µs:1 >1073741824µs:1"));
+
+  /* Another dispatch in the same bucket is added to its count. */
+  record_dispatch ("histogram", 90);
+  g_clear_pointer (&messages, g_ptr_array_unref);
+  messages = log_histograms ();
+  histogram = find_histogram (messages, "histogram");
+  g_assert_nonnull (histogram);
+  g_assert_true (g_str_has_prefix (histogram,
+                                   "Dispatch latency for ‘histogram’: n=4, "));
+  g_assert_true (g_str_has_suffix (histogram,
+                                   "; <128µs:2 <4096µs:1 >1073741824µs:1"));
+}
+
+/* Test that a named source which blocks the main loop for longer than the
+ * threshold is warned about by name, and that the poll function does not warn
+ * again about the iteration it was dispatched in. */
+static void
+test_loop_monitor_stall_named (void)
+{
+  const SleepData slow = { "slow", 2 * THRESHOLD_MS * 1000 };
+  g_autoptr(GPtrArray) messages = NULL;
+
+  ensure_enabled ();
+  iterate_until_idle ();
+
+  g_idle_add (sleep_cb, (gpointer) &slow);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Dispatching ‘slow’ took * ms, blocking the main loop");
+  iterate_until_idle ();
+  g_test_assert_expected_messages ();
+
+  messages = log_histograms ();
+  g_assert_nonnull (find_histogram (messages, "slow"));
+  g_assert_nonnull (find_histogram (messages, "main loop iteration"));
+}
+
+/* Test that when an iteration stalls in a source which isn’t named, the poll
+ * function warns about it, naming the slowest of the named sources dispatched
+ * in the same iteration. */
+static void
+test_loop_monitor_stall_slowest_named (void)
+{
+  const SleepData quick = { "quick", 0 };
+  const SleepData medium = { "medium", 10 * 1000 };
+  const SleepData unnamed = { NULL, 2 * THRESHOLD_MS * 1000 };
+
+  ensure_enabled ();
+  iterate_until_idle ();
+
+  /* Idles of the same priority are all dispatched in one iteration. */
+  g_idle_add (sleep_cb, (gpointer) &quick);
+  g_idle_add (sleep_cb, (gpointer) &medium);
+  g_idle_add (sleep_cb, (gpointer) &unnamed);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Main loop stalled for * ms; slowest named source "
+                         "was ‘medium’ (* ms)");
+  iterate_until_idle ();
+  g_test_assert_expected_messages ();
+}
+
+/* Test that when an iteration stalls with no named sources dispatched, the
+ * poll function blames an unnamed source. */
+static void
+test_loop_monitor_stall_unnamed (void)
+{
+  const SleepData unnamed = { NULL, 2 * THRESHOLD_MS * 1000 };
+
+  ensure_enabled ();
+  iterate_until_idle ();
+
+  g_idle_add (sleep_cb, (gpointer) &unnamed);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Main loop stalled for * ms in an unnamed source");
+  iterate_until_idle ();
+  g_test_assert_expected_messages ();
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  /* This must be first, before the monitor is enabled. */
+  g_test_add_func ("/loop-monitor/disabled", test_loop_monitor_disabled);
+  g_test_add_func ("/loop-monitor/histogram", test_loop_monitor_histogram);
+  g_test_add_func ("/loop-monitor/stall/named", test_loop_monitor_stall_named);
+  g_test_add_func ("/loop-monitor/stall/slowest-named",
+                   test_loop_monitor_stall_slowest_named);
+  g_test_add_func ("/loop-monitor/stall/unnamed", test_loop_monitor_stall_unnamed);
+
+  return g_test_run ();
+}
@@ -0,0 +1,563 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <libeos-payg/efi.h>
+#include <libeos-payg/errors.h>
+#include <libeos-payg/fake-clock.h>
+#include <libeos-payg/manager.h>
+#include <libeos-payg/manager-service.h>
+#include <libeos-payg/rate-limiting.h>
+#include <libeos-payg-codes/codes.h>
+#include <locale.h>
+
+#define OBJECT_PATH "/com/endlessm/Payg1"
+
+static const char KEY[] = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+static const char ACCOUNT_ID[] = "BEBACAFE";
+
+/* An #EpgManager with a fake clock, exported by an #EpgManagerService on a
+ * private bus, and a second connection which records the signals emitted. */
+typedef struct
+{
+  gchar *tmp_path;  /* (owned) */
+  GFile *tmp_dir;  /* (owned) */
+  GBytes *key;  /* (owned) */
+  EpcCounter next_counter;
+
+  EpgFakeClock *clock;  /* (owned) */
+  EpgProvider *provider;  /* (owned) */
+
+  GTestDBus *bus;  /* (owned) */
+  GDBusConnection *service_connection;  /* (owned) */
+  GDBusConnection *client_connection;  /* (owned) */
+  EpgManagerService *service;  /* (owned) */
+  guint subscription_id;
+
+  /* Signals received by @client_connection, in order. */
+  GPtrArray *signal_names;  /* (owned) (element-type utf8) */
+  GPtrArray *signal_parameters;  /* (owned) (element-type GVariant) */
+} Fixture;
+
+static void
+async_cb (GObject      *source,
+          GAsyncResult *result,
+          gpointer      data)
+{
+  GAsyncResult **result_out = data;
+
+  g_assert_null (*result_out);
+  *result_out = g_object_ref (result);
+}
+
+static void
+signal_cb (GDBusConnection *connection,
+           const gchar     *sender_name,
+           const gchar     *object_path,
+           const gchar     *interface_name,
+           const gchar     *signal_name,
+           GVariant        *parameters,
+           gpointer         user_data)
+{
+  Fixture *fixture = user_data;
+
+  g_ptr_array_add (fixture->signal_names, g_strdup (signal_name));
+  g_ptr_array_add (fixture->signal_parameters, g_variant_ref (parameters));
+}
+
+static GDBusConnection *
+connect_to_bus (Fixture *fixture)
+{
+  g_autoptr(GError) error = NULL;
+  GDBusConnection *connection;
+
+  connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (fixture->bus),
+                                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                       G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                       NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  return connection;
+}
+
+/* Add a new valid code for @period to the manager. */
+static void
+add_code (Fixture   *fixture,
+          EpcPeriod  period)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *code_str = NULL;
+  EpcCode code;
+  gint64 time_added = 0;
+
+  code = epc_calculate_code (period, fixture->next_counter++, fixture->key, &error);
+  g_assert_no_error (error);
+  code_str = epc_format_code (code);
+
+  epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (time_added, >, 0);
+}
+
+/* Try to add a code which is not valid, and check it fails with
+ * @expected_error. */
+static void
+add_invalid_code (Fixture         *fixture,
+                  EpgManagerError  expected_error)
+{
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+
+  g_assert_false (epg_provider_add_code (fixture->provider, "00000000", &time_added, &error));
+  g_assert_error (error, EPG_MANAGER_ERROR, (gint) expected_error);
+}
+
+/* Calculate a new valid code for @period, without adding it. */
+static gchar *
+next_code (Fixture   *fixture,
+           EpcPeriod  period)
+{
+  g_autoptr(GError) error = NULL;
+  EpcCode code;
+
+  code = epc_calculate_code (period, fixture->next_counter++, fixture->key, &error);
+  g_assert_no_error (error);
+
+  return epc_format_code (code);
+}
+
+/* Call AddCodes on the service with @codes from the client connection, and
+ * return the results, or %NULL and set @error. */
+static GVariant *
+call_add_codes (Fixture             *fixture,
+                const gchar * const *codes,
+                GError             **error)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+
+  g_dbus_connection_call (fixture->client_connection,
+                          g_dbus_connection_get_unique_name (fixture->service_connection),
+                          OBJECT_PATH,
+                          "com.endlessm.Payg1",
+                          "AddCodes",
+                          g_variant_new ("(^as)", codes),
+                          G_VARIANT_TYPE ("(a(xs))"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          async_cb,
+                          &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  return g_dbus_connection_call_finish (fixture->client_connection, result, error);
+}
+
+/* Dispatch everything which is ready on the main context, including idle
+ * callbacks and any sources on the fake clock whose time has come; then wait
+ * until the client has received every signal the service has emitted so far.
+ * Messages from one connection are delivered in order, so a round trip to the
+ * service connection is enough for the latter. */
+static void
+sync_with_service (Fixture *fixture)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GError) error = NULL;
+
+  while (g_main_context_iteration (NULL, FALSE));
+
+  g_dbus_connection_call (fixture->client_connection,
+                          g_dbus_connection_get_unique_name (fixture->service_connection),
+                          "/",
+                          "org.freedesktop.DBus.Peer",
+                          "Ping",
+                          NULL,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          async_cb,
+                          &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  reply = g_dbus_connection_call_finish (fixture->client_connection, result, &error);
+  g_assert_no_error (error);
+}
+
+/* Count the signals called @signal_name received so far. */
+static guint
+count_signals (Fixture     *fixture,
+               const gchar *signal_name)
+{
+  guint n = 0;
+
+  for (guint i = 0; i < fixture->signal_names->len; i++)
+    {
+      if (g_str_equal (fixture->signal_names->pdata[i], signal_name))
+        n++;
+    }
+
+  return n;
+}
+
+/* Return the parameters of the last signal called @signal_name received, or
+ * %NULL if there have been none. */
+static GVariant *
+get_last_signal (Fixture     *fixture,
+                 const gchar *signal_name)
+{
+  for (guint i = fixture->signal_names->len; i > 0; i--)
+    {
+      if (g_str_equal (fixture->signal_names->pdata[i - 1], signal_name))
+        return fixture->signal_parameters->pdata[i - 1];
+    }
+
+  return NULL;
+}
+
+static void
+setup (Fixture       *fixture,
+       gconstpointer  data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GFile) key_file = NULL;
+  g_autoptr(GFile) account_id_file = NULL;
+  g_autofree gchar *key_path = NULL;
+  g_autofree gchar *account_id_path = NULL;
+
+  fixture->tmp_path = g_dir_make_tmp ("libeos-payg-tests-manager-service-XXXXXX", &error);
+  g_assert_no_error (error);
+  fixture->tmp_dir = g_file_new_for_path (fixture->tmp_path);
+
+  fixture->key = g_bytes_new_static (KEY, sizeof (KEY) - 1);
+  fixture->next_counter = EPC_MINCOUNTER;
+
+  key_path = g_build_filename (fixture->tmp_path, "key", NULL);
+  g_file_set_contents (key_path, KEY, -1, &error);
+  g_assert_no_error (error);
+  key_file = g_file_new_for_path (key_path);
+
+  account_id_path = g_build_filename (fixture->tmp_path, "account-id", NULL);
+  g_file_set_contents (account_id_path, ACCOUNT_ID, -1, &error);
+  g_assert_no_error (error);
+  account_id_file = g_file_new_for_path (account_id_path);
+
+  fixture->clock = epg_fake_clock_new (-1, -1);
+  epg_manager_new (TRUE, key_file, account_id_file, fixture->tmp_dir,
+                   NULL, NULL, EPG_CLOCK (fixture->clock),
+                   NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  fixture->provider = epg_manager_new_finish (result, &error);
+  g_assert_no_error (error);
+
+  /* Start with some credit, so the service doesn’t start counting down to a
+   * shutdown. */
+  add_code (fixture, EPC_PERIOD_8_HOURS);
+
+  fixture->bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (fixture->bus);
+
+  fixture->service_connection = connect_to_bus (fixture);
+  fixture->client_connection = connect_to_bus (fixture);
+
+  fixture->signal_names = g_ptr_array_new_with_free_func (g_free);
+  fixture->signal_parameters = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+  fixture->subscription_id =
+      g_dbus_connection_signal_subscribe (fixture->client_connection,
+                                          NULL, NULL, NULL, OBJECT_PATH, NULL,
+                                          G_DBUS_SIGNAL_FLAGS_NONE,
+                                          signal_cb, fixture, NULL);
+
+  fixture->service = epg_manager_service_new (fixture->service_connection,
+                                              OBJECT_PATH, fixture->provider);
+  epg_manager_service_register (fixture->service, &error);
+  g_assert_no_error (error);
+
+  /* Make sure the client’s match rule is in place. */
+  sync_with_service (fixture);
+  g_assert_cmpuint (fixture->signal_names->len, ==, 0);
+}
+
+static void
+teardown (Fixture       *fixture,
+          gconstpointer  data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GDir) dir = NULL;
+  const gchar *name;
+
+  epg_manager_service_unregister (fixture->service);
+  g_clear_object (&fixture->service);
+
+  g_dbus_connection_signal_unsubscribe (fixture->client_connection,
+                                        fixture->subscription_id);
+  g_clear_pointer (&fixture->signal_names, g_ptr_array_unref);
+  g_clear_pointer (&fixture->signal_parameters, g_ptr_array_unref);
+
+  g_dbus_connection_close_sync (fixture->client_connection, NULL, NULL);
+  g_clear_object (&fixture->client_connection);
+  g_dbus_connection_close_sync (fixture->service_connection, NULL, NULL);
+  g_clear_object (&fixture->service_connection);
+  g_test_dbus_down (fixture->bus);
+  g_clear_object (&fixture->bus);
+
+  epg_provider_shutdown_async (fixture->provider, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  epg_provider_shutdown_finish (fixture->provider, result, &error);
+  g_assert_no_error (error);
+  g_clear_object (&fixture->provider);
+  g_clear_object (&fixture->clock);
+
+  dir = g_dir_open (fixture->tmp_path, 0, &error);
+  g_assert_no_error (error);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      g_autofree gchar *path = g_build_filename (fixture->tmp_path, name, NULL);
+      g_assert_no_errno (g_unlink (path));
+    }
+
+  g_assert_no_errno (g_rmdir (fixture->tmp_path));
+  g_clear_pointer (&fixture->tmp_path, g_free);
+  g_clear_object (&fixture->tmp_dir);
+  g_clear_pointer (&fixture->key, g_bytes_unref);
+}
+
+/* Test that several properties changing in the same main loop iteration, as
+ * happens when codes are added, wake up clients with a single
+ * PropertiesChanged signal carrying all of them. */
+static void
+test_manager_service_properties_changed (Fixture       *fixture,
+                                         gconstpointer  data)
+{
+  GVariant *parameters;
+  const gchar *interface_name;
+  g_autoptr(GVariant) changed = NULL;
+  g_autoptr(GVariant) invalidated = NULL;
+  guint64 expiry_time, rate_limit_end_time;
+
+  /* Each code notifies :expiry-time and :rate-limit-end-time. */
+  add_code (fixture, EPC_PERIOD_1_DAY);
+  add_code (fixture, EPC_PERIOD_1_HOUR);
+
+  sync_with_service (fixture);
+
+  g_assert_cmpuint (count_signals (fixture, "PropertiesChanged"), ==, 1);
+  g_assert_cmpuint (fixture->signal_names->len, ==, 1);
+
+  parameters = get_last_signal (fixture, "PropertiesChanged");
+  g_assert_nonnull (parameters);
+  g_variant_get (parameters, "(&s@a{sv}@as)", &interface_name, &changed, &invalidated);
+
+  g_assert_cmpstr (interface_name, ==, "com.endlessm.Payg1");
+  g_assert_cmpuint (g_variant_n_children (changed), ==, 2);
+  g_assert_cmpuint (g_variant_n_children (invalidated), ==, 0);
+
+  g_assert_true (g_variant_lookup (changed, "ExpiryTime", "t", &expiry_time));
+  g_assert_cmpuint (expiry_time, ==, epg_provider_get_expiry_time (fixture->provider));
+  g_assert_true (g_variant_lookup (changed, "RateLimitEndTime", "t", &rate_limit_end_time));
+  g_assert_cmpuint (rate_limit_end_time, ==, 0);
+
+  /* Nothing more is emitted once the changes have been signalled. */
+  sync_with_service (fixture);
+  g_assert_cmpuint (fixture->signal_names->len, ==, 1);
+}
+
+/* Test that CreditLow is emitted once as each threshold of remaining credit is
+ * reached, as the fake clock advances, and that rescheduling the timer when the
+ * expiry time is notified doesn’t signal a threshold again. */
+static void
+test_manager_service_credit_low (Fixture       *fixture,
+                                 gconstpointer  data)
+{
+  guint64 expiry_time = epg_provider_get_expiry_time (fixture->provider);
+  guint64 threshold;
+
+  /* The 8 hour code from setup() is below the 24 hour threshold already, so
+   * the first to be signalled is 1 hour. */
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 60 * 60 - 1);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 0);
+
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 60 * 60);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 1);
+  g_variant_get (get_last_signal (fixture, "CreditLow"), "(t)", &threshold);
+  g_assert_cmpuint (threshold, ==, 60 * 60);
+
+  /* Notifying the expiry time reschedules the timer, which must not signal
+   * the 1 hour threshold again. */
+  g_object_notify (G_OBJECT (fixture->provider), "expiry-time");
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 30 * 60);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 1);
+
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 5 * 60 - 1);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 1);
+
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 5 * 60);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 2);
+  g_variant_get (get_last_signal (fixture, "CreditLow"), "(t)", &threshold);
+  g_assert_cmpuint (threshold, ==, 5 * 60);
+
+  /* There are no lower thresholds; running out is signalled by Expired. */
+  g_object_notify (G_OBJECT (fixture->provider), "expiry-time");
+  epg_fake_clock_set_time (fixture->clock, expiry_time - 1);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "CreditLow"), ==, 2);
+}
+
+/* Test that RateLimitEnded is emitted once when the rate limiting period ends,
+ * as the fake clock advances, even if the timer was rescheduled in the
+ * meantime, and not again when it is rescheduled afterwards. */
+static void
+test_manager_service_rate_limit_ended (Fixture       *fixture,
+                                       gconstpointer  data)
+{
+  guint64 now = epg_clock_get_time (EPG_CLOCK (fixture->clock));
+  guint64 rate_limit_end_time;
+
+  for (gsize i = 0; i < EPG_RATE_LIMITING_N_ATTEMPTS; i++)
+    add_invalid_code (fixture, EPG_MANAGER_ERROR_INVALID_CODE);
+  add_invalid_code (fixture, EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS);
+
+  rate_limit_end_time = epg_provider_get_rate_limit_end_time (fixture->provider);
+  g_assert_cmpuint (rate_limit_end_time, >, now);
+
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "RateLimitEnded"), ==, 0);
+
+  /* A further attempt while rate limited reschedules the timer. */
+  add_invalid_code (fixture, EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS);
+  g_assert_cmpuint (epg_provider_get_rate_limit_end_time (fixture->provider), ==, rate_limit_end_time);
+
+  epg_fake_clock_set_time (fixture->clock, rate_limit_end_time - 1);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "RateLimitEnded"), ==, 0);
+
+  epg_fake_clock_set_time (fixture->clock, rate_limit_end_time);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "RateLimitEnded"), ==, 1);
+
+  /* The end time is now in the past, so rescheduling does nothing. */
+  g_object_notify (G_OBJECT (fixture->provider), "rate-limit-end-time");
+  epg_fake_clock_set_time (fixture->clock, rate_limit_end_time + 60);
+  sync_with_service (fixture);
+  g_assert_cmpuint (count_signals (fixture, "RateLimitEnded"), ==, 1);
+}
+
+/* Test that AddCodes adds each valid code and reports an error for each
+ * invalid one, in order. */
+static void
+test_manager_service_add_codes (Fixture       *fixture,
+                                gconstpointer  data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GVariant) results = NULL;
+  g_autofree gchar *code1 = next_code (fixture, EPC_PERIOD_1_HOUR);
+  g_autofree gchar *code2 = next_code (fixture, EPC_PERIOD_1_DAY);
+  const gchar *codes[] = { code1, "00000000", code2, NULL };
+  gint64 time_added;
+  const gchar *error_name;
+
+  reply = call_add_codes (fixture, codes, &error);
+  g_assert_no_error (error);
+
+  results = g_variant_get_child_value (reply, 0);
+  g_assert_cmpuint (g_variant_n_children (results), ==, 3);
+
+  g_variant_get_child (results, 0, "(x&s)", &time_added, &error_name);
+  g_assert_cmpint (time_added, ==, 60 * 60);
+  g_assert_cmpstr (error_name, ==, "");
+
+  g_variant_get_child (results, 1, "(x&s)", &time_added, &error_name);
+  g_assert_cmpint (time_added, ==, 0);
+  g_assert_cmpstr (error_name, ==, "com.endlessm.Payg1.Error.InvalidCode");
+
+  g_variant_get_child (results, 2, "(x&s)", &time_added, &error_name);
+  g_assert_cmpint (time_added, ==, 24 * 60 * 60);
+  g_assert_cmpstr (error_name, ==, "");
+}
+
+/* Test that AddCodes rejects batches longer than
+ * %EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES without trying any of the codes. */
+static void
+test_manager_service_add_codes_too_many (Fixture       *fixture,
+                                         gconstpointer  data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GPtrArray) codes = g_ptr_array_new_with_free_func (g_free);
+  guint64 expiry_time = epg_provider_get_expiry_time (fixture->provider);
+
+  for (gsize i = 0; i < EPG_MANAGER_SERVICE_MAXIMUM_ADD_CODES + 1; i++)
+    g_ptr_array_add (codes, next_code (fixture, EPC_PERIOD_1_HOUR));
+  g_ptr_array_add (codes, NULL);
+
+  reply = call_add_codes (fixture, (const gchar * const *) codes->pdata, &error);
+  g_assert_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS);
+  g_assert_null (reply);
+
+  g_assert_cmpuint (epg_provider_get_expiry_time (fixture->provider), ==, expiry_time);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_autoptr(GError) error = NULL;
+
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  eospayg_efi_init (EOSPAYG_EFI_TEST_MODE, &error);
+  g_assert_no_error (error);
+
+#define T(path, func) \
+  g_test_add (path, Fixture, NULL, setup, func, teardown)
+
+  T ("/manager-service/properties-changed", test_manager_service_properties_changed);
+  T ("/manager-service/credit-low", test_manager_service_credit_low);
+  T ("/manager-service/rate-limit-ended", test_manager_service_rate_limit_ended);
+  T ("/manager-service/add-codes", test_manager_service_add_codes);
+  T ("/manager-service/add-codes/too-many", test_manager_service_add_codes_too_many);
+
+#undef T
+
+  return g_test_run ();
+}
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
+#include <libeos-payg/efi.h>
 #include <libeos-payg/fake-clock.h>
 #include <libeos-payg/errors.h>
 #include <libeos-payg/manager.h>
@@ -48,6 +49,10 @@ typedef struct _Fixture {
   gchar *account_id_path;
   GFile *account_id_file;
 
+  /* Passed to epg_manager_new() if non-%NULL */
+  GBytes *efi_state;
+  GBytes *efi_state_b;
+
   EpcCounter next_counter;
 
   EpgProvider *provider;
@@ -169,6 +174,13 @@ teardown (Fixture *fixture,
 
   g_clear_object (&fixture->tmp_dir);
   g_clear_pointer (&fixture->key, g_bytes_unref);
+  g_clear_pointer (&fixture->efi_state, g_bytes_unref);
+  g_clear_pointer (&fixture->efi_state_b, g_bytes_unref);
+
+  eospayg_efi_internal_set_post_pivot (FALSE);
+  eospayg_efi_internal_set_fail_delete (FALSE);
+  eospayg_efi_var_delete (EFI_STATE_VARIABLE, NULL);
+  eospayg_efi_var_delete (EFI_STATE_VARIABLE_B, NULL);
 }
 
 static void
@@ -182,8 +194,9 @@ manager_new_failable (Fixture *fixture,
 
   clock = epg_fake_clock_new (-1, -1);
   epg_manager_new (enabled, fixture->key_file, fixture->account_id_file,
-                   fixture->tmp_dir, EPG_CLOCK (clock), NULL, async_cb,
-                   &result);
+                   fixture->tmp_dir, fixture->efi_state, fixture->efi_state_b,
+                   EPG_CLOCK (clock),
+                   NULL, async_cb, &result);
 
   while (result == NULL)
     g_main_context_iteration (NULL, TRUE);
@@ -993,6 +1006,107 @@ test_manager_error_rate_limit (Fixture *fixture,
   g_assert_cmpuint (5, ==, time_added);
 }
 
+static void
+count_notify_cb (GObject    *object,
+                 GParamSpec *pspec,
+                 gpointer    user_data)
+{
+  guint *n_notifications = user_data;
+
+  (*n_notifications)++;
+}
+
+/* test_manager_add_codes:
+ *
+ * Tests that adding a batch of codes applies the valid ones, returns an error
+ * for each invalid one without affecting the others, and notifies the expiry
+ * time only once.
+ */
+static void
+test_manager_add_codes (Fixture *fixture,
+                        gconstpointer data)
+{
+  manager_new (fixture);
+  g_autofree gchar *code1 = get_next_code (fixture);
+  g_autofree gchar *code2 = get_next_code (fixture);
+  const gchar *codes[] = { code1, "abcdefgh", code1, code2, NULL };
+  gint64 times_added[G_N_ELEMENTS (codes) - 1];
+  GError *errors[G_N_ELEMENTS (codes) - 1];
+  guint64 expiry_before_codes;
+  guint n_added, n_notifications = 0;
+
+  expiry_before_codes = epg_provider_get_expiry_time (fixture->provider);
+  g_signal_connect (fixture->provider, "notify::expiry-time",
+                    G_CALLBACK (count_notify_cb), &n_notifications);
+
+  n_added = epg_provider_add_codes (fixture->provider, codes, times_added, errors);
+  g_assert_cmpuint (n_added, ==, 2);
+
+  g_assert_no_error (errors[0]);
+  g_assert_cmpint (times_added[0], ==, 5);
+  g_assert_error (errors[1], EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE);
+  g_assert_cmpint (times_added[1], ==, 0);
+  g_assert_error (errors[2], EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_CODE_ALREADY_USED);
+  g_assert_cmpint (times_added[2], ==, 0);
+  g_assert_no_error (errors[3]);
+  g_assert_cmpint (times_added[3], ==, 5);
+
+  g_assert_cmpuint (epg_provider_get_expiry_time (fixture->provider), ==,
+                    expiry_before_codes + 10);
+  g_assert_cmpuint (n_notifications, ==, 1);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (errors); i++)
+    g_clear_error (&errors[i]);
+
+  g_signal_handlers_disconnect_by_func (fixture->provider, count_notify_cb, &n_notifications);
+}
+
+/* test_manager_add_code_async:
+ *
+ * Tests that the default implementation of epg_provider_add_code_async()
+ * applies a code like epg_provider_add_code() does, and reports errors in the
+ * same way.
+ */
+static void
+test_manager_add_code_async (Fixture *fixture,
+                             gconstpointer data)
+{
+  manager_new (fixture);
+  g_autofree gchar *code_str = get_next_code (fixture);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  guint64 expiry_before_code;
+  gboolean ret;
+
+  expiry_before_code = epg_provider_get_expiry_time (fixture->provider);
+
+  epg_provider_add_code_async (fixture->provider, code_str, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_provider_add_code_finish (fixture->provider, result, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_cmpint (time_added, ==, 5);
+  g_assert_cmpuint (epg_provider_get_expiry_time (fixture->provider), ==,
+                    expiry_before_code + 5);
+
+  g_clear_object (&result);
+  time_added = 0;
+
+  epg_provider_add_code_async (fixture->provider, code_str, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_provider_add_code_finish (fixture->provider, result, &time_added, &error);
+  g_assert_error (error, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_CODE_ALREADY_USED);
+  g_assert_false (ret);
+  g_assert_cmpint (time_added, ==, 0);
+}
+
 static void
 add_many (const char  *path_base,
           void       (*func) (Fixture *, gconstpointer),
@@ -1011,13 +1125,466 @@ add_many (const char  *path_base,
     }
 }
 
+static const guint8 EMPTY_EFI_STATE[] = { 1 };
+
+/* Read the EFI state variable @name, returning %NULL if it doesn’t exist. */
+static GBytes *
+read_efi_state (const gchar *name)
+{
+  g_autoptr(GError) error = NULL;
+  void *data;
+  int size = 0;
+
+  if (!eospayg_efi_var_exists (name))
+    return NULL;
+
+  data = eospayg_efi_var_read (name, -1, &size, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (data);
+
+  return g_bytes_new_take (data, size);
+}
+
+/* Get the generation from EFI @state, which is 0 if @state is %NULL or holds
+ * no state yet. All the tests use generations below 128, so they are a single
+ * varint byte. */
+static guint
+get_efi_state_generation (GBytes *state)
+{
+  gsize size = 0;
+  const guint8 *data = (state != NULL) ? g_bytes_get_data (state, &size) : NULL;
+
+  if (size < 2)
+    return 0;
+
+  g_assert_cmpuint (data[1], <, 0x80);
+  return data[1];
+}
+
+/* Replace the fixture’s EFI state with the current contents of both EFI state
+ * variables, as the service would read them at startup. */
+static void
+reread_efi_states (Fixture *fixture)
+{
+  g_clear_pointer (&fixture->efi_state, g_bytes_unref);
+  g_clear_pointer (&fixture->efi_state_b, g_bytes_unref);
+  fixture->efi_state = read_efi_state (EFI_STATE_VARIABLE);
+  fixture->efi_state_b = read_efi_state (EFI_STATE_VARIABLE_B);
+}
+
+/* test_manager_efi_state_add_save_reload:
+ *
+ * Tests that with EFI storage, applying a code, shutting down the
+ * EpgManager, and loading it up again from the EFI variable restores the same
+ * expiry time, and that the state is stored compactly and not in the state
+ * directory.
+ */
+static void
+test_manager_efi_state_add_save_reload (Fixture *fixture,
+                                        gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  guint64 expiry_before_code, expiry_after_reload;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  manager_new (fixture);
+
+  /* A freshly provisioned computer has no credit. */
+  expiry_before_code = epg_provider_get_expiry_time (fixture->provider);
+  g_assert_cmpuint (expiry_before_code, ==,
+                    epg_clock_get_time (epg_provider_get_clock (fixture->provider)));
+
+  for (gsize i = 0; i < 3; i++)
+    {
+      g_autofree gchar *code_str = get_next_code (fixture);
+
+      ret = epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+      g_assert_no_error (error);
+      g_assert_true (ret);
+    }
+
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  g_assert_false (g_file_test (fixture->clock_time_path, G_FILE_TEST_EXISTS));
+  g_assert_false (g_file_test (fixture->expiry_seconds_path, G_FILE_TEST_EXISTS));
+  g_assert_false (g_file_test (fixture->used_codes_path, G_FILE_TEST_EXISTS));
+
+  /* Version, 1-byte generation, 5-byte clock time, 1-byte credit, 1-byte
+   * period mask, then the length and 1-byte bitmap for the 5-second period. */
+  reread_efi_states (fixture);
+  guint generation_a = get_efi_state_generation (fixture->efi_state);
+  guint generation_b = get_efi_state_generation (fixture->efi_state_b);
+  GBytes *newest_state = (generation_a > generation_b) ? fixture->efi_state : fixture->efi_state_b;
+  g_assert_nonnull (newest_state);
+  g_assert_cmpuint (g_bytes_get_size (newest_state), ==, 11);
+
+  manager_new (fixture);
+  expiry_after_reload = epg_provider_get_expiry_time (fixture->provider);
+  g_assert_cmpuint (expiry_before_code + 15, ==, expiry_after_reload);
+
+  /* The used codes must have been restored too. */
+  fixture->next_counter = EPC_MINCOUNTER + 1;
+  g_autofree gchar *used_code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, used_code_str, &time_added, &error);
+  g_assert_error (error, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_CODE_ALREADY_USED);
+  g_assert_false (ret);
+}
+
+/* test_manager_efi_state_unchanged:
+ *
+ * Tests that the EFI variable is not rewritten when the state has not changed
+ * since it was loaded.
+ */
+static void
+test_manager_efi_state_unchanged (Fixture *fixture,
+                                  gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *code_str = NULL;
+  gint64 time_added = 0;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  manager_new (fixture);
+
+  code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  reread_efi_states (fixture);
+
+  /* Delete the variables so we can tell whether either is written again. */
+  eospayg_efi_var_delete (EFI_STATE_VARIABLE, NULL);
+  eospayg_efi_var_delete (EFI_STATE_VARIABLE_B, NULL);
+
+  manager_new (fixture);
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  g_assert_false (eospayg_efi_var_exists (EFI_STATE_VARIABLE));
+  g_assert_false (eospayg_efi_var_exists (EFI_STATE_VARIABLE_B));
+}
+
+/* test_manager_efi_state_alternate:
+ *
+ * Tests that each save writes the EFI variable which does not hold the newest
+ * state, with the next generation, so the newest state is never overwritten.
+ */
+static void
+test_manager_efi_state_alternate (Fixture *fixture,
+                                  gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  eospayg_efi_var_write (EFI_STATE_VARIABLE, EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE), &error);
+  g_assert_no_error (error);
+  manager_new (fixture);
+
+  for (gsize i = 0; i < 4; i++)
+    {
+      g_autoptr(GBytes) before_a = read_efi_state (EFI_STATE_VARIABLE);
+      g_autoptr(GBytes) before_b = read_efi_state (EFI_STATE_VARIABLE_B);
+      guint before_generation_a = get_efi_state_generation (before_a);
+      guint before_generation_b = get_efi_state_generation (before_b);
+      g_autofree gchar *code_str = get_next_code (fixture);
+
+      ret = epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+      g_assert_no_error (error);
+      g_assert_true (ret);
+
+      g_autoptr(GBytes) after_a = read_efi_state (EFI_STATE_VARIABLE);
+      g_autoptr(GBytes) after_b = read_efi_state (EFI_STATE_VARIABLE_B);
+      guint next_generation = MAX (before_generation_a, before_generation_b) + 1;
+
+      if (before_generation_a >= before_generation_b)
+        {
+          /* A held the newest state, so B must have been written. */
+          g_assert_true (g_bytes_equal (before_a, after_a));
+          g_assert_cmpuint (get_efi_state_generation (after_b), ==, next_generation);
+        }
+      else
+        {
+          g_assert_true (g_bytes_equal (before_b, after_b));
+          g_assert_cmpuint (get_efi_state_generation (after_a), ==, next_generation);
+        }
+    }
+}
+
+/* test_manager_efi_state_interrupted:
+ *
+ * Tests that if a save is interrupted, leaving the variable being written
+ * missing or corrupt, the state is loaded from the other variable.
+ */
+static void
+test_manager_efi_state_interrupted (Fixture *fixture,
+                                    gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GBytes) newest_state = NULL;
+  g_autoptr(GBytes) older_state = NULL;
+  static const guint8 corrupt_state[] = { 1, 0x80 };
+  gint64 time_added = 0;
+  guint64 expected_expiry;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  manager_new (fixture);
+
+  for (gsize i = 0; i < 2; i++)
+    {
+      g_autofree gchar *code_str = get_next_code (fixture);
+
+      ret = epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+      g_assert_no_error (error);
+      g_assert_true (ret);
+    }
+
+  expected_expiry = epg_provider_get_expiry_time (fixture->provider);
+
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  reread_efi_states (fixture);
+  if (get_efi_state_generation (fixture->efi_state) >
+      get_efi_state_generation (fixture->efi_state_b))
+    {
+      newest_state = g_steal_pointer (&fixture->efi_state);
+      older_state = g_steal_pointer (&fixture->efi_state_b);
+    }
+  else
+    {
+      newest_state = g_steal_pointer (&fixture->efi_state_b);
+      older_state = g_steal_pointer (&fixture->efi_state);
+    }
+
+  /* Power lost after deleting the older variable but before rewriting it: only
+   * the newest state is left, and it must be loaded in full. */
+  fixture->efi_state_b = g_bytes_ref (newest_state);
+  manager_new (fixture);
+  g_assert_cmpuint (epg_provider_get_expiry_time (fixture->provider), ==, expected_expiry);
+
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_clear_pointer (&fixture->efi_state_b, g_bytes_unref);
+
+  /* The newest variable was corrupted: fall back to the older state, which
+   * has the first code used but not the second. */
+  fixture->efi_state = g_bytes_new_static (corrupt_state, sizeof (corrupt_state));
+  fixture->efi_state_b = g_bytes_ref (older_state);
+  manager_new (fixture);
+
+  fixture->next_counter = EPC_MINCOUNTER;
+  g_autofree gchar *first_code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, first_code_str, &time_added, &error);
+  g_assert_error (error, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_CODE_ALREADY_USED);
+  g_assert_false (ret);
+  g_clear_error (&error);
+
+  g_autofree gchar *second_code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, second_code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+}
+
+/* test_manager_efi_state_post_pivot:
+ *
+ * Tests that after the root pivot, when an existing EFI variable can’t be
+ * overwritten and has to be deleted and created again, saves still alternate
+ * between the variables and the state can be reloaded.
+ */
+static void
+test_manager_efi_state_post_pivot (Fixture *fixture,
+                                   gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  guint64 expected_expiry;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  eospayg_efi_var_write (EFI_STATE_VARIABLE, EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE), &error);
+  g_assert_no_error (error);
+
+  eospayg_efi_internal_set_post_pivot (TRUE);
+
+  ret = eospayg_efi_var_write (EFI_STATE_VARIABLE, EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS);
+  g_assert_false (ret);
+  g_clear_error (&error);
+
+  manager_new (fixture);
+
+  /* The first save creates B; each one after that replaces an existing
+   * variable. */
+  for (guint i = 1; i <= 4; i++)
+    {
+      g_autofree gchar *code_str = get_next_code (fixture);
+
+      ret = epg_provider_add_code (fixture->provider, code_str, &time_added, &error);
+      g_assert_no_error (error);
+      g_assert_true (ret);
+
+      reread_efi_states (fixture);
+      g_assert_cmpuint (get_efi_state_generation ((i % 2 == 0) ? fixture->efi_state : fixture->efi_state_b),
+                        ==, i);
+      g_assert_cmpuint (get_efi_state_generation ((i % 2 == 0) ? fixture->efi_state_b : fixture->efi_state),
+                        ==, i - 1);
+    }
+
+  expected_expiry = epg_provider_get_expiry_time (fixture->provider);
+
+  ret = shutdown (fixture, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  reread_efi_states (fixture);
+  manager_new (fixture);
+  g_assert_cmpuint (epg_provider_get_expiry_time (fixture->provider), ==, expected_expiry);
+}
+
+/* test_manager_efi_state_post_pivot_delete_error:
+ *
+ * Tests that if deleting an EFI variable to rewrite it fails after the root
+ * pivot, the save fails without touching the newest state, and the next save
+ * retries the same variable.
+ */
+static void
+test_manager_efi_state_post_pivot_delete_error (Fixture *fixture,
+                                                gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GBytes) newest_state = NULL;
+  gint64 time_added = 0;
+  gboolean ret;
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  eospayg_efi_var_write (EFI_STATE_VARIABLE, EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE), &error);
+  g_assert_no_error (error);
+
+  eospayg_efi_internal_set_post_pivot (TRUE);
+  manager_new (fixture);
+
+  /* Creates B, which needs no deletion. */
+  g_autofree gchar *first_code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, first_code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  newest_state = read_efi_state (EFI_STATE_VARIABLE_B);
+  g_assert_cmpuint (get_efi_state_generation (newest_state), ==, 1);
+
+  /* Replacing A fails. As in test_manager_save_error(), the code is still
+   * applied, and the failed save is only logged. */
+  eospayg_efi_internal_set_fail_delete (TRUE);
+
+  g_autofree gchar *second_code_str = get_next_code (fixture);
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "*save_state failed:*busy*");
+  ret = epg_provider_add_code (fixture->provider, second_code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  while (g_main_context_iteration (NULL, FALSE));
+  g_test_assert_expected_messages ();
+
+  reread_efi_states (fixture);
+  g_assert_cmpmem (g_bytes_get_data (fixture->efi_state, NULL), g_bytes_get_size (fixture->efi_state),
+                   EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  g_assert_true (g_bytes_equal (fixture->efi_state_b, newest_state));
+
+  /* Once the variable can be deleted again, the next save replaces A. */
+  eospayg_efi_internal_set_fail_delete (FALSE);
+
+  g_autofree gchar *third_code_str = get_next_code (fixture);
+  ret = epg_provider_add_code (fixture->provider, third_code_str, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  reread_efi_states (fixture);
+  g_assert_cmpuint (get_efi_state_generation (fixture->efi_state), ==, 2);
+  g_assert_true (g_bytes_equal (fixture->efi_state_b, newest_state));
+}
+
+/* test_manager_efi_state_malformed:
+ * @data: a #GBytes of malformed EFI state
+ *
+ * Tests that malformed EFI state results in an error, and is reset so that
+ * the next start succeeds with no credit.
+ */
+static void
+test_manager_efi_state_malformed (Fixture *fixture,
+                                  gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GBytes) reset_state = NULL;
+
+  fixture->efi_state = g_bytes_ref ((GBytes *) data);
+  manager_new_failable (fixture, TRUE, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert_null (fixture->provider);
+
+  reset_state = read_efi_state (EFI_STATE_VARIABLE);
+  g_assert_nonnull (reset_state);
+  g_assert_cmpmem (g_bytes_get_data (reset_state, NULL), g_bytes_get_size (reset_state),
+                   EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+}
+
+/* test_manager_efi_state_key_missing:
+ *
+ * Tests that with EFI storage, a missing key is an error rather than
+ * disabling the manager.
+ */
+static void
+test_manager_efi_state_key_missing (Fixture *fixture,
+                                    gconstpointer data)
+{
+  g_autoptr(GError) error = NULL;
+
+  remove_path (fixture->key_path);
+
+  fixture->efi_state = g_bytes_new_static (EMPTY_EFI_STATE, sizeof (EMPTY_EFI_STATE));
+  manager_new_failable (fixture, TRUE, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_null (fixture->provider);
+}
+
 int
 main (int    argc,
       char **argv)
 {
+  g_autoptr(GError) error = NULL;
+
   setlocale (LC_ALL, "");
   g_test_init (&argc, &argv, NULL);
 
+  eospayg_efi_init (EOSPAYG_EFI_TEST_MODE, &error);
+  g_assert_no_error (error);
+
+  /* Bad version; truncated varint; period 26 is invalid; trailing byte */
+  static const guint8 bad_version[] = { 2 };
+  static const guint8 truncated[] = { 1, 0x80 };
+  static const guint8 bad_period[] = { 1, 0, 0, 0, 0x80, 0x80, 0x80, 0x20, 1, 1 };
+  static const guint8 trailing[] = { 1, 0, 0, 0, 0, 0 };
+  g_autoptr(GBytes) bad_version_bytes = g_bytes_new_static (bad_version, sizeof (bad_version));
+  g_autoptr(GBytes) truncated_bytes = g_bytes_new_static (truncated, sizeof (truncated));
+  g_autoptr(GBytes) bad_period_bytes = g_bytes_new_static (bad_period, sizeof (bad_period));
+  g_autoptr(GBytes) trailing_bytes = g_bytes_new_static (trailing, sizeof (trailing));
+
   const gpointer clock_time_offset =
      GSIZE_TO_POINTER (G_STRUCT_OFFSET (Fixture, clock_time_path));
   const gpointer expiry_seconds_offset =
@@ -1084,6 +1651,19 @@ main (int    argc,
   T ("/manager/error/malformed", test_manager_error_malformed, NULL);
   T ("/manager/error/reused", test_manager_error_reused, NULL);
   T ("/manager/error/rate-limit", test_manager_error_rate_limit, NULL);
+  T ("/manager/add-codes", test_manager_add_codes, NULL);
+  T ("/manager/add-code-async", test_manager_add_code_async, NULL);
+  T ("/manager/efi-state/add-save-reload", test_manager_efi_state_add_save_reload, NULL);
+  T ("/manager/efi-state/unchanged", test_manager_efi_state_unchanged, NULL);
+  T ("/manager/efi-state/alternate", test_manager_efi_state_alternate, NULL);
+  T ("/manager/efi-state/interrupted", test_manager_efi_state_interrupted, NULL);
+  T ("/manager/efi-state/post-pivot", test_manager_efi_state_post_pivot, NULL);
+  T ("/manager/efi-state/post-pivot/delete-error", test_manager_efi_state_post_pivot_delete_error, NULL);
+  T ("/manager/efi-state/malformed/version", test_manager_efi_state_malformed, bad_version_bytes);
+  T ("/manager/efi-state/malformed/truncated", test_manager_efi_state_malformed, truncated_bytes);
+  T ("/manager/efi-state/malformed/period", test_manager_efi_state_malformed, bad_period_bytes);
+  T ("/manager/efi-state/malformed/trailing", test_manager_efi_state_malformed, trailing_bytes);
+  T ("/manager/efi-state/key-missing", test_manager_efi_state_key_missing, NULL);
 #undef T
 
   return g_test_run ();
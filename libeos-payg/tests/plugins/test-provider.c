@@ -59,6 +59,15 @@ static gboolean    epg_test_provider_shutdown_finish (EpgProvider           *pro
                                                       GAsyncResult         *result,
                                                       GError              **error);
 
+static void        epg_test_provider_recheck_enabled_async  (EpgProvider          *provider,
+                                                             GCancellable         *cancellable,
+                                                             GAsyncReadyCallback   callback,
+                                                             gpointer              user_data);
+static gboolean    epg_test_provider_recheck_enabled_finish (EpgProvider          *provider,
+                                                             GAsyncResult         *result,
+                                                             GError              **error);
+
+static gboolean    epg_test_provider_probe               (EpgProvider *provider);
 static guint64     epg_test_provider_get_expiry_time     (EpgProvider *provider);
 static gboolean    epg_test_provider_get_enabled         (EpgProvider *provider);
 static guint64     epg_test_provider_get_rate_limit_end_time (EpgProvider *provider);
@@ -72,6 +81,13 @@ typedef struct
   const gchar *account_id; /* (owned) */
 } EpgTestProviderPrivate;
 
+/* Number of times any #EpgTestProvider has been initialised, so tests can check
+ * that providers are not needlessly re-initialised. */
+static guint n_inits = 0;
+
+/* How long a provider in `slow` mode takes to initialize, in milliseconds. */
+#define SLOW_INIT_MS 300
+
 typedef enum
 {
   PROP_EXPIRY_TIME = 1,
@@ -133,6 +149,9 @@ epg_test_provider_provider_iface_init (gpointer g_iface,
   iface->clear_code = epg_test_provider_clear_code;
   iface->shutdown_async = epg_test_provider_shutdown_async;
   iface->shutdown_finish = epg_test_provider_shutdown_finish;
+  iface->recheck_enabled_async = epg_test_provider_recheck_enabled_async;
+  iface->recheck_enabled_finish = epg_test_provider_recheck_enabled_finish;
+  iface->probe = epg_test_provider_probe;
   iface->get_expiry_time = epg_test_provider_get_expiry_time;
   iface->get_enabled = epg_test_provider_get_enabled;
   iface->get_rate_limit_end_time = epg_test_provider_get_rate_limit_end_time;
@@ -227,6 +246,22 @@ epg_test_provider_set_property (GObject      *object,
     }
 }
 
+/* Whether the provider is enabled is controlled by an environment variable
+ * named after its type: `enabled`, `disabled`, `absent` (which is disabled,
+ * and also makes the provider fail to probe), `hang` (which is disabled,
+ * and also makes initialization never complete unless it is cancelled), or
+ * `slow` (which is enabled, but takes %SLOW_INIT_MS to initialize). */
+static gboolean
+read_enabled (EpgTestProvider *self)
+{
+  const char *type_name = G_OBJECT_TYPE_NAME (self);
+  const char *type_name_env = g_getenv (type_name);
+
+  g_debug ("%s=%s", type_name, type_name_env ?: "");
+  return (0 == g_strcmp0 (type_name_env, "enabled") ||
+          0 == g_strcmp0 (type_name_env, "slow"));
+}
+
 static void
 epg_test_provider_constructed (GObject *object)
 {
@@ -235,11 +270,21 @@ epg_test_provider_constructed (GObject *object)
 
   G_OBJECT_CLASS (epg_test_provider_parent_class)->constructed (object);
 
-  const char *type_name = G_OBJECT_TYPE_NAME (self);
-  const char *type_name_env = g_getenv (type_name);
+  priv->enabled = read_enabled (self);
+}
 
-  g_debug ("%s=%s", type_name, type_name_env ?: "");
-  priv->enabled = 0 == g_strcmp0 (type_name_env, "enabled");
+/**
+ * epg_test_provider_get_n_inits:
+ *
+ * Get the number of times any #EpgTestProvider has been initialised in this
+ * process.
+ *
+ * Returns: number of initialisations
+ */
+guint
+epg_test_provider_get_n_inits (void)
+{
+  return n_inits;
 }
 
 static gboolean
@@ -258,6 +303,27 @@ epg_test_provider_clear_code (EpgProvider  *provider,
   return TRUE;
 }
 
+static gboolean
+init_cancelled_cb (GCancellable *cancellable,
+                   gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+
+  g_task_return_error_if_cancelled (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+init_slow_cb (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+
+  g_task_return_boolean (task, TRUE);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 epg_test_provider_init_async (GAsyncInitable      *initable,
                               int                  priority,
@@ -271,6 +337,29 @@ epg_test_provider_init_async (GAsyncInitable      *initable,
   g_task_set_source_tag (task, epg_test_provider_init_async);
   g_task_set_priority (task, priority);
 
+  n_inits++;
+
+  if (g_strcmp0 (g_getenv (G_OBJECT_TYPE_NAME (self)), "hang") == 0)
+    {
+      /* Simulate a provider which is stuck (for example, on slow I/O) until
+       * it is cancelled. */
+      if (cancellable != NULL)
+        {
+          g_autoptr(GSource) source = g_cancellable_source_new (cancellable);
+          g_source_set_callback (source, G_SOURCE_FUNC (init_cancelled_cb),
+                                 g_object_ref (task), g_object_unref);
+          g_source_attach (source, g_main_context_get_thread_default ());
+        }
+
+      return;
+    }
+  else if (g_strcmp0 (g_getenv (G_OBJECT_TYPE_NAME (self)), "slow") == 0)
+    {
+      g_timeout_add_full (G_PRIORITY_DEFAULT, SLOW_INIT_MS, init_slow_cb,
+                          g_object_ref (task), g_object_unref);
+      return;
+    }
+
   g_task_return_boolean (task, TRUE);
 }
 
@@ -330,6 +419,56 @@ epg_test_provider_shutdown_finish (EpgProvider   *provider,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+static void
+epg_test_provider_recheck_enabled_async (EpgProvider         *provider,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data)
+{
+  EpgTestProvider *self = EPG_TEST_PROVIDER (provider);
+  EpgTestProviderPrivate *priv = epg_test_provider_get_instance_private (self);
+
+  g_return_if_fail (EPG_IS_TEST_PROVIDER (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_test_provider_recheck_enabled_async);
+
+  gboolean enabled = read_enabled (self);
+  if (enabled != priv->enabled)
+    {
+      priv->enabled = enabled;
+      g_object_notify (G_OBJECT (self), "enabled");
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+epg_test_provider_recheck_enabled_finish (EpgProvider   *provider,
+                                          GAsyncResult  *result,
+                                          GError       **error)
+{
+  EpgTestProvider *self = EPG_TEST_PROVIDER (provider);
+
+  g_return_val_if_fail (EPG_IS_TEST_PROVIDER (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_test_provider_recheck_enabled_async), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static gboolean
+epg_test_provider_probe (EpgProvider *provider)
+{
+  EpgTestProvider *self = EPG_TEST_PROVIDER (provider);
+
+  g_return_val_if_fail (EPG_IS_TEST_PROVIDER (self), FALSE);
+
+  return 0 != g_strcmp0 (g_getenv (G_OBJECT_TYPE_NAME (self)), "absent");
+}
+
 guint64
 epg_test_provider_get_expiry_time (EpgProvider *provider)
 {
@@ -30,4 +30,6 @@ struct _EpgTestProviderClass {
   GObjectClass parent_class;
 };
 
+guint epg_test_provider_get_n_inits (void);
+
 G_END_DECLS
@@ -23,8 +23,10 @@
 #include <gio/gio.h>
 #include <libeos-payg/errors.h>
 #include <libeos-payg/provider-loader.h>
+#include <libeos-payg/tests/plugins/test-provider.h>
 #include <locale.h>
 
+#ifdef ENABLE_PLUGINS
 enum {
   ENABLE_PROVIDER_ONE = 1 << 0,
   ENABLE_PROVIDER_TWO = 1 << 1,
@@ -63,6 +65,8 @@ teardown (Fixture       *fixture,
 {
 }
 
+#endif  /* ENABLE_PLUGINS */
+
 static void
 async_cb (GObject      *source,
           GAsyncResult *result,
@@ -74,6 +78,7 @@ async_cb (GObject      *source,
   *result_out = g_object_ref (result);
 }
 
+#ifdef ENABLE_PLUGINS
 /* Tests loading the two defined test providers, asserting that they are
  * enabled or disabled as determined by the flags in the test data.
  */
@@ -166,6 +171,242 @@ test_get_first_enabled (Fixture       *fixture,
     }
 }
 
+/* Tests that reusing a loader after no provider was enabled (as happens across
+ * the root pivot) re-checks the providers it kept in standby, rather than
+ * initializing them again.
+ */
+static void
+test_get_first_enabled_recheck (void)
+{
+  g_autofree gchar *plugins_dir = g_test_build_filename (G_TEST_BUILT,
+                                                         "plugins",
+                                                         NULL);
+  g_autoptr(EpgProviderLoader) loader = epg_provider_loader_new (plugins_dir);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(EpgProvider) provider = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  g_setenv ("EpgTestProviderOne", "disabled", TRUE);
+  g_setenv ("EpgTestProviderTwo", "disabled", TRUE);
+
+  guint n_inits_before = epg_test_provider_get_n_inits ();
+
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, FALSE);
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_null (provider);
+  g_assert_cmpuint (epg_test_provider_get_n_inits (), ==, n_inits_before + 2);
+
+  /* Pretend that the state for provider one has become available. */
+  g_setenv ("EpgTestProviderOne", "enabled", TRUE);
+  g_clear_object (&result);
+
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, FALSE);
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (provider);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (provider), ==, "EpgTestProviderOne");
+  g_assert_true (epg_provider_get_enabled (provider));
+
+  /* Neither provider was initialized again. */
+  g_assert_cmpuint (epg_test_provider_get_n_inits (), ==, n_inits_before + 2);
+}
+
+/* Tests that providers which fail to probe are not initialized by
+ * epg_provider_loader_get_first_enabled_async(), but are by
+ * epg_provider_loader_load_async().
+ */
+static void
+test_get_first_enabled_probe (void)
+{
+  g_autofree gchar *plugins_dir = g_test_build_filename (G_TEST_BUILT,
+                                                         "plugins",
+                                                         NULL);
+  g_autoptr(EpgProviderLoader) loader = epg_provider_loader_new (plugins_dir);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(EpgProvider) provider = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  g_setenv ("EpgTestProviderOne", "absent", TRUE);
+  g_setenv ("EpgTestProviderTwo", "enabled", TRUE);
+
+  guint n_inits_before = epg_test_provider_get_n_inits ();
+
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, FALSE);
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (provider);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (provider), ==, "EpgTestProviderTwo");
+
+  /* Only the enabled provider was initialized. */
+  g_assert_cmpuint (epg_test_provider_get_n_inits (), ==, n_inits_before + 1);
+
+  /* Loading all providers doesn’t probe. */
+  g_clear_object (&result);
+  epg_provider_loader_load_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, FALSE);
+
+  providers = epg_provider_loader_load_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (providers->len, ==, 2);
+}
+
+/* Tests that a provider which never finishes initializing is treated as failed
+ * once the loader’s timeout expires, rather than stalling the load.
+ */
+static void
+test_get_first_enabled_timeout (void)
+{
+  g_autofree gchar *plugins_dir = g_test_build_filename (G_TEST_BUILT,
+                                                         "plugins",
+                                                         NULL);
+  g_autoptr(EpgProviderLoader) loader = g_object_new (EPG_TYPE_PROVIDER_LOADER,
+                                                      "module-dir", plugins_dir,
+                                                      "init-timeout-ms", 100,
+                                                      NULL);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(EpgProvider) provider = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  g_setenv ("EpgTestProviderOne", "hang", TRUE);
+  g_setenv ("EpgTestProviderTwo", "enabled", TRUE);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Timed out after 100 ms initializing *");
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_test_assert_expected_messages ();
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (provider);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (provider), ==, "EpgTestProviderTwo");
+
+  /* The hung provider is not returned from a full load either. */
+  g_clear_object (&result);
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Timed out after 100 ms initializing *");
+  epg_provider_loader_load_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_test_assert_expected_messages ();
+
+  providers = epg_provider_loader_load_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_cmpuint (providers->len, ==, 1);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (g_ptr_array_index (providers, 0)), ==,
+                   "EpgTestProviderTwo");
+}
+
+/* Tests the timeouts used by #EpgService: a limit during secure init, before
+ * the root pivot, and none when the same loader is used after the pivot, so a
+ * provider which is slow to initialize is still found then.
+ */
+static void
+test_get_first_enabled_timeout_post_pivot (void)
+{
+  g_autofree gchar *plugins_dir = g_test_build_filename (G_TEST_BUILT,
+                                                         "plugins",
+                                                         NULL);
+  g_autoptr(EpgProviderLoader) loader = epg_provider_loader_new (plugins_dir);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(EpgProvider) provider = NULL;
+  g_autoptr(GError) local_error = NULL;
+  guint init_timeout_ms;
+
+  /* There is no limit by default. */
+  g_object_get (loader, "init-timeout-ms", &init_timeout_ms, NULL);
+  g_assert_cmpuint (init_timeout_ms, ==, 0);
+
+  /* Before the pivot, the slow provider takes longer than the limit. */
+  g_object_set (loader, "init-timeout-ms", 100, NULL);
+  g_setenv ("EpgTestProviderOne", "slow", TRUE);
+  g_setenv ("EpgTestProviderTwo", "absent", TRUE);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Timed out after 100 ms initializing *");
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_test_assert_expected_messages ();
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_null (provider);
+
+  /* After the pivot, it is given as long as it needs. */
+  g_object_set (loader, "init-timeout-ms", 0, NULL);
+  g_clear_object (&result);
+
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (provider);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (provider), ==, "EpgTestProviderOne");
+}
+#endif  /* ENABLE_PLUGINS */
+
+/* Tests that a provider registered with epg_provider_loader_register_static()
+ * is loaded without a plugin. As registration is global, this must be the
+ * last test.
+ */
+static void
+test_get_first_enabled_static (void)
+{
+  g_autofree gchar *plugins_dir = g_test_build_filename (G_TEST_BUILT,
+                                                         "plugins",
+                                                         NULL);
+  g_autoptr(EpgProviderLoader) loader = NULL;
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(EpgProvider) provider = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  g_setenv ("EpgTestProvider", "enabled", TRUE);
+  g_setenv ("EpgTestProviderOne", "absent", TRUE);
+  g_setenv ("EpgTestProviderTwo", "absent", TRUE);
+
+  epg_provider_loader_register_static (EPG_TYPE_TEST_PROVIDER);
+  loader = epg_provider_loader_new (plugins_dir);
+
+  epg_provider_loader_get_first_enabled_async (loader, NULL, async_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, FALSE);
+
+  provider = epg_provider_loader_get_first_enabled_finish (loader, result, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (provider);
+  g_assert_cmpstr (G_OBJECT_TYPE_NAME (provider), ==, "EpgTestProvider");
+  g_assert_true (epg_provider_get_enabled (provider));
+}
+
 int
 main (int    argc,
       char **argv)
@@ -173,6 +414,7 @@ main (int    argc,
   setlocale (LC_ALL, "");
   g_test_init (&argc, &argv, NULL);
 
+#ifdef ENABLE_PLUGINS
   gsize i;
 
   for (i = 0; i < G_N_ELEMENTS (matrix); i++)
@@ -189,5 +431,18 @@ main (int    argc,
       g_free (path);
     }
 
+  g_test_add_func ("/provider-loader/get-first-enabled/recheck",
+                   test_get_first_enabled_recheck);
+  g_test_add_func ("/provider-loader/get-first-enabled/probe",
+                   test_get_first_enabled_probe);
+  g_test_add_func ("/provider-loader/get-first-enabled/timeout",
+                   test_get_first_enabled_timeout);
+  g_test_add_func ("/provider-loader/get-first-enabled/timeout/post-pivot",
+                   test_get_first_enabled_timeout_post_pivot);
+#endif
+
+  g_test_add_func ("/provider-loader/get-first-enabled/static",
+                   test_get_first_enabled_static);
+
   return g_test_run ();
 }
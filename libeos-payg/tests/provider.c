@@ -0,0 +1,501 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libeos-payg/errors.h>
+#include <libeos-payg/fake-clock.h>
+#include <libeos-payg/manager-service.h>
+#include <libeos-payg/provider.h>
+#include <libeos-payg/tests/plugins/test-provider.h>
+#include <locale.h>
+
+#define OBJECT_PATH "/com/endlessm/Payg1"
+#define INVALID_CODE "00000000"
+#define TIME_ADDED 60
+
+/* A test provider which implements the add_code_async() and add_code_finish()
+ * vfuncs itself, completing from an idle callback as a provider doing I/O
+ * would. Every code except %INVALID_CODE is accepted. Its synchronous
+ * add_code() must never be called.
+ *
+ * If @hold is set, calls are not completed until release_held_calls() is
+ * called, to simulate a slow provider. */
+#define EPG_TYPE_TEST_PROVIDER_ASYNC epg_test_provider_async_get_type ()
+G_DECLARE_FINAL_TYPE (EpgTestProviderAsync, epg_test_provider_async, EPG, TEST_PROVIDER_ASYNC, EpgTestProvider)
+
+struct _EpgTestProviderAsync
+{
+  EpgTestProvider parent;
+
+  guint n_add_code_async_calls;
+
+  gboolean hold;
+  GPtrArray *held_tasks;  /* (owned) (element-type GTask) */
+};
+
+static void epg_test_provider_async_provider_iface_init (gpointer g_iface,
+                                                         gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (EpgTestProviderAsync, epg_test_provider_async, EPG_TYPE_TEST_PROVIDER,
+                         G_IMPLEMENT_INTERFACE (EPG_TYPE_PROVIDER,
+                                                epg_test_provider_async_provider_iface_init))
+
+static void
+epg_test_provider_async_finalize (GObject *object)
+{
+  EpgTestProviderAsync *self = EPG_TEST_PROVIDER_ASYNC (object);
+
+  g_assert_cmpuint (self->held_tasks->len, ==, 0);
+  g_clear_pointer (&self->held_tasks, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (epg_test_provider_async_parent_class)->finalize (object);
+}
+
+static void
+epg_test_provider_async_class_init (EpgTestProviderAsyncClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = epg_test_provider_async_finalize;
+}
+
+static void
+epg_test_provider_async_init (EpgTestProviderAsync *self)
+{
+  self->held_tasks = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+static gboolean
+epg_test_provider_async_add_code (EpgProvider  *provider,
+                                  const gchar  *code_str,
+                                  gint64       *time_added,
+                                  GError      **error)
+{
+  /* The asynchronous vfuncs are implemented, so this must not be used. */
+  g_return_val_if_reached (FALSE);
+}
+
+static gboolean
+add_code_idle_cb (gpointer user_data)
+{
+  g_autoptr(GTask) task = G_TASK (user_data);
+  const gchar *code_str = g_task_get_task_data (task);
+
+  if (g_str_equal (code_str, INVALID_CODE))
+    {
+      g_task_return_new_error (task, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE,
+                               "Code %s is invalid", code_str);
+    }
+  else
+    {
+      gint64 time_added = TIME_ADDED;
+      g_task_return_pointer (task, g_memdup2 (&time_added, sizeof (time_added)), g_free);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+epg_test_provider_async_add_code_async (EpgProvider         *provider,
+                                        const gchar         *code_str,
+                                        GCancellable        *cancellable,
+                                        GAsyncReadyCallback  callback,
+                                        gpointer             user_data)
+{
+  EpgTestProviderAsync *self = EPG_TEST_PROVIDER_ASYNC (provider);
+
+  g_autoptr(GTask) task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epg_test_provider_async_add_code_async);
+  g_task_set_task_data (task, g_strdup (code_str), g_free);
+
+  self->n_add_code_async_calls++;
+
+  if (self->hold)
+    g_ptr_array_add (self->held_tasks, g_steal_pointer (&task));
+  else
+    g_idle_add (add_code_idle_cb, g_steal_pointer (&task));
+}
+
+/* Complete all the calls held so far, from idle callbacks. */
+static void
+release_held_calls (EpgTestProviderAsync *self)
+{
+  for (guint i = 0; i < self->held_tasks->len; i++)
+    g_idle_add (add_code_idle_cb, g_object_ref (self->held_tasks->pdata[i]));
+
+  g_ptr_array_set_size (self->held_tasks, 0);
+}
+
+static gboolean
+epg_test_provider_async_add_code_finish (EpgProvider   *provider,
+                                         GAsyncResult  *result,
+                                         gint64        *time_added,
+                                         GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, provider), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epg_test_provider_async_add_code_async), FALSE);
+
+  g_autofree gint64 *time_added_ptr = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (time_added_ptr == NULL)
+    return FALSE;
+
+  *time_added = *time_added_ptr;
+  return TRUE;
+}
+
+/* Never expire, so that #EpgManagerService doesn’t start a shutdown timer. */
+static guint64
+epg_test_provider_async_get_expiry_time (EpgProvider *provider)
+{
+  return G_MAXUINT64;
+}
+
+static void
+epg_test_provider_async_provider_iface_init (gpointer g_iface,
+                                             gpointer iface_data)
+{
+  EpgProviderInterface *iface = g_iface;
+
+  /* The rest of the vtable is inherited from #EpgTestProvider. */
+  iface->add_code = epg_test_provider_async_add_code;
+  iface->add_code_async = epg_test_provider_async_add_code_async;
+  iface->add_code_finish = epg_test_provider_async_add_code_finish;
+  iface->get_expiry_time = epg_test_provider_async_get_expiry_time;
+}
+
+typedef struct
+{
+  EpgFakeClock *clock;  /* (owned) */
+  EpgTestProviderAsync *provider;  /* (owned) */
+} Fixture;
+
+static void
+setup (Fixture       *fixture,
+       gconstpointer  data)
+{
+  g_setenv ("EpgTestProviderAsync", "enabled", TRUE);
+
+  fixture->clock = epg_fake_clock_new (-1, -1);
+  fixture->provider = g_object_new (EPG_TYPE_TEST_PROVIDER_ASYNC,
+                                    "clock", fixture->clock,
+                                    NULL);
+  g_assert_true (epg_provider_get_enabled (EPG_PROVIDER (fixture->provider)));
+}
+
+static void
+teardown (Fixture       *fixture,
+          gconstpointer  data)
+{
+  g_clear_object (&fixture->provider);
+  g_clear_object (&fixture->clock);
+}
+
+static void
+async_cb (GObject      *source,
+          GAsyncResult *result,
+          gpointer      data)
+{
+  GAsyncResult **result_out = data;
+
+  g_assert_null (*result_out);
+  *result_out = g_object_ref (result);
+}
+
+/* Test that epg_provider_add_code_async() uses the provider’s own
+ * implementation when there is one, and that epg_provider_add_code_finish()
+ * passes back its result and errors. */
+static void
+test_provider_add_code_async (Fixture       *fixture,
+                              gconstpointer  data)
+{
+  EpgProvider *provider = EPG_PROVIDER (fixture->provider);
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 time_added = 0;
+  gboolean ret;
+
+  epg_provider_add_code_async (provider, "12345678", NULL, async_cb, &result);
+  g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, 1);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_provider_add_code_finish (provider, result, &time_added, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_cmpint (time_added, ==, TIME_ADDED);
+  g_clear_object (&result);
+
+  time_added = 0;
+  epg_provider_add_code_async (provider, INVALID_CODE, NULL, async_cb, &result);
+  g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, 2);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  ret = epg_provider_add_code_finish (provider, result, &time_added, &error);
+  g_assert_error (error, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE);
+  g_assert_false (ret);
+  g_assert_cmpint (time_added, ==, 0);
+}
+
+/* Test that epg_provider_add_codes_async() adds the codes one at a time with
+ * the provider’s own asynchronous implementation, and that
+ * epg_provider_add_codes_finish() passes back each result. */
+static void
+test_provider_add_codes_async (Fixture       *fixture,
+                               gconstpointer  data)
+{
+  EpgProvider *provider = EPG_PROVIDER (fixture->provider);
+  const gchar *codes[] = { "12345678", INVALID_CODE, "23456789", NULL };
+  g_autoptr(GAsyncResult) result = NULL;
+  gint64 times_added[G_N_ELEMENTS (codes) - 1] = { 0, };
+  GError *errors[G_N_ELEMENTS (codes) - 1] = { NULL, };
+  guint n_added;
+
+  fixture->provider->hold = TRUE;
+  epg_provider_add_codes_async (provider, codes, NULL, async_cb, &result);
+
+  /* Only one code is in flight at a time. */
+  for (guint i = 1; i <= 3; i++)
+    {
+      while (fixture->provider->held_tasks->len == 0)
+        g_main_context_iteration (NULL, TRUE);
+
+      g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, i);
+      g_assert_cmpuint (fixture->provider->held_tasks->len, ==, 1);
+      g_assert_null (result);
+
+      release_held_calls (fixture->provider);
+    }
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  n_added = epg_provider_add_codes_finish (provider, result, times_added, errors);
+  g_assert_cmpuint (n_added, ==, 2);
+
+  g_assert_no_error (errors[0]);
+  g_assert_cmpint (times_added[0], ==, TIME_ADDED);
+  g_assert_error (errors[1], EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE);
+  g_assert_cmpint (times_added[1], ==, 0);
+  g_assert_no_error (errors[2]);
+  g_assert_cmpint (times_added[2], ==, TIME_ADDED);
+
+  g_clear_error (&errors[1]);
+}
+
+/* Call AddCode(@code_str) on the service exported on @connection. */
+static GVariant *
+call_add_code (GDBusConnection  *connection,
+               const gchar      *code_str,
+               GError          **error)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+
+  g_dbus_connection_call (connection,
+                          g_dbus_connection_get_unique_name (connection),
+                          OBJECT_PATH,
+                          "com.endlessm.Payg1",
+                          "AddCode",
+                          g_variant_new ("(s)", code_str),
+                          G_VARIANT_TYPE ("(x)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          async_cb,
+                          &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  return g_dbus_connection_call_finish (connection, result, error);
+}
+
+/* Test that #EpgManagerService handles AddCode with the provider’s
+ * asynchronous implementation, and returns its errors to the caller. */
+static void
+test_provider_add_code_async_service (Fixture       *fixture,
+                                      gconstpointer  data)
+{
+  g_autoptr(GTestDBus) bus = NULL;
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(EpgManagerService) service = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 time_added;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                       G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                       NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  service = epg_manager_service_new (connection, OBJECT_PATH,
+                                     EPG_PROVIDER (fixture->provider));
+  epg_manager_service_register (service, &error);
+  g_assert_no_error (error);
+
+  reply = call_add_code (connection, "12345678", &error);
+  g_assert_no_error (error);
+  g_variant_get (reply, "(x)", &time_added);
+  g_assert_cmpint (time_added, ==, TIME_ADDED);
+  g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, 1);
+  g_clear_pointer (&reply, g_variant_unref);
+
+  reply = call_add_code (connection, INVALID_CODE, &error);
+  g_assert_error (error, EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE);
+  g_assert_null (reply);
+  g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, 2);
+
+  epg_manager_service_unregister (service);
+  g_clear_object (&service);
+
+  g_dbus_connection_close_sync (connection, NULL, NULL);
+  g_test_dbus_down (bus);
+}
+
+/* Test that #EpgManagerService handles AddCodes with the provider’s
+ * asynchronous implementation, and keeps handling other calls while a slow
+ * provider is still working on the batch. */
+static void
+test_provider_add_codes_async_service (Fixture       *fixture,
+                                       gconstpointer  data)
+{
+  g_autoptr(GTestDBus) bus = NULL;
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(EpgManagerService) service = NULL;
+  g_autoptr(GAsyncResult) add_codes_result = NULL;
+  g_autoptr(GAsyncResult) get_result = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GVariant) results = NULL;
+  g_autoptr(GError) error = NULL;
+  const gchar *codes[] = { "12345678", INVALID_CODE, NULL };
+  gint64 time_added;
+  const gchar *error_name;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                       G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                       NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  service = epg_manager_service_new (connection, OBJECT_PATH,
+                                     EPG_PROVIDER (fixture->provider));
+  epg_manager_service_register (service, &error);
+  g_assert_no_error (error);
+
+  fixture->provider->hold = TRUE;
+
+  g_dbus_connection_call (connection,
+                          g_dbus_connection_get_unique_name (connection),
+                          OBJECT_PATH,
+                          "com.endlessm.Payg1",
+                          "AddCodes",
+                          g_variant_new ("(^as)", codes),
+                          G_VARIANT_TYPE ("(a(xs))"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          async_cb,
+                          &add_codes_result);
+
+  while (fixture->provider->held_tasks->len == 0)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* The service must still answer other calls while the provider is busy. */
+  g_dbus_connection_call (connection,
+                          g_dbus_connection_get_unique_name (connection),
+                          OBJECT_PATH,
+                          "org.freedesktop.DBus.Properties",
+                          "Get",
+                          g_variant_new ("(ss)", "com.endlessm.Payg1", "Enabled"),
+                          G_VARIANT_TYPE ("(v)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          async_cb,
+                          &get_result);
+
+  while (get_result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  reply = g_dbus_connection_call_finish (connection, get_result, &error);
+  g_assert_no_error (error);
+  g_clear_pointer (&reply, g_variant_unref);
+  g_assert_null (add_codes_result);
+
+  while (add_codes_result == NULL)
+    {
+      release_held_calls (fixture->provider);
+      g_main_context_iteration (NULL, TRUE);
+    }
+
+  g_assert_cmpuint (fixture->provider->n_add_code_async_calls, ==, 2);
+
+  reply = g_dbus_connection_call_finish (connection, add_codes_result, &error);
+  g_assert_no_error (error);
+
+  results = g_variant_get_child_value (reply, 0);
+  g_assert_cmpuint (g_variant_n_children (results), ==, 2);
+
+  g_variant_get_child (results, 0, "(x&s)", &time_added, &error_name);
+  g_assert_cmpint (time_added, ==, TIME_ADDED);
+  g_assert_cmpstr (error_name, ==, "");
+
+  g_variant_get_child (results, 1, "(x&s)", &time_added, &error_name);
+  g_assert_cmpint (time_added, ==, 0);
+  g_assert_cmpstr (error_name, ==, "com.endlessm.Payg1.Error.InvalidCode");
+
+  epg_manager_service_unregister (service);
+  g_clear_object (&service);
+
+  g_dbus_connection_close_sync (connection, NULL, NULL);
+  g_test_dbus_down (bus);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+#define T(path, func) \
+  g_test_add (path, Fixture, NULL, setup, func, teardown)
+
+  T ("/provider/add-code-async", test_provider_add_code_async);
+  T ("/provider/add-code-async/service", test_provider_add_code_async_service);
+  T ("/provider/add-codes-async", test_provider_add_codes_async);
+  T ("/provider/add-codes-async/service", test_provider_add_codes_async_service);
+
+#undef T
+
+  return g_test_run ();
+}
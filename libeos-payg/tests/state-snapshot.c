@@ -0,0 +1,321 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+/* For F_GET_SEALS. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <libeos-payg/state-snapshot.h>
+#include <locale.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+/* Map a file descriptor returned by epg_state_snapshot_dup_fd() as a client
+ * would. */
+static const EpgStateSnapshotData *
+map_snapshot (int fd)
+{
+  void *data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ,
+                     MAP_SHARED, fd, 0);
+  g_assert_true (data != MAP_FAILED);
+  return data;
+}
+
+/* Whether @fd is a snapshot frozen with F_SEAL_WRITE, as on kernels without
+ * F_SEAL_FUTURE_WRITE; in which case existing mappings don’t see updates. */
+static gboolean
+is_frozen (int fd)
+{
+  int seals = fcntl (fd, F_GET_SEALS);
+  g_assert_cmpint (seals, >=, 0);
+  return (seals & F_SEAL_WRITE) != 0;
+}
+
+/* Test that updates are visible through a client’s mapping, including ones
+ * made after it was mapped. */
+static void
+test_state_snapshot_update (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(EpgStateSnapshot) snapshot = NULL;
+  EpgStateSnapshotData copy;
+  gboolean ret;
+  int fd;
+
+  snapshot = epg_state_snapshot_new (&error);
+  g_assert_no_error (error);
+  g_assert_nonnull (snapshot);
+
+  fd = epg_state_snapshot_dup_fd (snapshot, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (fd, >=, 0);
+
+  if (is_frozen (fd))
+    {
+      close (fd);
+      g_test_skip ("F_SEAL_FUTURE_WRITE is not supported by this kernel");
+      return;
+    }
+
+  const EpgStateSnapshotData *data = map_snapshot (fd);
+  close (fd);
+
+  ret = epg_state_snapshot_read (data, &copy);
+  g_assert_true (ret);
+  g_assert_cmpuint (copy.magic, ==, EPG_STATE_SNAPSHOT_MAGIC);
+  g_assert_cmpuint (copy.version, ==, EPG_STATE_SNAPSHOT_VERSION);
+  g_assert_cmpuint (copy.enabled, ==, 0);
+  g_assert_cmpuint (copy.expiry_time, ==, 0);
+  g_assert_cmpuint (copy.rate_limit_end_time, ==, 0);
+
+  epg_state_snapshot_update (snapshot, TRUE, 1234, 56);
+
+  ret = epg_state_snapshot_read (data, &copy);
+  g_assert_true (ret);
+  g_assert_cmpuint (copy.enabled, ==, 1);
+  g_assert_cmpuint (copy.expiry_time, ==, 1234);
+  g_assert_cmpuint (copy.rate_limit_end_time, ==, 56);
+  g_assert_cmpuint (copy.sequence % 2, ==, 0);
+
+  guint32 old_sequence = copy.sequence;
+  epg_state_snapshot_update (snapshot, FALSE, G_MAXUINT64, 0);
+
+  ret = epg_state_snapshot_read (data, &copy);
+  g_assert_true (ret);
+  g_assert_cmpuint (copy.enabled, ==, 0);
+  g_assert_cmpuint (copy.expiry_time, ==, G_MAXUINT64);
+  g_assert_cmpuint (copy.rate_limit_end_time, ==, 0);
+  g_assert_cmpuint (copy.sequence, >, old_sequence);
+
+  munmap ((void *) data, sizeof (*data));
+}
+
+/* Test that clients can’t modify the snapshot through their file
+ * descriptor. */
+static void
+test_state_snapshot_read_only (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(EpgStateSnapshot) snapshot = NULL;
+  void *data;
+  int fd;
+
+  snapshot = epg_state_snapshot_new (&error);
+  g_assert_no_error (error);
+
+  fd = epg_state_snapshot_dup_fd (snapshot, &error);
+  g_assert_no_error (error);
+
+  data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  g_assert_true (data == MAP_FAILED);
+  g_assert_cmpint (errno, ==, EACCES);
+
+  g_assert_cmpint (ftruncate (fd, 0), <, 0);
+
+  close (fd);
+}
+
+/* Test that a client can’t get write access to the snapshot by reopening its
+ * file descriptor read-write through /proc: the memfd must be sealed against
+ * writes and writable mappings, while the daemon can still update it. */
+static void
+test_state_snapshot_reopen_read_write (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(EpgStateSnapshot) snapshot = NULL;
+  g_autofree gchar *path = NULL;
+  EpgStateSnapshotData copy;
+  const guint64 expiry_time = G_MAXUINT64;
+  void *data;
+  int fd, rw_fd, seals;
+
+  snapshot = epg_state_snapshot_new (&error);
+  g_assert_no_error (error);
+
+  fd = epg_state_snapshot_dup_fd (snapshot, &error);
+  g_assert_no_error (error);
+
+  if (is_frozen (fd))
+    {
+      close (fd);
+      g_test_skip ("F_SEAL_FUTURE_WRITE is not supported by this kernel");
+      return;
+    }
+
+  seals = fcntl (fd, F_GET_SEALS);
+  g_assert_cmpint (seals, >=, 0);
+  g_assert_cmpint (seals & F_SEAL_FUTURE_WRITE, !=, 0);
+  g_assert_cmpint (seals & F_SEAL_SEAL, !=, 0);
+
+  path = g_strdup_printf ("/proc/self/fd/%d", fd);
+  rw_fd = open (path, O_RDWR | O_CLOEXEC);
+
+  if (rw_fd < 0)
+    {
+      /* Refusing to reopen it at all would be fine too. */
+      g_test_message ("Reopening read-write failed: %s", g_strerror (errno));
+    }
+  else
+    {
+      g_assert_cmpint (pwrite (rw_fd, &expiry_time, sizeof (expiry_time),
+                               G_STRUCT_OFFSET (EpgStateSnapshotData, expiry_time)), <, 0);
+      g_assert_cmpint (errno, ==, EPERM);
+
+      data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, rw_fd, 0);
+      g_assert_true (data == MAP_FAILED);
+      g_assert_cmpint (errno, ==, EPERM);
+
+      g_assert_cmpint (ftruncate (rw_fd, 0), <, 0);
+      g_assert_cmpint (errno, ==, EPERM);
+
+      close (rw_fd);
+    }
+
+  /* The daemon’s own mapping still works, and the client sees its updates. */
+  epg_state_snapshot_update (snapshot, TRUE, 1234, 0);
+
+  data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ, MAP_SHARED, fd, 0);
+  g_assert_true (data != MAP_FAILED);
+  g_assert_true (epg_state_snapshot_read (data, &copy));
+  g_assert_cmpuint (copy.enabled, ==, 1);
+  g_assert_cmpuint (copy.expiry_time, ==, 1234);
+
+  munmap (data, sizeof (EpgStateSnapshotData));
+  close (fd);
+}
+
+/* Test the fallback for kernels without F_SEAL_FUTURE_WRITE: the memfd is
+ * frozen with F_SEAL_WRITE, so clients can’t write to it, and each update
+ * publishes a new one while existing mappings keep the old values. */
+static void
+test_state_snapshot_write_seal_fallback (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(EpgStateSnapshot) snapshot = NULL;
+  g_autofree gchar *path = NULL;
+  EpgStateSnapshotData copy;
+  const EpgStateSnapshotData *old_data, *new_data;
+  const guint64 expiry_time = G_MAXUINT64;
+  void *data;
+  int fd, rw_fd;
+
+  epg_state_snapshot_internal_set_use_future_write_seal (FALSE);
+
+  snapshot = epg_state_snapshot_new (&error);
+  g_assert_no_error (error);
+
+  fd = epg_state_snapshot_dup_fd (snapshot, &error);
+  g_assert_no_error (error);
+  g_assert_true (is_frozen (fd));
+
+  old_data = map_snapshot (fd);
+  g_assert_true (epg_state_snapshot_read (old_data, &copy));
+  g_assert_cmpuint (copy.magic, ==, EPG_STATE_SNAPSHOT_MAGIC);
+  g_assert_cmpuint (copy.version, ==, EPG_STATE_SNAPSHOT_VERSION);
+  g_assert_cmpuint (copy.expiry_time, ==, 0);
+
+  /* A client can’t write to it, even after reopening it read-write. */
+  path = g_strdup_printf ("/proc/self/fd/%d", fd);
+  rw_fd = open (path, O_RDWR | O_CLOEXEC);
+
+  if (rw_fd >= 0)
+    {
+      g_assert_cmpint (pwrite (rw_fd, &expiry_time, sizeof (expiry_time),
+                               G_STRUCT_OFFSET (EpgStateSnapshotData, expiry_time)), <, 0);
+      g_assert_cmpint (errno, ==, EPERM);
+
+      data = mmap (NULL, sizeof (EpgStateSnapshotData), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, rw_fd, 0);
+      g_assert_true (data == MAP_FAILED);
+      g_assert_cmpint (errno, ==, EPERM);
+
+      close (rw_fd);
+    }
+
+  close (fd);
+
+  /* Updates are published in a new memfd. */
+  epg_state_snapshot_update (snapshot, TRUE, 1234, 56);
+
+  fd = epg_state_snapshot_dup_fd (snapshot, &error);
+  g_assert_no_error (error);
+  g_assert_true (is_frozen (fd));
+
+  new_data = map_snapshot (fd);
+  close (fd);
+
+  g_assert_true (epg_state_snapshot_read (new_data, &copy));
+  g_assert_cmpuint (copy.enabled, ==, 1);
+  g_assert_cmpuint (copy.expiry_time, ==, 1234);
+  g_assert_cmpuint (copy.rate_limit_end_time, ==, 56);
+
+  g_assert_true (epg_state_snapshot_read (old_data, &copy));
+  g_assert_cmpuint (copy.expiry_time, ==, 0);
+
+  munmap ((void *) new_data, sizeof (*new_data));
+  munmap ((void *) old_data, sizeof (*old_data));
+
+  epg_state_snapshot_internal_set_use_future_write_seal (TRUE);
+}
+
+/* Test that a mapping which isn’t a state snapshot is rejected, as is one
+ * which is stuck half way through an update. */
+static void
+test_state_snapshot_read_invalid (void)
+{
+  EpgStateSnapshotData data = { 0, };
+  EpgStateSnapshotData copy;
+
+  g_assert_false (epg_state_snapshot_read (&data, &copy));
+
+  data.magic = EPG_STATE_SNAPSHOT_MAGIC;
+  data.version = EPG_STATE_SNAPSHOT_VERSION;
+  g_assert_true (epg_state_snapshot_read (&data, &copy));
+
+  data.sequence = 1;
+  g_assert_false (epg_state_snapshot_read (&data, &copy));
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/state-snapshot/update", test_state_snapshot_update);
+  g_test_add_func ("/state-snapshot/read-only", test_state_snapshot_read_only);
+  g_test_add_func ("/state-snapshot/reopen-read-write", test_state_snapshot_reopen_read_write);
+  g_test_add_func ("/state-snapshot/write-seal-fallback", test_state_snapshot_write_seal_fallback);
+  g_test_add_func ("/state-snapshot/read-invalid", test_state_snapshot_read_invalid);
+
+  return g_test_run ();
+}
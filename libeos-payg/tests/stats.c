@@ -0,0 +1,148 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libeos-payg/errors.h>
+#include <libeos-payg/stats.h>
+#include <locale.h>
+
+/* Test that counters start at zero, increment independently, and are
+ * cleared by epg_stats_reset(). */
+static void
+test_stats_counters (void)
+{
+  epg_stats_reset ();
+
+  for (gsize i = 0; i < EPG_STATS_N_COUNTERS; i++)
+    g_assert_cmpuint (epg_stats_get (i), ==, 0);
+
+  epg_stats_increment (EPG_STATS_CODES_ATTEMPTED);
+  epg_stats_increment (EPG_STATS_CODES_ATTEMPTED);
+  epg_stats_increment (EPG_STATS_EFI_WRITES);
+
+  g_assert_cmpuint (epg_stats_get (EPG_STATS_CODES_ATTEMPTED), ==, 2);
+  g_assert_cmpuint (epg_stats_get (EPG_STATS_EFI_WRITES), ==, 1);
+  g_assert_cmpuint (epg_stats_get (EPG_STATS_EFI_READS), ==, 0);
+
+  epg_stats_reset ();
+
+  g_assert_cmpuint (epg_stats_get (EPG_STATS_CODES_ATTEMPTED), ==, 0);
+}
+
+/* Test that rejected codes are counted by reason, with errors from other
+ * domains counted as ‘Other’. */
+static void
+test_stats_codes_rejected (void)
+{
+  g_autoptr(GError) invalid_error = NULL;
+  g_autoptr(GError) rate_limit_error = NULL;
+  g_autoptr(GError) other_error = NULL;
+
+  epg_stats_reset ();
+
+  invalid_error = g_error_new_literal (EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_INVALID_CODE, "Invalid");
+  rate_limit_error = g_error_new_literal (EPG_MANAGER_ERROR, EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS, "Too many");
+  other_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED, "Cancelled");
+
+  epg_stats_record_code_rejected (invalid_error);
+  epg_stats_record_code_rejected (invalid_error);
+  epg_stats_record_code_rejected (rate_limit_error);
+  epg_stats_record_code_rejected (other_error);
+
+  g_assert_cmpuint (epg_stats_get_codes_rejected (EPG_MANAGER_ERROR_INVALID_CODE), ==, 2);
+  g_assert_cmpuint (epg_stats_get_codes_rejected (EPG_MANAGER_ERROR_TOO_MANY_ATTEMPTS), ==, 1);
+  g_assert_cmpuint (epg_stats_get_codes_rejected (EPG_MANAGER_ERROR_DISABLED), ==, 0);
+  g_assert_cmpuint (epg_stats_get_codes_rejected (-1), ==, 1);
+
+  g_autoptr(GVariant) rejected = g_variant_ref_sink (epg_stats_dup_codes_rejected ());
+  g_autoptr(GVariant) expected = g_variant_ref_sink (
+      g_variant_new_parsed ("{'InvalidCode': uint64 2, 'TooManyAttempts': 1, 'Other': 1}"));
+  g_assert_true (g_variant_equal (rejected, expected));
+}
+
+/* Test the nearest-rank percentiles of save latencies, including once the
+ * window of recent values has wrapped around. */
+static void
+test_stats_save_latency (void)
+{
+  epg_stats_reset ();
+
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (50), ==, 0);
+
+  /* Record 1..100 in reverse order. */
+  for (gint64 i = 100; i > 0; i--)
+    epg_stats_record_save_latency (i);
+
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (0), ==, 1);
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (50), ==, 50);
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (99), ==, 99);
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (100), ==, 100);
+
+  /* Push all of those out of the window. */
+  for (gsize i = 0; i < 1000; i++)
+    epg_stats_record_save_latency (7);
+
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (0), ==, 7);
+  g_assert_cmpint (epg_stats_get_save_latency_percentile (99), ==, 7);
+}
+
+/* Test the maximum expiry lateness, uptime and startup phases. */
+static void
+test_stats_misc (void)
+{
+  epg_stats_reset ();
+
+  g_assert_cmpuint (epg_stats_get_uptime (), ==, 0);
+  epg_stats_set_start_time (g_get_monotonic_time () - 5 * G_USEC_PER_SEC);
+  g_assert_cmpuint (epg_stats_get_uptime (), >=, 5);
+
+  epg_stats_record_expiry_lateness (3);
+  epg_stats_record_expiry_lateness (10);
+  epg_stats_record_expiry_lateness (0);
+  g_assert_cmpuint (epg_stats_get_expiry_lateness_max (), ==, 10);
+
+  epg_stats_set_startup_phase ("efi_init", 100);
+  epg_stats_set_startup_phase ("secure_init", 2000);
+  epg_stats_set_startup_phase ("efi_init", 150);
+
+  g_autoptr(GVariant) phases = g_variant_ref_sink (epg_stats_dup_startup_phases ());
+  g_autoptr(GVariant) expected = g_variant_ref_sink (
+      g_variant_new_parsed ("[('efi_init', int64 150), ('secure_init', 2000)]"));
+  g_assert_true (g_variant_equal (phases, expected));
+
+  epg_stats_reset ();
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/stats/counters", test_stats_counters);
+  g_test_add_func ("/stats/codes-rejected", test_stats_codes_rejected);
+  g_test_add_func ("/stats/save-latency", test_stats_save_latency);
+  g_test_add_func ("/stats/misc", test_stats_misc);
+
+  return g_test_run ();
+}
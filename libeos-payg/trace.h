@@ -0,0 +1,66 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright © 2026 Endless OS Foundation LLC
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License,
+ * v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ * obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * GNU Lesser General Public License Version 2.1 or later (the "LGPL"), in
+ * which case the provisions of the LGPL are applicable instead of those above.
+ * If you wish to allow use of your version of this file only under the terms
+ * of the LGPL, and not to allow others to use your version of this file under
+ * the terms of the MPL, indicate your decision by deleting the provisions
+ * above and replace them with the notice and other provisions required by the
+ * LGPL. If you do not delete the provisions above, a recipient may use your
+ * version of this file under the terms of either the MPL or the LGPL.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Static tracepoints (USDT probes) in the `eos_payg` provider, for use with
+ * bpftrace, perf, SystemTap, etc. on production builds. For example:
+ *
+ *    bpftrace -e 'usdt:/usr/libexec/eos-paygd1:eos_payg:clock_jump
+ *                 { printf("%d\n", arg0); }'
+ *
+ * A disabled probe costs a single nop. If `sys/sdt.h` was not available at
+ * build time, the probes are compiled out entirely, but their arguments are
+ * still evaluated so that they don’t trigger unused variable warnings.
+ *
+ * The config.h header must be included before this one.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define EPG_TRACE0(name) \
+  DTRACE_PROBE (eos_payg, name)
+#define EPG_TRACE1(name, a1) \
+  DTRACE_PROBE1 (eos_payg, name, a1)
+#define EPG_TRACE2(name, a1, a2) \
+  DTRACE_PROBE2 (eos_payg, name, a1, a2)
+#define EPG_TRACE3(name, a1, a2, a3) \
+  DTRACE_PROBE3 (eos_payg, name, a1, a2, a3)
+
+#else  /* if !HAVE_SYS_SDT_H */
+
+#define EPG_TRACE0(name) \
+  G_STMT_START { } G_STMT_END
+#define EPG_TRACE1(name, a1) \
+  G_STMT_START { (void) (a1); } G_STMT_END
+#define EPG_TRACE2(name, a1, a2) \
+  G_STMT_START { (void) (a1); (void) (a2); } G_STMT_END
+#define EPG_TRACE3(name, a1, a2, a3) \
+  G_STMT_START { (void) (a1); (void) (a2); (void) (a3); } G_STMT_END
+
+#endif  /* !HAVE_SYS_SDT_H */
+
+G_END_DECLS
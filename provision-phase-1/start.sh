@@ -12,7 +12,23 @@ done
 clear
 echo "Provisioning payg..."
 echo "Please wait."
-device_id=$(python3 /var/eos-factory-test/code_gen.py)
+# The USB stick is the one containing this tool's tarball
+usb_path=
+for tarball in /run/media/root/*/Endless_Factory_Test.tar
+do
+    if [ -f "$tarball" ]; then
+        usb_path=$(dirname "$tarball")
+        break
+    fi
+done
+if [ -z "$usb_path" ]; then
+    echo "Could not find the USB device containing Endless_Factory_Test.tar" >&2
+    exit 1
+fi
+if ! device_id=$(/var/eos-factory-test/eos-payg-provision-1 "$usb_path"); then
+    echo "PROVISIONING FAILED. Please check the USB device and try again." >&2
+    exit 1
+fi
 echo ""
 echo "YOUR DEVICE ID IS $device_id. PLEASE WRITE THIS DOWN!"
 rm -rf /var/eos-factory-test